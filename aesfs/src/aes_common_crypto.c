@@ -24,12 +24,14 @@
 #include <stdio.h>
 
 #include "crypto.h"
+#include "stats.h"
 
 struct crypto_aes {
     CCCryptorRef  enc;
     CCCryptorRef  dec;
     unsigned char iv[32];
-    pthread_mutex_t lock;
+    pthread_mutex_t enc_lock;
+    pthread_mutex_t dec_lock;
 };
 
 #define __aes_cryptor_create(cryptor, op, key, iv)                          \
@@ -38,6 +40,8 @@ struct crypto_aes {
 
 static int __aes_process (crypto_aes_t *crypto,
                           CCCryptorRef cryptor,
+                          pthread_mutex_t *lock,
+                          iostat_id_t lock_stat,
                           const void *src,
                           unsigned int src_size,
                           void *dst,
@@ -46,14 +50,17 @@ static int __aes_process (crypto_aes_t *crypto,
     size_t out_avail;
     size_t used = 0;
     uint8_t *outp;
+    uint64_t start;
     size_t moved;
 
-    pthread_mutex_lock(&(crypto->lock));
+    start = iostat_now();
+    pthread_mutex_lock(lock);
+    iostat_add(lock_stat, start, 0, 0);
 
     outp = (uint8_t *)dst;
     out_avail = src_size + 16;
     if (CCCryptorUpdate(cryptor, src, src_size, outp, out_avail, &moved)) {
-        pthread_mutex_unlock(&(crypto->lock));
+        pthread_mutex_unlock(lock);
         CCCryptorReset(cryptor, crypto->iv);
         return(-2);
     }
@@ -62,7 +69,7 @@ static int __aes_process (crypto_aes_t *crypto,
     used += moved;
     out_avail -= moved;
     if (CCCryptorFinal(cryptor, outp, out_avail, &moved)) {
-        pthread_mutex_unlock(&(crypto->lock));
+        pthread_mutex_unlock(lock);
         CCCryptorReset(cryptor, crypto->iv);
         return(-3);
     }
@@ -72,7 +79,7 @@ static int __aes_process (crypto_aes_t *crypto,
         *dst_size = used;
 
     CCCryptorReset(cryptor, crypto->iv);
-    pthread_mutex_unlock(&(crypto->lock));
+    pthread_mutex_unlock(lock);
     return(0);
 }
 
@@ -93,14 +100,21 @@ crypto_aes_t *crypto_aes_open (const void *key,
         return(NULL);
     }
 
-    if (pthread_mutex_init(&(crypto->lock), NULL)) {
+    if (pthread_mutex_init(&(crypto->enc_lock), NULL)) {
+        free(crypto);
+        return(NULL);
+    }
+
+    if (pthread_mutex_init(&(crypto->dec_lock), NULL)) {
+        pthread_mutex_destroy(&(crypto->enc_lock));
         free(crypto);
         return(NULL);
     }
 
     /* Initialize Encryption */
     if (__aes_cryptor_create(&(crypto->enc), kCCEncrypt, ikey, crypto->iv)) {
-        pthread_mutex_destroy(&(crypto->lock));
+        pthread_mutex_destroy(&(crypto->enc_lock));
+        pthread_mutex_destroy(&(crypto->dec_lock));
         free(crypto);
         return(NULL);
     }
@@ -108,7 +122,8 @@ crypto_aes_t *crypto_aes_open (const void *key,
     /* Initialize Decryption */
     if (__aes_cryptor_create(&(crypto->dec), kCCDecrypt, ikey, crypto->iv)) {
         CCCryptorRelease(crypto->enc);
-        pthread_mutex_destroy(&(crypto->lock));
+        pthread_mutex_destroy(&(crypto->enc_lock));
+        pthread_mutex_destroy(&(crypto->dec_lock));
         free(crypto);
         return(NULL);
     }
@@ -119,7 +134,8 @@ crypto_aes_t *crypto_aes_open (const void *key,
 void crypto_aes_close (crypto_aes_t *crypto) {
     CCCryptorRelease(crypto->enc);
     CCCryptorRelease(crypto->dec);
-    pthread_mutex_destroy(&(crypto->lock));
+    pthread_mutex_destroy(&(crypto->enc_lock));
+    pthread_mutex_destroy(&(crypto->dec_lock));
     free(crypto);
 }
 
@@ -129,7 +145,8 @@ int crypto_aes_encrypt (crypto_aes_t *crypto,
                         void *dst,
                         unsigned int *dst_size)
 {
-    return(__aes_process(crypto, crypto->enc, src, src_size, dst, dst_size));
+    return(__aes_process(crypto, crypto->enc, &(crypto->enc_lock),
+                         IOSTAT_LOCK_AES_ENCODE, src, src_size, dst, dst_size));
 }
 
 int crypto_aes_decrypt (crypto_aes_t *crypto,
@@ -138,7 +155,8 @@ int crypto_aes_decrypt (crypto_aes_t *crypto,
                         void *dst,
                         unsigned int *dst_size)
 {
-    return(__aes_process(crypto, crypto->dec, src, src_size, dst, dst_size));
+    return(__aes_process(crypto, crypto->dec, &(crypto->dec_lock),
+                         IOSTAT_LOCK_AES_DECODE, src, src_size, dst, dst_size));
 }
 
 #endif /* CRYPTO_COMMON_CRYPTO */
@@ -25,11 +25,13 @@
 #include <openssl/evp.h>
 
 #include "crypto.h"
+#include "stats.h"
 
 struct crypto_aes {
     EVP_CIPHER_CTX enc;
     EVP_CIPHER_CTX dec;
-    pthread_mutex_t lock;
+    pthread_mutex_t enc_lock;
+    pthread_mutex_t dec_lock;
 };
 
 crypto_aes_t *crypto_aes_open (const void *key,
@@ -49,7 +51,13 @@ crypto_aes_t *crypto_aes_open (const void *key,
     if ((crypto = (crypto_aes_t *) malloc(sizeof(crypto_aes_t))) == NULL)
         return(NULL);
 
-    if (pthread_mutex_init(&(crypto->lock), NULL)) {
+    if (pthread_mutex_init(&(crypto->enc_lock), NULL)) {
+        free(crypto);
+        return(NULL);
+    }
+
+    if (pthread_mutex_init(&(crypto->dec_lock), NULL)) {
+        pthread_mutex_destroy(&(crypto->enc_lock));
         free(crypto);
         return(NULL);
     }
@@ -58,7 +66,8 @@ crypto_aes_t *crypto_aes_open (const void *key,
     EVP_CIPHER_CTX_init(&(crypto->enc));
     if (!EVP_EncryptInit_ex(&(crypto->enc), EVP_aes_256_cbc(), NULL, ikey, iv)) {
         EVP_CIPHER_CTX_cleanup(&(crypto->enc));
-        pthread_mutex_destroy(&(crypto->lock));
+        pthread_mutex_destroy(&(crypto->enc_lock));
+        pthread_mutex_destroy(&(crypto->dec_lock));
         free(crypto);
         return(NULL);
     }
@@ -68,7 +77,8 @@ crypto_aes_t *crypto_aes_open (const void *key,
     if (!EVP_DecryptInit_ex(&(crypto->dec), EVP_aes_256_cbc(), NULL, ikey, iv)) {
         EVP_CIPHER_CTX_cleanup(&(crypto->enc));
         EVP_CIPHER_CTX_cleanup(&(crypto->dec));
-        pthread_mutex_destroy(&(crypto->lock));
+        pthread_mutex_destroy(&(crypto->enc_lock));
+        pthread_mutex_destroy(&(crypto->dec_lock));
         free(crypto);
         return(NULL);
     }
@@ -79,7 +89,8 @@ crypto_aes_t *crypto_aes_open (const void *key,
 void crypto_aes_close (crypto_aes_t *crypto) {
     EVP_CIPHER_CTX_cleanup(&(crypto->enc));
     EVP_CIPHER_CTX_cleanup(&(crypto->dec));
-    pthread_mutex_destroy(&(crypto->lock));
+    pthread_mutex_destroy(&(crypto->enc_lock));
+    pthread_mutex_destroy(&(crypto->dec_lock));
     free(crypto);
 }
 
@@ -90,14 +101,17 @@ int crypto_aes_encrypt (crypto_aes_t *crypto,
                         unsigned int *dst_size)
 {
     EVP_CIPHER_CTX *e = &(crypto->enc);
+    uint64_t start;
     int psize = 0;
     int fsize = 0;
 
-    pthread_mutex_lock(&(crypto->lock));
+    start = iostat_now();
+    pthread_mutex_lock(&(crypto->enc_lock));
+    iostat_add(IOSTAT_LOCK_AES_ENCODE, start, 0, 0);
 
     /* allows reusing of 'e' for multiple encryption cycles */
     if (!EVP_EncryptInit_ex(e, NULL, NULL, NULL, NULL)) {
-        pthread_mutex_unlock(&(crypto->lock));
+        pthread_mutex_unlock(&(crypto->enc_lock));
         return(-1);
     }
 
@@ -105,20 +119,20 @@ int crypto_aes_encrypt (crypto_aes_t *crypto,
      * generated, *len is the size of plaintext in bytes
      */
     if (!EVP_EncryptUpdate(e, dst, &psize, src, src_size)) {
-        pthread_mutex_unlock(&(crypto->lock));
+        pthread_mutex_unlock(&(crypto->enc_lock));
         return(-2);
     }
 
     /* update ciphertext with the final remaining bytes */
     if (!EVP_EncryptFinal_ex(e, dst + psize, &fsize)) {
-        pthread_mutex_unlock(&(crypto->lock));
+        pthread_mutex_unlock(&(crypto->enc_lock));
         return(-3);
     }
 
     if (dst_size != NULL)
         *dst_size = psize + fsize;
 
-    pthread_mutex_unlock(&(crypto->lock));
+    pthread_mutex_unlock(&(crypto->enc_lock));
     return(0);
 }
 
@@ -129,30 +143,33 @@ int crypto_aes_decrypt (crypto_aes_t *crypto,
                         unsigned int *dst_size)
 {
     EVP_CIPHER_CTX *e = &(crypto->dec);
+    uint64_t start;
     int psize = 0;
     int fsize = 0;
 
-    pthread_mutex_lock(&(crypto->lock));
+    start = iostat_now();
+    pthread_mutex_lock(&(crypto->dec_lock));
+    iostat_add(IOSTAT_LOCK_AES_DECODE, start, 0, 0);
 
     if (!EVP_DecryptInit_ex(e, NULL, NULL, NULL, NULL)) {
-        pthread_mutex_unlock(&(crypto->lock));
+        pthread_mutex_unlock(&(crypto->dec_lock));
         return(-1);
     }
 
     if (!EVP_DecryptUpdate(e, dst, &psize, src, src_size)) {
-        pthread_mutex_unlock(&(crypto->lock));
+        pthread_mutex_unlock(&(crypto->dec_lock));
         return(-2);
     }
 
     if (!EVP_DecryptFinal_ex(e, dst + psize, &fsize)) {
-        pthread_mutex_unlock(&(crypto->lock));
+        pthread_mutex_unlock(&(crypto->dec_lock));
         return(-3);
     }
 
     if (dst_size != NULL)
         *dst_size = psize + fsize;
 
-    pthread_mutex_unlock(&(crypto->lock));
+    pthread_mutex_unlock(&(crypto->dec_lock));
     return(0);
 }
 
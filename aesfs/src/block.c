@@ -14,33 +14,50 @@
  *   limitations under the License.
  */
 
+#define _GNU_SOURCE
+
+#include <sys/stat.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <string.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <fcntl.h>
+#include <errno.h>
 #include <stdio.h>
 
 #include "crypto.h"
 #include "block.h"
+#include "stats.h"
+
+#define __min(a, b)              (((a) < (b)) ? (a) : (b))
 
-#define __align_down(x, size)    (((x) / (size)) * (size))
-#define __ioblock_offset(x)      (IOFHEAD_SIZE + (((x) / IOBLOCK_USER_SIZE) * IOBLOCK_DISK_SIZE))
+#define __ioblock_count(size)                                               \
+    __min(IOBLOCK_BATCH, ((size) + IOBLOCK_USER_SIZE - 1) / IOBLOCK_USER_SIZE)
 
-typedef struct ioblock ioblock_t;
+static int __is_zero (const void *data, size_t size) {
+    const uint64_t *p = (const uint64_t *)data;
 
-struct ioblock {
-    iohead_t head;
-    uint8_t  body[IOBLOCK_BODY_SIZE];
-} __attribute__((__packed__));
+    for (; size >= 8; size -= 8) {
+        if (*p++ != 0)
+            return(0);
+    }
+
+    return(1);
+}
 
 size_t ioread (int fd, void *buf, size_t size, off_t off) {
     unsigned char *pbuf = (unsigned char *)buf;
+    uint64_t start;
     ssize_t rd;
     size_t n;
 
     n = 0;
     while (n < size) {
-        if ((rd = pread(fd, pbuf + n, size - n, off + n)) <= 0)
+        start = iostat_now();
+        rd = pread(fd, pbuf + n, size - n, off + n);
+        iostat_add(IOSTAT_SYS_PREAD, start, (rd > 0) ? rd : 0, rd < 0);
+        if (rd <= 0)
             break;
 
         n += rd;
@@ -52,12 +69,16 @@ size_t ioread (int fd, void *buf, size_t size, off_t off) {
 
 size_t iowrite (int fd, const void *buf, size_t size, off_t off) {
     const unsigned char *pbuf = (const unsigned char *)buf;
+    uint64_t start;
     ssize_t wr;
     size_t n;
 
     n = 0;
     while (n < size) {
-        if ((wr = pwrite(fd, pbuf + n, size - n, off + n)) <= 0)
+        start = iostat_now();
+        wr = pwrite(fd, pbuf + n, size - n, off + n);
+        iostat_add(IOSTAT_SYS_PWRITE, start, (wr > 0) ? wr : 0, wr < 0);
+        if (wr <= 0)
             break;
 
         n += wr;
@@ -80,34 +101,140 @@ int iofhead_write (int fd, const struct iofhead *fhead) {
     return(iowrite(fd, fhead, IOFHEAD_SIZE, 0) != IOFHEAD_SIZE);
 }
 
-#define __ioblock_read(fd, block, offset)                                   \
-    ioread(fd, block, sizeof(ioblock_t), offset)
+static int __ioblock_encode (iocodec_t *codec, ioblock_t *dblock, const ioblock_t *ublock) {
+    uint64_t start = iostat_now();
+    int res = codec->plug->encode(&(codec->data), dblock, ublock);
+    iostat_add(IOSTAT_BLOCK_ENCODE, start, IOBLOCK_DISK_SIZE, res);
+    return(res);
+}
 
-#define __ioblock_write(fd, block, offset)                                  \
-    iowrite(fd, block, sizeof(ioblock_t), offset)
+static int __ioblock_decode (iocodec_t *codec, ioblock_t *ublock, const ioblock_t *dblock) {
+    uint64_t start = iostat_now();
+    int res = codec->plug->decode(&(codec->data), ublock, dblock);
+    iostat_add(IOSTAT_BLOCK_DECODE, start, IOBLOCK_DISK_SIZE, res);
+    return(res);
+}
 
-#define __ioblock_encode(codec, dblock, ublock)                             \
-    ((codec)->plug->encode(&((codec)->data), dblock, ublock))
+static uint32_t __ioblock_crc (const ioblock_t *ublock) {
+    uint64_t start = iostat_now();
+    uint32_t crc = crc32c(ublock->body, ublock->head.length);
+    iostat_add(IOSTAT_BLOCK_CRC, start, ublock->head.length, 0);
+    return(crc);
+}
 
-#define __ioblock_decode(codec, ublock, dblock)                             \
-    ((codec)->plug->decode(&((codec)->data), ublock, dblock))
+/* ============================================================================
+ *  Batch buffers pool
+ */
+#define IOBLOCK_POOL_MAX         (64)
 
-static int __ioblock_fetch (iocodec_t *codec,
-                            int fd,
-                            off_t offset,
-                            ioblock_t *dblock,
-                            ioblock_t *ublock)
+static pthread_mutex_t __ioblock_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static ioblock_t *__ioblock_pool[IOBLOCK_POOL_MAX];
+static unsigned int __ioblock_pool_size;
+
+/* Page aligned buffer of IOBLOCK_BATCH disk blocks */
+ioblock_t *ioblock_batch_alloc (void) {
+    ioblock_t *dblocks = NULL;
+    void *buffer;
+
+    pthread_mutex_lock(&__ioblock_pool_lock);
+    if (__ioblock_pool_size > 0)
+        dblocks = __ioblock_pool[--__ioblock_pool_size];
+    pthread_mutex_unlock(&__ioblock_pool_lock);
+
+    if (dblocks != NULL)
+        return(dblocks);
+
+    if (posix_memalign(&buffer, IOBLOCK_DISK_SIZE, IOBLOCK_BATCH_SIZE))
+        return(NULL);
+
+    return((ioblock_t *)buffer);
+}
+
+void ioblock_batch_free (ioblock_t *dblocks) {
+    pthread_mutex_lock(&__ioblock_pool_lock);
+    if (__ioblock_pool_size < IOBLOCK_POOL_MAX) {
+        __ioblock_pool[__ioblock_pool_size++] = dblocks;
+        dblocks = NULL;
+    }
+    pthread_mutex_unlock(&__ioblock_pool_lock);
+
+    free(dblocks);
+}
+
+/* ============================================================================
+ *  Uncached I/O
+ */
+/*
+ * O_DIRECT does not fit the file layout: blocks are 16 bytes off the
+ * page grid (file header), and a direct write of a block would need a
+ * read-modify-write of the pages shared with its neighbours. The
+ * ciphertext is dropped from the page cache after the I/O instead,
+ * written pages are flushed first, so writes are synchronous.
+ */
+static void __iocache_drop (int fd, off_t offset, size_t size, int dirty) {
+#ifdef SYNC_FILE_RANGE_WRITE
+    if (dirty) {
+        sync_file_range(fd, offset, size, SYNC_FILE_RANGE_WAIT_BEFORE |
+                                          SYNC_FILE_RANGE_WRITE |
+                                          SYNC_FILE_RANGE_WAIT_AFTER);
+    }
+#endif
+#ifdef POSIX_FADV_DONTNEED
+    posix_fadvise(fd, offset, size, POSIX_FADV_DONTNEED);
+#endif
+}
+
+int ioblock_read_batch (iocodec_t *codec,
+                        int fd,
+                        uint64_t index,
+                        unsigned int count,
+                        ioblock_t *dblocks)
+{
+    off_t offset = IOBLOCK_DISK_OFFSET(index);
+    size_t rd;
+
+    rd = ioread(fd, dblocks, count * IOBLOCK_DISK_SIZE, offset);
+    if (codec->flags & IOBLOCK_FLAG_UNCACHED)
+        __iocache_drop(fd, offset, rd, 0);
+
+    /* A trailing partial block is returned, and will fail to decode */
+    return((rd + IOBLOCK_DISK_SIZE - 1) / IOBLOCK_DISK_SIZE);
+}
+
+/*
+ * An all-zero disk block is a hole only if it was never written: part of
+ * it is unallocated (punched, or extended by ftruncate) or past the end
+ * of file. Encoded blocks are written whole, so zeroed or torn ciphertext
+ * is allocated and is not mistaken for a hole.
+ */
+static int __ioblock_is_hole (int fd, uint64_t index) {
+    off_t offset = IOBLOCK_DISK_OFFSET(index);
+    off_t hole;
+
+    if ((hole = lseek(fd, offset, SEEK_HOLE)) < 0)
+        return(errno == ENXIO);
+
+    return(hole < (off_t)(offset + IOBLOCK_DISK_SIZE));
+}
+
+int ioblock_decode (iocodec_t *codec,
+                    int fd,
+                    uint64_t index,
+                    ioblock_t *ublock,
+                    const ioblock_t *dblock)
 {
     uint32_t crc;
-    ssize_t rd;
 
-    if ((rd = __ioblock_read(fd, dblock, offset)) == 0) {
-        memset(ublock, 0, sizeof(ioblock_t));
-        return(1);
-    }
+    /* An all-zero disk block is a hole: a full block of zeros */
+    if (__is_zero(dblock, IOBLOCK_DISK_SIZE)) {
+        if (!__ioblock_is_hole(fd, index))
+            return(-5);
 
-    if (rd != IOBLOCK_DISK_SIZE)
-        return(-1);
+        memset(ublock, 0, IOBLOCK_PLAIN_SIZE);
+        ublock->head.magic = IOBLOCK_MAGIC;
+        ublock->head.length = IOBLOCK_USER_SIZE;
+        return(0);
+    }
 
     if (__ioblock_decode(codec, ublock, dblock))
         return(-2);
@@ -116,8 +243,11 @@ static int __ioblock_fetch (iocodec_t *codec,
     if (ublock->head.magic != IOBLOCK_MAGIC)
         return(-3);
 
+    if (ublock->head.length > IOBLOCK_USER_SIZE)
+        return(-3);
+
     /* Check crc */
-    crc = crc32c(ublock->body, ublock->head.length);
+    crc = __ioblock_crc(ublock);
     if (ublock->head.crc != crc) {
         fprintf(stderr, "fetch(): FAIL CRC %u != %u\n", ublock->head.crc, crc);
         return(-4);
@@ -126,60 +256,461 @@ static int __ioblock_fetch (iocodec_t *codec,
     return(0);
 }
 
-static int __ioblock_store (iocodec_t *codec,
+static int __ioblock_fetch (iocodec_t *codec,
                             int fd,
-                            off_t offset,
+                            uint64_t index,
                             ioblock_t *dblock,
                             ioblock_t *ublock)
+{
+    if (ioblock_read_batch(codec, fd, index, 1, dblock) == 0) {
+        memset(ublock, 0, sizeof(ioblock_t));
+        return(1);
+    }
+
+    return(ioblock_decode(codec, fd, index, ublock, dblock));
+}
+
+static int __ioblock_encode_block (iocodec_t *codec,
+                                   ioblock_t *dblock,
+                                   ioblock_t *ublock)
 {
     ublock->head.magic = IOBLOCK_MAGIC;
-    ublock->head.crc = crc32c(ublock->body, ublock->head.length);
+    ublock->head.crc = __ioblock_crc(ublock);
+    return(__ioblock_encode(codec, dblock, ublock));
+}
+
+static int __ioblock_store_batch (iocodec_t *codec,
+                                  int fd,
+                                  uint64_t index,
+                                  unsigned int count,
+                                  const ioblock_t *dblocks)
+{
+    off_t offset = IOBLOCK_DISK_OFFSET(index);
+    size_t size = count * IOBLOCK_DISK_SIZE;
 
-    if (__ioblock_encode(codec, dblock, ublock))
+    if (iowrite(fd, dblocks, size, offset) != size)
         return(-1);
 
-    if (__ioblock_write(fd, dblock, offset) != IOBLOCK_DISK_SIZE)
-        return(-2);
+    if (codec->flags & IOBLOCK_FLAG_UNCACHED)
+        __iocache_drop(fd, offset, size, 1);
+
+    return(0);
+}
+
+static int __ioblock_store_zero (iocodec_t *codec,
+                                 int fd,
+                                 uint64_t index,
+                                 ioblock_t *dblock)
+{
+    ioblock_t ublock;
+
+    memset(&ublock, 0, sizeof(ioblock_t));
+    ublock.head.length = IOBLOCK_USER_SIZE;
+    if (__ioblock_encode_block(codec, dblock, &ublock))
+        return(-1);
+
+    return(__ioblock_store_batch(codec, fd, index, 1, dblock));
+}
+
+/*
+ * Replace the blocks with a hole. Blocks are not aligned to the
+ * filesystem pages (the file header is in front), so only the pages
+ * fully covered by a run of zero blocks are released: the blocks left
+ * without an unallocated range are stored encoded (see __ioblock_seal).
+ */
+static int __ioblock_punch_hole (int fd, uint64_t index, unsigned int count) {
+    off_t offset = IOBLOCK_DISK_OFFSET(index);
+    off_t length = count * IOBLOCK_DISK_SIZE;
+    struct stat st;
+
+    if (fstat(fd, &st))
+        return(-1);
+
+    /* Beyond the end of file, just extend it */
+    if (offset >= st.st_size)
+        return(ftruncate(fd, offset + length));
+
+#ifdef FALLOC_FL_PUNCH_HOLE
+    if (!fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, length)) {
+        if ((offset + length) > st.st_size)
+            return(ftruncate(fd, offset + length));
+        return(0);
+    }
+#endif
+
+    /* No hole punching support, all the blocks are stored encoded */
+    return(0);
+}
+
+/*
+ * Store as encoded zero blocks the blocks of the hole run that are not
+ * seen as holes (see __ioblock_is_hole). Storing a block allocates the
+ * pages shared with its neighbours, so loop until the run is stable.
+ */
+static int __ioblock_seal (iocodec_t *codec,
+                           int fd,
+                           uint64_t index,
+                           unsigned int count,
+                           ioblock_t *dblocks)
+{
+    uint32_t sealed = 0;
+    unsigned int i;
+    int changed;
+
+    do {
+        changed = 0;
+        for (i = 0; i < count; ++i) {
+            if ((sealed & (1U << i)) || __ioblock_is_hole(fd, index + i))
+                continue;
+
+            if (__ioblock_store_zero(codec, fd, index + i, &dblocks[i]))
+                return(-1);
+
+            sealed |= (1U << i);
+            changed = 1;
+        }
+    } while (changed);
 
     return(0);
 }
 
+static int __ioblock_store_hole (iocodec_t *codec,
+                                 int fd,
+                                 uint64_t index,
+                                 unsigned int count,
+                                 ioblock_t *dblocks)
+{
+    uint64_t start = iostat_now();
+    int res;
+
+    if (!(res = __ioblock_punch_hole(fd, index, count)))
+        res = __ioblock_seal(codec, fd, index, count, dblocks);
+
+    iostat_add(IOSTAT_BLOCK_HOLE, start, count * IOBLOCK_DISK_SIZE, res);
+    return(res);
+}
+
+/*
+ * A neighbour hole may lose its unallocated range, when the write
+ * allocates the page shared with it: store it as an encoded zero block.
+ * It is read back first, to not overwrite a concurrent write.
+ */
+static int __ioblock_seal_neighbour (iocodec_t *codec,
+                                     int fd,
+                                     uint64_t index,
+                                     ioblock_t *dblock)
+{
+    if (__ioblock_is_hole(fd, index))
+        return(0);
+
+    if (ioread(fd, dblock, IOBLOCK_DISK_SIZE, IOBLOCK_DISK_OFFSET(index)) != IOBLOCK_DISK_SIZE)
+        return(-1);
+
+    if (!__is_zero(dblock, IOBLOCK_DISK_SIZE))
+        return(0);
+
+    return(__ioblock_store_zero(codec, fd, index, dblock));
+}
+
+static int __ioblock_flush (iocodec_t *codec,
+                            int fd,
+                            uint64_t index,
+                            unsigned int count,
+                            ioblock_t *dblocks,
+                            int holes)
+{
+    int prev, next;
+    int res;
+
+    prev = (index > 0 && __ioblock_is_hole(fd, index - 1));
+    next = __ioblock_is_hole(fd, index + count);
+
+    if (holes)
+        res = __ioblock_store_hole(codec, fd, index, count, dblocks);
+    else
+        res = __ioblock_store_batch(codec, fd, index, count, dblocks);
+
+    /* The blocks are written, dblocks is free to use as scratch */
+    if (!res && prev)
+        res = __ioblock_seal_neighbour(codec, fd, index - 1, &dblocks[0]);
+
+    if (!res && next)
+        res = __ioblock_seal_neighbour(codec, fd, index + count, &dblocks[0]);
+
+    return(res);
+}
+
+static int __ioblock_read (iocodec_t *codec,
+                           int fd,
+                           char *buf,
+                           size_t size,
+                           off_t offset,
+                           ioblock_t *dblocks)
+{
+    ioblock_t ublock;
+    unsigned int count;
+    uint64_t index;
+    size_t boffset;
+    size_t avail;
+    int i, n;
+    int rd;
+
+    index = IOBLOCK_INDEX(offset);
+    boffset = offset - (index * IOBLOCK_USER_SIZE);
+
+    rd = 0;
+    while (size > 0) {
+        count = __ioblock_count(boffset + size);
+        if ((n = ioblock_read_batch(codec, fd, index, count, dblocks)) == 0)
+            break;
+
+        for (i = 0; i < n; ++i) {
+            if (ioblock_decode(codec, fd, index + i, &ublock, &dblocks[i]))
+                return((rd > 0) ? rd : -1);
+
+            /* Short block, is the last one */
+            if (boffset >= ublock.head.length)
+                return(rd);
+
+            avail = __min(ublock.head.length - boffset, size);
+            memcpy(buf + rd, ublock.body + boffset, avail);
+
+            rd += avail;
+            size -= avail;
+            boffset = 0;
+
+            if (ublock.head.length < IOBLOCK_USER_SIZE)
+                return(rd);
+        }
+
+        if (n < count)
+            break;
+
+        index += n;
+    }
+
+    return(rd);
+}
+
 int ioblock_read (iocodec_t *codec,
                   int fd,
                   char *buf,
                   size_t size,
                   off_t offset)
 {
-    ioblock_t dblock;
+    ioblock_t *dblocks;
+    int res;
+
+    if ((dblocks = ioblock_batch_alloc()) == NULL)
+        return(-1);
+
+    res = __ioblock_read(codec, fd, buf, size, offset, dblocks);
+    ioblock_batch_free(dblocks);
+    return(res);
+}
+
+/*
+ * Decodes the blocks straight into the user buffer, avoiding the copy
+ * from a temporary block. A decoded block is its header followed by the
+ * user data, so block N is decoded IOBLOCK_HEAD_SIZE bytes before its
+ * position in 'buf', over the tail of block N - 1. Blocks are decoded
+ * from the last one to the first, so every header lands on data that
+ * is decoded later. The first block(s), without room for the header in
+ * front, go through a temporary block.
+ * A decode may write up to IOBLOCK_DISK_SIZE bytes, IOBLOCK_DECODE_SLACK
+ * past the block data: over the first bytes of block N + 1, decoded and
+ * saved/restored around the decode, or over the slack at the end of 'buf'.
+ *
+ * 'buf' must be at least IOBLOCK_INPLACE_SIZE(offset, size) bytes.
+ */
+static int __ioblock_read_inplace (iocodec_t *codec,
+                                   int fd,
+                                   char *buf,
+                                   size_t size,
+                                   off_t offset,
+                                   ioblock_t *dblocks)
+{
+    uint8_t slack[IOBLOCK_DECODE_SLACK];
     ioblock_t ublock;
-    off_t doffset;
-    size_t avail;
-    int wr;
+    ioblock_t *pblock;
+    uint8_t *tail;
+    uint64_t nblocks;
+    uint64_t first;
+    uint64_t index;
+    size_t boffset;
+    ssize_t dstart;
+    size_t limit;
+    int limit_err;
+    int count;
+    int res;
+    int i, n;
+
+    if (size == 0)
+        return(0);
 
-    doffset = __ioblock_offset(offset);
-    if (__ioblock_fetch(codec, fd, doffset, &dblock, &ublock))
+    index = IOBLOCK_INDEX(offset);
+    boffset = offset - (index * IOBLOCK_USER_SIZE);
+    nblocks = (boffset + size + IOBLOCK_USER_SIZE - 1) / IOBLOCK_USER_SIZE;
+
+    /* Returned data stops at the first missing, short or corrupted block */
+    limit = size;
+    limit_err = 0;
+
+    first = ((nblocks - 1) / IOBLOCK_BATCH) * IOBLOCK_BATCH;
+    for (;;) {
+        count = __min(IOBLOCK_BATCH, nblocks - first);
+        n = ioblock_read_batch(codec, fd, index + first, count, dblocks);
+        if (n < count) {
+            dstart = ((first + n) * IOBLOCK_USER_SIZE) - boffset;
+            limit = (dstart > 0) ? dstart : 0;
+            limit_err = 0;
+        }
+
+        for (i = n - 1; i >= 0; --i) {
+            dstart = ((first + i) * IOBLOCK_USER_SIZE) - boffset;
+
+            if (dstart >= (ssize_t)IOBLOCK_HEAD_SIZE) {
+                pblock = (ioblock_t *)(buf + dstart - IOBLOCK_HEAD_SIZE);
+                tail = (uint8_t *)pblock + IOBLOCK_PLAIN_SIZE;
+                memcpy(slack, tail, IOBLOCK_DECODE_SLACK);
+            } else {
+                pblock = &ublock;
+                tail = NULL;
+            }
+
+            res = ioblock_decode(codec, fd, index + first + i, pblock, &dblocks[i]);
+            if (tail != NULL)
+                memcpy(tail, slack, IOBLOCK_DECODE_SLACK);
+
+            if (res) {
+                limit = (dstart > 0) ? dstart : 0;
+                limit_err = 1;
+                continue;
+            }
+
+            if (pblock->head.length < IOBLOCK_USER_SIZE) {
+                ssize_t end = dstart + pblock->head.length;
+                limit = __min(limit, (end > 0) ? (size_t)end : 0);
+                limit_err = 0;
+            }
+
+            if (pblock == &ublock) {
+                size_t skip = (dstart < 0) ? -dstart : 0;
+                if (skip < ublock.head.length) {
+                    size_t avail = ublock.head.length - skip;
+                    dstart += skip;
+                    avail = __min(avail, size - dstart);
+                    memcpy(buf + dstart, ublock.body + skip, avail);
+                }
+            }
+        }
+
+        if (first == 0)
+            break;
+
+        first -= IOBLOCK_BATCH;
+    }
+
+    return((limit == 0 && limit_err) ? -1 : (int)limit);
+}
+
+int ioblock_read_inplace (iocodec_t *codec,
+                          int fd,
+                          char *buf,
+                          size_t size,
+                          off_t offset)
+{
+    ioblock_t *dblocks;
+    int res;
+
+    if ((dblocks = ioblock_batch_alloc()) == NULL)
         return(-1);
 
-    offset = (offset - __align_down(offset, IOBLOCK_USER_SIZE));
-    avail = ublock.head.length - offset;
-    avail = (size > avail) ? avail : size;
-    memcpy(buf, ublock.body + offset, avail);
+    res = __ioblock_read_inplace(codec, fd, buf, size, offset, dblocks);
+    ioblock_batch_free(dblocks);
+    return(res);
+}
 
-    wr = avail;
-    size -= avail;
+static int __ioblock_write (iocodec_t *codec,
+                            int fd,
+                            const char *buf,
+                            size_t size,
+                            off_t offset,
+                            ioblock_t *dblocks)
+{
+    ioblock_t ublock;
+    unsigned int count;
+    uint64_t index;
+    size_t boffset;
+    size_t avail;
+    int pending;
+    int holes;
+    int hole;
+    int wr;
+
+    index = IOBLOCK_INDEX(offset);
+    boffset = offset - (index * IOBLOCK_USER_SIZE);
+
+    wr = 0;
+    count = 0;
+    holes = 0;
+    pending = 0;
     while (size > 0) {
-        doffset += IOBLOCK_DISK_SIZE;
-        if (__ioblock_fetch(codec, fd, doffset, &dblock, &ublock))
-            break;
+        avail = __min(IOBLOCK_USER_SIZE - boffset, size);
+        if (avail == IOBLOCK_USER_SIZE) {
+            ublock.head.length = avail;
+        } else {
+            /* Partial block, dblocks[count] is used as scratch */
+            if (__ioblock_fetch(codec, fd, index + count, &dblocks[count], &ublock) < 0)
+                break;
+
+            if ((boffset + avail) > ublock.head.length)
+                ublock.head.length = boffset + avail;
+        }
+
+        memcpy(ublock.body + boffset, buf + wr + pending, avail);
 
-        avail = (size > ublock.head.length) ? ublock.head.length : size;
-        memcpy(buf + wr, ublock.body, avail);
+        /* Full zero blocks are not encoded, but stored as holes */
+        hole = (ublock.head.length == IOBLOCK_USER_SIZE &&
+                __is_zero(ublock.body, IOBLOCK_USER_SIZE));
+
+        if (count > 0 && hole != holes) {
+            if (__ioblock_flush(codec, fd, index, count, dblocks, holes))
+                return((wr > 0) ? wr : -1);
+
+            index += count;
+            wr += pending;
+            pending = 0;
+            count = 0;
+        }
 
-        wr += avail;
+        holes = hole;
+        if (!hole && __ioblock_encode_block(codec, &dblocks[count], &ublock))
+            break;
+
+        count++;
+        pending += avail;
         size -= avail;
+        boffset = 0;
+
+        if (count == IOBLOCK_BATCH) {
+            if (__ioblock_flush(codec, fd, index, count, dblocks, holes))
+                return((wr > 0) ? wr : -1);
+
+            index += count;
+            wr += pending;
+            pending = 0;
+            count = 0;
+        }
+    }
+
+    if (count > 0) {
+        if (__ioblock_flush(codec, fd, index, count, dblocks, holes))
+            return((wr > 0) ? wr : -1);
+        wr += pending;
     }
 
-    return(wr);
+    return((wr > 0 || size == 0) ? wr : -1);
 }
 
 int ioblock_write (iocodec_t *codec,
@@ -187,63 +718,160 @@ int ioblock_write (iocodec_t *codec,
                    const char *buf,
                    size_t size,
                    off_t offset)
+{
+    ioblock_t *dblocks;
+    int res;
+
+    if ((dblocks = ioblock_batch_alloc()) == NULL)
+        return(-1);
+
+    res = __ioblock_write(codec, fd, buf, size, offset, dblocks);
+    ioblock_batch_free(dblocks);
+    return(res);
+}
+
+/*
+ * Resize the data from 'length' to 'new_length', keeping the block grid
+ * consistent: the last block carries the tail length, blocks past the
+ * old end are zero-filled (holes) and the disk file is cut/extended to
+ * the last block. Growing only extends the disk file. The caller updates
+ * the file header.
+ */
+int ioblock_truncate (iocodec_t *codec,
+                      int fd,
+                      uint64_t length,
+                      uint64_t new_length)
 {
     ioblock_t dblock;
     ioblock_t ublock;
-    off_t doffset;
+    struct stat st;
+    uint64_t nblocks;
+    uint64_t index;
+    size_t boffset;
     size_t avail;
-    int wr;
-
-    doffset = __ioblock_offset(offset);
 
-    offset = (offset - __align_down(offset, IOBLOCK_USER_SIZE));
-    avail = offset + size;
-    if (avail >= IOBLOCK_USER_SIZE && offset == 0) {
-        avail = IOBLOCK_USER_SIZE;
-        ublock.head.length = avail;
-    } else {
-        if (__ioblock_fetch(codec, fd, doffset, &dblock, &ublock) < 0)
-            return(-1);
+    if (new_length < length) {
+        index = IOBLOCK_INDEX(new_length);
+        boffset = new_length - (index * IOBLOCK_USER_SIZE);
+
+        /* The new last block is partial, cut its length */
+        if (boffset > 0) {
+            if (__ioblock_fetch(codec, fd, index, &dblock, &ublock) < 0)
+                return(-1);
+
+            if (ublock.head.length > boffset) {
+                ublock.head.length = boffset;
+                if (__ioblock_encode_block(codec, &dblock, &ublock))
+                    return(-2);
+                if (__ioblock_flush(codec, fd, index, 1, &dblock, 0))
+                    return(-3);
+            }
+            index++;
+        }
 
-        if (avail > IOBLOCK_USER_SIZE)
-            avail = IOBLOCK_USER_SIZE;
+        return(ftruncate(fd, IOBLOCK_DISK_OFFSET(index)) ? -4 : 0);
+    }
 
-        if (avail > ublock.head.length)
-            ublock.head.length = avail;
+    if (new_length > length) {
+        index = IOBLOCK_INDEX(length);
+        boffset = length - (index * IOBLOCK_USER_SIZE);
+
+        /* Zero-fill the old last block past its own length, the following
+         * ones are holes. Data already in the block (e.g. a concurrent
+         * write past 'length') is never overwritten.
+         */
+        if (boffset > 0) {
+            if (__ioblock_fetch(codec, fd, index, &dblock, &ublock) < 0)
+                return(-1);
+
+            avail = __min(IOBLOCK_USER_SIZE, boffset + (new_length - length));
+            if (ublock.head.length < avail) {
+                memset(ublock.body + ublock.head.length, 0, avail - ublock.head.length);
+                ublock.head.length = avail;
+                if (__ioblock_encode_block(codec, &dblock, &ublock))
+                    return(-2);
+                if (__ioblock_flush(codec, fd, index, 1, &dblock, 0))
+                    return(-3);
+            }
+        }
 
-        avail = avail - offset;
+        /* Growing never cuts the disk file, blocks may be already there */
+        nblocks = (new_length + IOBLOCK_USER_SIZE - 1) / IOBLOCK_USER_SIZE;
+        if (fstat(fd, &st))
+            return(-4);
+        if ((uint64_t)st.st_size < IOBLOCK_DISK_OFFSET(nblocks))
+            return(ftruncate(fd, IOBLOCK_DISK_OFFSET(nblocks)) ? -4 : 0);
     }
 
-    memcpy(ublock.body + offset, buf, avail);
-    if (__ioblock_store(codec, fd, doffset, &dblock, &ublock))
-        return(0);
+    return(0);
+}
 
-    wr = avail;
-    size -= avail;
-    while (size > 0) {
-        doffset += IOBLOCK_DISK_SIZE;
+#define __disk_block_floor(doffset)                                         \
+    (((doffset) - IOFHEAD_SIZE) / IOBLOCK_DISK_SIZE)
 
-        if (size >= IOBLOCK_USER_SIZE) {
-            avail = IOBLOCK_USER_SIZE;
-            ublock.head.length = avail;
-        } else {
-            if (__ioblock_fetch(codec, fd, doffset, &dblock, &ublock) < 0)
-                break;
+#define __disk_block_ceil(doffset)                                          \
+    (((doffset) - IOFHEAD_SIZE + IOBLOCK_DISK_SIZE - 1) / IOBLOCK_DISK_SIZE)
 
-            avail = size;
-            if (size > ublock.head.length)
-                ublock.head.length = avail;
-        }
+static int64_t __ioblock_seek_data (int fd, uint64_t index) {
+    off_t doffset;
 
-        memcpy(ublock.body, buf + wr, avail);
-        if (__ioblock_store(codec, fd, doffset, &dblock, &ublock))
-            break;
+    /* The first block with a data byte */
+    if ((doffset = lseek(fd, IOBLOCK_DISK_OFFSET(index), SEEK_DATA)) < 0)
+        return(-1);
 
-        wr += avail;
-        size -= avail;
+    return(__disk_block_floor(doffset));
+}
+
+static int64_t __ioblock_seek_hole (int fd, uint64_t index) {
+    off_t doffset;
+    uint64_t hole;
+
+    /* The first block fully inside a hole */
+    for (;;) {
+        if ((doffset = lseek(fd, IOBLOCK_DISK_OFFSET(index), SEEK_HOLE)) < 0)
+            return(-1);
+
+        hole = __disk_block_ceil(doffset);
+        if ((doffset = lseek(fd, doffset, SEEK_DATA)) < 0)
+            return((errno == ENXIO) ? (int64_t)hole : -1);
+
+        if (doffset >= IOBLOCK_DISK_OFFSET(hole + 1))
+            return(hole);
+
+        index = hole + 1;
     }
+}
+
+/*
+ * SEEK_DATA/SEEK_HOLE on the user data offsets, at block granularity.
+ * Blocks are not aligned to the filesystem pages, so a block partially
+ * covered by a hole is data. Returns -1 (errno ENXIO) if there is no
+ * data past 'offset'.
+ */
+off_t ioblock_seek (int fd, off_t offset, int whence) {
+    uint64_t index;
+    int64_t block;
+
+    index = IOBLOCK_INDEX(offset);
+    if (whence == SEEK_DATA)
+        block = __ioblock_seek_data(fd, index);
+    else
+        block = __ioblock_seek_hole(fd, index);
+
+    if (block < 0) {
+        if (errno != EINVAL)
+            return(-1);
+
+        /* No sparse file support, everything up to the end of file is data */
+        if (whence == SEEK_DATA || (block = lseek(fd, 0, SEEK_END)) < 0)
+            return(offset);
+        block = __disk_block_ceil(block);
+    }
+
+    if ((uint64_t)block <= index)
+        return(offset);
 
-    return(wr);
+    return(block * IOBLOCK_USER_SIZE);
 }
 
 static int __ioblock_encode_plain (iocodec_data_t *data, void *dst, const void *src) {
@@ -253,8 +881,7 @@ static int __ioblock_encode_plain (iocodec_data_t *data, void *dst, const void *
 }
 
 static int __ioblock_decode_plain (iocodec_data_t *data, void *dst, const void *src) {
-    memset(dst, 0, IOBLOCK_DISK_SIZE);
-    memcpy(dst, src, IOBLOCK_DISK_SIZE);
+    memcpy(dst, src, IOBLOCK_PLAIN_SIZE);
     return(0);
 }
 
@@ -263,24 +890,31 @@ iocodec_plug_t ioblock_plain_codec = {
     .decode = __ioblock_decode_plain,
 };
 
-static int __ioblock_codec_xor (iocodec_data_t *data, void *dst, const void *src) {
+static void __ioblock_xor (uint64_t key, void *dst, const void *src, unsigned int size) {
     const uint64_t *psrc = (const uint64_t *)src;
     uint64_t *pdst = (uint64_t *)dst;
     unsigned int n;
 
-    memset(dst, 0, IOBLOCK_DISK_SIZE);
-    for (n = 0; n < IOBLOCK_DISK_SIZE; n += 8) {
-        *pdst = *psrc ^ data->u64;
+    for (n = 0; n < size; n += 8) {
+        *pdst = *psrc ^ key;
         pdst++;
         psrc++;
     }
+}
+
+static int __ioblock_encode_xor (iocodec_data_t *data, void *dst, const void *src) {
+    __ioblock_xor(data->u64, dst, src, IOBLOCK_DISK_SIZE);
+    return(0);
+}
 
+static int __ioblock_decode_xor (iocodec_data_t *data, void *dst, const void *src) {
+    __ioblock_xor(data->u64, dst, src, IOBLOCK_PLAIN_SIZE);
     return(0);
 }
 
 iocodec_plug_t ioblock_xor_codec = {
-    .encode = __ioblock_codec_xor,
-    .decode = __ioblock_codec_xor,
+    .encode = __ioblock_encode_xor,
+    .decode = __ioblock_decode_xor,
 };
 
 static int __ioblock_encode_aes (iocodec_data_t *data, void *dst, const void *src) {
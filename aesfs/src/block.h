@@ -17,8 +17,15 @@
 #ifndef _BLOCK_H_
 #define _BLOCK_H_
 
+#include <sys/types.h>
+#include <unistd.h>
 #include <stdint.h>
 
+#ifndef SEEK_DATA
+    #define SEEK_DATA            3
+    #define SEEK_HOLE            4
+#endif
+
 #define IOFHEAD_SIZE             (sizeof(struct iofhead))
 #define IOFHEAD_MAGIC            (0x71cc75bf)
 #define IOBLOCK_MAGIC            (0x506787e)
@@ -29,10 +36,35 @@
 #define IOBLOCK_BODY_SIZE        (IOBLOCK_DISK_SIZE - IOBLOCK_HEAD_SIZE)
 #define IOBLOCK_USER_SIZE        (IOBLOCK_BODY_SIZE - IOBLOCK_AES_SIZE)
 
+/* Decoded bytes of a block: header + user data */
+#define IOBLOCK_PLAIN_SIZE       (IOBLOCK_HEAD_SIZE + IOBLOCK_USER_SIZE)
+
+/* Max number of blocks fetched with a single pread() */
+#define IOBLOCK_BATCH            (16)
+
+#define IOBLOCK_INDEX(offset)        ((offset) / IOBLOCK_USER_SIZE)
+#define IOBLOCK_DISK_OFFSET(index)   (IOFHEAD_SIZE + ((index) * IOBLOCK_DISK_SIZE))
+
+/* Blocks of a batch buffer (ioblock_batch_alloc) */
+#define IOBLOCK_BATCH_SIZE       (IOBLOCK_BATCH * IOBLOCK_DISK_SIZE)
+
+/* Drop the ciphertext from the page cache after I/O, writes are synchronous */
+#define IOBLOCK_FLAG_UNCACHED    (1 << 0)
+
+/* A decode may write a full disk block, past the decoded bytes (AES) */
+#define IOBLOCK_DECODE_SLACK     (IOBLOCK_DISK_SIZE - IOBLOCK_PLAIN_SIZE)
+
+/* Buffer size required by ioblock_read_inplace() */
+#define IOBLOCK_INPLACE_SIZE(offset, size)                                  \
+    (((((offset) % IOBLOCK_USER_SIZE) + (size) + IOBLOCK_USER_SIZE - 1) /   \
+       IOBLOCK_USER_SIZE) * IOBLOCK_USER_SIZE - ((offset) % IOBLOCK_USER_SIZE) \
+       + IOBLOCK_DECODE_SLACK)
+
 typedef struct iocodec_plug iocodec_plug_t;
 typedef union  iocodec_data iocodec_data_t;
 typedef struct iocodec iocodec_t;
 typedef struct iohead iohead_t;
+typedef struct ioblock ioblock_t;
 
 struct iofhead {
     uint32_t magic;
@@ -47,6 +79,11 @@ struct iohead {
     uint32_t pad;
 } __attribute__((__packed__));
 
+struct ioblock {
+    iohead_t head;
+    uint8_t  body[IOBLOCK_BODY_SIZE];
+} __attribute__((__packed__));
+
 struct iocodec_plug {
     int (*encode) (iocodec_data_t *data, void *dst, const void *src);
     int (*decode) (iocodec_data_t *data, void *dst, const void *src);
@@ -62,6 +99,7 @@ union iocodec_data {
 struct iocodec {
     iocodec_plug_t *plug;
     iocodec_data_t data;
+    unsigned int flags;
 };
 
 extern iocodec_plug_t ioblock_plain_codec;
@@ -74,16 +112,41 @@ size_t  iowrite         (int fd, const void *buf, size_t size, off_t offset);
 int     iofhead_read    (int fd, struct iofhead *fhead);
 int     iofhead_write   (int fd, const struct iofhead *fhead);
 
+ioblock_t *ioblock_batch_alloc (void);
+void        ioblock_batch_free  (ioblock_t *dblocks);
+
+int     ioblock_read_batch  (iocodec_t *codec,
+                             int fd,
+                             uint64_t index,
+                             unsigned int count,
+                             ioblock_t *dblocks);
+int     ioblock_decode      (iocodec_t *codec,
+                             int fd,
+                             uint64_t index,
+                             ioblock_t *ublock,
+                             const ioblock_t *dblock);
+
 int     ioblock_read    (iocodec_t *codec,
                          int fd,
                          char *buf,
                          size_t size,
                          off_t offset);
+int     ioblock_read_inplace (iocodec_t *codec,
+                              int fd,
+                              char *buf,
+                              size_t size,
+                              off_t offset);
 int     ioblock_write   (iocodec_t *codec,
                          int fd,
                          const char *buf,
                          size_t size,
                          off_t offset);
+int     ioblock_truncate (iocodec_t *codec,
+                          int fd,
+                          uint64_t length,
+                          uint64_t new_length);
+
+off_t   ioblock_seek    (int fd, off_t offset, int whence);
 
 uint32_t crc32c (const void *data, unsigned int n);
 
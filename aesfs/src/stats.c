@@ -0,0 +1,180 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include "stats.h"
+
+struct iostat {
+    uint64_t count;
+    uint64_t errors;
+    uint64_t bytes;
+    uint64_t time;
+    uint64_t hist[IOSTAT_HIST_BUCKETS];
+};
+
+static struct iostat __iostats[IOSTAT_MAX];
+
+static const char *__iostat_names[IOSTAT_MAX] = {
+    "fuse.getattr",
+    "fuse.readlink",
+    "fuse.readdir",
+    "fuse.mknod",
+    "fuse.mkdir",
+    "fuse.unlink",
+    "fuse.rmdir",
+    "fuse.symlink",
+    "fuse.rename",
+    "fuse.link",
+    "fuse.chmod",
+    "fuse.chown",
+    "fuse.truncate",
+    "fuse.utimens",
+    "fuse.open",
+    "fuse.create",
+    "fuse.read",
+    "fuse.write",
+    "fuse.statfs",
+    "fuse.release",
+    "fuse.fsync",
+    "fuse.xattr",
+    "block.encode",
+    "block.decode",
+    "block.crc",
+    "block.hole",
+    "sys.pread",
+    "sys.pwrite",
+    "lock.aes-encode",
+    "lock.aes-decode",
+    "lock.file",
+};
+
+/* ============================================================================
+ *  Histogram buckets
+ */
+static unsigned int __hist_bucket (uint64_t value) {
+    unsigned int shift;
+
+    if (value < 8)
+        return(value);
+
+    /* 3 bits below the msb select the sub-bucket */
+    shift = (63 - __builtin_clzll(value)) - 3;
+    return((shift << 3) + (value >> shift));
+}
+
+static uint64_t __hist_bucket_max (unsigned int index) {
+    unsigned int shift;
+
+    if (index < 8)
+        return(index);
+
+    shift = (index >> 3) - 1;
+    return((((uint64_t)(8 + (index & 7)) + 1) << shift) - 1);
+}
+
+static uint64_t __hist_percentile (const uint64_t *hist,
+                                   uint64_t count,
+                                   double percentile)
+{
+    uint64_t threshold;
+    uint64_t total;
+    unsigned int i;
+
+    threshold = (uint64_t)(count * percentile);
+    if (threshold == 0)
+        threshold = 1;
+
+    total = 0;
+    for (i = 0; i < IOSTAT_HIST_BUCKETS; ++i) {
+        total += hist[i];
+        if (total >= threshold)
+            return(__hist_bucket_max(i));
+    }
+
+    return(0);
+}
+
+static uint64_t __hist_max (const uint64_t *hist) {
+    int i;
+
+    for (i = IOSTAT_HIST_BUCKETS - 1; i >= 0; --i) {
+        if (hist[i] > 0)
+            return(__hist_bucket_max(i));
+    }
+
+    return(0);
+}
+
+/* ============================================================================
+ *  Public API
+ */
+uint64_t iostat_now (void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return(((uint64_t)ts.tv_sec * 1000000000ull) + ts.tv_nsec);
+}
+
+void iostat_add (iostat_id_t id, uint64_t start, uint64_t bytes, int error) {
+    struct iostat *stat = &(__iostats[id]);
+    uint64_t elapsed;
+
+    elapsed = iostat_now() - start;
+    __sync_fetch_and_add(&(stat->count), 1);
+    __sync_fetch_and_add(&(stat->time), elapsed);
+    __sync_fetch_and_add(&(stat->hist[__hist_bucket(elapsed)]), 1);
+    if (bytes > 0)
+        __sync_fetch_and_add(&(stat->bytes), bytes);
+    if (error)
+        __sync_fetch_and_add(&(stat->errors), 1);
+}
+
+void iostat_reset (void) {
+    memset(__iostats, 0, sizeof(__iostats));
+}
+
+int iostat_dump (FILE *stream) {
+    uint64_t hist[IOSTAT_HIST_BUCKETS];
+    struct iostat *stat;
+    uint64_t count;
+    unsigned int i;
+
+    fprintf(stream, "%-16s %10s %8s %14s %10s %10s %10s %10s %10s\n",
+            "# name", "count", "errors", "bytes",
+            "avg-us", "p50-us", "p99-us", "p999-us", "max-us");
+
+    for (i = 0; i < IOSTAT_MAX; ++i) {
+        stat = &(__iostats[i]);
+        if ((count = stat->count) == 0)
+            continue;
+
+        /* Snapshot, concurrent updates are not a problem */
+        memcpy(hist, stat->hist, sizeof(hist));
+        fprintf(stream, "%-16s %10llu %8llu %14llu %10.2f %10.2f %10.2f %10.2f %10.2f\n",
+                __iostat_names[i],
+                (unsigned long long)count,
+                (unsigned long long)stat->errors,
+                (unsigned long long)stat->bytes,
+                (stat->time / (double)count) / 1000.0,
+                __hist_percentile(hist, count, 0.50) / 1000.0,
+                __hist_percentile(hist, count, 0.99) / 1000.0,
+                __hist_percentile(hist, count, 0.999) / 1000.0,
+                __hist_max(hist) / 1000.0);
+    }
+
+    return(ferror(stream));
+}
@@ -0,0 +1,77 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+typedef enum iostat_id iostat_id_t;
+
+enum iostat_id {
+    /* FUSE operations */
+    IOSTAT_FUSE_GETATTR,
+    IOSTAT_FUSE_READLINK,
+    IOSTAT_FUSE_READDIR,
+    IOSTAT_FUSE_MKNOD,
+    IOSTAT_FUSE_MKDIR,
+    IOSTAT_FUSE_UNLINK,
+    IOSTAT_FUSE_RMDIR,
+    IOSTAT_FUSE_SYMLINK,
+    IOSTAT_FUSE_RENAME,
+    IOSTAT_FUSE_LINK,
+    IOSTAT_FUSE_CHMOD,
+    IOSTAT_FUSE_CHOWN,
+    IOSTAT_FUSE_TRUNCATE,
+    IOSTAT_FUSE_UTIMENS,
+    IOSTAT_FUSE_OPEN,
+    IOSTAT_FUSE_CREATE,
+    IOSTAT_FUSE_READ,
+    IOSTAT_FUSE_WRITE,
+    IOSTAT_FUSE_STATFS,
+    IOSTAT_FUSE_RELEASE,
+    IOSTAT_FUSE_FSYNC,
+    IOSTAT_FUSE_XATTR,
+
+    /* Block layer */
+    IOSTAT_BLOCK_ENCODE,
+    IOSTAT_BLOCK_DECODE,
+    IOSTAT_BLOCK_CRC,
+    IOSTAT_BLOCK_HOLE,
+    IOSTAT_SYS_PREAD,
+    IOSTAT_SYS_PWRITE,
+
+    /* Lock waits */
+    IOSTAT_LOCK_AES_ENCODE,
+    IOSTAT_LOCK_AES_DECODE,
+    IOSTAT_LOCK_FILE,
+
+    IOSTAT_MAX,
+};
+
+/* Log-linear buckets: 8 sub-buckets per power of two (12.5% precision) */
+#define IOSTAT_HIST_BUCKETS      (8 + (61 * 8))
+
+uint64_t    iostat_now      (void);
+void        iostat_add      (iostat_id_t id,
+                             uint64_t start,
+                             uint64_t bytes,
+                             int error);
+void        iostat_reset    (void);
+int         iostat_dump     (FILE *stream);
+
+#endif /* !_STATS_H_ */
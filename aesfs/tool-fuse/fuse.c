@@ -21,7 +21,9 @@
 #include <fuse.h>
 
 #include <sys/time.h>
+#include <pthread.h>
 #include <string.h>
+#include <signal.h>
 #include <unistd.h>
 #include <dirent.h>
 #include <stdlib.h>
@@ -36,6 +38,7 @@
 
 #include "crypto.h"
 #include "block.h"
+#include "stats.h"
 #include "util.h"
 
 /* ============================================================================
@@ -46,6 +49,8 @@ struct aesfs {
     iocodec_t     codec;
     const char *  root;
     unsigned int  root_length;
+    const char *  stats_path;
+    int           uncached;
 };
 
 static struct aesfs __aesfs;
@@ -58,6 +63,7 @@ static int aesfs_open (void) {
     /* Init AES codec */
     __aesfs.codec.plug = &ioblock_aes_codec;
     __aesfs.codec.data.ptr = __aesfs.aes;
+    __aesfs.codec.flags = __aesfs.uncached ? IOBLOCK_FLAG_UNCACHED : 0;
 
     return(0);
 }
@@ -66,29 +72,143 @@ static void aesfs_close (void) {
     crypto_aes_close(__aesfs.aes);
 }
 
+static void aesfs_stats_dump (void) {
+    FILE *stream = stderr;
+
+    if (__aesfs.stats_path != NULL) {
+        if ((stream = fopen(__aesfs.stats_path, "a")) == NULL)
+            return;
+    }
+
+    iostat_dump(stream);
+
+    if (stream != stderr)
+        fclose(stream);
+}
+
+static void *aesfs_stats_thread (void *data) {
+    sigset_t set;
+    int sig;
+
+    /* SIGUSR1 is blocked in every thread, and received here */
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    while (!sigwait(&set, &sig))
+        aesfs_stats_dump();
+
+    return(NULL);
+}
+
 /* ============================================================================
  *  AESFS File helpers
  */
-struct aesfs_file {
+
+/*
+ * State shared by every open of the same file (and its hard links):
+ * the header and the lock that serializes the length updates.
+ * A stale per-handle length would grow/cut the data written by others.
+ */
+struct aesfs_inode {
+    struct aesfs_inode *next;
+    dev_t dev;
+    ino_t ino;
+    unsigned int refs;
+
+    pthread_mutex_t lock;
     struct iofhead head;
+};
+
+struct aesfs_file {
+    struct aesfs_inode *inode;
     int fd;
+
+    /* Virtual file content (fd is -1, no inode) */
+    char * vdata;
+    size_t vsize;
 };
 
+static struct aesfs_inode *__aesfs_inodes = NULL;
+static pthread_mutex_t __aesfs_inodes_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct aesfs_inode *aesfs_inode_get (int fd) {
+    struct aesfs_inode *inode;
+    struct stat st;
+
+    if (fstat(fd, &st))
+        return(NULL);
+
+    pthread_mutex_lock(&__aesfs_inodes_lock);
+    for (inode = __aesfs_inodes; inode != NULL; inode = inode->next) {
+        if (inode->dev == st.st_dev && inode->ino == st.st_ino) {
+            inode->refs++;
+            pthread_mutex_unlock(&__aesfs_inodes_lock);
+            return(inode);
+        }
+    }
+
+    if ((inode = (struct aesfs_inode *) malloc(sizeof(struct aesfs_inode))) == NULL) {
+        pthread_mutex_unlock(&__aesfs_inodes_lock);
+        return(NULL);
+    }
+
+    if (pthread_mutex_init(&(inode->lock), NULL)) {
+        pthread_mutex_unlock(&__aesfs_inodes_lock);
+        free(inode);
+        return(NULL);
+    }
+
+    /* First open, the header is the one on disk */
+    if (iofhead_read(fd, &(inode->head))) {
+        inode->head.magic = IOFHEAD_MAGIC;
+        inode->head.flags = 0;
+        inode->head.length = 0;
+    }
+
+    inode->dev = st.st_dev;
+    inode->ino = st.st_ino;
+    inode->refs = 1;
+    inode->next = __aesfs_inodes;
+    __aesfs_inodes = inode;
+    pthread_mutex_unlock(&__aesfs_inodes_lock);
+    return(inode);
+}
+
+static void aesfs_inode_put (struct aesfs_inode *inode) {
+    struct aesfs_inode **p;
+
+    pthread_mutex_lock(&__aesfs_inodes_lock);
+    if (--inode->refs > 0) {
+        pthread_mutex_unlock(&__aesfs_inodes_lock);
+        return;
+    }
+
+    for (p = &__aesfs_inodes; *p != inode; p = &((*p)->next));
+    *p = inode->next;
+    pthread_mutex_unlock(&__aesfs_inodes_lock);
+
+    pthread_mutex_destroy(&(inode->lock));
+    free(inode);
+}
+
 static struct aesfs_file *aesfs_file_from_fd (int fd) {
     struct aesfs_file *file;
 
     if (!(file = (struct aesfs_file *) malloc(sizeof(struct aesfs_file)))) {
-        close(fd);
+        if (fd >= 0)
+            close(fd);
         return(NULL);
     }
 
-    file->fd = fd;
-    if (iofhead_read(fd, &(file->head))) {
-        file->head.magic = IOFHEAD_MAGIC;
-        file->head.flags = 0;
-        file->head.length = 0;
+    file->inode = NULL;
+    if (fd >= 0 && (file->inode = aesfs_inode_get(fd)) == NULL) {
+        close(fd);
+        free(file);
+        return(NULL);
     }
 
+    file->fd = fd;
+    file->vdata = NULL;
+    file->vsize = 0;
     return(file);
 }
 
@@ -113,12 +233,93 @@ static struct aesfs_file *aesfs_file_open (const char *path, int flags) {
     return(aesfs_file_from_fd(fd));
 }
 
+static void aesfs_file_close (struct aesfs_file *file);
+
+static struct aesfs_file *aesfs_file_stats (void) {
+    struct aesfs_file *file;
+    FILE *stream;
+
+    if ((file = aesfs_file_from_fd(-1)) == NULL)
+        return(NULL);
+
+    /* Snapshot at open time, reads return a consistent report */
+    if ((stream = open_memstream(&(file->vdata), &(file->vsize))) == NULL) {
+        aesfs_file_close(file);
+        return(NULL);
+    }
+
+    iostat_dump(stream);
+    fclose(stream);
+    return(file);
+}
+
+static void aesfs_file_lock (struct aesfs_file *file) {
+    uint64_t start = iostat_now();
+    pthread_mutex_lock(&(file->inode->lock));
+    iostat_add(IOSTAT_LOCK_FILE, start, 0, 0);
+}
+
+static void aesfs_file_unlock (struct aesfs_file *file) {
+    pthread_mutex_unlock(&(file->inode->lock));
+}
+
+static uint64_t aesfs_file_length (struct aesfs_file *file) {
+    uint64_t length;
+
+    aesfs_file_lock(file);
+    length = file->inode->head.length;
+    aesfs_file_unlock(file);
+    return(length);
+}
+
 static int aesfs_file_sync (struct aesfs_file *file) {
-    return(iofhead_write(file->fd, &(file->head)));
+    return(iofhead_write(file->fd, &(file->inode->head)));
+}
+
+static int __aesfs_file_resize (struct aesfs_file *file, uint64_t length) {
+    if (ioblock_truncate(&__aesfs.codec, file->fd, file->inode->head.length, length))
+        return(-1);
+
+    file->inode->head.length = length;
+    return(aesfs_file_sync(file));
+}
+
+static int aesfs_file_truncate (struct aesfs_file *file, uint64_t length) {
+    int res;
+
+    aesfs_file_lock(file);
+    res = __aesfs_file_resize(file, length);
+    aesfs_file_unlock(file);
+    return(res);
+}
+
+static int aesfs_file_grow (struct aesfs_file *file, uint64_t length) {
+    int res = 0;
+
+    /* Writing past the end, fill the gap with holes first */
+    aesfs_file_lock(file);
+    if (length > file->inode->head.length)
+        res = __aesfs_file_resize(file, length);
+    aesfs_file_unlock(file);
+    return(res);
+}
+
+static void aesfs_file_extend (struct aesfs_file *file, uint64_t length) {
+    /* Writes run in parallel, only the length update is serialized */
+    aesfs_file_lock(file);
+    if (length > file->inode->head.length) {
+        file->inode->head.length = length;
+        aesfs_file_sync(file);
+    }
+    aesfs_file_unlock(file);
 }
 
 static void aesfs_file_close (struct aesfs_file *file) {
-    close(file->fd);
+    if (file->inode != NULL)
+        aesfs_inode_put(file->inode);
+    if (file->fd >= 0)
+        close(file->fd);
+    free(file->vdata);
     free(file);
 }
 
@@ -262,10 +463,46 @@ static int aesfs_file_stat (const char *path, struct stat *stbuf) {
         return((res < 0) ? -errno : 0);                                     \
     } while (0);
 
+/* ============================================================================
+ *  AESFS Control files
+ */
+#define AESFS_CTL_DIR               "/.aesfs"
+#define AESFS_CTL_STATS             AESFS_CTL_DIR "/stats"
+
+/* The control dir is not listed in the root, to keep it out of copies */
+static int __ctl_getattr (const char *path, struct stat *stbuf) {
+    memset(stbuf, 0, sizeof(struct stat));
+    stbuf->st_uid = getuid();
+    stbuf->st_gid = getgid();
+
+    if (!strcmp(path, AESFS_CTL_DIR)) {
+        stbuf->st_mode = S_IFDIR | 0555;
+        stbuf->st_nlink = 2;
+        return(0);
+    }
+
+    /* Size is unknown until open, reads are direct_io */
+    if (!strcmp(path, AESFS_CTL_STATS)) {
+        stbuf->st_mode = S_IFREG | 0444;
+        stbuf->st_nlink = 1;
+        return(0);
+    }
+
+    return(-ENOENT);
+}
+
+#define __is_ctl_path(path)                                                 \
+    (!strncmp(path, AESFS_CTL_DIR, sizeof(AESFS_CTL_DIR) - 1) &&            \
+     (path[sizeof(AESFS_CTL_DIR) - 1] == '\0' ||                            \
+      path[sizeof(AESFS_CTL_DIR) - 1] == '/'))
+
 /* ============================================================================
  *  FUSE operations
  */
 static int __getattr (const char *path, struct stat *stbuf) {
+    if (__is_ctl_path(path))
+        return(__ctl_getattr(path, stbuf));
+
     __fuse_sys_bypass(aesfs_file_stat, path, stbuf);
 }
 
@@ -301,6 +538,13 @@ static int __readdir (const char *path,
     (void)offset;
     (void)fi;
 
+    if (!strcmp(path, AESFS_CTL_DIR)) {
+        filler(buf, ".", NULL, 0);
+        filler(buf, "..", NULL, 0);
+        filler(buf, AESFS_CTL_STATS + sizeof(AESFS_CTL_DIR), NULL, 0);
+        return(0);
+    }
+
     if ((realpath = aesfs_file_path_encode(path)) == NULL)
         return(-ENOMEM);
 
@@ -402,7 +646,28 @@ static int __chown (const char *path, uid_t uid, gid_t gid) {
 }
 
 static int __truncate (const char *path, off_t size) {
-    __fuse_sys_bypass(truncate, path, size);
+    struct aesfs_file *file;
+    char *realpath;
+    int res;
+
+    if ((realpath = aesfs_file_path_encode(path)) == NULL)
+        return(-ENOMEM);
+
+    if ((file = aesfs_file_open(realpath, O_RDWR)) == NULL) {
+        free(realpath);
+        return(-errno);
+    }
+
+    res = aesfs_file_truncate(file, size);
+
+    aesfs_file_close(file);
+    free(realpath);
+    return(res ? -EIO : 0);
+}
+
+static int __ftruncate (const char *path, off_t size, struct fuse_file_info *fi) {
+    struct aesfs_file *file = (struct aesfs_file *)fi->fh;
+    return(aesfs_file_truncate(file, size) ? -EIO : 0);
 }
 
 static int __utimens (const char *path, const struct timespec ts[2]) {
@@ -436,10 +701,30 @@ static int __create (const char *path, mode_t mode, struct fuse_file_info *fi) {
     return(0);
 }
 
+static int __ctl_open (const char *path, struct fuse_file_info *fi) {
+    struct aesfs_file *file;
+
+    if (strcmp(path, AESFS_CTL_STATS))
+        return(-ENOENT);
+
+    if ((fi->flags & O_ACCMODE) != O_RDONLY)
+        return(-EACCES);
+
+    if ((file = aesfs_file_stats()) == NULL)
+        return(-ENOMEM);
+
+    fi->fh = (uint64_t)file;
+    fi->direct_io = 1;
+    return(0);
+}
+
 static int __open (const char *path, struct fuse_file_info *fi) {
     struct aesfs_file *file;
     char *realpath;
 
+    if (__is_ctl_path(path))
+        return(__ctl_open(path, fi));
+
     fi->flags &= ~O_RDONLY;
     fi->flags &= ~O_WRONLY;
     fi->flags |= O_RDWR;
@@ -452,38 +737,110 @@ static int __open (const char *path, struct fuse_file_info *fi) {
         return(-errno);
     }
 
+    /* The plaintext pages are the only cached copy, keep them */
+    fi->keep_cache = __aesfs.uncached;
     fi->fh = (uint64_t)file;
     free(realpath);
     return(0);
 }
 
-static int __read (const char *path,
-                   char *buf,
-                   size_t size,
-                   off_t offset,
-                   struct fuse_file_info *fi)
+/*
+ * Blocks are decoded directly in the buffer handed to FUSE,
+ * the kernel receives the plain data without an extra copy.
+ */
+static int __read_buf (const char *path,
+                       struct fuse_bufvec **bufp,
+                       size_t size,
+                       off_t offset,
+                       struct fuse_file_info *fi)
 {
     struct aesfs_file *file = (struct aesfs_file *)fi->fh;
-    int rd = ioblock_read(&__aesfs.codec, file->fd, buf, size, offset);
-    return((rd < 0) ? -EIO : rd);
+    struct fuse_bufvec *src;
+    uint64_t length;
+    char *buf;
+    int rd;
+
+    /* The last block may be a hole, longer than the file */
+    length = (file->vdata != NULL) ? file->vsize : aesfs_file_length(file);
+    if ((uint64_t)offset >= length)
+        size = 0;
+    else if ((offset + size) > length)
+        size = length - offset;
+
+    if ((src = (struct fuse_bufvec *) malloc(sizeof(struct fuse_bufvec))) == NULL)
+        return(-ENOMEM);
+
+    if (size == 0) {
+        *src = FUSE_BUFVEC_INIT(0);
+        *bufp = src;
+        return(0);
+    }
+
+    /* Virtual file, the content is already in memory */
+    if (file->vdata != NULL) {
+        if ((buf = (char *) malloc(size)) == NULL) {
+            free(src);
+            return(-ENOMEM);
+        }
+
+        memcpy(buf, file->vdata + offset, size);
+        *src = FUSE_BUFVEC_INIT(size);
+        src->buf[0].mem = buf;
+        *bufp = src;
+        return(0);
+    }
+
+    if ((buf = (char *) malloc(IOBLOCK_INPLACE_SIZE(offset, size))) == NULL) {
+        free(src);
+        return(-ENOMEM);
+    }
+
+    if ((rd = ioblock_read_inplace(&__aesfs.codec, file->fd, buf, size, offset)) < 0) {
+        free(buf);
+        free(src);
+        return(-EIO);
+    }
+
+    *src = FUSE_BUFVEC_INIT(rd);
+    src->buf[0].mem = buf;
+    *bufp = src;
+    return(0);
 }
 
-static int __write (const char *path,
-                    const char *buf,
-                    size_t size,
-                    off_t offset,
-                    struct fuse_file_info *fi)
+static int __write_buf (const char *path,
+                        struct fuse_bufvec *buf,
+                        off_t offset,
+                        struct fuse_file_info *fi)
 {
     struct aesfs_file *file = (struct aesfs_file *)fi->fh;
+    struct fuse_bufvec dst;
+    size_t size;
+    char *data;
     int wr;
 
-    if ((wr = ioblock_write(&__aesfs.codec, file->fd, buf, size, offset)) > 0) {
-        if ((offset + wr) > file->head.length) {
-            file->head.length = offset + wr;
-            aesfs_file_sync(file);
-        }
+    if ((uint64_t)offset > aesfs_file_length(file) && aesfs_file_grow(file, offset))
+        return(-EIO);
+
+    size = fuse_buf_size(buf);
+    if (buf->count == 1 && !(buf->buf[0].flags & FUSE_BUF_IS_FD)) {
+        /* Encode straight from the FUSE request buffer */
+        data = (char *)buf->buf[0].mem + buf->off;
+        wr = ioblock_write(&__aesfs.codec, file->fd, data, size, offset);
+    } else {
+        /* Spliced data (pipe) must be in memory to be encrypted */
+        if ((data = (char *) malloc(size)) == NULL)
+            return(-ENOMEM);
+
+        dst = FUSE_BUFVEC_INIT(size);
+        dst.buf[0].mem = data;
+        if ((wr = fuse_buf_copy(&dst, buf, 0)) > 0)
+            wr = ioblock_write(&__aesfs.codec, file->fd, data, wr, offset);
+        free(data);
     }
 
+    if (wr > 0)
+        aesfs_file_extend(file, offset + wr);
+
     return((wr < 0) ? -EIO : wr);
 }
 
@@ -534,37 +891,168 @@ static int __removexattr (const char *path, const char *name) {
 }
 #endif /* HAVE_SETXATTR */
 
+#define AESFS_MAX_WRITE         (128 << 10)
+#define AESFS_MAX_READAHEAD     (1 << 20)
+
+static void *__init (struct fuse_conn_info *conn) {
+    pthread_t thread;
+
+    /* Large requests let ioblock_read/write batch the disk I/O */
+    conn->want |= FUSE_CAP_BIG_WRITES | FUSE_CAP_ASYNC_READ;
+    conn->max_write = AESFS_MAX_WRITE;
+    conn->max_readahead = AESFS_MAX_READAHEAD;
+    conn->max_background = 64;
+    conn->congestion_threshold = 48;
+
+    /* Started here, after fuse_main() has daemonized */
+    if (!pthread_create(&thread, NULL, aesfs_stats_thread, NULL))
+        pthread_detach(thread);
+
+    return(NULL);
+}
+
+/* ============================================================================
+ *  FUSE operations stats
+ */
+#define __fuse_stat_op(func, stat_id, args_decl, args)                      \
+    static int func##_stat args_decl {                                      \
+        uint64_t start = iostat_now();                                      \
+        int res = func args;                                                \
+        iostat_add(stat_id, start, (res > 0) ? res : 0, res < 0);           \
+        return(res);                                                        \
+    }
+
+__fuse_stat_op(__getattr, IOSTAT_FUSE_GETATTR,
+               (const char *path, struct stat *stbuf),
+               (path, stbuf))
+__fuse_stat_op(__readlink, IOSTAT_FUSE_READLINK,
+               (const char *path, char *buf, size_t size),
+               (path, buf, size))
+__fuse_stat_op(__readdir, IOSTAT_FUSE_READDIR,
+               (const char *path, void *buf, fuse_fill_dir_t filler,
+                off_t offset, struct fuse_file_info *fi),
+               (path, buf, filler, offset, fi))
+__fuse_stat_op(__mknod, IOSTAT_FUSE_MKNOD,
+               (const char *path, mode_t mode, dev_t rdev),
+               (path, mode, rdev))
+__fuse_stat_op(__mkdir, IOSTAT_FUSE_MKDIR,
+               (const char *path, mode_t mode),
+               (path, mode))
+__fuse_stat_op(__symlink, IOSTAT_FUSE_SYMLINK,
+               (const char *from, const char *to),
+               (from, to))
+__fuse_stat_op(__unlink, IOSTAT_FUSE_UNLINK,
+               (const char *path),
+               (path))
+__fuse_stat_op(__rmdir, IOSTAT_FUSE_RMDIR,
+               (const char *path),
+               (path))
+__fuse_stat_op(__rename, IOSTAT_FUSE_RENAME,
+               (const char *from, const char *to),
+               (from, to))
+__fuse_stat_op(__link, IOSTAT_FUSE_LINK,
+               (const char *from, const char *to),
+               (from, to))
+__fuse_stat_op(__chmod, IOSTAT_FUSE_CHMOD,
+               (const char *path, mode_t mode),
+               (path, mode))
+__fuse_stat_op(__chown, IOSTAT_FUSE_CHOWN,
+               (const char *path, uid_t uid, gid_t gid),
+               (path, uid, gid))
+__fuse_stat_op(__truncate, IOSTAT_FUSE_TRUNCATE,
+               (const char *path, off_t size),
+               (path, size))
+__fuse_stat_op(__ftruncate, IOSTAT_FUSE_TRUNCATE,
+               (const char *path, off_t size, struct fuse_file_info *fi),
+               (path, size, fi))
+__fuse_stat_op(__utimens, IOSTAT_FUSE_UTIMENS,
+               (const char *path, const struct timespec ts[2]),
+               (path, ts))
+__fuse_stat_op(__open, IOSTAT_FUSE_OPEN,
+               (const char *path, struct fuse_file_info *fi),
+               (path, fi))
+__fuse_stat_op(__create, IOSTAT_FUSE_CREATE,
+               (const char *path, mode_t mode, struct fuse_file_info *fi),
+               (path, mode, fi))
+__fuse_stat_op(__write_buf, IOSTAT_FUSE_WRITE,
+               (const char *path, struct fuse_bufvec *buf,
+                off_t offset, struct fuse_file_info *fi),
+               (path, buf, offset, fi))
+__fuse_stat_op(__statfs, IOSTAT_FUSE_STATFS,
+               (const char *path, struct statvfs *stbuf),
+               (path, stbuf))
+__fuse_stat_op(__release, IOSTAT_FUSE_RELEASE,
+               (const char *path, struct fuse_file_info *fi),
+               (path, fi))
+__fuse_stat_op(__fsync, IOSTAT_FUSE_FSYNC,
+               (const char *path, int isdatasync, struct fuse_file_info *fi),
+               (path, isdatasync, fi))
+
+#ifdef HAVE_SETXATTR
+__fuse_stat_op(__setxattr, IOSTAT_FUSE_XATTR,
+               (const char *path, const char *name, const char *value,
+                size_t size, int flags),
+               (path, name, value, size, flags))
+__fuse_stat_op(__getxattr, IOSTAT_FUSE_XATTR,
+               (const char *path, const char *name, char *value, size_t size),
+               (path, name, value, size))
+__fuse_stat_op(__listxattr, IOSTAT_FUSE_XATTR,
+               (const char *path, char *list, size_t size),
+               (path, list, size))
+__fuse_stat_op(__removexattr, IOSTAT_FUSE_XATTR,
+               (const char *path, const char *name),
+               (path, name))
+#endif /* HAVE_SETXATTR */
+
+/* read_buf returns 0, the size is in the bufvec */
+static int __read_buf_stat (const char *path,
+                            struct fuse_bufvec **bufp,
+                            size_t size,
+                            off_t offset,
+                            struct fuse_file_info *fi)
+{
+    uint64_t start = iostat_now();
+    int res = __read_buf(path, bufp, size, offset, fi);
+    iostat_add(IOSTAT_FUSE_READ, start, res ? 0 : fuse_buf_size(*bufp), res < 0);
+    return(res);
+}
+
 /* ============================================================================
  *  FUSE operations table
  */
 static struct fuse_operations __aesfs_fuse = {
-    .getattr    = __getattr,
-    .readlink   = __readlink,
-    .readdir    = __readdir,
-    .mknod      = __mknod,
-    .mkdir      = __mkdir,
-    .symlink    = __symlink,
-    .unlink     = __unlink,
-    .rmdir      = __rmdir,
-    .rename     = __rename,
-    .link       = __link,
-    .chmod      = __chmod,
-    .chown      = __chown,
-    .truncate   = __truncate,
-    .utimens    = __utimens,
-    .open       = __open,
-    .create     = __create,
-    .read       = __read,
-    .write      = __write,
-    .statfs     = __statfs,
-    .release    = __release,
-    .fsync      = __fsync,
+    .init       = __init,
+    .getattr    = __getattr_stat,
+    .readlink   = __readlink_stat,
+    .readdir    = __readdir_stat,
+    .mknod      = __mknod_stat,
+    .mkdir      = __mkdir_stat,
+    .symlink    = __symlink_stat,
+    .unlink     = __unlink_stat,
+    .rmdir      = __rmdir_stat,
+    .rename     = __rename_stat,
+    .link       = __link_stat,
+    .chmod      = __chmod_stat,
+    .chown      = __chown_stat,
+    .truncate   = __truncate_stat,
+    .ftruncate  = __ftruncate_stat,
+    .utimens    = __utimens_stat,
+    .open       = __open_stat,
+    .create     = __create_stat,
+    .read_buf   = __read_buf_stat,
+    .write_buf  = __write_buf_stat,
+    .statfs     = __statfs_stat,
+    .release    = __release_stat,
+    .fsync      = __fsync_stat,
 #ifdef HAVE_SETXATTR
-    .setxattr    = __setxattr,
-    .getxattr    = __getxattr,
-    .listxattr   = __listxattr,
-    .removexattr = __removexattr,
+    .setxattr    = __setxattr_stat,
+    .getxattr    = __getxattr_stat,
+    .listxattr   = __listxattr_stat,
+    .removexattr = __removexattr_stat,
 #endif
+    /* Open files are accessed by handle, the path is not needed */
+    .flag_nullpath_ok = 1,
+    .flag_nopath      = 1,
 };
 
 /* ============================================================================
@@ -579,6 +1067,8 @@ enum {
 
 static struct fuse_opt __aesfs_opts[] = {
     AESFS_OPT("root=%s", root, 0),
+    AESFS_OPT("stats=%s", stats_path, 0),
+    AESFS_OPT("uncached", uncached, 1),
 
     FUSE_OPT_KEY("-V", AESFS_KEY_VERSION),
     FUSE_OPT_KEY("--version", AESFS_KEY_VERSION),
@@ -603,7 +1093,12 @@ static int __aesfs_opt_proc (void *data,
                     "    -V   --version     print version\n"
                     "\n"
                     "AESFS options:\n"
-                    "    -o root=ROOT-PATH  root path\n", outargs->argv[0]);
+                    "    -o root=ROOT-PATH  root path\n"
+                    "    -o stats=PATH      SIGUSR1 stats dump file (default stderr)\n"
+                    "    -o uncached        do not keep the ciphertext in the page cache\n"
+                    "\n"
+                    "Stats are also available reading <mountpoint>" AESFS_CTL_STATS "\n",
+                    outargs->argv[0]);
             fuse_opt_add_arg(outargs, "-ho");
             fuse_main(outargs->argc, outargs->argv, &__aesfs_fuse, NULL);
             exit(EXIT_FAILURE);
@@ -619,10 +1114,14 @@ static int __aesfs_opt_proc (void *data,
 
 int main (int argc, char **argv) {
     struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+    sigset_t sigset;
+    char opt[64];
     int res;
 
     __aesfs.root = NULL;
     __aesfs.root_length = 0;
+    __aesfs.stats_path = NULL;
+    __aesfs.uncached = 0;
 
     fuse_opt_parse(&args, &__aesfs, __aesfs_opts, __aesfs_opt_proc);
     __aesfs.root_length = (__aesfs.root != NULL) ? strlen(__aesfs.root) : 0;
@@ -634,9 +1133,19 @@ int main (int argc, char **argv) {
     if (__aesfs.root[__aesfs.root_length - 1] == '/')
         __aesfs.root_length--;
 
+    /* Request large kernel transfers, the default is 4k writes */
+    snprintf(opt, sizeof(opt), "-obig_writes,max_read=%d,max_write=%d",
+             AESFS_MAX_WRITE, AESFS_MAX_WRITE);
+    fuse_opt_add_arg(&args, opt);
+
     if ((aesfs_open()) < 0)
         return(EXIT_FAILURE);
 
+    /* Inherited by the FUSE threads, SIGUSR1 goes to the stats thread */
+    sigemptyset(&sigset);
+    sigaddset(&sigset, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &sigset, NULL);
+
     res = fuse_main(args.argc, args.argv, &__aesfs_fuse, NULL);
 
     aesfs_close();
@@ -20,16 +20,23 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <fcntl.h>
+#include <errno.h>
 
 #include "block.h"
+#include "scrub.h"
 #include "util.h"
 
 typedef int (*file_func_t) (iocodec_t *codec, const char *src, const char *dst);
 
+#define __min(a, b)              (((a) < (b)) ? (a) : (b))
+
 static int __file_encrypt (iocodec_t *codec, const char *src, const char *dst) {
-    char buffer[IOBLOCK_BODY_SIZE];
+    char buffer[IOBLOCK_BATCH * IOBLOCK_USER_SIZE];
     struct iofhead fhead;
+    struct stat st;
+    uint64_t length;
     int sfd, dfd;
+    off_t hole;
     size_t rd;
     off_t off;
 
@@ -46,16 +53,51 @@ static int __file_encrypt (iocodec_t *codec, const char *src, const char *dst) {
         return(2);
     }
 
+    if (fstat(sfd, &st)) {
+        perror("fstat()");
+        close(dfd);
+        close(sfd);
+        return(3);
+    }
+
+    /* Only the data extents of the source are encrypted */
     off = 0;
-    while ((rd  = ioread(sfd, buffer, IOBLOCK_USER_SIZE, off)) > 0) {
-        if (ioblock_write(codec, dfd, buffer, rd, off) <= 0)
+    length = 0;
+    while (off < st.st_size) {
+        if ((hole = lseek(sfd, off, SEEK_DATA)) < 0) {
+            if (errno == ENXIO)
+                break;
+            hole = st.st_size;
+        } else {
+            off = hole;
+            if ((hole = lseek(sfd, off, SEEK_HOLE)) < 0)
+                hole = st.st_size;
+        }
+
+        /* Fill the gap with holes, keeping the block grid consistent */
+        if (off > length && ioblock_truncate(codec, dfd, length, off))
             break;
-        off += rd;
+
+        length = off;
+        while (off < hole) {
+            if ((rd = ioread(sfd, buffer, __min(sizeof(buffer), hole - off), off)) == 0)
+                break;
+            if ((size_t)ioblock_write(codec, dfd, buffer, rd, off) != rd)
+                break;
+            off += rd;
+        }
+
+        if (off < hole)
+            break;
+        length = off;
     }
 
+    if (st.st_size > length)
+        ioblock_truncate(codec, dfd, length, st.st_size);
+
     fhead.magic = IOFHEAD_MAGIC;
     fhead.flags = 0;
-    fhead.length = off;
+    fhead.length = st.st_size;
     iofhead_write(dfd, &fhead);
 
     close(dfd);
@@ -64,10 +106,12 @@ static int __file_encrypt (iocodec_t *codec, const char *src, const char *dst) {
 }
 
 static int __file_decrypt (iocodec_t *codec, const char *src, const char *dst) {
-    char buffer[IOBLOCK_DISK_SIZE];
+    char buffer[IOBLOCK_BATCH * IOBLOCK_USER_SIZE];
+    struct iofhead fhead;
     int sfd, dfd;
+    off_t hole;
     off_t off;
-    size_t rd;
+    int rd;
 
     printf("decrypt %s -> %s\n", src, dst);
 
@@ -76,20 +120,42 @@ static int __file_decrypt (iocodec_t *codec, const char *src, const char *dst) {
         return(1);
     }
 
+    if (iofhead_read(sfd, &fhead)) {
+        fprintf(stderr, "%s: invalid file header\n", src);
+        close(sfd);
+        return(3);
+    }
+
     if ((dfd = open(dst, O_CREAT | O_TRUNC | O_WRONLY, 0644)) < 0) {
         perror("open()");
         close(sfd);
         return(2);
     }
 
+    /* Holes are skipped, the output file is sparse */
+    rd = 0;
     off = 0;
-    while ((rd  = ioblock_read(codec, sfd, buffer, IOBLOCK_USER_SIZE, off)) > 0)
-    {
-        if (iowrite(dfd, buffer, rd, off) <= 0)
+    while ((uint64_t)off < fhead.length) {
+        if ((off = ioblock_seek(sfd, off, SEEK_DATA)) < 0)
+            break;
+
+        if ((hole = ioblock_seek(sfd, off, SEEK_HOLE)) < 0 || (uint64_t)hole > fhead.length)
+            hole = fhead.length;
+
+        while (off < hole) {
+            rd = ioblock_read(codec, sfd, buffer, __min(sizeof(buffer), hole - off), off);
+            if (rd <= 0 || iowrite(dfd, buffer, rd, off) != (size_t)rd)
+                break;
+            off += rd;
+        }
+
+        if (off < hole)
             break;
-        off += rd;
     }
 
+    if (rd >= 0 && ftruncate(dfd, fhead.length))
+        perror("ftruncate()");
+
     close(dfd);
     close(sfd);
     return(0);
@@ -97,21 +163,47 @@ static int __file_decrypt (iocodec_t *codec, const char *src, const char *dst) {
 
 int main (int argc, char **argv) {
     file_func_t ffunc = __file_encrypt;
+    scrub_opts_t scrub_opts;
     iocodec_t codec;
+    int scrub = 0;
     int o;
 
-    while ((o = getopt(argc, argv, "hdax")) != -1) {
+    codec.plug = NULL;
+    codec.flags = 0;
+    scrub_opts.threads = sysconf(_SC_NPROCESSORS_ONLN);
+    scrub_opts.rate = 0;
+    scrub_opts.checkpoint = NULL;
+    scrub_opts.names = NULL;
+    while ((o = getopt(argc, argv, "hdaxpsj:r:c:")) != -1) {
       switch (o) {
         case 'h':
-          fprintf(stderr, "usage: aespack [-d] <codec> <files...>\n");
+          fprintf(stderr, "usage: aespack [-d] <codec> <src> <dst> [<src> <dst>...]\n");
+          fprintf(stderr, "       aespack -s [-j N] [-r MB/s] [-c FILE] <codec> <volume-root...>\n");
           fprintf(stderr, "codec:\n");
           fprintf(stderr, "   -a   AES codec:\n");
           fprintf(stderr, "   -x   XOR Codec:\n");
           fprintf(stderr, "   -p   Plain Codec:\n");
+          fprintf(stderr, "scrub:\n");
+          fprintf(stderr, "   -s   Verify every block of the volume\n");
+          fprintf(stderr, "   -j   Number of threads (default: cpus)\n");
+          fprintf(stderr, "   -r   Max read rate in MB/s (default: unlimited)\n");
+          fprintf(stderr, "   -c   Checkpoint file to resume from (outside the volume)\n");
           return(0);
         case 'd': /* Decompress */
           ffunc = __file_decrypt;
           break;
+        case 's': /* Scrub */
+          scrub = 1;
+          break;
+        case 'j':
+          scrub_opts.threads = strtoul(optarg, NULL, 10);
+          break;
+        case 'r':
+          scrub_opts.rate = strtoul(optarg, NULL, 10);
+          break;
+        case 'c':
+          scrub_opts.checkpoint = optarg;
+          break;
         case 'a': /* AES codec */
           codec.plug = &ioblock_aes_codec;
           if ((codec.data.ptr = crypto_aes_from_input()) == NULL) {
@@ -121,7 +213,7 @@ int main (int argc, char **argv) {
           break;
         case 'x': /* Xor codec */
           codec.plug = &ioblock_xor_codec;
-          if (!xor_from_input()) {
+          if (!(codec.data.u64 = xor_from_input())) {
             fprintf(stderr, "Failed to initialize XOR.\n");
             return(EXIT_FAILURE);
           }
@@ -139,6 +231,26 @@ int main (int argc, char **argv) {
         return(EXIT_FAILURE);
     }
 
+    if (scrub) {
+        if (optind == argc) {
+            fprintf(stderr, "missing volume root.\n");
+            return(EXIT_FAILURE);
+        }
+
+        if (scrub_opts.threads == 0)
+            scrub_opts.threads = 1;
+
+        /* The aesfs mount encrypts the file names with the AES key */
+        if (codec.plug == &ioblock_aes_codec)
+            scrub_opts.names = (crypto_aes_t *)codec.data.ptr;
+
+        /* A full volume pass must not evict the page cache */
+        codec.flags |= IOBLOCK_FLAG_UNCACHED;
+
+        o = scrub_volume(&codec, &scrub_opts, argv + optind, argc - optind);
+        return((o != 0) ? EXIT_FAILURE : 0);
+    }
+
     if ((argc - optind) & 1) {
         fprintf(stderr, "file must be provided as <src> <dst> [<src> <dst>]\n");
         return(EXIT_FAILURE);
@@ -0,0 +1,589 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <time.h>
+#include <ftw.h>
+
+#include "scrub.h"
+#include "stats.h"
+
+/* Blocks verified by a thread in one step (4M) */
+#define SCRUB_CHUNK_BLOCKS          (1024)
+#define SCRUB_CHECKPOINT_NSEC       (5000000000ull)
+
+#define __min(a, b)                 (((a) < (b)) ? (a) : (b))
+
+struct scrub_file {
+    char *   path;          /* Backing path */
+    char *   name;          /* User-visible path, used in the reports */
+    uint64_t nblocks;
+};
+
+struct scrub_pos {
+    size_t   file;
+    uint64_t block;
+};
+
+struct scrub {
+    iocodec_t *codec;
+    const scrub_opts_t *opts;
+    pthread_mutex_t lock;
+
+    /* Root being walked, the names are relative to it */
+    const char *root;
+    size_t root_length;
+
+    /* Files to verify, sorted by path */
+    struct scrub_file *files;
+    size_t nfiles;
+    size_t files_size;
+
+    /* Next chunk to verify, and chunks in progress (one per thread) */
+    struct scrub_pos cursor;
+    struct scrub_pos *inflight;
+    uint64_t checkpoint_time;
+
+    /* Rate limit, next time a read is allowed */
+    uint64_t rate_next;
+
+    /* First bad block, the kept checkpoint resumes from it */
+    struct scrub_pos first_bad;
+
+    uint64_t blocks;
+    uint64_t bad;
+};
+
+/* nftw() has no user data */
+static struct scrub *__scrub;
+
+/* ============================================================================
+ *  File names
+ */
+#define __hex_byte(b)               (isdigit(b) ? (b - '0') : (b - 'a' + 10))
+#define __two_hex_bytes(b0, b1)     ((__hex_byte(b0) << 4) + __hex_byte(b1))
+
+/* Same encoding of the aesfs mount, a name is the hex of the encrypted one */
+static char *__scrub_name_decode (crypto_aes_t *aes,
+                                  char *name,
+                                  const char *part,
+                                  size_t size)
+{
+    unsigned char buffer[1024];
+    unsigned int part_size;
+    unsigned char *pbuf;
+
+    /* Names that are not encoded are kept as they are */
+    if ((size & 15) != 0) {
+        memcpy(name, part, size);
+        return(name + size);
+    }
+
+    if ((size >> 1) > sizeof(buffer))
+        return(NULL);
+
+    pbuf = buffer;
+    while (size > 0) {
+        if (!isxdigit(part[0]) || !isxdigit(part[1]))
+            return(NULL);
+        *pbuf++ = __two_hex_bytes(tolower(part[0]), tolower(part[1]));
+        part += 2;
+        size -= 2;
+    }
+
+    if (crypto_aes_decrypt(aes, buffer, pbuf - buffer, name, &part_size))
+        return(NULL);
+
+    return(name + part_size);
+}
+
+/* Maps the backing path to the path seen through the mount, relative to
+ * the walked root. Falls back to the backing path if a name is not
+ * decodable (plain volume, or a different key).
+ */
+static char *__scrub_file_name (struct scrub *scrub, const char *path, int base) {
+    const char *rel;
+    const char *p;
+    char *name;
+    char *pn;
+
+    if (scrub->opts->names == NULL)
+        return(strdup(path));
+
+    /* A single file root has no relative path, only its name */
+    rel = path + scrub->root_length;
+    if (*rel == '\0')
+        rel = path + base;
+    while (*rel == '/')
+        rel++;
+
+    /* Decoded names are never longer than the encoded ones */
+    if ((name = (char *) malloc(strlen(rel) + 2)) == NULL)
+        return(NULL);
+
+    pn = name;
+    while (*rel != '\0') {
+        if ((p = strchr(rel, '/')) == NULL)
+            p = rel + strlen(rel);
+
+        *pn++ = '/';
+        if ((pn = __scrub_name_decode(scrub->opts->names, pn, rel, p - rel)) == NULL) {
+            free(name);
+            return(strdup(path));
+        }
+
+        for (rel = p; *rel == '/'; ++rel);
+    }
+    *pn = '\0';
+
+    return(name);
+}
+
+/* ============================================================================
+ *  Volume walk
+ */
+static int __scrub_add_file (const char *path,
+                             const struct stat *st,
+                             int type,
+                             struct FTW *ftw)
+{
+    struct scrub *scrub = __scrub;
+    struct scrub_file *file;
+    char *name;
+
+    if (type != FTW_F || !S_ISREG(st->st_mode))
+        return(0);
+
+    if (st->st_size < (off_t)IOFHEAD_SIZE) {
+        if ((name = __scrub_file_name(scrub, path, ftw->base)) == NULL)
+            return(-1);
+        printf("%s: missing file header (%s)\n", name, path);
+        scrub->bad++;
+        free(name);
+        return(0);
+    }
+
+    if (scrub->nfiles == scrub->files_size) {
+        size_t size = (scrub->files_size > 0) ? scrub->files_size << 1 : 64;
+        file = (struct scrub_file *) realloc(scrub->files, size * sizeof(struct scrub_file));
+        if (file == NULL)
+            return(-1);
+
+        scrub->files = file;
+        scrub->files_size = size;
+    }
+
+    file = &(scrub->files[scrub->nfiles]);
+    if ((file->path = strdup(path)) == NULL)
+        return(-1);
+
+    if ((file->name = __scrub_file_name(scrub, path, ftw->base)) == NULL) {
+        free(file->path);
+        return(-1);
+    }
+
+    /* A trailing partial block is counted, and reported as bad */
+    file->nblocks = (st->st_size - IOFHEAD_SIZE + IOBLOCK_DISK_SIZE - 1) / IOBLOCK_DISK_SIZE;
+    scrub->nfiles++;
+    return(0);
+}
+
+static int __scrub_file_cmp (const void *a, const void *b) {
+    return(strcmp(((const struct scrub_file *)a)->path,
+                  ((const struct scrub_file *)b)->path));
+}
+
+/* ============================================================================
+ *  Checkpoint
+ */
+#define __pos_cmp(a, b)                                                     \
+    (((a)->file != (b)->file) ? (((a)->file < (b)->file) ? -1 : 1) :        \
+     (((a)->block != (b)->block) ? (((a)->block < (b)->block) ? -1 : 1) : 0))
+
+static int __scrub_checkpoint_load (struct scrub *scrub) {
+    unsigned long long block;
+    char path[4096];
+    size_t i;
+    FILE *fp;
+
+    if ((fp = fopen(scrub->opts->checkpoint, "r")) == NULL)
+        return((errno == ENOENT) ? 0 : -1);
+
+    if (fscanf(fp, "%4095[^\n]\n%llu", path, &block) != 2) {
+        fclose(fp);
+        return(-1);
+    }
+    fclose(fp);
+
+    /* Everything before the checkpoint position was verified */
+    for (i = 0; i < scrub->nfiles; ++i) {
+        int cmp = strcmp(scrub->files[i].path, path);
+        if (cmp > 0)
+            break;
+
+        if (cmp == 0) {
+            scrub->cursor.block = block;
+            break;
+        }
+    }
+
+    scrub->cursor.file = i;
+    printf("resume from %s block %llu\n", path, block);
+    return(0);
+}
+
+static int __scrub_checkpoint_store (struct scrub *scrub, const struct scrub_pos *pos) {
+    char tmp_path[4096];
+    FILE *fp;
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", scrub->opts->checkpoint);
+    if ((fp = fopen(tmp_path, "w")) == NULL)
+        return(-1);
+
+    fprintf(fp, "%s\n%llu\n", scrub->files[pos->file].path,
+            (unsigned long long)pos->block);
+    if (fclose(fp))
+        return(-2);
+
+    return(rename(tmp_path, scrub->opts->checkpoint));
+}
+
+/* Called with the lock held */
+static void __scrub_checkpoint (struct scrub *scrub) {
+    struct scrub_pos pos;
+    uint64_t now;
+    unsigned int i;
+
+    if (scrub->opts->checkpoint == NULL)
+        return;
+
+    now = iostat_now();
+    if ((now - scrub->checkpoint_time) < SCRUB_CHECKPOINT_NSEC)
+        return;
+
+    /* Chunks are handed out in order, before the oldest one in progress
+     * everything is verified.
+     */
+    pos = scrub->cursor;
+    for (i = 0; i < scrub->opts->threads; ++i) {
+        if (scrub->inflight[i].file < scrub->nfiles && __pos_cmp(&(scrub->inflight[i]), &pos) < 0)
+            pos = scrub->inflight[i];
+    }
+
+    if (pos.file < scrub->nfiles && __scrub_checkpoint_store(scrub, &pos))
+        perror("checkpoint");
+
+    scrub->checkpoint_time = now;
+}
+
+/* ============================================================================
+ *  Rate limit
+ */
+static void __scrub_rate_acquire (struct scrub *scrub, size_t bytes) {
+    struct timespec ts;
+    uint64_t wait;
+    uint64_t now;
+
+    if (scrub->opts->rate == 0)
+        return;
+
+    pthread_mutex_lock(&(scrub->lock));
+    now = iostat_now();
+    if (scrub->rate_next < now)
+        scrub->rate_next = now;
+    wait = scrub->rate_next - now;
+    scrub->rate_next += (bytes * 1000000000ull) / ((uint64_t)scrub->opts->rate << 20);
+    pthread_mutex_unlock(&(scrub->lock));
+
+    if (wait > 0) {
+        ts.tv_sec = wait / 1000000000ull;
+        ts.tv_nsec = wait % 1000000000ull;
+        nanosleep(&ts, NULL);
+    }
+}
+
+/* ============================================================================
+ *  Verify
+ */
+static const char *__scrub_error (int error) {
+    switch (error) {
+        case -2: return("decode failed");
+        case -3: return("bad block header");
+        case -4: return("crc mismatch");
+        case -5: return("zeroed block");
+    }
+    return("unknown error");
+}
+
+static void __scrub_bad (struct scrub *scrub, struct scrub_file *file, uint64_t index) {
+    struct scrub_pos pos;
+
+    pos.file = file - scrub->files;
+    pos.block = index;
+
+    pthread_mutex_lock(&(scrub->lock));
+    if (__pos_cmp(&pos, &(scrub->first_bad)) < 0)
+        scrub->first_bad = pos;
+    scrub->bad++;
+    pthread_mutex_unlock(&(scrub->lock));
+}
+
+static void __scrub_check_header (struct scrub *scrub, int fd, struct scrub_file *file) {
+    struct iofhead fhead;
+
+    if (iofhead_read(fd, &fhead))
+        return;
+
+    if (fhead.length > (file->nblocks * IOBLOCK_USER_SIZE)) {
+        printf("%s: header length %llu beyond the data (%s)\n", file->name,
+               (unsigned long long)fhead.length, file->path);
+        __scrub_bad(scrub, file, 0);
+    }
+}
+
+static void __scrub_verify (struct scrub *scrub,
+                            struct scrub_file *file,
+                            uint64_t index,
+                            uint64_t count)
+{
+    ioblock_t *dblocks;
+    ioblock_t ublock;
+    unsigned int nblocks;
+    int i, n, err;
+    int fd;
+
+    if ((fd = open(file->path, O_RDONLY)) < 0) {
+        printf("%s: %s (%s)\n", file->name, strerror(errno), file->path);
+        __scrub_bad(scrub, file, index);
+        return;
+    }
+
+    if ((dblocks = ioblock_batch_alloc()) == NULL) {
+        perror("ioblock_batch_alloc()");
+        close(fd);
+        return;
+    }
+
+    if (index == 0)
+        __scrub_check_header(scrub, fd, file);
+
+    while (count > 0) {
+        nblocks = __min(IOBLOCK_BATCH, count);
+        __scrub_rate_acquire(scrub, nblocks * IOBLOCK_DISK_SIZE);
+
+        if ((n = ioblock_read_batch(scrub->codec, fd, index, nblocks, dblocks)) == 0)
+            break;
+
+        for (i = 0; i < n; ++i) {
+            if ((err = ioblock_decode(scrub->codec, fd, index + i, &ublock, &dblocks[i])) != 0) {
+                printf("%s: bad block %llu, offset %llu (%s disk %llu): %s\n",
+                       file->name,
+                       (unsigned long long)(index + i),
+                       (unsigned long long)((index + i) * IOBLOCK_USER_SIZE),
+                       file->path,
+                       (unsigned long long)IOBLOCK_DISK_OFFSET(index + i),
+                       __scrub_error(err));
+                fflush(stdout);
+                __scrub_bad(scrub, file, index + i);
+            }
+        }
+
+        __sync_fetch_and_add(&(scrub->blocks), n);
+        index += n;
+        count -= n;
+    }
+
+    ioblock_batch_free(dblocks);
+    close(fd);
+}
+
+/* Called with the lock held */
+static int __scrub_next (struct scrub *scrub, struct scrub_pos *pos, uint64_t *count) {
+    struct scrub_file *file;
+
+    while (scrub->cursor.file < scrub->nfiles) {
+        file = &(scrub->files[scrub->cursor.file]);
+        if (scrub->cursor.block < file->nblocks) {
+            *pos = scrub->cursor;
+            *count = __min(SCRUB_CHUNK_BLOCKS, file->nblocks - pos->block);
+            scrub->cursor.block += *count;
+            return(1);
+        }
+
+        scrub->cursor.file++;
+        scrub->cursor.block = 0;
+    }
+
+    return(0);
+}
+
+struct scrub_worker {
+    struct scrub *scrub;
+    unsigned int id;
+};
+
+static void *__scrub_worker (void *data) {
+    struct scrub_worker *worker = (struct scrub_worker *)data;
+    struct scrub *scrub = worker->scrub;
+    struct scrub_pos *inflight;
+    uint64_t count;
+
+    inflight = &(scrub->inflight[worker->id]);
+    for (;;) {
+        pthread_mutex_lock(&(scrub->lock));
+        inflight->file = scrub->nfiles;
+        __scrub_checkpoint(scrub);
+        if (!__scrub_next(scrub, inflight, &count)) {
+            pthread_mutex_unlock(&(scrub->lock));
+            break;
+        }
+        pthread_mutex_unlock(&(scrub->lock));
+
+        __scrub_verify(scrub, &(scrub->files[inflight->file]), inflight->block, count);
+    }
+
+    return(NULL);
+}
+
+int scrub_volume (iocodec_t *codec,
+                  const scrub_opts_t *opts,
+                  char **roots,
+                  int nroots)
+{
+    struct scrub_worker *workers;
+    pthread_t *threads;
+    struct scrub scrub;
+    uint64_t start;
+    unsigned int nthreads;
+    double elapsed;
+    unsigned int i;
+    int res;
+
+    memset(&scrub, 0, sizeof(struct scrub));
+    scrub.codec = codec;
+    scrub.opts = opts;
+
+    /* Collect the files, sorted to have a stable resume order */
+    __scrub = &scrub;
+    for (i = 0; i < (unsigned int)nroots; ++i) {
+        scrub.root = roots[i];
+        scrub.root_length = strlen(roots[i]);
+        if (nftw(roots[i], __scrub_add_file, 32, FTW_PHYS)) {
+            perror(roots[i]);
+            res = -1;
+            goto _cleanup;
+        }
+    }
+    qsort(scrub.files, scrub.nfiles, sizeof(struct scrub_file), __scrub_file_cmp);
+
+    if (opts->checkpoint != NULL && __scrub_checkpoint_load(&scrub)) {
+        fprintf(stderr, "invalid checkpoint %s\n", opts->checkpoint);
+        res = -1;
+        goto _cleanup;
+    }
+
+    threads = (pthread_t *) malloc(opts->threads * sizeof(pthread_t));
+    workers = (struct scrub_worker *) malloc(opts->threads * sizeof(struct scrub_worker));
+    scrub.inflight = (struct scrub_pos *) malloc(opts->threads * sizeof(struct scrub_pos));
+    if (threads == NULL || workers == NULL || scrub.inflight == NULL) {
+        free(scrub.inflight);
+        free(workers);
+        free(threads);
+        res = -1;
+        goto _cleanup;
+    }
+
+    pthread_mutex_init(&(scrub.lock), NULL);
+    scrub.checkpoint_time = iostat_now();
+    scrub.first_bad.file = scrub.nfiles;
+    for (i = 0; i < opts->threads; ++i)
+        scrub.inflight[i].file = scrub.nfiles;
+
+    /* Workers pull from the shared cursor, the started ones cover the volume */
+    start = iostat_now();
+    for (nthreads = 0; nthreads < opts->threads; ++nthreads) {
+        workers[nthreads].scrub = &scrub;
+        workers[nthreads].id = nthreads;
+        if ((errno = pthread_create(&(threads[nthreads]), NULL,
+                                    __scrub_worker, &(workers[nthreads]))) != 0)
+        {
+            perror("pthread_create");
+            break;
+        }
+    }
+
+    for (i = 0; i < nthreads; ++i)
+        pthread_join(threads[i], NULL);
+    elapsed = (iostat_now() - start) / 1000000000.0;
+
+    if (nthreads == 0) {
+        pthread_mutex_destroy(&(scrub.lock));
+        free(scrub.inflight);
+        free(workers);
+        free(threads);
+        res = -1;
+        goto _cleanup;
+    }
+
+    /* Completed, next run starts from the beginning. With bad blocks the
+     * checkpoint is kept, moved to the first bad one: the next run verifies
+     * again from there (e.g. after restoring the files). Files without a
+     * header are not in the list: the next run restarts from the first file.
+     */
+    if (opts->checkpoint != NULL) {
+        if (scrub.bad == 0 || scrub.nfiles == 0) {
+            unlink(opts->checkpoint);
+        } else {
+            if (scrub.first_bad.file == scrub.nfiles) {
+                scrub.first_bad.file = 0;
+                scrub.first_bad.block = 0;
+            }
+            if (__scrub_checkpoint_store(&scrub, &(scrub.first_bad)))
+                perror("checkpoint");
+            else
+                printf("scrub: checkpoint kept in %s\n", opts->checkpoint);
+        }
+    }
+
+    printf("scrub: %zu files, %llu blocks, %llu bad, %.2fsec (%.2fMB/s)\n",
+           scrub.nfiles, (unsigned long long)scrub.blocks,
+           (unsigned long long)scrub.bad, elapsed,
+           ((scrub.blocks * IOBLOCK_DISK_SIZE) / (1024.0 * 1024.0)) / (elapsed + 1e-9));
+
+    pthread_mutex_destroy(&(scrub.lock));
+    free(scrub.inflight);
+    free(workers);
+    free(threads);
+    res = (int)__min(scrub.bad, 0x7fffffff);
+
+_cleanup:
+    for (i = 0; i < scrub.nfiles; ++i) {
+        free(scrub.files[i].path);
+        free(scrub.files[i].name);
+    }
+    free(scrub.files);
+    __scrub = NULL;
+    return(res);
+}
@@ -0,0 +1,44 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef _SCRUB_H_
+#define _SCRUB_H_
+
+#include "crypto.h"
+#include "block.h"
+
+typedef struct scrub_opts scrub_opts_t;
+
+struct scrub_opts {
+    unsigned int threads;       /* Number of verify threads */
+    unsigned int rate;          /* Max read rate in MB/s, 0 unlimited */
+    const char * checkpoint;    /* Resume/progress file, NULL disabled */
+    crypto_aes_t *names;        /* Key of the encrypted file names, NULL plain */
+};
+
+/*
+ * Verify every block of the aesfs files under 'roots' (the backing
+ * directories or single files). Bad blocks are reported on stdout, by
+ * the user-visible path when the file names are encrypted (opts->names).
+ * The checkpoint is removed only when the volume has no bad blocks.
+ * Returns the number of bad blocks, or -1 on error.
+ */
+int scrub_volume (iocodec_t *codec,
+                  const scrub_opts_t *opts,
+                  char **roots,
+                  int nroots);
+
+#endif /* !_SCRUB_H_ */
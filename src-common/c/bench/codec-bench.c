@@ -0,0 +1,884 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+
+/*
+ * Codec and stream stack benchmark.
+ *
+ *   codec-bench [-b 4096,64k] [-n rounds] [-s synthetic-size] [-o out.json] [file ...]
+ *
+ * Every codec is run block by block over each corpus (the given files, or
+ * the synthetic text/records/random corpora) and then as an encoded stream
+ * over an in-memory stream, next to the plain buffered stack.
+ * Results are printed as JSON, one entry per corpus/name/block-size:
+ * ratio, MB/s and the p50/p99 latency of a single block (or a single
+ * block-sized write/read call for the stream stacks).
+ */
+
+#include <sys/stat.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "aes.h"
+#include "buffered.h"
+#include "encoded.h"
+#include "codec.h"
+
+#define BENCH_MAX_BLOCKS        16
+#define BENCH_MAX_CORPUS        32
+#define BENCH_SYNTHETIC_SIZE    (4 << 20)
+#define BENCH_ROUNDS            3
+
+/* ============================================================================
+ *  Timing and latency histogram
+ */
+#define HIST_BUCKETS            (8 + (61 * 8))
+
+struct bench_hist {
+    uint64_t count;
+    uint64_t buckets[HIST_BUCKETS];
+};
+
+static uint64_t __time_nanos (void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return(((uint64_t)ts.tv_sec * 1000000000ull) + ts.tv_nsec);
+}
+
+/* Log-linear buckets: 8 sub-buckets per power of two (12.5% precision) */
+static unsigned int __hist_bucket (uint64_t value) {
+    unsigned int shift;
+
+    if (value < 8)
+        return(value);
+
+    shift = (63 - __builtin_clzll(value)) - 3;
+    return((shift << 3) + (value >> shift));
+}
+
+static uint64_t __hist_bucket_max (unsigned int index) {
+    unsigned int shift;
+
+    if (index < 8)
+        return(index);
+
+    shift = (index >> 3) - 1;
+    return((((uint64_t)(8 + (index & 7)) + 1) << shift) - 1);
+}
+
+static void __hist_add (struct bench_hist *hist, uint64_t nanos) {
+    hist->buckets[__hist_bucket(nanos)]++;
+    hist->count++;
+}
+
+static double __hist_percentile_us (const struct bench_hist *hist,
+                                    double percentile)
+{
+    uint64_t threshold;
+    uint64_t total;
+    unsigned int i;
+
+    threshold = (uint64_t)(hist->count * percentile);
+    if (threshold == 0)
+        threshold = 1;
+
+    total = 0;
+    for (i = 0; i < HIST_BUCKETS; ++i) {
+        total += hist->buckets[i];
+        if (total >= threshold)
+            return(__hist_bucket_max(i) / 1000.0);
+    }
+
+    return(0.0);
+}
+
+/* ============================================================================
+ *  Results
+ */
+struct bench_result {
+    const char *corpus;
+    const char *kind;
+    const char *name;
+    unsigned int block_size;
+    uint64_t bytes;
+    uint64_t encoded_bytes;
+    uint64_t encode_nanos;          /* Best round */
+    uint64_t decode_nanos;          /* Best round */
+    struct bench_hist encode;
+    struct bench_hist decode;
+    int ok;
+};
+
+static void __result_reset (struct bench_result *result,
+                            const char *corpus,
+                            const char *kind,
+                            const char *name,
+                            unsigned int block_size,
+                            uint64_t bytes)
+{
+    memset(result, 0, sizeof(struct bench_result));
+    result->corpus = corpus;
+    result->kind = kind;
+    result->name = name;
+    result->block_size = block_size;
+    result->bytes = bytes;
+    result->encode_nanos = UINT64_MAX;
+    result->decode_nanos = UINT64_MAX;
+    result->ok = 1;
+}
+
+static double __mbs (uint64_t bytes, uint64_t nanos) {
+    if (nanos == 0 || nanos == UINT64_MAX)
+        return(0.0);
+    return((bytes / (1024.0 * 1024.0)) / (nanos / 1000000000.0));
+}
+
+static void __result_dump (FILE *out,
+                           const struct bench_result *result,
+                           int first)
+{
+    double ratio;
+
+    ratio = result->encoded_bytes ?
+                ((double)result->bytes / result->encoded_bytes) : 0.0;
+
+    fprintf(out, "%s    {\"corpus\": \"%s\", \"kind\": \"%s\", \"name\": \"%s\", "
+                 "\"block_size\": %u,\n",
+            first ? "" : ",\n",
+            result->corpus, result->kind, result->name, result->block_size);
+    fprintf(out, "     \"bytes\": %llu, \"encoded_bytes\": %llu, \"ratio\": %.4f, "
+                 "\"ok\": %s,\n",
+            (unsigned long long)result->bytes,
+            (unsigned long long)result->encoded_bytes,
+            ratio, result->ok ? "true" : "false");
+    fprintf(out, "     \"encode_mbs\": %.2f, \"encode_p50_us\": %.2f, "
+                 "\"encode_p99_us\": %.2f,\n",
+            __mbs(result->bytes, result->encode_nanos),
+            __hist_percentile_us(&(result->encode), 0.50),
+            __hist_percentile_us(&(result->encode), 0.99));
+    fprintf(out, "     \"decode_mbs\": %.2f, \"decode_p50_us\": %.2f, "
+                 "\"decode_p99_us\": %.2f}",
+            __mbs(result->bytes, result->decode_nanos),
+            __hist_percentile_us(&(result->decode), 0.50),
+            __hist_percentile_us(&(result->decode), 0.99));
+}
+
+/* ============================================================================
+ *  Corpus
+ */
+struct bench_corpus {
+    char name[64];
+    unsigned char *data;
+    unsigned int size;
+};
+
+static uint64_t __rand_state = 0x9e3779b97f4a7c15ull;
+
+static uint32_t __rand (void) {
+    __rand_state ^= __rand_state << 13;
+    __rand_state ^= __rand_state >> 7;
+    __rand_state ^= __rand_state << 17;
+    return((uint32_t)(__rand_state >> 16));
+}
+
+/* Log lines, repetitive text with a few changing fields */
+static void __corpus_text (unsigned char *data, unsigned int size) {
+    static const char *levels[] = { "INFO", "DEBUG", "WARN", "ERROR" };
+    static const char *words[] = {
+        "request", "completed", "block", "flush", "reader", "writer",
+        "compaction", "segment", "checkpoint", "retry", "timeout", "client",
+    };
+    unsigned int used = 0;
+    char line[256];
+    int n;
+
+    while (used < size) {
+        n = snprintf(line, sizeof(line),
+                     "2012-%02u-%02u %02u:%02u:%02u.%03u %-5s [worker-%u] %s %s id=%08x took=%ums\n",
+                     1 + __rand() % 12, 1 + __rand() % 28, __rand() % 24,
+                     __rand() % 60, __rand() % 60, __rand() % 1000,
+                     levels[__rand() & 3], __rand() % 16,
+                     words[__rand() % 12], words[__rand() % 12],
+                     __rand(), __rand() % 5000);
+        if ((unsigned int)n > (size - used))
+            n = size - used;
+        memcpy(data + used, line, n);
+        used += n;
+    }
+}
+
+/* Fixed size binary records, small integers and a few constant fields */
+static void __corpus_records (unsigned char *data, unsigned int size) {
+    uint32_t key = 0;
+    unsigned int i;
+
+    for (i = 0; (i + 32) <= size; i += 32) {
+        uint32_t value = __rand();
+        key += 1 + (value & 7);
+        memcpy(data + i, &key, 4);
+        memset(data + i + 4, 0, 12);
+        data[i + 4] = value >> 24;
+        data[i + 5] = (value >> 16) & 3;
+        memcpy(data + i + 16, "user:0000000000\n", 16);
+        data[i + 21 + (value & 7)] = '0' + ((value >> 8) % 10);
+    }
+    memset(data + i, 0, size - i);
+}
+
+static void __corpus_random (unsigned char *data, unsigned int size) {
+    unsigned int i;
+    for (i = 0; i < size; ++i)
+        data[i] = __rand() & 0xff;
+}
+
+static int __corpus_synthetic (struct bench_corpus *corpus,
+                               const char *name,
+                               unsigned int size,
+                               void (*generate) (unsigned char *, unsigned int))
+{
+    if ((corpus->data = (unsigned char *) malloc(size)) == NULL)
+        return(-1);
+
+    snprintf(corpus->name, sizeof(corpus->name), "%s", name);
+    corpus->size = size;
+    generate(corpus->data, size);
+    return(0);
+}
+
+static int __corpus_load (struct bench_corpus *corpus, const char *path) {
+    const char *name;
+    struct stat st;
+    FILE *fp;
+
+    if (stat(path, &st) < 0 || st.st_size <= 0 || st.st_size > (1 << 30))
+        return(-1);
+
+    if ((fp = fopen(path, "rb")) == NULL)
+        return(-1);
+
+    corpus->size = st.st_size;
+    if ((corpus->data = (unsigned char *) malloc(corpus->size)) == NULL) {
+        fclose(fp);
+        return(-1);
+    }
+
+    if (fread(corpus->data, 1, corpus->size, fp) != corpus->size) {
+        free(corpus->data);
+        fclose(fp);
+        return(-1);
+    }
+
+    name = strrchr(path, '/');
+    snprintf(corpus->name, sizeof(corpus->name), "%s", name ? name + 1 : path);
+    fclose(fp);
+    return(0);
+}
+
+/* ============================================================================
+ *  Memory stream
+ */
+struct memory_stream {
+    stream_t __base_type__;
+    unsigned char *data;
+    unsigned int capacity;
+    unsigned int size;
+    unsigned int offset;
+};
+
+static int __memory_write (stream_t *stream, const void *buf, unsigned int n) {
+    struct memory_stream *memory = (struct memory_stream *)stream;
+
+    if ((memory->size + n) > memory->capacity) {
+        unsigned int capacity = memory->capacity ? memory->capacity : 4096;
+        unsigned char *data;
+
+        while (capacity < (memory->size + n))
+            capacity <<= 1;
+
+        if ((data = (unsigned char *) realloc(memory->data, capacity)) == NULL)
+            return(-1);
+
+        memory->data = data;
+        memory->capacity = capacity;
+    }
+
+    memcpy(memory->data + memory->size, buf, n);
+    memory->size += n;
+    return(n);
+}
+
+static int __memory_read (stream_t *stream, void *buf, unsigned int n) {
+    struct memory_stream *memory = (struct memory_stream *)stream;
+
+    if (n > (memory->size - memory->offset))
+        n = memory->size - memory->offset;
+
+    memcpy(buf, memory->data + memory->offset, n);
+    memory->offset += n;
+    return(n);
+}
+
+static int __memory_seek (stream_t *stream, uint64_t offset) {
+    struct memory_stream *memory = (struct memory_stream *)stream;
+
+    if (offset > memory->size)
+        return(-1);
+
+    memory->offset = offset;
+    return(0);
+}
+
+static uint64_t __memory_position (stream_t *stream) {
+    return(((struct memory_stream *)stream)->size);
+}
+
+static uint64_t __memory_length (stream_t *stream) {
+    return(((struct memory_stream *)stream)->size);
+}
+
+static const stream_vtable_t __memory_stream = {
+    .write     = __memory_write,
+    .flush     = NULL,
+    .zread     = NULL,
+    .read      = __memory_read,
+    .seek      = __memory_seek,
+
+    .can_write = NULL,
+    .can_zread = NULL,
+    .can_read  = NULL,
+    .can_seek  = NULL,
+
+    .position  = __memory_position,
+    .length    = __memory_length,
+};
+
+static void __memory_reset (struct memory_stream *memory) {
+    memory->__base_type__.vtable = &__memory_stream;
+    memory->size = 0;
+    memory->offset = 0;
+}
+
+/* ============================================================================
+ *  Codecs, add new codecs to __bench_codecs
+ */
+struct bench_codec {
+    const char *name;
+    int  (*open)  (codec_t *codec, int param);
+    void (*close) (codec_t *codec);
+    int param;
+};
+
+static int __plain_open (codec_t *codec, int param) {
+    codec->vtable = &codec_plain;
+    codec->data.ptr = NULL;
+    return(0);
+}
+
+static int __xor_open (codec_t *codec, int param) {
+    codec->vtable = &codec_xor;
+    codec->data.u64 = 0x5bd1e9955bd1e995ull;
+    return(0);
+}
+
+static int __lz4_open (codec_t *codec, int acceleration) {
+    lz4_codec_t *lz4;
+
+    if ((lz4 = (lz4_codec_t *) malloc(sizeof(lz4_codec_t))) == NULL)
+        return(-1);
+
+    if (lz4_codec_open(lz4, acceleration)) {
+        free(lz4);
+        return(-1);
+    }
+
+    codec->vtable = &codec_lz4;
+    codec->data.ptr = lz4;
+    return(0);
+}
+
+static void __lz4_close (codec_t *codec) {
+    lz4_codec_close((lz4_codec_t *)codec->data.ptr);
+    free(codec->data.ptr);
+}
+
+static int __aes_open (codec_t *codec, int param) {
+    aes_t *aes;
+
+    if ((aes = (aes_t *) malloc(sizeof(aes_t))) == NULL)
+        return(-1);
+
+    if (aes_open(aes, "codec-bench", 11, "salt", 4)) {
+        free(aes);
+        return(-1);
+    }
+
+    codec->vtable = &codec_aes;
+    codec->data.ptr = aes;
+    return(0);
+}
+
+static void __aes_close (codec_t *codec) {
+    aes_close((aes_t *)codec->data.ptr);
+    free(codec->data.ptr);
+}
+
+#ifdef HAVE_ZSTD
+static int __zstd_open (codec_t *codec, int level) {
+    zstd_codec_t *zstd;
+
+    if ((zstd = (zstd_codec_t *) malloc(sizeof(zstd_codec_t))) == NULL)
+        return(-1);
+
+    if (zstd_codec_open(zstd, level, 0)) {
+        free(zstd);
+        return(-1);
+    }
+
+    codec->vtable = &codec_zstd;
+    codec->data.ptr = zstd;
+    return(0);
+}
+
+static void __zstd_close (codec_t *codec) {
+    zstd_codec_close((zstd_codec_t *)codec->data.ptr);
+    free(codec->data.ptr);
+}
+#endif /* HAVE_ZSTD */
+
+/* lz4 then aes, the usual compress-and-encrypt stack */
+struct lz4_aes_chain {
+    codec_chain_t chain;
+    codec_t codecs[2];
+};
+
+static int __lz4_aes_open (codec_t *codec, int acceleration) {
+    struct lz4_aes_chain *stack;
+    codec_t *codecs[2];
+
+    if ((stack = (struct lz4_aes_chain *) malloc(sizeof(*stack))) == NULL)
+        return(-1);
+
+    if (__lz4_open(&(stack->codecs[0]), acceleration)) {
+        free(stack);
+        return(-1);
+    }
+
+    if (__aes_open(&(stack->codecs[1]), 0)) {
+        __lz4_close(&(stack->codecs[0]));
+        free(stack);
+        return(-1);
+    }
+
+    codecs[0] = &(stack->codecs[0]);
+    codecs[1] = &(stack->codecs[1]);
+    if (codec_chain_open(&(stack->chain), codecs, 2)) {
+        __aes_close(&(stack->codecs[1]));
+        __lz4_close(&(stack->codecs[0]));
+        free(stack);
+        return(-1);
+    }
+
+    codec->vtable = &codec_chain;
+    codec->data.ptr = stack;
+    return(0);
+}
+
+static void __lz4_aes_close (codec_t *codec) {
+    struct lz4_aes_chain *stack = (struct lz4_aes_chain *)codec->data.ptr;
+    codec_chain_close(&(stack->chain));
+    __aes_close(&(stack->codecs[1]));
+    __lz4_close(&(stack->codecs[0]));
+    free(stack);
+}
+
+static const struct bench_codec __bench_codecs[] = {
+    { "plain",      __plain_open,   NULL,            0 },
+    { "xor",        __xor_open,     NULL,            0 },
+    { "lz4",        __lz4_open,     __lz4_close,     1 },
+    { "lz4-fast8",  __lz4_open,     __lz4_close,     8 },
+    { "aes",        __aes_open,     __aes_close,     0 },
+    { "lz4+aes",    __lz4_aes_open, __lz4_aes_close, 1 },
+#ifdef HAVE_ZSTD
+    { "zstd-1",     __zstd_open,    __zstd_close,    1 },
+    { "zstd-3",     __zstd_open,    __zstd_close,    3 },
+#endif /* HAVE_ZSTD */
+};
+
+#define BENCH_NCODECS   (sizeof(__bench_codecs) / sizeof(__bench_codecs[0]))
+
+/* ============================================================================
+ *  Block bench, one codec call per block
+ */
+static int __bench_blocks (struct bench_result *result,
+                           codec_t *codec,
+                           const struct bench_corpus *corpus,
+                           unsigned int block_size,
+                           unsigned int rounds)
+{
+    unsigned int nblocks, max_length, i, r;
+    unsigned char *encoded, *decoded;
+    unsigned int *sizes;
+    uint64_t start, t, elapsed;
+
+    nblocks = (corpus->size + block_size - 1) / block_size;
+    max_length = codec_max_length(codec, block_size);
+    encoded = (unsigned char *) malloc((size_t)nblocks * max_length);
+    decoded = (unsigned char *) malloc(corpus->size);
+    sizes = (unsigned int *) malloc(nblocks * sizeof(unsigned int));
+    if (encoded == NULL || decoded == NULL || sizes == NULL) {
+        free(encoded);
+        free(decoded);
+        free(sizes);
+        return(-1);
+    }
+
+    for (r = 0; r < rounds; ++r) {
+        result->encoded_bytes = 0;
+        elapsed = 0;
+        for (i = 0; i < nblocks; ++i) {
+            unsigned int offset = i * block_size;
+            unsigned int size = corpus->size - offset;
+            int n;
+
+            if (size > block_size)
+                size = block_size;
+
+            start = __time_nanos();
+            n = codec_encode(codec, encoded + ((size_t)i * max_length), max_length,
+                             corpus->data + offset, size);
+            t = __time_nanos() - start;
+
+            __hist_add(&(result->encode), t);
+            elapsed += t;
+            if (n <= 0) {
+                result->ok = 0;
+                n = 0;
+            }
+            sizes[i] = n;
+            result->encoded_bytes += n;
+        }
+        if (elapsed < result->encode_nanos)
+            result->encode_nanos = elapsed;
+    }
+
+    for (r = 0; r < rounds && result->ok; ++r) {
+        elapsed = 0;
+        for (i = 0; i < nblocks; ++i) {
+            unsigned int offset = i * block_size;
+            unsigned int size = corpus->size - offset;
+            int err;
+
+            if (size > block_size)
+                size = block_size;
+
+            start = __time_nanos();
+            err = codec_decode(codec, decoded + offset, size,
+                               encoded + ((size_t)i * max_length), sizes[i]);
+            t = __time_nanos() - start;
+
+            __hist_add(&(result->decode), t);
+            elapsed += t;
+            if (err)
+                result->ok = 0;
+        }
+        if (elapsed < result->decode_nanos)
+            result->decode_nanos = elapsed;
+    }
+
+    if (result->ok && memcmp(decoded, corpus->data, corpus->size))
+        result->ok = 0;
+
+    free(encoded);
+    free(decoded);
+    free(sizes);
+    return(0);
+}
+
+/* ============================================================================
+ *  Stream bench, one block-sized write/read call at the time
+ */
+static int __bench_stream (struct bench_result *result,
+                           codec_t *codec,
+                           struct memory_stream *memory,
+                           const struct bench_corpus *corpus,
+                           unsigned int block_size,
+                           unsigned int rounds)
+{
+    buffered_writer_t bwriter;
+    buffered_reader_t breader;
+    encoded_writer_t ewriter;
+    encoded_reader_t ereader;
+    stream_t *stream;
+    unsigned char *decoded;
+    uint64_t start, t, elapsed;
+    unsigned int offset, r;
+    int n;
+
+    if ((decoded = (unsigned char *) malloc(corpus->size + block_size)) == NULL)
+        return(-1);
+
+    for (r = 0; r < rounds; ++r) {
+        __memory_reset(memory);
+        if (codec != NULL) {
+            encoded_writer_open(&ewriter, codec, (stream_t *)memory, block_size);
+            stream = (stream_t *)&ewriter;
+        } else {
+            buffered_writer_open(&bwriter, (stream_t *)memory, block_size);
+            stream = (stream_t *)&bwriter;
+        }
+
+        elapsed = 0;
+        for (offset = 0; offset < corpus->size; offset += block_size) {
+            unsigned int size = corpus->size - offset;
+
+            if (size > block_size)
+                size = block_size;
+
+            start = __time_nanos();
+            n = io_write(stream, corpus->data + offset, size);
+            t = __time_nanos() - start;
+
+            __hist_add(&(result->encode), t);
+            elapsed += t;
+            if (n != (int)size)
+                result->ok = 0;
+        }
+
+        start = __time_nanos();
+        if (io_flush(stream) < 0)
+            result->ok = 0;
+        elapsed += __time_nanos() - start;
+
+        if (codec != NULL)
+            encoded_writer_close(&ewriter);
+        else
+            buffered_writer_close(&bwriter);
+
+        if (elapsed < result->encode_nanos)
+            result->encode_nanos = elapsed;
+        result->encoded_bytes = memory->size;
+    }
+
+    for (r = 0; r < rounds && result->ok; ++r) {
+        memory->offset = 0;
+        if (codec != NULL) {
+            encoded_reader_open(&ereader, codec, (stream_t *)memory);
+            stream = (stream_t *)&ereader;
+        } else {
+            buffered_reader_open(&breader, (stream_t *)memory, block_size);
+            stream = (stream_t *)&breader;
+        }
+
+        elapsed = 0;
+        offset = 0;
+        do {
+            start = __time_nanos();
+            n = io_read(stream, decoded + offset, block_size);
+            t = __time_nanos() - start;
+
+            elapsed += t;
+            if (n > 0) {
+                __hist_add(&(result->decode), t);
+                offset += n;
+            }
+        } while (n > 0 && offset < corpus->size);
+
+        if (codec != NULL)
+            encoded_reader_close(&ereader);
+        else
+            buffered_reader_close(&breader);
+
+        if (n < 0 || offset != corpus->size)
+            result->ok = 0;
+        if (elapsed < result->decode_nanos)
+            result->decode_nanos = elapsed;
+    }
+
+    if (result->ok && memcmp(decoded, corpus->data, corpus->size))
+        result->ok = 0;
+
+    free(decoded);
+    return(0);
+}
+
+/* ============================================================================
+ *  Main
+ */
+static unsigned int __parse_size (const char *str, char **end) {
+    unsigned long value;
+
+    value = strtoul(str, end, 10);
+    switch (**end) {
+        case 'k': case 'K': value <<= 10; (*end)++; break;
+        case 'm': case 'M': value <<= 20; (*end)++; break;
+    }
+    return((unsigned int)value);
+}
+
+static unsigned int __parse_blocks (unsigned int *blocks, const char *str) {
+    unsigned int count = 0;
+    char *end;
+
+    while (*str != '\0' && count < BENCH_MAX_BLOCKS) {
+        unsigned int size = __parse_size(str, &end);
+        if (end == str)
+            break;
+        if (size > 0)
+            blocks[count++] = size;
+        str = (*end == ',') ? end + 1 : end;
+    }
+    return(count);
+}
+
+static void __usage (const char *prog) {
+    fprintf(stderr, "usage: %s [-b block-sizes] [-n rounds] [-s synthetic-size] "
+                    "[-o output.json] [file ...]\n", prog);
+}
+
+int main (int argc, char **argv) {
+    struct bench_corpus corpus[BENCH_MAX_CORPUS];
+    unsigned int blocks[BENCH_MAX_BLOCKS];
+    unsigned int nblocks, ncorpus, rounds, synthetic;
+    struct memory_stream memory;
+    struct bench_result result;
+    const char *output = NULL;
+    unsigned int c, b, k;
+    codec_t codec;
+    char *end;
+    FILE *out;
+    int first;
+    int opt;
+
+    nblocks = 0;
+    rounds = BENCH_ROUNDS;
+    synthetic = BENCH_SYNTHETIC_SIZE;
+    while ((opt = getopt(argc, argv, "b:n:s:o:h")) != -1) {
+        switch (opt) {
+            case 'b':
+                nblocks = __parse_blocks(blocks, optarg);
+                break;
+            case 'n':
+                rounds = strtoul(optarg, NULL, 10);
+                break;
+            case 's':
+                synthetic = __parse_size(optarg, &end);
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            default:
+                __usage(argv[0]);
+                return(1);
+        }
+    }
+
+    if (nblocks == 0) {
+        blocks[0] = 4 << 10;
+        blocks[1] = 64 << 10;
+        nblocks = 2;
+    }
+
+    if (rounds == 0)
+        rounds = 1;
+
+    ncorpus = 0;
+    if (optind < argc) {
+        for (; optind < argc && ncorpus < BENCH_MAX_CORPUS; ++optind) {
+            if (__corpus_load(&(corpus[ncorpus]), argv[optind])) {
+                fprintf(stderr, "codec-bench: unable to load %s\n", argv[optind]);
+                continue;
+            }
+            ncorpus++;
+        }
+    } else if (synthetic > 0) {
+        if (!__corpus_synthetic(&(corpus[ncorpus]), "text", synthetic, __corpus_text))
+            ncorpus++;
+        if (!__corpus_synthetic(&(corpus[ncorpus]), "records", synthetic, __corpus_records))
+            ncorpus++;
+        if (!__corpus_synthetic(&(corpus[ncorpus]), "random", synthetic, __corpus_random))
+            ncorpus++;
+    }
+
+    if (ncorpus == 0) {
+        fprintf(stderr, "codec-bench: no corpus to run\n");
+        return(1);
+    }
+
+    if (output == NULL) {
+        out = stdout;
+    } else if ((out = fopen(output, "w")) == NULL) {
+        perror(output);
+        return(1);
+    }
+
+    memset(&memory, 0, sizeof(struct memory_stream));
+    __memory_reset(&memory);
+
+    fprintf(out, "{\"bench\": \"codec-bench\", \"rounds\": %u, \"results\": [\n", rounds);
+    first = 1;
+    for (c = 0; c < ncorpus; ++c) {
+        for (b = 0; b < nblocks; ++b) {
+            /* Stream stack without codecs, for reference */
+            __result_reset(&result, corpus[c].name, "stream", "buffered",
+                           blocks[b], corpus[c].size);
+            if (!__bench_stream(&result, NULL, &memory, &(corpus[c]), blocks[b], rounds)) {
+                __result_dump(out, &result, first);
+                first = 0;
+            }
+
+            for (k = 0; k < BENCH_NCODECS; ++k) {
+                const struct bench_codec *bench = &(__bench_codecs[k]);
+
+                if (bench->open(&codec, bench->param)) {
+                    fprintf(stderr, "codec-bench: %s not available\n", bench->name);
+                    continue;
+                }
+
+                __result_reset(&result, corpus[c].name, "codec", bench->name,
+                               blocks[b], corpus[c].size);
+                if (!__bench_blocks(&result, &codec, &(corpus[c]), blocks[b], rounds)) {
+                    __result_dump(out, &result, first);
+                    first = 0;
+                }
+
+                __result_reset(&result, corpus[c].name, "encoded", bench->name,
+                               blocks[b], corpus[c].size);
+                if (!__bench_stream(&result, &codec, &memory, &(corpus[c]), blocks[b], rounds)) {
+                    __result_dump(out, &result, first);
+                    first = 0;
+                }
+
+                if (bench->close != NULL)
+                    bench->close(&codec);
+            }
+        }
+    }
+    fprintf(out, "\n]}\n");
+
+    if (out != stdout) {
+        fclose(out);
+        printf("codec-bench: results written to %s\n", output);
+    }
+
+    for (c = 0; c < ncorpus; ++c)
+        free(corpus[c].data);
+    free(memory.data);
+    return(0);
+}
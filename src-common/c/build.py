@@ -22,6 +22,7 @@ from threading import Thread
 
 import shutil
 import string
+import pipes
 import time
 import sys
 import os
@@ -203,9 +204,9 @@ class Build(object):
         else:
             _removeDirectory(self._dir_obj)
 
-    def runTool(self, tool, verbose=True):
+    def runTool(self, tool, verbose=True, args=None):
         ldLibraryPathUpdate([self._dir_lib])
-        exit_code, output = execCommand(tool)
+        exit_code, output = execCommand('%s %s' % (tool, args) if args else tool)
 
         tool_output = []
         if verbose:
@@ -543,6 +544,19 @@ class BuildLibrary(Build):
                         shutil.copyfile(src_path, dst_path)
                         msg_write(' [CP]', dst_path)
 
+def _benchArgs(options, tool):
+    args = []
+    if options.bench_blocks:
+        args.append('-b %s' % options.bench_blocks)
+    if options.bench_json:
+        if not os.path.exists(options.bench_json):
+            os.makedirs(options.bench_json)
+        json_path = os.path.join(options.bench_json, '%s.json' % os.path.basename(tool))
+        args.append('-o %s' % pipes.quote(json_path))
+    if options.bench_corpus:
+        args.extend([pipes.quote(path) for path in options.bench_corpus.split(',') if path])
+    return ' '.join(args)
+
 def _parseCmdline():
     try:
         from argparse import ArgumentParser
@@ -568,6 +582,16 @@ def _parseCmdline():
                         help="Show traceback infomation if something fails")
     parser.add_argument('--no-output', dest='no_output', action='store_true', default=False,
                         help='Do not print messages')
+    parser.add_argument('--zstd', dest='zstd', action='store_true', default=False,
+                        help='Build the zstd codecs (requires libzstd)')
+    parser.add_argument('--bench', dest='bench', action='store_true', default=False,
+                        help='Build and run the benchmarks')
+    parser.add_argument('--bench-corpus', dest='bench_corpus', action='store', default=None,
+                        help='Comma separated list of files used as benchmark corpus')
+    parser.add_argument('--bench-blocks', dest='bench_blocks', action='store', default=None,
+                        help='Comma separated list of benchmark block sizes (e.g. 4k,64k)')
+    parser.add_argument('--bench-json', dest='bench_json', action='store', default=None,
+                        help='Directory where the benchmarks write the JSON results')
 
     return parser.parse_args()
 
@@ -580,13 +604,17 @@ if __name__ == '__main__':
     DEFAULT_RELEASE_CFLAGS = ['-O2']
     DEFAULT_DEBUG_CFLAGS = ['-g']
     DEFAULT_DEFINES = ['-D__USE_FILE_OFFSET64']
-    DEFAULT_LDLIBS = ['-lcrypto']
+    DEFAULT_LDLIBS = ['-lcrypto', '-lpthread']
 
     if Build.platformIsMac():
         DEFAULT_DEFINES.extend(['-DAES_COMMON_CRYPTO', '-DSHA1_COMMON_CRYPTO'])
     else:
         DEFAULT_DEFINES.extend(['-DAES_OPENSSL', '-DSHA1_OPENSSL'])
 
+    if options.zstd:
+        DEFAULT_DEFINES.append('-DHAVE_ZSTD')
+        DEFAULT_LDLIBS.append('-lzstd')
+
     # Default Build Options
     default_opts = BuildOptions()
     default_opts.addDefines(DEFAULT_DEFINES)
@@ -633,3 +661,14 @@ if __name__ == '__main__':
         tools = build.build()
         build.runTools('Demo', tools, verbose=options.verbose)
 
+        if options.bench:
+            build = BuildMiniTools('common-bench', ['bench'], options=build_opts)
+            tools = build.build()
+
+            # Run one at a time, benchmarks should not compete for the cpus
+            msg_write('Run Tools:', 'Bench')
+            msg_write('-' * 60)
+            for tool in sorted(tools):
+                build.runTool(tool, verbose=True, args=_benchArgs(options, tool))
+            msg_write()
+
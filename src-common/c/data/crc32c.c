@@ -0,0 +1,180 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+
+#include <pthread.h>
+#include <string.h>
+
+#include "crc32c.h"
+
+#define CRC32C_POLY                 0x82f63b78U
+
+/* Lanes of the interleaved hardware loop, combined with __crc32c_shift() */
+#define CRC32C_LANE                 4096
+
+static uint32_t __crc32c_table[8][256];
+static uint32_t __crc32c_lane_shift[4][256];
+static pthread_once_t __crc32c_once = PTHREAD_ONCE_INIT;
+static int __crc32c_has_hw = 0;
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    #define __le64(x)               __builtin_bswap64(x)
+#else
+    #define __le64(x)               (x)
+#endif
+
+/* ============================================================================
+ *  Tables
+ */
+static void __crc32c_init (void) {
+    uint32_t basis[32];
+    uint32_t c;
+    unsigned int i, j, k;
+
+    for (i = 0; i < 256; ++i) {
+        c = i;
+        for (j = 0; j < 8; ++j)
+            c = (c & 1) ? ((c >> 1) ^ CRC32C_POLY) : (c >> 1);
+        __crc32c_table[0][i] = c;
+    }
+
+    for (i = 0; i < 256; ++i) {
+        for (k = 1; k < 8; ++k) {
+            c = __crc32c_table[k - 1][i];
+            __crc32c_table[k][i] = (c >> 8) ^ __crc32c_table[0][c & 0xff];
+        }
+    }
+
+    /* Appending CRC32C_LANE zero bytes is linear in the crc register */
+    for (i = 0; i < 32; ++i) {
+        c = 1U << i;
+        for (j = 0; j < CRC32C_LANE; ++j)
+            c = (c >> 8) ^ __crc32c_table[0][c & 0xff];
+        basis[i] = c;
+    }
+
+    for (k = 0; k < 4; ++k) {
+        for (i = 0; i < 256; ++i) {
+            c = 0;
+            for (j = 0; j < 8; ++j) {
+                if (i & (1U << j))
+                    c ^= basis[(k << 3) + j];
+            }
+            __crc32c_lane_shift[k][i] = c;
+        }
+    }
+}
+
+/* ============================================================================
+ *  Software, slicing-by-8
+ */
+static uint32_t __crc32c_sw (uint32_t c, const uint8_t *p, size_t n) {
+    uint64_t v;
+
+    while (n >= 8) {
+        memcpy(&v, p, 8);
+        v = __le64(v) ^ c;
+        c = __crc32c_table[7][v & 0xff] ^
+            __crc32c_table[6][(v >> 8) & 0xff] ^
+            __crc32c_table[5][(v >> 16) & 0xff] ^
+            __crc32c_table[4][(v >> 24) & 0xff] ^
+            __crc32c_table[3][(v >> 32) & 0xff] ^
+            __crc32c_table[2][(v >> 40) & 0xff] ^
+            __crc32c_table[1][(v >> 48) & 0xff] ^
+            __crc32c_table[0][v >> 56];
+        p += 8;
+        n -= 8;
+    }
+
+    while (n--)
+        c = (c >> 8) ^ __crc32c_table[0][(c ^ *p++) & 0xff];
+
+    return(c);
+}
+
+/* ============================================================================
+ *  Hardware, SSE4.2 (three independent lanes hide the crc32 latency)
+ */
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <nmmintrin.h>
+
+#define __CRC32C_HW     1
+
+static inline uint32_t __crc32c_shift (uint32_t c) {
+    return(__crc32c_lane_shift[0][c & 0xff] ^
+           __crc32c_lane_shift[1][(c >> 8) & 0xff] ^
+           __crc32c_lane_shift[2][(c >> 16) & 0xff] ^
+           __crc32c_lane_shift[3][c >> 24]);
+}
+
+__attribute__((target("sse4.2")))
+static uint32_t __crc32c_hw (uint32_t crc, const uint8_t *p, size_t n) {
+    uint64_t c0 = crc;
+    uint64_t c1, c2, v;
+    const uint8_t *end;
+
+    while (n >= (3 * CRC32C_LANE)) {
+        c1 = 0;
+        c2 = 0;
+        for (end = p + CRC32C_LANE; p < end; p += 8) {
+            memcpy(&v, p, 8);
+            c0 = _mm_crc32_u64(c0, v);
+            memcpy(&v, p + CRC32C_LANE, 8);
+            c1 = _mm_crc32_u64(c1, v);
+            memcpy(&v, p + 2 * CRC32C_LANE, 8);
+            c2 = _mm_crc32_u64(c2, v);
+        }
+        c0 = __crc32c_shift((uint32_t)c0) ^ (uint32_t)c1;
+        c0 = __crc32c_shift((uint32_t)c0) ^ (uint32_t)c2;
+        p += 2 * CRC32C_LANE;
+        n -= 3 * CRC32C_LANE;
+    }
+
+    while (n >= 8) {
+        memcpy(&v, p, 8);
+        c0 = _mm_crc32_u64(c0, v);
+        p += 8;
+        n -= 8;
+    }
+
+    while (n--)
+        c0 = _mm_crc32_u8((uint32_t)c0, *p++);
+
+    return((uint32_t)c0);
+}
+#endif
+
+/* ============================================================================
+ *  Public API
+ */
+static void __crc32c_setup (void) {
+    __crc32c_init();
+#if defined(__CRC32C_HW)
+    __crc32c_has_hw = __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+uint32_t crc32c (uint32_t crc, const void *data, size_t length) {
+    /* Tables are built once, pthread_once() publishes them to every thread */
+    pthread_once(&__crc32c_once, __crc32c_setup);
+
+#if defined(__CRC32C_HW)
+    if (__crc32c_has_hw)
+        return(~__crc32c_hw(~crc, (const uint8_t *)data, length));
+#endif
+
+    return(~__crc32c_sw(~crc, (const uint8_t *)data, length));
+}
@@ -0,0 +1,39 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef _DATA_CRC32C_H_
+#define _DATA_CRC32C_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * CRC-32C (Castagnoli), as used by iSCSI/ext4/leveldb.
+ * crc32c(0, "123456789", 9) == 0xe3069283
+ * Chain calls passing the previous result as 'crc'. Uses the SSE4.2
+ * crc32 instruction when the cpu has it, a slicing-by-8 table otherwise.
+ */
+uint32_t    crc32c          (uint32_t crc, const void *data, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !_DATA_CRC32C_H_ */
@@ -0,0 +1,274 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <string.h>
+
+#include "hash.h"
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    #define __le64(x)               __builtin_bswap64(x)
+    #define __le32(x)               __builtin_bswap32(x)
+#else
+    #define __le64(x)               (x)
+    #define __le32(x)               (x)
+#endif
+
+#define HASH_READ_SIZE              4096
+
+static const uint64_t __hash_secret[4] = {
+    0xa0761d6478bd642full, 0xe7037ed1a0b428dbull,
+    0x8ebc6af09c88c6e3ull, 0x589965cc75374cc3ull,
+};
+
+#define S0      __hash_secret[0]
+#define S1      __hash_secret[1]
+#define S2      __hash_secret[2]
+#define S3      __hash_secret[3]
+
+/* ============================================================================
+ *  Primitives
+ */
+static inline uint64_t __mix (uint64_t a, uint64_t b) {
+    __uint128_t r = (__uint128_t)a * b;
+    return((uint64_t)r ^ (uint64_t)(r >> 64));
+}
+
+static inline uint64_t __rotl (uint64_t x, unsigned int r) {
+    return((x << r) | (x >> (64 - r)));
+}
+
+static inline uint64_t __read64 (const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return(__le64(v));
+}
+
+static inline uint64_t __read32 (const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return(__le32(v));
+}
+
+/* The n (<= 8) bytes at p as a zero padded little-endian word */
+static inline uint64_t __read_partial (const uint8_t *p, size_t n) {
+    if (n >= 4) {
+        /* Overlapping loads, the shared bytes land on the same bits */
+        return(__read32(p) | (__read32(p + n - 4) << ((n - 4) << 3)));
+    }
+    if (n > 0) {
+        return((uint64_t)p[0] |
+               ((uint64_t)p[n >> 1] << ((n >> 1) << 3)) |
+               ((uint64_t)p[n - 1] << ((n - 1) << 3)));
+    }
+    return(0);
+}
+
+static inline uint64_t __hash_seed (uint64_t seed) {
+    return(seed ^ __mix(seed ^ S0, S1));
+}
+
+static inline void __hash_stripe (uint64_t *lanes, const uint8_t *p) {
+    lanes[0] = __mix(__read64(p +  0) ^ S1, __read64(p +  8) ^ lanes[0]);
+    lanes[1] = __mix(__read64(p + 16) ^ S2, __read64(p + 24) ^ lanes[1]);
+    lanes[2] = __mix(__read64(p + 32) ^ S3, __read64(p + 40) ^ lanes[2]);
+}
+
+/* Fold the lanes and the 0..48 bytes tail, 'b' is the hash128 accumulator */
+static inline uint64_t __hash_tail (const uint64_t *lanes,
+                                    const uint8_t *p,
+                                    size_t n,
+                                    uint64_t *b)
+{
+    uint64_t a = lanes[0] ^ lanes[1] ^ lanes[2];
+    uint64_t x, y;
+
+    if (b != NULL)
+        *b = lanes[0] + __rotl(lanes[1], 21) + __rotl(lanes[2], 42);
+
+    while (n > 0) {
+        if (n >= 16) {
+            x = __read64(p);
+            y = __read64(p + 8);
+            p += 16;
+            n -= 16;
+        } else if (n > 8) {
+            x = __read64(p);
+            y = __read_partial(p + 8, n - 8);
+            n = 0;
+        } else {
+            x = __read_partial(p, n);
+            y = 0;
+            n = 0;
+        }
+
+        a = __mix(x ^ S1, y ^ a);
+        if (b != NULL)
+            *b = __mix(x ^ S2, y ^ *b);
+    }
+
+    return(a);
+}
+
+static inline uint64_t __hash_final64 (uint64_t a, uint64_t length) {
+    return(__mix(a ^ S0, S1 ^ length));
+}
+
+/* ============================================================================
+ *  One-shot
+ */
+uint64_t hash64 (const void *data, size_t length, uint64_t seed) {
+    const uint8_t *p = (const uint8_t *)data;
+    uint64_t lanes[3];
+    size_t n = length;
+
+    lanes[0] = lanes[1] = lanes[2] = __hash_seed(seed);
+    for (; n > HASH_STRIPE_SIZE; n -= HASH_STRIPE_SIZE, p += HASH_STRIPE_SIZE)
+        __hash_stripe(lanes, p);
+
+    return(__hash_final64(__hash_tail(lanes, p, n, NULL), length));
+}
+
+void hash128 (hash128_t *hash, const void *data, size_t length, uint64_t seed) {
+    const uint8_t *p = (const uint8_t *)data;
+    uint64_t lanes[3];
+    size_t n = length;
+    uint64_t a, b;
+
+    lanes[0] = lanes[1] = lanes[2] = __hash_seed(seed);
+    for (; n > HASH_STRIPE_SIZE; n -= HASH_STRIPE_SIZE, p += HASH_STRIPE_SIZE)
+        __hash_stripe(lanes, p);
+
+    a = __hash_tail(lanes, p, n, &b);
+    hash->low = __hash_final64(a, length);
+    hash->high = __mix(b ^ S2, S3 ^ length);
+}
+
+void hash64_many (const void * const *keys,
+                  const size_t *lengths,
+                  size_t count,
+                  uint64_t *hashes,
+                  uint64_t seed)
+{
+    uint64_t h0 = __hash_seed(seed);
+    uint64_t x[4], y[4], a;
+    const uint8_t *p;
+    size_t i, j, n;
+
+    /* No vector 64x64->128 multiply: short keys 4 at a time, to overlap them */
+    for (i = 0; (i + 4) <= count; i += 4) {
+        if ((lengths[i] | lengths[i + 1] | lengths[i + 2] | lengths[i + 3]) > 16) {
+            for (j = i; j < (i + 4); ++j)
+                hashes[j] = hash64(keys[j], lengths[j], seed);
+            continue;
+        }
+
+        for (j = 0; j < 4; ++j) {
+            p = (const uint8_t *)keys[i + j];
+            n = lengths[i + j];
+            x[j] = (n > 8) ? __read64(p) : __read_partial(p, n);
+            y[j] = (n > 8) ? __read_partial(p + 8, n - 8) : 0;
+        }
+
+        for (j = 0; j < 4; ++j) {
+            a = (lengths[i + j] > 0) ? __mix(x[j] ^ S1, y[j] ^ h0) : h0;
+            hashes[i + j] = __hash_final64(a, lengths[i + j]);
+        }
+    }
+
+    for (; i < count; ++i)
+        hashes[i] = hash64(keys[i], lengths[i], seed);
+}
+
+/* ============================================================================
+ *  Streaming
+ */
+void hash_init (hash_state_t *state, uint64_t seed) {
+    state->lanes[0] = state->lanes[1] = state->lanes[2] = __hash_seed(seed);
+    state->length = 0;
+    state->buffered = 0;
+}
+
+void hash_update (hash_state_t *state, const void *data, size_t length) {
+    const uint8_t *p = (const uint8_t *)data;
+    size_t n;
+
+    state->length += length;
+
+    /* A stripe is consumed only when more data follows it */
+    if (state->buffered > 0) {
+        n = HASH_STRIPE_SIZE - state->buffered;
+        if (length <= n) {
+            memcpy(state->buffer + state->buffered, p, length);
+            state->buffered += length;
+            return;
+        }
+
+        memcpy(state->buffer + state->buffered, p, n);
+        __hash_stripe(state->lanes, state->buffer);
+        state->buffered = 0;
+        p += n;
+        length -= n;
+    }
+
+    for (; length > HASH_STRIPE_SIZE; length -= HASH_STRIPE_SIZE, p += HASH_STRIPE_SIZE)
+        __hash_stripe(state->lanes, p);
+
+    memcpy(state->buffer, p, length);
+    state->buffered = length;
+}
+
+int hash_update_slice (hash_state_t *state, const slice_t *slice) {
+    uint8_t buffer[HASH_READ_SIZE];
+    unsigned int offset, length;
+    int n;
+
+    length = slice_length(slice);
+    for (offset = 0; offset < length; offset += n) {
+        if ((n = slice_copy(slice, buffer, offset, sizeof(buffer))) <= 0)
+            return(-1);
+        hash_update(state, buffer, n);
+    }
+
+    return(0);
+}
+
+int64_t hash_update_stream (hash_state_t *state, stream_t *stream) {
+    uint8_t buffer[HASH_READ_SIZE];
+    int64_t total = 0;
+    int rd;
+
+    while ((rd = io_read(stream, buffer, sizeof(buffer))) > 0) {
+        hash_update(state, buffer, rd);
+        total += rd;
+    }
+
+    return((rd < 0) ? -1 : total);
+}
+
+uint64_t hash_digest64 (const hash_state_t *state) {
+    uint64_t a;
+
+    a = __hash_tail(state->lanes, state->buffer, state->buffered, NULL);
+    return(__hash_final64(a, state->length));
+}
+
+void hash_digest128 (const hash_state_t *state, hash128_t *hash) {
+    uint64_t a, b;
+
+    a = __hash_tail(state->lanes, state->buffer, state->buffered, &b);
+    hash->low = __hash_final64(a, state->length);
+    hash->high = __mix(b ^ S2, S3 ^ state->length);
+}
@@ -0,0 +1,82 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef _DATA_HASH_H_
+#define _DATA_HASH_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "stream.h"
+#include "slice.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 64/128-bit non-cryptographic hash (wyhash-style 64x64->128 multiply
+ * mixing, 48-byte stripes). The output depends only on the bytes and
+ * the seed, it is stable across platforms and releases. The C++ library
+ * Hash.h wraps these functions.
+ */
+#define HASH_DEFAULT_SEED           0x3c6ef372fe94f82bull
+#define HASH_STRIPE_SIZE            48
+
+typedef struct hash128 hash128_t;
+typedef struct hash_state hash_state_t;
+
+struct hash128 {
+    uint64_t low;
+    uint64_t high;
+};
+
+struct hash_state {
+    uint64_t lanes[3];
+    uint64_t length;
+    uint8_t  buffer[HASH_STRIPE_SIZE];
+    unsigned int buffered;
+};
+
+uint64_t    hash64              (const void *data,
+                                 size_t length,
+                                 uint64_t seed);
+void        hash128             (hash128_t *hash,
+                                 const void *data,
+                                 size_t length,
+                                 uint64_t seed);
+
+/* hashes[i] = hash64(keys[i], lengths[i], seed) */
+void        hash64_many         (const void * const *keys,
+                                 const size_t *lengths,
+                                 size_t count,
+                                 uint64_t *hashes,
+                                 uint64_t seed);
+
+void        hash_init           (hash_state_t *state, uint64_t seed);
+void        hash_update         (hash_state_t *state,
+                                 const void *data,
+                                 size_t length);
+int         hash_update_slice   (hash_state_t *state, const slice_t *slice);
+int64_t     hash_update_stream  (hash_state_t *state, stream_t *stream);
+uint64_t    hash_digest64       (const hash_state_t *state);
+void        hash_digest128      (const hash_state_t *state, hash128_t *hash);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !_DATA_HASH_H_ */
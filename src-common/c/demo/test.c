@@ -24,6 +24,7 @@
 #include "buffered.h"
 #include "encoded.h"
 #include "stream.h"
+#include "frame.h"
 #include "disk.h"
 #include "aes.h"
 
@@ -88,6 +89,7 @@ static void __test1 (void) {
     codec_t lz4_codec;
 
     lz4_codec.vtable = &codec_lz4;
+    lz4_codec.data.ptr = NULL;
 
     printf("================================================\n");
     printf("TEST 1 - Encoded Writer\n");
@@ -214,12 +216,18 @@ static void __test_rwencoded (const char *filename, codec_t *codec) {
 }
 
 static void __test4 (void) {
+    lz4_codec_t lz4;
     codec_t codec;
-    codec.vtable = &codec_lz4;
 
     printf("================================================\n");
     printf("TEST 4 - Disk Stream + LZ4 Encoded Writer/Reader\n");
+
+    codec.vtable = &codec_lz4;
+    codec.data.ptr = &lz4;
+
+    lz4_codec_open(&lz4, 1);
     __test_rwencoded("test4.data", &codec);
+    lz4_codec_close(&lz4);
 }
 
 static void __test5 (void) {
@@ -237,6 +245,139 @@ static void __test5 (void) {
     aes_close(&aes);
 }
 
+#ifdef HAVE_ZSTD
+static void __test8 (void) {
+    zstd_codec_t zstd;
+    codec_t codec;
+
+    printf("================================================\n");
+    printf("TEST 8 - Disk Stream + Zstd Encoded Writer/Reader\n");
+
+    codec.vtable = &codec_zstd;
+    codec.data.ptr = &zstd;
+
+    zstd_codec_open(&zstd, 3, 0);
+    __test_rwencoded("test8.data", &codec);
+    zstd_codec_close(&zstd);
+}
+#endif /* HAVE_ZSTD */
+
+static void __test9 (void) {
+    codec_t codecs[2];
+    codec_t *chain_codecs[2];
+    codec_chain_t chain;
+    lz4_codec_t lz4;
+    codec_t codec;
+    aes_t aes;
+
+    printf("================================================\n");
+    printf("TEST 9 - Disk Stream + LZ4/AES Chain Encoded Writer/Reader\n");
+
+    codecs[0].vtable = &codec_lz4;
+    codecs[0].data.ptr = &lz4;
+    codecs[1].vtable = &codec_aes;
+    codecs[1].data.ptr = &aes;
+    chain_codecs[0] = &codecs[0];
+    chain_codecs[1] = &codecs[1];
+
+    codec.vtable = &codec_chain;
+    codec.data.ptr = &chain;
+
+    lz4_codec_open(&lz4, 1);
+    aes_open(&aes, "MyAesKey", 8, "abcdefgh", 8);
+    codec_chain_open(&chain, chain_codecs, 2);
+    __test_rwencoded("test9.data", &codec);
+    codec_chain_close(&chain);
+    aes_close(&aes);
+    lz4_codec_close(&lz4);
+}
+
+static void __test11 (void) {
+    codec_t codecs[3];
+    codec_t *chain_codecs[3];
+    codec_chain_t chain;
+    lz4_codec_t lz4;
+    codec_t codec;
+
+    printf("================================================\n");
+    printf("TEST 11 - Disk Stream + XOR/LZ4/XOR Chain Encoded Writer/Reader\n");
+
+    /* Same codec twice with different keys, decoded by position */
+    codecs[0].vtable = &codec_xor;
+    codecs[0].data.u64 = 0x5a17c0de5a17c0deull;
+    codecs[1].vtable = &codec_lz4;
+    codecs[1].data.ptr = &lz4;
+    codecs[2].vtable = &codec_xor;
+    codecs[2].data.u64 = 0x0123456789abcdefull;
+    chain_codecs[0] = &codecs[0];
+    chain_codecs[1] = &codecs[1];
+    chain_codecs[2] = &codecs[2];
+
+    codec.vtable = &codec_chain;
+    codec.data.ptr = &chain;
+
+    lz4_codec_open(&lz4, 1);
+    codec_chain_open(&chain, chain_codecs, 3);
+    __test_rwencoded("test11.data", &codec);
+    codec_chain_close(&chain);
+    lz4_codec_close(&lz4);
+}
+
+static void __test10 (void) {
+    encoded_writer_t encoded_writer;
+    encoded_reader_t encoded_reader;
+    disk_stream_t disk;
+    stream_t *stream;
+    lz4_codec_t lz4;
+    char buffer[48];
+    codec_t codec;
+    int n;
+
+    printf("================================================\n");
+    printf("TEST 10 - Disk Stream + LZ4 Encoded, Damaged Block Resync\n");
+
+    codec.vtable = &codec_lz4;
+    codec.data.ptr = &lz4;
+    lz4_codec_open(&lz4, 1);
+
+    disk_stream_create(&disk, "test10.data", O_CREAT | O_TRUNC | O_RDWR, 0644);
+    encoded_writer_open(&encoded_writer, &codec, (stream_t *)&disk, 11);
+    stream = (stream_t *)&encoded_writer;
+    io_write(stream, "Hello World", 11);
+    io_write(stream, "Damaged Blk", 11);
+    io_write(stream, "Hello World", 11);
+    io_flush(stream);
+    encoded_writer_close(&encoded_writer);
+
+    /* Flip a byte in the second block payload */
+    n = io_length((stream_t *)&disk) / 3;
+    io_seek((stream_t *)&disk, n + FRAME_HEADER_SIZE + 2);
+    io_write((stream_t *)&disk, "?", 1);
+
+    io_seek((stream_t *)&disk, 0);
+    encoded_reader_open(&encoded_reader, &codec, (stream_t *)&disk);
+    stream = (stream_t *)&encoded_reader;
+    n = io_read(stream, buffer, 33);
+    printf("no resync: read %d\n", n);
+    encoded_reader_close(&encoded_reader);
+
+    io_seek((stream_t *)&disk, 0);
+    encoded_reader_open(&encoded_reader, &codec, (stream_t *)&disk);
+    encoded_reader_set_flags(&encoded_reader, ENCODED_VERIFY_STORED |
+                                              ENCODED_VERIFY_DATA |
+                                              ENCODED_RESYNC);
+    stream = (stream_t *)&encoded_reader;
+    n = io_read(stream, buffer, 33);
+    buffer[n] = 0;
+    printf("resync: read %d %s (damaged %llu skipped %llu)\n", n, buffer,
+           (unsigned long long)encoded_reader.damaged,
+           (unsigned long long)encoded_reader.skipped);
+    encoded_reader_close(&encoded_reader);
+
+    disk_stream_close(&disk);
+    lz4_codec_close(&lz4);
+}
+
 /* ============================================================================
  *  Data Tests
  */
@@ -332,6 +473,12 @@ int main (int argc, char **argv) {
     __test3();
     __test4();
     __test5();
+#ifdef HAVE_ZSTD
+    __test8();
+#endif
+    __test9();
+    __test11();
+    __test10();
 
     __test6();
     __test7();
@@ -17,12 +17,129 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <time.h>
 
 #include "buffered.h"
 
+/* ============================================================================
+ *  Adaptive Sizing
+ */
+static uint64_t __buffered_now (void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return(((uint64_t)ts.tv_sec * 1000) + (ts.tv_nsec / 1000000));
+}
+
+static void __buffered_sizing_init (buffered_sizing_t *sizing,
+                                    unsigned int min_size,
+                                    unsigned int max_size)
+{
+    sizing->min_size = min_size;
+    sizing->max_size = max_size;
+    sizing->streak = 0;
+    sizing->last_io = 0;
+}
+
+static unsigned int __buffered_set_adaptive (buffered_sizing_t *sizing,
+                                             unsigned int align,
+                                             unsigned int max_size)
+{
+    if (align == 0)
+        align = BUFFERED_DEFAULT_ALIGN;
+
+    if (max_size == 0)
+        max_size = BUFFERED_DEFAULT_MAX;
+
+    max_size -= max_size % align;
+    if (max_size < align)
+        max_size = align;
+
+    __buffered_sizing_init(sizing, align, max_size);
+    return(align);
+}
+
+/* Size of the next buffer, after a fill/flush of 'used' bytes of 'size' */
+static unsigned int __buffered_adapt (buffered_sizing_t *sizing,
+                                      buffered_stats_t *stats,
+                                      unsigned int size,
+                                      unsigned int used)
+{
+    uint64_t now;
+    int idle;
+
+    if (sizing->min_size == sizing->max_size)
+        return(size);
+
+    now = __buffered_now();
+    idle = sizing->last_io > 0 && (now - sizing->last_io) >= BUFFERED_IDLE_MSEC;
+    sizing->last_io = now;
+
+    /* Sequential access, grow the buffer to do less calls on the stream */
+    if (used >= size && !idle) {
+        if (++(sizing->streak) < BUFFERED_GROW_STREAK || size >= sizing->max_size)
+            return(size);
+
+        sizing->streak = 0;
+        stats->grows++;
+        return((size > (sizing->max_size >> 1)) ? sizing->max_size : (size << 1));
+    }
+
+    sizing->streak = 0;
+    if (size <= sizing->min_size)
+        return(size);
+
+    if (idle) {
+        stats->shrinks++;
+        return(sizing->min_size);
+    }
+
+    /* Sparse access, the buffer is too big */
+    if (used < (size >> 2)) {
+        stats->shrinks++;
+        size >>= 1;
+        size -= size % sizing->min_size;
+        return((size > sizing->min_size) ? size : sizing->min_size);
+    }
+
+    return(size);
+}
+
+/* The buffer is empty, the content is not preserved */
+static void __buffered_resize (unsigned char **blob,
+                               unsigned int *size,
+                               unsigned int new_size)
+{
+    unsigned char *pblob;
+
+    if (new_size == *size)
+        return;
+
+    if (*blob != NULL) {
+        /* Keep the old buffer on failure */
+        if ((pblob = (unsigned char *) realloc(*blob, new_size)) == NULL)
+            return;
+        *blob = pblob;
+    }
+
+    *size = new_size;
+}
+
 /* ============================================================================
  *  Buffered Writer
  */
+static int __buffered_stream_write (buffered_writer_t *writer,
+                                    const void *buffer,
+                                    unsigned int size)
+{
+    int wr;
+
+    wr = io_write_fully(writer->stream, buffer, size);
+    writer->stats.stream_ops++;
+    if (wr > 0)
+        writer->stats.stream_bytes += wr;
+    return(wr);
+}
+
 static int __buffered_blocks_write (buffered_writer_t *writer,
                                     const unsigned char *buffer,
                                     unsigned int size)
@@ -32,7 +149,8 @@ static int __buffered_blocks_write (buffered_writer_t *writer,
 
     n = 0;
     while (size >= blk_size) {
-        if ((wr = io_write_fully(writer->stream, buffer, blk_size)) != blk_size)
+        writer->stats.direct_ops++;
+        if ((wr = __buffered_stream_write(writer, buffer, blk_size)) != blk_size)
             return(-(n + wr));
 
         buffer += blk_size;
@@ -52,6 +170,9 @@ static int __buffered_write (stream_t *stream,
     unsigned int avail = writer->size - writer->used;
     int n, wr;
 
+    writer->stats.requests++;
+
+    n = 0;
     if (!(writer->used)) {
         if ((n = __buffered_blocks_write(writer, pblob, size)) < 0)
             return(-n);
@@ -62,14 +183,14 @@ static int __buffered_write (stream_t *stream,
 
     if (writer->blob == NULL) {
         if ((writer->blob = (unsigned char *) malloc(writer->size)) == NULL)
-            return(0);
+            return(n);
     }
 
     /* There's all the space that you need! */
     if (size <= avail) {
         memcpy(writer->blob + writer->used, pblob, size);
         writer->used += size;
-        return(size);
+        return(n + size);
     }
 
     /* Fill the buffer, better to flush */
@@ -77,14 +198,19 @@ static int __buffered_write (stream_t *stream,
     writer->used += avail;
     pblob += avail;
     size -= avail;
-    if ((wr = io_write_fully(writer->stream, writer->blob, writer->size)) != writer->size)
+    if ((wr = __buffered_stream_write(writer, writer->blob, writer->size)) != writer->size)
         return(avail - (writer->size - wr));
 
+    /* The buffer is empty, grow it if the writes are sequential */
+    __buffered_resize(&(writer->blob), &(writer->size),
+                      __buffered_adapt(&(writer->sizing), &(writer->stats),
+                                       writer->size, writer->size));
+
     /* Flush directly if input is greater than buffer */
-    n = avail;
     if ((wr = __buffered_blocks_write(writer, pblob, size)) < 0)
-        return(-wr);
+        return(avail - wr);
 
+    n = avail + wr;
     pblob += wr;
     size -= wr;
 
@@ -97,9 +223,13 @@ static int __buffered_write (stream_t *stream,
 static int __buffered_flush (stream_t *stream) {
     buffered_writer_t *writer = (buffered_writer_t *)stream;
     if (writer->used > 0) {
+        unsigned int size;
         int wr;
-        wr = io_write_fully(writer->stream, writer->blob, writer->used);
+        wr = __buffered_stream_write(writer, writer->blob, writer->used);
+        size = __buffered_adapt(&(writer->sizing), &(writer->stats),
+                                writer->size, writer->used);
         writer->used = 0;
+        __buffered_resize(&(writer->blob), &(writer->size), size);
         return(wr);
     }
     return(0);
@@ -140,6 +270,19 @@ int buffered_writer_open (buffered_writer_t *writer,
     writer->blob = NULL;
     writer->size = size;
     writer->used = 0U;
+    __buffered_sizing_init(&(writer->sizing), size, size);
+    memset(&(writer->stats), 0, sizeof(buffered_stats_t));
+    return(0);
+}
+
+int buffered_writer_set_adaptive (buffered_writer_t *writer,
+                                  unsigned int align,
+                                  unsigned int max_size)
+{
+    if (writer->blob != NULL)
+        return(-1);
+
+    writer->size = __buffered_set_adaptive(&(writer->sizing), align, max_size);
     return(0);
 }
 
@@ -155,15 +298,32 @@ void buffered_writer_close (buffered_writer_t *writer) {
 /* ============================================================================
  *  Buffered Reader
  */
+static int __buffered_stream_read (buffered_reader_t *reader,
+                                   void *buffer,
+                                   unsigned int size)
+{
+    int rd;
+
+    rd = io_read_fully(reader->stream, buffer, size);
+    reader->stats.stream_ops++;
+    if (rd > 0)
+        reader->stats.stream_bytes += rd;
+    return(rd);
+}
+
 static int __buffered_read (stream_t *stream, void *blob, unsigned int size) {
     buffered_reader_t *reader = (buffered_reader_t *)stream;
     unsigned char *pblob = (unsigned char *)blob;
     unsigned int avail = reader->size - reader->used;
     int n, rd;
 
+    reader->stats.requests++;
+
     /* Direct read if requested size is largen than buffer and no buf */
-    if (!avail && size >= reader->reqs)
-        return(io_read_fully(reader->stream, blob, size));
+    if (!avail && size >= reader->reqs) {
+        reader->stats.direct_ops++;
+        return(__buffered_stream_read(reader, blob, size));
+    }
 
     /* There's all the data you need! */
     if (size <= avail) {
@@ -180,23 +340,34 @@ static int __buffered_read (stream_t *stream, void *blob, unsigned int size) {
     /* Copy the old buffer, to the end */
     if ((n = avail) > 0) {
         memcpy(pblob, reader->blob + reader->used, avail);
+        reader->used = reader->size;
         pblob += avail;
         size -= avail;
     }
 
     /* Direct read if requested size is larger than buffer */
     if (size >= reader->reqs) {
-        rd = io_read_fully(reader->stream, pblob, size);
+        reader->stats.direct_ops++;
+        rd = __buffered_stream_read(reader, pblob, size);
         reader->used = 0;
         reader->size = 0;
         return((rd > 0) ? (n + rd) : n);
     }
 
+    /* The buffer is empty, the previous fill decides the next size */
+    if (reader->size > 0) {
+        __buffered_resize(&(reader->blob), &(reader->reqs),
+                          __buffered_adapt(&(reader->sizing), &(reader->stats),
+                                           reader->reqs, reader->size));
+    }
+
     /* Fill the buffer */
-    if ((rd = io_read_fully(reader->stream, reader->blob, reader->reqs)) <= 0)
+    if ((rd = __buffered_stream_read(reader, reader->blob, reader->reqs)) <= 0)
         return(n);
 
-    /* Copy to user */
+    /* Copy to user, the end of the stream may give back less than asked */
+    if (size > (unsigned int)rd)
+        size = rd;
     memcpy(pblob, reader->blob, size);
     reader->used = size;
     reader->size = rd;
@@ -229,6 +400,19 @@ int buffered_reader_open (buffered_reader_t *reader,
     reader->size = 0U;
     reader->used = 0U;
     reader->reqs = size;
+    __buffered_sizing_init(&(reader->sizing), size, size);
+    memset(&(reader->stats), 0, sizeof(buffered_stats_t));
+    return(0);
+}
+
+int buffered_reader_set_adaptive (buffered_reader_t *reader,
+                                  unsigned int align,
+                                  unsigned int max_size)
+{
+    if (reader->blob != NULL)
+        return(-1);
+
+    reader->reqs = __buffered_set_adaptive(&(reader->sizing), align, max_size);
     return(0);
 }
 
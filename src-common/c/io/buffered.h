@@ -19,8 +19,47 @@
 
 #include "stream.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef struct buffered_writer buffered_writer_t;
 typedef struct buffered_reader buffered_reader_t;
+typedef struct buffered_sizing buffered_sizing_t;
+typedef struct buffered_stats buffered_stats_t;
+
+/*
+ * Adaptive buffer size (see buffered_*_set_adaptive()), the buffer is
+ * resized only when empty:
+ *  - doubles, up to max_size, after BUFFERED_GROW_STREAK full buffers
+ *    in a row (sustained sequential access, fewer calls on the stream)
+ *  - halves, down to min_size, when a fill/flush uses less than 1/4
+ *  - is back to min_size after BUFFERED_IDLE_MSEC without fills/flushes
+ * Sizes are multiples of min_size, the 'align' passed to set_adaptive():
+ * the device block size (see disk_stream_blksize()) or 0 for 4K.
+ * set_adaptive() must be called before the first read/write.
+ */
+#define BUFFERED_GROW_STREAK        2
+#define BUFFERED_IDLE_MSEC          1000
+#define BUFFERED_DEFAULT_ALIGN      (4 << 10)
+#define BUFFERED_DEFAULT_MAX        (1 << 20)
+
+struct buffered_sizing {
+    unsigned int min_size;      /* Equal to max_size, fixed size */
+    unsigned int max_size;
+    unsigned int streak;        /* Full buffers in a row */
+    uint64_t     last_io;       /* msec, last fill/flush */
+};
+
+/* Access-pattern counters */
+struct buffered_stats {
+    uint64_t requests;          /* read/write calls */
+    uint64_t stream_ops;        /* reads/writes on the underlying stream */
+    uint64_t direct_ops;        /* of which bypassing the buffer */
+    uint64_t stream_bytes;      /* bytes read/written on the stream */
+    uint64_t grows;
+    uint64_t shrinks;
+};
 
 struct buffered_writer {
     stream_t __base_type__;
@@ -28,6 +67,8 @@ struct buffered_writer {
     unsigned char *blob;
     unsigned int   size;
     unsigned int   used;
+    buffered_sizing_t sizing;
+    buffered_stats_t  stats;
 };
 
 struct buffered_reader {
@@ -36,18 +77,30 @@ struct buffered_reader {
     unsigned char *blob;
     unsigned int   size;
     unsigned int   used;
-    unsigned int   reqs;
+    unsigned int   reqs;        /* Buffer size */
+    buffered_sizing_t sizing;
+    buffered_stats_t  stats;
 };
 
 int     buffered_writer_open        (buffered_writer_t *writer,
                                      stream_t *stream,
                                      unsigned int size);
+int     buffered_writer_set_adaptive(buffered_writer_t *writer,
+                                     unsigned int align,
+                                     unsigned int max_size);
 void    buffered_writer_close       (buffered_writer_t *writer);
 
 int     buffered_reader_open        (buffered_reader_t *reader,
                                      stream_t *stream,
                                      unsigned int size);
+int     buffered_reader_set_adaptive(buffered_reader_t *reader,
+                                     unsigned int align,
+                                     unsigned int max_size);
 void    buffered_reader_close       (buffered_reader_t *reader);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* !_IO_BUFFERED_H_ */
 
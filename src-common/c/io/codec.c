@@ -19,11 +19,126 @@
 
 #include "codec.h"
 
+/* ============================================================================
+ *  Plain Codec, blocks are stored as they are (framing and crc only)
+ */
+static int __plain_encode (codec_t *obj,
+                           void *dst,
+                           unsigned int dst_size,
+                           const void *src,
+                           unsigned int src_size)
+{
+    if (src_size > dst_size)
+        return(-1);
+
+    memcpy(dst, src, src_size);
+    return(src_size);
+}
+
+static int __plain_decode (codec_t *obj,
+                           void *dst,
+                           unsigned int dst_size,
+                           const void *src,
+                           unsigned int src_size)
+{
+    if (src_size != dst_size)
+        return(1);
+
+    memcpy(dst, src, src_size);
+    return(0);
+}
+
+static int __plain_max_length (codec_t *obj, unsigned int size) {
+    return(size);
+}
+
+codec_vtable_t codec_plain = {
+    .id         = CODEC_ID_PLAIN,
+    .encode     = __plain_encode,
+    .decode     = __plain_decode,
+    .max_length = __plain_max_length,
+};
+
+/* ============================================================================
+ *  Xor Codec, codec.data.u64 is the key (repeated every 8 bytes)
+ */
+static void __xor_block (uint64_t key,
+                         unsigned char *dst,
+                         const unsigned char *src,
+                         unsigned int size)
+{
+    unsigned int i;
+    uint64_t word;
+
+    for (i = 0; (i + 8) <= size; i += 8) {
+        memcpy(&word, src + i, 8);
+        word ^= key;
+        memcpy(dst + i, &word, 8);
+    }
+
+    /* Tail, the key bytes in memory order */
+    memcpy(&word, &key, 8);
+    for (; i < size; ++i)
+        dst[i] = src[i] ^ ((const unsigned char *)&word)[i & 7];
+}
+
+static int __xor_encode (codec_t *obj,
+                         void *dst,
+                         unsigned int dst_size,
+                         const void *src,
+                         unsigned int src_size)
+{
+    if (src_size > dst_size)
+        return(-1);
+
+    __xor_block(obj->data.u64, (unsigned char *)dst,
+                (const unsigned char *)src, src_size);
+    return(src_size);
+}
+
+static int __xor_decode (codec_t *obj,
+                         void *dst,
+                         unsigned int dst_size,
+                         const void *src,
+                         unsigned int src_size)
+{
+    if (src_size != dst_size)
+        return(1);
+
+    __xor_block(obj->data.u64, (unsigned char *)dst,
+                (const unsigned char *)src, src_size);
+    return(0);
+}
+
+static int __xor_max_length (codec_t *obj, unsigned int size) {
+    return(size);
+}
+
+codec_vtable_t codec_xor = {
+    .id         = CODEC_ID_XOR,
+    .encode     = __xor_encode,
+    .decode     = __xor_decode,
+    .max_length = __xor_max_length,
+};
+
 /* ============================================================================
  *  Lz4 Codec (http://code.google.com/p/lz4/)
  */
-int LZ4_compress (const char *src, char *dst, int isize);
-int LZ4_uncompress (const char *src, char *dst, int osize);
+#include "codec/lz4l.h"
+
+int lz4_codec_open (lz4_codec_t *lz4, int acceleration) {
+    if ((lz4->state = malloc(LZ4L_sizeofState())) == NULL)
+        return(-1);
+
+    LZ4L_resetState(lz4->state);
+    lz4->acceleration = (acceleration > 0) ? acceleration : 1;
+    return(0);
+}
+
+void lz4_codec_close (lz4_codec_t *lz4) {
+    free(lz4->state);
+    lz4->state = NULL;
+}
 
 static int __lz4_encode (codec_t *obj,
                          void *dst,
@@ -31,7 +146,17 @@ static int __lz4_encode (codec_t *obj,
                          const void *src,
                          unsigned int src_size)
 {
-    return(LZ4_compress((const char *)src, (char *)dst, src_size));
+    lz4_codec_t *lz4 = (lz4_codec_t *)obj->data.ptr;
+
+    /* No codec state, fallback to a one-shot compression */
+    if (lz4 == NULL) {
+        return(LZ4L_compress_fast((const char *)src, (char *)dst,
+                                 src_size, dst_size, 1));
+    }
+
+    return(LZ4L_compress_fast_extState(lz4->state,
+                                      (const char *)src, (char *)dst,
+                                      src_size, dst_size, lz4->acceleration));
 }
 
 static int __lz4_decode (codec_t *obj,
@@ -40,24 +165,40 @@ static int __lz4_decode (codec_t *obj,
                          const void *src,
                          unsigned int src_size)
 {
-    return(LZ4_uncompress((const char*)src, (char*)dst, dst_size) != src_size);
+    return(LZ4L_decompress_safe((const char *)src, (char *)dst,
+                               src_size, dst_size) != (int)dst_size);
 }
 
 static int __lz4_max_length (codec_t *obj, unsigned int size) {
-    int extra = 1 + ((size << 2) / 100);
-    return(size + ((extra + 7) & (-8)));
+    return(LZ4L_compressBound(size));
+}
+
+/* Blocks of the C++ Lz4Writer in checkpoint mode */
+static int __lz4_decode_linked (codec_t *obj,
+                                void *dst,
+                                unsigned int dst_size,
+                                const void *src,
+                                unsigned int src_size,
+                                unsigned int prefix_size)
+{
+    return(LZ4L_decompress_safe_usingPrefix((const char *)src, (char *)dst,
+                                           src_size, dst_size,
+                                           prefix_size) != (int)dst_size);
 }
 
 codec_vtable_t codec_lz4 = {
-    .encode     = __lz4_encode,
-    .decode     = __lz4_decode,
-    .max_length = __lz4_max_length,
+    .id            = CODEC_ID_LZ4,
+    .encode        = __lz4_encode,
+    .decode        = __lz4_decode,
+    .max_length    = __lz4_max_length,
+    .decode_linked = __lz4_decode_linked,
 };
 
 
 /* ============================================================================
- *  AES Codec
+ *  AES Codec, built with an AES backend (AES_OPENSSL, AES_COMMON_CRYPTO)
  */
+#if defined(AES_OPENSSL) || defined(AES_COMMON_CRYPTO)
 #include "codec/aes/aes.h"
 
 static int __aes_encode (codec_t *obj,
@@ -85,8 +226,359 @@ static int __aes_max_length (codec_t *obj, unsigned int size) {
 }
 
 codec_vtable_t codec_aes = {
+    .id         = CODEC_ID_AES,
     .encode     = __aes_encode,
     .decode     = __aes_decode,
     .max_length = __aes_max_length,
 };
+#endif /* AES_OPENSSL || AES_COMMON_CRYPTO */
+
+/* ============================================================================
+ *  Codec Chain
+ *  Block layout: [uint8 n][n ids][(n - 1) uint32 intermediate sizes][data]
+ */
+#define __CHAIN_HEADER_SIZE(n)          (1 + (n) + 4 * ((n) - 1))
+
+static void __write_u32le (unsigned char *buf, uint32_t value) {
+    buf[0] = value & 0xff;
+    buf[1] = (value >> 8) & 0xff;
+    buf[2] = (value >> 16) & 0xff;
+    buf[3] = (value >> 24) & 0xff;
+}
+
+static uint32_t __read_u32le (const unsigned char *buf) {
+    return(buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24));
+}
+
+static int __chain_reserve (codec_chain_t *chain, unsigned int size) {
+    unsigned char *scratch;
+    unsigned int i;
+
+    if (size <= chain->scratch_size)
+        return(0);
+
+    /* Round up, blocks of a stream have usually the same size */
+    size = (size + 4095) & ~4095U;
+    for (i = 0; i < 2; ++i) {
+        if ((scratch = (unsigned char *) realloc(chain->scratch[i], size)) == NULL)
+            return(-1);
+        chain->scratch[i] = scratch;
+    }
+
+    chain->scratch_size = size;
+    return(0);
+}
+
+/* Codecs are matched by position, the same id may appear more than once
+ * (e.g. xor + xor, or aes with two keys). The id is only a check.
+ */
+static codec_t *__chain_codec (codec_chain_t *chain,
+                               const unsigned char *hdr,
+                               unsigned int i)
+{
+    codec_t *codec = chain->codecs[i];
+    return((codec_id(codec) == hdr[1 + i]) ? codec : NULL);
+}
+
+int codec_chain_open (codec_chain_t *chain,
+                      codec_t **codecs,
+                      unsigned int ncodecs)
+{
+    unsigned int i;
+
+    if (ncodecs == 0 || ncodecs > CODEC_CHAIN_MAX)
+        return(-1);
+
+    for (i = 0; i < ncodecs; ++i)
+        chain->codecs[i] = codecs[i];
+
+    chain->ncodecs = ncodecs;
+    chain->scratch[0] = NULL;
+    chain->scratch[1] = NULL;
+    chain->scratch_size = 0;
+    return(0);
+}
+
+void codec_chain_close (codec_chain_t *chain) {
+    free(chain->scratch[0]);
+    free(chain->scratch[1]);
+    chain->scratch[0] = NULL;
+    chain->scratch[1] = NULL;
+    chain->scratch_size = 0;
+}
+
+static int __chain_encode (codec_t *obj,
+                           void *dst,
+                           unsigned int dst_size,
+                           const void *src,
+                           unsigned int src_size)
+{
+    codec_chain_t *chain = (codec_chain_t *)obj->data.ptr;
+    unsigned int n = chain->ncodecs;
+    unsigned int hdr_size = __CHAIN_HEADER_SIZE(n);
+    unsigned char *hdr = (unsigned char *)dst;
+    const unsigned char *in;
+    unsigned char *out;
+    unsigned int out_size;
+    unsigned int size;
+    unsigned int i;
+    int csize;
+
+    if (dst_size < hdr_size)
+        return(-1);
+
+    /* The scratch buffers hold the widest intermediate output */
+    size = src_size;
+    out_size = 0;
+    for (i = 0; i < n - 1; ++i) {
+        size = codec_max_length(chain->codecs[i], size);
+        if (size > out_size)
+            out_size = size;
+    }
+
+    if (__chain_reserve(chain, out_size) < 0)
+        return(-1);
+
+    hdr[0] = n;
+    in = (const unsigned char *)src;
+    size = src_size;
+    for (i = 0; i < n; ++i) {
+        hdr[1 + i] = codec_id(chain->codecs[i]);
+
+        /* Ping-pong between the scratch buffers, the last one goes to dst */
+        if (i < n - 1) {
+            out = chain->scratch[i & 1];
+            out_size = chain->scratch_size;
+        } else {
+            out = hdr + hdr_size;
+            out_size = dst_size - hdr_size;
+        }
+
+        if ((csize = codec_encode(chain->codecs[i], out, out_size, in, size)) <= 0)
+            return(-1);
+
+        if (i < n - 1)
+            __write_u32le(hdr + 1 + n + 4 * i, csize);
+
+        in = out;
+        size = csize;
+    }
+
+    return(hdr_size + size);
+}
+
+static int __chain_decode (codec_t *obj,
+                           void *dst,
+                           unsigned int dst_size,
+                           const void *src,
+                           unsigned int src_size)
+{
+    codec_chain_t *chain = (codec_chain_t *)obj->data.ptr;
+    const unsigned char *hdr = (const unsigned char *)src;
+    const unsigned char *in;
+    unsigned char *out;
+    unsigned int out_size;
+    unsigned int in_size;
+    unsigned int hdr_size;
+    unsigned int size;
+    codec_t *codec;
+    unsigned int n;
+    int i;
+
+    if (src_size < 1 || (n = hdr[0]) != chain->ncodecs)
+        return(1);
+
+    if (src_size < (hdr_size = __CHAIN_HEADER_SIZE(n)))
+        return(2);
+
+    /* Intermediate sizes are the decode targets, bounded by the codecs */
+    size = dst_size;
+    out_size = 0;
+    for (i = 0; i < (int)n - 1; ++i) {
+        if ((codec = __chain_codec(chain, hdr, i)) == NULL)
+            return(3);
+
+        size = codec_max_length(codec, size);
+        if ((in_size = __read_u32le(hdr + 1 + n + 4 * i)) > size)
+            return(3);
+
+        if (in_size > out_size)
+            out_size = in_size;
+    }
+
+    if (__chain_reserve(chain, out_size) < 0)
+        return(4);
+
+    in = hdr + hdr_size;
+    in_size = src_size - hdr_size;
+    for (i = n - 1; i >= 0; --i) {
+        if ((codec = __chain_codec(chain, hdr, i)) == NULL)
+            return(3);
+
+        if (i > 0) {
+            out = chain->scratch[i & 1];
+            out_size = __read_u32le(hdr + 1 + n + 4 * (i - 1));
+        } else {
+            out = (unsigned char *)dst;
+            out_size = dst_size;
+        }
+
+        if (codec_decode(codec, out, out_size, in, in_size))
+            return(5);
+
+        in = out;
+        in_size = out_size;
+    }
+
+    return(0);
+}
+
+static int __chain_max_length (codec_t *obj, unsigned int size) {
+    codec_chain_t *chain = (codec_chain_t *)obj->data.ptr;
+    unsigned int i;
+
+    for (i = 0; i < chain->ncodecs; ++i)
+        size = codec_max_length(chain->codecs[i], size);
+
+    return(__CHAIN_HEADER_SIZE(chain->ncodecs) + size);
+}
+
+codec_vtable_t codec_chain = {
+    .id         = CODEC_ID_CHAIN,
+    .encode     = __chain_encode,
+    .decode     = __chain_decode,
+    .max_length = __chain_max_length,
+};
+
+/* ============================================================================
+ *  Zstd Codec (http://facebook.github.io/zstd/)
+ */
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#include <zdict.h>
+
+#define ZSTD_CODEC_LONG_WINDOW_LOG      27
+
+int zstd_codec_open (zstd_codec_t *zstd, int level, int long_distance) {
+    zstd->cdict = NULL;
+    zstd->ddict = NULL;
+    zstd->level = (level < 1) ? 1 : ((level > 19) ? 19 : level);
+
+    if ((zstd->cctx = ZSTD_createCCtx()) == NULL)
+        return(-1);
+
+    if ((zstd->dctx = ZSTD_createDCtx()) == NULL) {
+        ZSTD_freeCCtx((ZSTD_CCtx *)zstd->cctx);
+        return(-2);
+    }
+
+    ZSTD_CCtx_setParameter((ZSTD_CCtx *)zstd->cctx,
+                           ZSTD_c_compressionLevel, zstd->level);
+    if (long_distance) {
+        ZSTD_CCtx_setParameter((ZSTD_CCtx *)zstd->cctx,
+                               ZSTD_c_enableLongDistanceMatching, 1);
+        ZSTD_CCtx_setParameter((ZSTD_CCtx *)zstd->cctx,
+                               ZSTD_c_windowLog, ZSTD_CODEC_LONG_WINDOW_LOG);
+    }
+
+    /* Accept long distance blocks, whatever the writer settings were */
+    ZSTD_DCtx_setParameter((ZSTD_DCtx *)zstd->dctx,
+                           ZSTD_d_windowLogMax, ZSTD_CODEC_LONG_WINDOW_LOG);
+    return(0);
+}
+
+void zstd_codec_close (zstd_codec_t *zstd) {
+    ZSTD_freeCCtx((ZSTD_CCtx *)zstd->cctx);
+    ZSTD_freeDCtx((ZSTD_DCtx *)zstd->dctx);
+    ZSTD_freeCDict((ZSTD_CDict *)zstd->cdict);
+    ZSTD_freeDDict((ZSTD_DDict *)zstd->ddict);
+    zstd->cctx = NULL;
+    zstd->dctx = NULL;
+    zstd->cdict = NULL;
+    zstd->ddict = NULL;
+}
+
+int zstd_codec_load_dict (zstd_codec_t *zstd,
+                          const void *dict,
+                          unsigned int size)
+{
+    ZSTD_CDict *cdict;
+    ZSTD_DDict *ddict;
+
+    if ((cdict = ZSTD_createCDict(dict, size, zstd->level)) == NULL)
+        return(-1);
+
+    if ((ddict = ZSTD_createDDict(dict, size)) == NULL) {
+        ZSTD_freeCDict(cdict);
+        return(-2);
+    }
+
+    ZSTD_CCtx_refCDict((ZSTD_CCtx *)zstd->cctx, cdict);
+    ZSTD_DCtx_refDDict((ZSTD_DCtx *)zstd->dctx, ddict);
+
+    ZSTD_freeCDict((ZSTD_CDict *)zstd->cdict);
+    ZSTD_freeDDict((ZSTD_DDict *)zstd->ddict);
+    zstd->cdict = cdict;
+    zstd->ddict = ddict;
+    return(0);
+}
 
+int zstd_codec_train_dict (void *dict,
+                           unsigned int capacity,
+                           const void *samples,
+                           const unsigned int *sizes,
+                           unsigned int nsamples)
+{
+    size_t *ssizes;
+    size_t size;
+    unsigned int i;
+
+    if ((ssizes = (size_t *) malloc(nsamples * sizeof(size_t))) == NULL)
+        return(-1);
+
+    for (i = 0; i < nsamples; ++i)
+        ssizes[i] = sizes[i];
+
+    size = ZDICT_trainFromBuffer(dict, capacity, samples, ssizes, nsamples);
+    free(ssizes);
+
+    return(ZDICT_isError(size) ? -2 : (int)size);
+}
+
+static int __zstd_encode (codec_t *obj,
+                          void *dst,
+                          unsigned int dst_size,
+                          const void *src,
+                          unsigned int src_size)
+{
+    zstd_codec_t *zstd = (zstd_codec_t *)obj->data.ptr;
+    size_t size;
+
+    size = ZSTD_compress2((ZSTD_CCtx *)zstd->cctx, dst, dst_size, src, src_size);
+    return(ZSTD_isError(size) ? -1 : (int)size);
+}
+
+static int __zstd_decode (codec_t *obj,
+                          void *dst,
+                          unsigned int dst_size,
+                          const void *src,
+                          unsigned int src_size)
+{
+    zstd_codec_t *zstd = (zstd_codec_t *)obj->data.ptr;
+    size_t size;
+
+    size = ZSTD_decompressDCtx((ZSTD_DCtx *)zstd->dctx, dst, dst_size, src, src_size);
+    return(ZSTD_isError(size) || size != dst_size);
+}
+
+static int __zstd_max_length (codec_t *obj, unsigned int size) {
+    return(ZSTD_compressBound(size));
+}
+
+codec_vtable_t codec_zstd = {
+    .id         = CODEC_ID_ZSTD,
+    .encode     = __zstd_encode,
+    .decode     = __zstd_decode,
+    .max_length = __zstd_max_length,
+};
+#endif /* HAVE_ZSTD */
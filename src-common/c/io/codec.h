@@ -19,10 +19,21 @@
 
 #include <stdint.h>
 
+#include "codec_id.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef const struct codec_vtable codec_vtable_t;
 typedef struct codec codec_t;
+typedef struct lz4_codec lz4_codec_t;
+typedef struct zstd_codec zstd_codec_t;
+typedef struct codec_chain codec_chain_t;
 
 struct codec_vtable {
+    unsigned int id;
+
     int (*encode)     (codec_t *codec,
                        void *dst,
                        unsigned int dst_size,
@@ -35,6 +46,15 @@ struct codec_vtable {
                        unsigned int src_size);
     int (*max_length) (codec_t *codec,
                        unsigned int size);
+
+    /* Optional, decode a linked block: dst is preceded by the prefix_size
+     * bytes of the previous blocks, that the block may reference. */
+    int (*decode_linked) (codec_t *codec,
+                          void *dst,
+                          unsigned int dst_size,
+                          const void *src,
+                          unsigned int src_size,
+                          unsigned int prefix_size);
 };
 
 struct codec {
@@ -47,9 +67,80 @@ struct codec {
     } data;
 };
 
+/*
+ * LZ4 codec state, set as codec.data.ptr.
+ * acceleration: 1 is the default, higher values trade ratio for speed.
+ * A codec with a NULL data.ptr allocates a temporary state on each block.
+ */
+struct lz4_codec {
+    void *state;
+    int acceleration;
+};
+
+int  lz4_codec_open  (lz4_codec_t *lz4, int acceleration);
+void lz4_codec_close (lz4_codec_t *lz4);
+
+extern const codec_vtable_t codec_plain;
+extern const codec_vtable_t codec_xor;
 extern const codec_vtable_t codec_lz4;
 extern const codec_vtable_t codec_aes;
 
+/*
+ * Codec chain, set as codec.data.ptr. Encodes with each codec in order
+ * (e.g. lz4 then aes) using two scratch buffers reused across blocks.
+ * Each block starts with the list of codec ids and intermediate sizes.
+ * The decoder uses the codecs by position, in reverse order: the reader
+ * chain must have the codecs of the writer, in the same order (the ids are
+ * checked, duplicates like two xor or two aes keys are allowed).
+ */
+#define CODEC_CHAIN_MAX         4
+
+struct codec_chain {
+    codec_t *codecs[CODEC_CHAIN_MAX];
+    unsigned int ncodecs;
+    unsigned char *scratch[2];
+    unsigned int scratch_size;
+};
+
+int  codec_chain_open  (codec_chain_t *chain,
+                        codec_t **codecs,
+                        unsigned int ncodecs);
+void codec_chain_close (codec_chain_t *chain);
+
+extern const codec_vtable_t codec_chain;
+
+#ifdef HAVE_ZSTD
+/*
+ * Zstd codec state, set as codec.data.ptr.
+ * level: 1-19, long_distance enables the long distance matcher
+ * (128M window, the reader must be a zstd codec too).
+ * A dictionary trained with zstd_codec_train_dict() can be loaded on both
+ * the writer and the reader side, to compress small blocks.
+ */
+struct zstd_codec {
+    void *cctx;
+    void *dctx;
+    void *cdict;
+    void *ddict;
+    int level;
+};
+
+int  zstd_codec_open       (zstd_codec_t *zstd,
+                            int level,
+                            int long_distance);
+void zstd_codec_close      (zstd_codec_t *zstd);
+int  zstd_codec_load_dict  (zstd_codec_t *zstd,
+                            const void *dict,
+                            unsigned int size);
+int  zstd_codec_train_dict (void *dict,
+                            unsigned int capacity,
+                            const void *samples,
+                            const unsigned int *sizes,
+                            unsigned int nsamples);
+
+extern const codec_vtable_t codec_zstd;
+#endif /* HAVE_ZSTD */
+
 #define codec_encode(codec, dst, dst_size, src, src_size)               \
     (codec)->vtable->encode(codec, dst, dst_size, src, src_size)
 
@@ -59,5 +150,18 @@ extern const codec_vtable_t codec_aes;
 #define codec_max_length(codec, size)                                   \
     (codec)->vtable->max_length(codec, size)
 
+#define codec_decode_linked(codec, dst, dst_size, src, src_size, prefix) \
+    (codec)->vtable->decode_linked(codec, dst, dst_size, src, src_size, prefix)
+
+#define codec_can_decode_linked(codec)                                  \
+    ((codec)->vtable->decode_linked != NULL)
+
+#define codec_id(codec)                                                 \
+    ((codec)->vtable->id)
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* _CODEC_H_ */
 
@@ -14,6 +14,8 @@
  *   limitations under the License.
  */
 
+#if defined(AES_OPENSSL) || defined(AES_COMMON_CRYPTO)
+
 #include <stdlib.h>
 
 #include "sha1.h"
@@ -79,3 +81,4 @@ void aes_key (unsigned char ikey[32],
     }
 }
 
+#endif /* AES_OPENSSL || AES_COMMON_CRYPTO */
@@ -0,0 +1,45 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef _LZ4L_H_
+#define _LZ4L_H_
+
+/*
+ * Bounded compression/decompression added to the bundled lz4.c: a state
+ * reused across blocks, an output limit, acceleration and a linked prefix
+ * (the previous block as dictionary). The LZ4L_ prefix keeps them apart
+ * from the upstream LZ4 API, the signatures are not the same.
+ */
+int  LZ4L_compressBound (int isize);
+int  LZ4L_sizeofState   (void);
+void LZ4L_resetState    (void *state);
+
+int  LZ4L_compress_fast          (const char *source, char *dest, int isize,
+                                  int maxOutputSize, int acceleration);
+int  LZ4L_compress_fast_extState (void *state, const char *source, char *dest,
+                                  int isize, int maxOutputSize, int acceleration);
+/* prefixSize: bytes right before 'source', the previous linked input */
+int  LZ4L_compress_fast_continue (void *state, const char *source, char *dest,
+                                  int isize, int maxOutputSize, int acceleration,
+                                  int prefixSize);
+
+int  LZ4L_decompress_safe             (const char *source, char *dest,
+                                       int isize, int maxOutputSize);
+int  LZ4L_decompress_safe_usingPrefix (const char *source, char *dest,
+                                       int isize, int maxOutputSize,
+                                       int prefixSize);
+
+#endif /* !_LZ4L_H_ */
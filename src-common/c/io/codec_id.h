@@ -0,0 +1,34 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef _CODEC_IDS_H_
+#define _CODEC_IDS_H_
+
+/*
+ * Codec ids, recorded in each encoded block header.
+ * The one list of the C codec_vtable_t (codec.h) and of the C++
+ * CompressedWriter/CompressedReader (cpp/io/CodecId.h).
+ */
+enum codec_id {
+    CODEC_ID_PLAIN = 0,
+    CODEC_ID_LZ4   = 1,
+    CODEC_ID_AES   = 2,
+    CODEC_ID_ZSTD  = 3,
+    CODEC_ID_CHAIN = 4,
+    CODEC_ID_XOR   = 5,
+};
+
+#endif /* !_CODEC_IDS_H_ */
@@ -110,3 +110,10 @@ void disk_stream_close (disk_stream_t *disk) {
     close(disk->fd);    
 }
 
+unsigned int disk_stream_blksize (disk_stream_t *disk) {
+    struct stat buf;
+    if (fstat(disk->fd, &buf) < 0 || buf.st_blksize <= 0)
+        return(4096);
+    return(buf.st_blksize);
+}
+
@@ -19,6 +19,10 @@
 
 #include "stream.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef struct disk_stream disk_stream_t;
 
 struct disk_stream {
@@ -36,5 +40,12 @@ int     disk_stream_create  (disk_stream_t *disk,
                              int mode);
 void    disk_stream_close   (disk_stream_t *disk);
 
+/* Preferred I/O size (st_blksize), 4K if unknown */
+unsigned int disk_stream_blksize (disk_stream_t *disk);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* !_IO_DISK_H_ */
 
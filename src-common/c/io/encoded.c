@@ -17,106 +17,126 @@
 #include <string.h>
 #include <stdlib.h>
 
+#include "crc32c.h"
 #include "encoded.h"
+#include "frame.h"
+
+/* ============================================================================
+ *  Scratch buffers, owned by the stream and reused across blocks
+ */
+static int __encoded_reserve (unsigned char **buf,
+                              unsigned int *buf_size,
+                              uint64_t size)
+{
+    unsigned char *pbuf;
+
+    if (size <= *buf_size)
+        return(0);
+
+    /* Round up, avoids a realloc for each slightly bigger block */
+    size = (size + 4095) & ~(uint64_t)4095;
+    if (size > 0xffffffffU)
+        return(-1);
+
+    if ((pbuf = (unsigned char *) realloc(*buf, size)) == NULL)
+        return(-1);
+
+    *buf = pbuf;
+    *buf_size = size;
+    return(0);
+}
 
 /* ============================================================================
  *  Encoded Writer (Encoder)
  */
-static int __encoded_write_block (encoded_writer_t *buffer,
+static int __encoded_write_block (encoded_writer_t *writer,
                                   const void *blob,
                                   unsigned int size)
 {
-    unsigned char *cbuf;
+    frame_header_t frame;
+    unsigned char *payload;
+    uint64_t length;
     int csize;
 
-    csize = codec_max_length(buffer->codec, size);
-    if ((cbuf = (unsigned char *) malloc(csize)) == NULL)
+    /* Header and data go out with a single write */
+    length = FRAME_HEADER_SIZE + (uint64_t)codec_max_length(writer->codec, size);
+    if (__encoded_reserve(&(writer->cbuf), &(writer->cbuf_size), length) < 0)
         return(-1);
 
-    csize = codec_encode(buffer->codec, cbuf, csize, blob, size);
-    if (io_write_vuint(buffer->stream, size) <= 0)
-        return(-2);
+    payload = writer->cbuf + FRAME_HEADER_SIZE;
+    csize = codec_encode(writer->codec, payload,
+                         writer->cbuf_size - FRAME_HEADER_SIZE, blob, size);
+    if (csize <= 0)
+        return(-1);
 
-    if (io_write_vuint(buffer->stream, csize) <= 0)
-        return(-2);
+    frame.codec = codec_id(writer->codec);
+    frame.flags = FRAME_FLAG_DATA_CRC;
+    frame.size = size;
+    frame.csize = csize;
+    frame.stored_crc = crc32c(0, payload, csize);
+    frame.data_crc = crc32c(0, blob, size);
+    frame_header_encode(writer->cbuf, &frame);
 
-    if (io_write_fully(buffer->stream, cbuf, csize) <= 0)
+    length = FRAME_HEADER_SIZE + csize;
+    if (io_write_fully(writer->stream, writer->cbuf, length) != (int)length)
         return(-3);
 
-    free(cbuf);
     return(size);
 }
 
-static int __encoded_write_blocks (encoded_writer_t *writer,
-                                   const unsigned char *buffer,
-                                   unsigned int size)
-{
-    unsigned int blk_size = writer->size;
-    int n, wr;
-
-    n = 0;
-    while (size >= writer->size) {
-        if ((wr = __encoded_write_block(writer, buffer, blk_size)) != blk_size)
-            return(-(n + wr));
-
-        buffer += blk_size;
-        size -= blk_size;
-        n += blk_size;
-    }
-
-    return(n);
-}
-
 static int __encoded_write (stream_t *stream,
                             const void *blob,
                             unsigned int size)
 {
     encoded_writer_t *writer = (encoded_writer_t *)stream;
     const unsigned char *pblob = (const unsigned char *)blob;
-    unsigned int avail = writer->size - writer->used;
-    int n, wr;
+    unsigned int avail;
+    int n = 0;
 
-    /* Flush directly if input is greater than buffer */
-    if (writer->used == 0) {
-        if ((n = __encoded_write_blocks(writer, pblob, size)) < 0)
-            return(-n);
+    /* Complete the pending block first */
+    if (writer->used > 0) {
+        avail = writer->size - writer->used;
+        if (size < avail) {
+            memcpy(writer->blob + writer->used, pblob, size);
+            writer->used += size;
+            return(size);
+        }
 
-        pblob += n;
-        size -= n;
-    }
+        memcpy(writer->blob + writer->used, pblob, avail);
+        writer->used += avail;
+        pblob += avail;
+        size -= avail;
+        n = avail;
 
-    if (writer->blob == NULL) {
-        if ((writer->blob = (unsigned char *) malloc(writer->size)) == NULL)
-            return(0);
+        /* On failure the block stays pending, the next write retries */
+        if (__encoded_write_block(writer, writer->blob, writer->size) != (int)writer->size)
+            return((n > 0) ? n : -1);
+        writer->used = 0;
     }
 
-    /* There's all the space that you need! */
-    if (size <= avail) {
-        memcpy(writer->blob + writer->used, pblob, size);
-        writer->used += size;
-        return(size);
-    }
+    /* Encode the full blocks straight from the user data */
+    while (size >= writer->size) {
+        if (__encoded_write_block(writer, pblob, writer->size) != (int)writer->size)
+            return((n > 0) ? n : -1);
 
-    /* Fill the buffer, better to flush */
-    memcpy(writer->blob + writer->used, pblob, avail);
-    writer->used += avail;
-    pblob += avail;
-    size -= avail;
-    if ((wr = __encoded_write_block(writer, writer->blob, writer->size)) != writer->size)
-        return(avail - (writer->size - wr));
+        pblob += writer->size;
+        size -= writer->size;
+        n += writer->size;
+    }
 
-    /* Flush directly if input is greater than buffer */
-    n = avail;
-    if ((wr = __encoded_write_blocks(writer, pblob, size)) < 0)
-        return(-wr);
+    /* Store remaining in buffer */
+    if (size > 0) {
+        if (writer->blob == NULL) {
+            if ((writer->blob = (unsigned char *) malloc(writer->size)) == NULL)
+                return((n > 0) ? n : -1);
+        }
 
-    pblob += wr;
-    size -= wr;
+        memcpy(writer->blob, pblob, size);
+        writer->used = size;
+        n += size;
+    }
 
-    /* Store remaining in buffer */
-    writer->used = size;
-    memcpy(writer->blob, pblob, size);
-    return(n + size);
+    return(n);
 }
 
 static int __encoded_flush (stream_t *stream) {
@@ -156,6 +176,8 @@ int encoded_writer_open (encoded_writer_t *writer,
     writer->stream = stream;
     writer->codec = codec;
     writer->blob = NULL;
+    writer->cbuf = NULL;
+    writer->cbuf_size = 0;
     writer->size = size;
     writer->used = 0U;
     return(0);
@@ -166,6 +188,11 @@ void encoded_writer_close (encoded_writer_t *writer) {
         free(writer->blob);
         writer->blob = NULL;
     }
+    if (writer->cbuf != NULL) {
+        free(writer->cbuf);
+        writer->cbuf = NULL;
+    }
+    writer->cbuf_size = 0;
     writer->size = 0;
     writer->used = 0;
 }
@@ -173,79 +200,226 @@ void encoded_writer_close (encoded_writer_t *writer) {
 /* ============================================================================
  *  Encoded Reader (Decoder)
  */
-static int __encoded_read_block (encoded_reader_t *buffer) {
-    unsigned char *cbuf;
-    uint64_t csize;
-    uint64_t size;
-
-    /* Read header */
-    if (io_read_vuint(buffer->stream, &size) <= 0)
+/*
+ * Linked blocks are decoded right after the previous ones, in the history
+ * window, then copied out (raw blocks are just copied in from cbuf).
+ * Only the last FRAME_HISTORY_SIZE bytes are kept.
+ */
+static int __encoded_decode_history (encoded_reader_t *reader,
+                                     const frame_header_t *frame,
+                                     unsigned char *dst)
+{
+    unsigned int prefix;
+    unsigned char *pbuf;
+    uint64_t capacity;
+    int err;
+
+    /* A linked block without history: the chain was broken by a damaged
+     * block, or the reader did not start at an independent block. */
+    if ((frame->flags & FRAME_FLAG_LINKED) && reader->hist_size == 0)
         return(-1);
 
-    if (io_read_vuint(buffer->stream, &csize) <= 0)
-        return(-2);
+    if (!(frame->flags & FRAME_FLAG_LINKED))
+        reader->hist_size = 0;
+
+    prefix = reader->hist_size;
+    if (prefix > FRAME_HISTORY_SIZE)
+        prefix = FRAME_HISTORY_SIZE;
+
+    if ((uint64_t)reader->hist_size + frame->size > reader->hist_capacity) {
+        if ((uint64_t)prefix + frame->size > reader->hist_capacity) {
+            /* Grow, with room for two windows the memmove is amortized */
+            capacity = (2 * FRAME_HISTORY_SIZE) + (uint64_t)frame->size;
+            if (capacity > 0xffffffffU)
+                return(-1);
+
+            if ((pbuf = (unsigned char *) malloc(capacity)) == NULL)
+                return(-1);
+
+            if (prefix > 0)
+                memcpy(pbuf, reader->history + reader->hist_size - prefix, prefix);
+            free(reader->history);
+
+            reader->history = pbuf;
+            reader->hist_capacity = capacity;
+        } else {
+            memmove(reader->history,
+                    reader->history + reader->hist_size - prefix,
+                    prefix);
+        }
+        reader->hist_size = prefix;
+    }
 
-    /* Alloc compressed buffer */
-    if ((cbuf = (unsigned char *) malloc(csize)) == NULL)
-        return(-3);
+    pbuf = reader->history + reader->hist_size;
+    if (frame->codec == CODEC_ID_PLAIN) {
+        memcpy(pbuf, reader->cbuf, frame->size);
+        err = 0;
+    } else if (frame->flags & FRAME_FLAG_LINKED) {
+        err = codec_decode_linked(reader->codec, pbuf, frame->size,
+                                  reader->cbuf, frame->csize, prefix);
+    } else {
+        err = codec_decode(reader->codec, pbuf, frame->size,
+                           reader->cbuf, frame->csize);
+    }
 
-    /* Read uncompressed data */
-    if (io_read_fully(buffer->stream, cbuf, csize) != (int)csize) {
-        free(cbuf);
-        return(-4);
+    if (err) {
+        reader->hist_size = 0;
+        return(-1);
     }
 
-    /* Prepare new buffer for data */
-    if (buffer->size != size) {
-        if (buffer->blob != NULL)
-            free(buffer->blob);
+    memcpy(dst, pbuf, frame->size);
+    reader->hist_size += frame->size;
+    return(frame->size);
+}
+
+static int __encoded_read_block (encoded_reader_t *reader,
+                                 unsigned char *dst,
+                                 unsigned int dst_size)
+{
+    frame_header_t frame;
+    unsigned char *pbuf;
+    uint64_t skipped;
+    int resync;
+    int rd;
 
-        if ((buffer->blob = (unsigned char *) malloc(size)) == NULL) {
-            free(cbuf);
-            return(-5);
+    reader->size = 0;
+    reader->used = 0;
+    resync = !!(reader->flags & ENCODED_RESYNC);
+    while (1) {
+        /* Read header, end of stream or unrecoverable damage */
+        skipped = reader->skipped;
+        if ((rd = frame_read_header(reader->stream, &frame, resync, &(reader->skipped))) <= 0)
+            return((rd == 0) ? -1 : -2);
+
+        /* Resynced, the blocks in between are lost */
+        if (skipped != reader->skipped)
+            reader->hist_size = 0;
+
+        /* Block written by a different codec (or stored raw) */
+        if (frame.codec != codec_id(reader->codec) && frame.codec != CODEC_ID_PLAIN)
+            return(-7);
+
+        if (frame.codec == CODEC_ID_PLAIN && frame.csize != frame.size)
+            return(-2);
+
+        /* Linked blocks, the codec must be able to reference the history */
+        if ((frame.flags & FRAME_FLAG_LINKED) && frame.codec != CODEC_ID_PLAIN &&
+            !codec_can_decode_linked(reader->codec))
+        {
+            return(-9);
         }
 
-        buffer->size = size;
-        buffer->used = 0;
-    }
+        /* Not part of a linked chain, drop the history */
+        if (!(frame.flags & FRAME_FLAG_HISTORY))
+            reader->hist_size = 0;
+
+        /* Read encoded data */
+        if (__encoded_reserve(&(reader->cbuf), &(reader->cbuf_size), frame.csize) < 0)
+            return(-3);
+
+        if ((rd = io_read_fully(reader->stream, reader->cbuf, frame.csize)) != (int)frame.csize) {
+            if (resync) {
+                reader->damaged++;
+                reader->skipped += FRAME_HEADER_SIZE + ((rd > 0) ? rd : 0);
+            }
+            return(-4);
+        }
+
+        if ((reader->flags & ENCODED_VERIFY_STORED) &&
+            crc32c(0, reader->cbuf, frame.csize) != frame.stored_crc)
+        {
+            goto _damaged;
+        }
 
-    /* Transform */
-    if (codec_decode(buffer->codec, buffer->blob, size, cbuf, csize)) {
-        free(cbuf);
-        return(-6);
+        /* The whole block fits in the user buffer, decode directly there */
+        if (dst != NULL && frame.size <= dst_size) {
+            pbuf = dst;
+        } else {
+            /* Prepare the block buffer, only grows */
+            if (__encoded_reserve(&(reader->blob), &(reader->capacity), frame.size) < 0)
+                return(-5);
+            pbuf = reader->blob;
+        }
+
+        if (frame.flags & FRAME_FLAG_HISTORY) {
+            rd = __encoded_decode_history(reader, &frame, pbuf);
+        } else if (frame.codec == CODEC_ID_PLAIN) {
+            memcpy(pbuf, reader->cbuf, frame.size);
+            rd = frame.size;
+        } else if (codec_decode(reader->codec, pbuf, frame.size, reader->cbuf, frame.csize)) {
+            rd = -1;
+        } else {
+            rd = frame.size;
+        }
+
+        if (rd != (int)frame.size) {
+            if (!resync)
+                return(-6);
+            goto _damaged;
+        }
+
+        if ((reader->flags & ENCODED_VERIFY_DATA) &&
+            (frame.flags & FRAME_FLAG_DATA_CRC) &&
+            crc32c(0, pbuf, frame.size) != frame.data_crc)
+        {
+            goto _damaged;
+        }
+
+        if (pbuf == dst)
+            return(frame.size);
+
+        reader->size = frame.size;
+        return(0);
+
+_damaged:
+        if (!resync)
+            return(-8);
+
+        /* The header is sane, skip just this block
+         * (and the linked ones up to the next independent block) */
+        reader->hist_size = 0;
+        reader->damaged++;
+        reader->skipped += FRAME_HEADER_SIZE + frame.csize;
     }
 
-    /* Free compressed buffer */
-    free(cbuf);
-    return(0);
+    return(-1);
 }
 
 static int __encoded_read (stream_t *stream, void *blob, unsigned int size) {
-    encoded_reader_t *buffer = (encoded_reader_t *)stream;
-    unsigned int avail = buffer->size - buffer->used;
+    encoded_reader_t *reader = (encoded_reader_t *)stream;
+    unsigned int avail = reader->size - reader->used;
     unsigned char *pblob = (unsigned char *)blob;
+    int rd;
 
     if (size <= avail) {
-        memcpy(blob, buffer->blob + buffer->used, size);
-        buffer->used += size;
+        memcpy(blob, reader->blob + reader->used, size);
+        reader->used += size;
         return(size);
     }
 
     /* Copy the old buffer to the end. */
     if (avail > 0) {
-        memcpy(pblob, buffer->blob + buffer->used, avail);
+        memcpy(pblob, reader->blob + reader->used, avail);
+        reader->used += avail;
         pblob += avail;
         size -= avail;
     }
 
     do {
-        if (__encoded_read_block(buffer) < 0)
+        if ((rd = __encoded_read_block(reader, pblob, size)) < 0)
             break;
 
+        /* Decoded in the user buffer */
+        if (rd > 0) {
+            pblob += rd;
+            size -= rd;
+            continue;
+        }
+
         /* Copy to user */
-        avail = (size > buffer->size) ? buffer->size : size;
-        memcpy(pblob, buffer->blob, avail);
-        buffer->used = avail;
+        avail = (size > reader->size) ? reader->size : size;
+        memcpy(pblob, reader->blob, avail);
+        reader->used = avail;
         pblob += avail;
         size -= avail;
     } while (size > 0);
@@ -277,16 +451,43 @@ int encoded_reader_open (encoded_reader_t *reader,
     reader->codec = codec;
     reader->stream = stream;
     reader->blob = NULL;
+    reader->cbuf = NULL;
+    reader->cbuf_size = 0;
+    reader->capacity = 0;
     reader->size = 0;
     reader->used = 0;
+    reader->history = NULL;
+    reader->hist_capacity = 0;
+    reader->hist_size = 0;
+    reader->flags = ENCODED_VERIFY_STORED;
+    reader->damaged = 0;
+    reader->skipped = 0;
     return(0);
 }
 
+void encoded_reader_set_flags (encoded_reader_t *reader,
+                               unsigned int flags)
+{
+    reader->flags = flags;
+}
+
 void encoded_reader_close (encoded_reader_t *reader) {
     if (reader->blob != NULL) {
         free(reader->blob);
         reader->blob = NULL;
     }
+    if (reader->cbuf != NULL) {
+        free(reader->cbuf);
+        reader->cbuf = NULL;
+    }
+    if (reader->history != NULL) {
+        free(reader->history);
+        reader->history = NULL;
+    }
+    reader->hist_capacity = 0;
+    reader->hist_size = 0;
+    reader->cbuf_size = 0;
+    reader->capacity = 0;
     reader->used = 0;
     reader->size = 0;
 }
@@ -21,14 +21,26 @@
 #include "stream.h"
 #include "codec.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef struct encoded_writer encoded_writer_t;
 typedef struct encoded_reader encoded_reader_t;
 
+/*
+ * Each block is written as a frame (see frame.h), the same format of the
+ * C++ CompressedWriter/CompressedReader. The reader rejects blocks written
+ * with a different codec, except raw (CODEC_ID_PLAIN) blocks and it follows
+ * linked blocks if the codec implements decode_linked.
+ */
 struct encoded_writer {
     stream_t __base_type__;
     stream_t *     stream;
     codec_t *      codec;
     unsigned char *blob;
+    unsigned char *cbuf;        /* Frame header + encode scratch, reused */
+    unsigned int   cbuf_size;
     unsigned int   size;
     unsigned int   used;
 };
@@ -38,10 +50,27 @@ struct encoded_reader {
     stream_t *     stream;
     codec_t *      codec;
     unsigned char *blob;
+    unsigned char *cbuf;        /* Encoded block, reused across blocks */
+    unsigned int   cbuf_size;
+    unsigned int   capacity;    /* blob allocated size */
     unsigned int   size;
     unsigned int   used;
+    unsigned char *history;     /* Decoded linked blocks */
+    unsigned int   hist_capacity;
+    unsigned int   hist_size;
+    unsigned int   flags;       /* ENCODED_VERIFY_* | ENCODED_RESYNC */
+    uint64_t       damaged;     /* Damaged blocks skipped (resync) */
+    uint64_t       skipped;     /* Bytes skipped (resync) */
 };
 
+/*
+ * Reader flags, the default is ENCODED_VERIFY_STORED. Checking the decoded
+ * data costs a second crc pass over each block.
+ */
+#define ENCODED_VERIFY_STORED       (1 << 0)
+#define ENCODED_VERIFY_DATA         (1 << 1)
+#define ENCODED_RESYNC              (1 << 2)
+
 int encoded_writer_open (encoded_writer_t *writer,
                          codec_t *codec,
                          stream_t *stream,
@@ -51,7 +80,13 @@ void encoded_writer_close (encoded_writer_t *writer);
 int encoded_reader_open (encoded_reader_t *reader,
                          codec_t *codec,
                          stream_t *stream);
+void encoded_reader_set_flags (encoded_reader_t *reader,
+                               unsigned int flags);
 void encoded_reader_close (encoded_reader_t *reader);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* !_IO_ENCODED_H_ */
 
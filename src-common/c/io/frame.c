@@ -0,0 +1,127 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+
+#include <string.h>
+
+#include "crc32c.h"
+#include "frame.h"
+
+static void __write_u32be (unsigned char *buf, uint32_t value) {
+    buf[0] = (value >> 24) & 0xff;
+    buf[1] = (value >> 16) & 0xff;
+    buf[2] = (value >> 8) & 0xff;
+    buf[3] = value & 0xff;
+}
+
+static uint32_t __read_u32be (const unsigned char *buf) {
+    return(((uint32_t)buf[0] << 24) | ((uint32_t)buf[1] << 16) |
+           ((uint32_t)buf[2] << 8) | buf[3]);
+}
+
+/* Offset of the next (possibly partial) magic after buffer[0] */
+static unsigned int __frame_magic_scan (const unsigned char *buffer,
+                                        unsigned int size)
+{
+    unsigned int i, n;
+
+    for (i = 1; i < size; ++i) {
+        n = (size - i) < 4 ? (size - i) : 4;
+        if (!memcmp(buffer + i, FRAME_MAGIC, n))
+            return(i);
+    }
+
+    return(size);
+}
+
+void frame_header_encode (unsigned char *buffer,
+                          const frame_header_t *header)
+{
+    memcpy(buffer, FRAME_MAGIC, 4);
+    buffer[4] = FRAME_VERSION;
+    buffer[5] = header->codec;
+    buffer[6] = header->flags;
+    buffer[7] = 0;
+    __write_u32be(buffer + 8, header->size);
+    __write_u32be(buffer + 12, header->csize);
+    __write_u32be(buffer + 16, header->stored_crc);
+    __write_u32be(buffer + 20, header->data_crc);
+    __write_u32be(buffer + 24, crc32c(0, buffer, 24));
+}
+
+int frame_header_decode (frame_header_t *header,
+                         const unsigned char *buffer)
+{
+    if (memcmp(buffer, FRAME_MAGIC, 4))
+        return(-1);
+
+    if (__read_u32be(buffer + 24) != crc32c(0, buffer, 24))
+        return(-2);
+
+    if (buffer[4] != FRAME_VERSION)
+        return(-3);
+
+    header->codec = buffer[5];
+    header->flags = buffer[6];
+    header->size = __read_u32be(buffer + 8);
+    header->csize = __read_u32be(buffer + 12);
+    header->stored_crc = __read_u32be(buffer + 16);
+    header->data_crc = __read_u32be(buffer + 20);
+    return(0);
+}
+
+int frame_read_header (stream_t *stream,
+                       frame_header_t *header,
+                       int resync,
+                       uint64_t *skipped)
+{
+    unsigned char buffer[FRAME_HEADER_SIZE];
+    unsigned int avail = 0;
+    unsigned int offset;
+    int err, rd;
+
+    while (1) {
+        rd = io_read_fully(stream, buffer + avail, FRAME_HEADER_SIZE - avail);
+        if (rd < 0)
+            rd = 0;
+
+        if ((avail += rd) < FRAME_HEADER_SIZE) {
+            /* Truncated tail, nothing else to read */
+            if (avail == 0)
+                return(0);
+
+            if (!resync)
+                return(-4);
+
+            *skipped += avail;
+            return(0);
+        }
+
+        if ((err = frame_header_decode(header, buffer)) == 0)
+            return(1);
+
+        if (!resync)
+            return(err);
+
+        /* Slide to the next candidate magic */
+        offset = __frame_magic_scan(buffer, FRAME_HEADER_SIZE);
+        memmove(buffer, buffer + offset, FRAME_HEADER_SIZE - offset);
+        avail = FRAME_HEADER_SIZE - offset;
+        *skipped += offset;
+    }
+
+    return(-1);
+}
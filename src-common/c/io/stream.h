@@ -20,6 +20,10 @@
 #include <stdint.h>
 #include <stdio.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef const struct stream_vtable stream_vtable_t;
 typedef struct stream stream_t;
 
@@ -92,5 +96,9 @@ int     io_read_int32   (stream_t *stream, int32_t *value);
 int     io_read_int64   (stream_t *stream, int64_t *value);
 int     io_read_vint    (stream_t *stream, int64_t *value);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* !_IO_STREAM_H_ */
 
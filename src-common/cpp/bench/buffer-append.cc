@@ -0,0 +1,124 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <sys/time.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "Buffer.h"
+
+#define BENCH_STREAM_SIZE       (64 << 20)
+#define BENCH_KEYS              (1 << 20)
+#define BENCH_RECORDS           (1 << 14)
+#define BENCH_RECORD_SIZE       (4 << 10)
+
+static double __time_now (void) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return(now.tv_sec + (now.tv_usec / 1000000.0));
+}
+
+/* One big buffer filled with small appends (log/WAL style) */
+static size_t bench_stream (const BufferGrowPolicy *policy) {
+    uint8_t chunk[64];
+    size_t i, size;
+    Buffer buf(0, policy);
+
+    for (i = 0; i < sizeof(chunk); ++i)
+        chunk[i] = i & 0xff;
+
+    for (i = 0, size = 0; size < BENCH_STREAM_SIZE; ++i) {
+        size_t n = 8 + (i % 57);
+        buf.append(chunk, n);
+        size += n;
+    }
+
+    return(buf.size());
+}
+
+/* Lots of short-lived small keys */
+static size_t __bench_keys (const BufferGrowPolicy *policy, size_t hint) {
+    const char *prefix = "user:";
+    size_t i, total = 0;
+    uint64_t key;
+
+    for (i = 0; i < BENCH_KEYS; ++i) {
+        Buffer buf(hint, policy);
+        key = i * 0x9e3779b97f4a7c15ull;
+        buf.append(prefix, 5);
+        buf.append(&key, sizeof(key));
+        buf.append(&i, sizeof(i));
+        total += buf.size();
+    }
+
+    return(total);
+}
+
+static size_t bench_keys (const BufferGrowPolicy *policy) {
+    return(__bench_keys(policy, 0));
+}
+
+/* Same keys, forced on the heap (the behaviour without inline storage) */
+static size_t bench_keys_heap (const BufferGrowPolicy *policy) {
+    return(__bench_keys(policy, BUFFER_INLINE_SIZE + 1));
+}
+
+/* Medium records built field by field */
+static size_t bench_records (const BufferGrowPolicy *policy) {
+    uint8_t field[32];
+    size_t i, j, total = 0;
+
+    for (i = 0; i < sizeof(field); ++i)
+        field[i] = i;
+
+    for (i = 0; i < BENCH_RECORDS; ++i) {
+        Buffer buf(0, policy);
+        for (j = 0; j < (BENCH_RECORD_SIZE / sizeof(field)); ++j)
+            buf.append(field, sizeof(field));
+        total += buf.size();
+    }
+
+    return(total);
+}
+
+static void bench_run (const char *name,
+                       size_t (*func) (const BufferGrowPolicy *))
+{
+    double st, linear, geometric;
+    size_t a, b;
+
+    st = __time_now();
+    a = func(BufferGrowPolicy::linear());
+    linear = __time_now() - st;
+
+    st = __time_now();
+    b = func(BufferGrowPolicy::geometric());
+    geometric = __time_now() - st;
+
+    printf("%-10s %12.3fms %12.3fms %8.2fx%s\n", name,
+           linear * 1000.0, geometric * 1000.0,
+           (geometric > 0) ? (linear / geometric) : 0.0,
+           (a != b) ? " (size mismatch!)" : "");
+}
+
+int main (int argc, char **argv) {
+    printf("%-10s %14s %14s %9s\n", "# bench", "linear-512", "geometric", "speedup");
+    bench_run("stream", bench_stream);
+    bench_run("keys", bench_keys);
+    bench_run("keys-heap", bench_keys_heap);
+    bench_run("records", bench_records);
+    return(0);
+}
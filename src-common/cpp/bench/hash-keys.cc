@@ -0,0 +1,115 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <sys/time.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "Hash.h"
+
+#define BENCH_KEYS              (1 << 16)
+#define BENCH_ROUNDS            64
+#define BENCH_BLOB_SIZE         (1 << 20)
+
+static double __time_now (void) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return(now.tv_sec + (now.tv_usec / 1000000.0));
+}
+
+static const void *__keys[BENCH_KEYS];
+static size_t __lengths[BENCH_KEYS];
+static uint64_t __hashes[BENCH_KEYS];
+static uint8_t *__blob;
+
+static void bench_setup (void) {
+    size_t i;
+
+    __blob = (uint8_t *)malloc(BENCH_BLOB_SIZE);
+    srand(42);
+    for (i = 0; i < BENCH_BLOB_SIZE; ++i)
+        __blob[i] = rand() & 0xff;
+
+    /* Short keys, 4 to 16 bytes */
+    for (i = 0; i < BENCH_KEYS; ++i) {
+        __keys[i] = __blob + (i * 16);
+        __lengths[i] = 4 + (rand() % 13);
+    }
+}
+
+static uint64_t bench_single (void) {
+    uint64_t sum = 0;
+    int r, i;
+
+    for (r = 0; r < BENCH_ROUNDS; ++r) {
+        for (i = 0; i < BENCH_KEYS; ++i)
+            sum += hash64(__keys[i], __lengths[i]);
+    }
+    return(sum);
+}
+
+static uint64_t bench_many (void) {
+    uint64_t sum = 0;
+    int r, i;
+
+    for (r = 0; r < BENCH_ROUNDS; ++r) {
+        hash64Many(__keys, __lengths, BENCH_KEYS, __hashes);
+        for (i = 0; i < BENCH_KEYS; ++i)
+            sum += __hashes[i];
+    }
+    return(sum);
+}
+
+static uint64_t bench_bulk (void) {
+    uint64_t sum = 0;
+    int r;
+
+    for (r = 0; r < BENCH_ROUNDS; ++r)
+        sum += hash64(__blob, BENCH_BLOB_SIZE, r);
+    return(sum);
+}
+
+static void bench_run (const char *name, uint64_t (*func) (void), double bytes) {
+    double st, elapsed;
+    uint64_t sum;
+
+    st = __time_now();
+    sum = func();
+    elapsed = __time_now() - st;
+
+    printf("%-10s %12.3fms %10.1fMiB/s  (%016llx)\n", name, elapsed * 1000.0,
+           (elapsed > 0) ? (bytes / elapsed) / (1 << 20) : 0.0,
+           (unsigned long long)sum);
+}
+
+int main (int argc, char **argv) {
+    double key_bytes = 0;
+    int i;
+
+    bench_setup();
+    for (i = 0; i < BENCH_KEYS; ++i)
+        key_bytes += __lengths[i];
+    key_bytes *= BENCH_ROUNDS;
+
+    printf("%-10s %14s %16s\n", "# bench", "time", "throughput");
+    bench_run("single", bench_single, key_bytes);
+    bench_run("many", bench_many, key_bytes);
+    bench_run("bulk-1M", bench_bulk, (double)BENCH_BLOB_SIZE * BENCH_ROUNDS);
+
+    free(__blob);
+    return(0);
+}
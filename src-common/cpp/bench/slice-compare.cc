@@ -0,0 +1,147 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <sys/time.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "BlobSlice.h"
+
+#define BENCH_KEYS              (1 << 16)
+#define BENCH_ROUNDS            64
+#define BENCH_KEY_PREFIX        24
+
+/* Same keys without data(), goes through the fetch*() path */
+class FetchSlice : public ByteSlice {
+    public:
+        FetchSlice() : _blob(NULL), _length(0) {}
+        FetchSlice(const uint8_t *blob, size_t length)
+            : _blob(blob), _length(length) {}
+
+        size_t length (void) const { return(_length); }
+        uint8_t fetch8 (size_t index) const { return(_blob[index]); }
+
+    private:
+        const uint8_t *_blob;
+        size_t _length;
+};
+
+static double __time_now (void) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return(now.tv_sec + (now.tv_usec / 1000000.0));
+}
+
+static uint8_t *__keys_blob;
+static BlobSlice *__blob_keys;
+static FetchSlice *__fetch_keys;
+
+static void bench_setup (void) {
+    uint8_t *p;
+    size_t i, j;
+
+    __keys_blob = (uint8_t *)malloc(BENCH_KEYS * 64);
+    __blob_keys = new BlobSlice[BENCH_KEYS];
+    __fetch_keys = new FetchSlice[BENCH_KEYS];
+
+    /* Sorted-run like keys: long shared prefix, short random suffix */
+    srand(42);
+    for (i = 0; i < BENCH_KEYS; ++i) {
+        size_t length = BENCH_KEY_PREFIX + 8 + (rand() % 24);
+        p = __keys_blob + (i * 64);
+        for (j = 0; j < BENCH_KEY_PREFIX; ++j)
+            p[j] = 'k';
+        for (; j < length; ++j)
+            p[j] = rand() & 0xff;
+        __blob_keys[i] = BlobSlice(p, length);
+        __fetch_keys[i] = FetchSlice(p, length);
+    }
+}
+
+static long bench_fetch (void) {
+    const ByteSlice *a, *b;
+    long sum = 0;
+    int r, i;
+
+    for (r = 0; r < BENCH_ROUNDS; ++r) {
+        for (i = 1; i < BENCH_KEYS; ++i) {
+            a = &(__fetch_keys[i - 1]);
+            b = &(__fetch_keys[i]);
+            sum += (a->compare(b) < 0);
+        }
+    }
+    return(sum);
+}
+
+static long bench_virtual (void) {
+    const ByteSlice *a, *b;
+    long sum = 0;
+    int r, i;
+
+    for (r = 0; r < BENCH_ROUNDS; ++r) {
+        for (i = 1; i < BENCH_KEYS; ++i) {
+            a = &(__blob_keys[i - 1]);
+            b = &(__blob_keys[i]);
+            sum += (a->compare(b) < 0);
+        }
+    }
+    return(sum);
+}
+
+static long bench_template (void) {
+    long sum = 0;
+    int r, i;
+
+    for (r = 0; r < BENCH_ROUNDS; ++r) {
+        for (i = 1; i < BENCH_KEYS; ++i)
+            sum += (sliceCompare(__blob_keys[i - 1], __blob_keys[i]) < 0);
+    }
+    return(sum);
+}
+
+static void bench_run (const char *name, long (*func) (void), double base) {
+    double st, elapsed;
+    long sum;
+
+    st = __time_now();
+    sum = func();
+    elapsed = __time_now() - st;
+
+    printf("%-10s %12.3fms %8.2fx  (%ld)\n", name, elapsed * 1000.0,
+           (elapsed > 0) ? (base / elapsed) : 1.0, sum);
+}
+
+int main (int argc, char **argv) {
+    double st;
+
+    bench_setup();
+
+    /* Baseline: the fetch*() path, as every compare used to be */
+    st = __time_now();
+    bench_fetch();
+    st = __time_now() - st;
+
+    printf("%-10s %14s %9s\n", "# bench", "time", "speedup");
+    bench_run("fetch", bench_fetch, st);
+    bench_run("virtual", bench_virtual, st);
+    bench_run("template", bench_template, st);
+
+    delete[] __fetch_keys;
+    delete[] __blob_keys;
+    free(__keys_blob);
+    return(0);
+}
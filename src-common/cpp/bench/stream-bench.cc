@@ -0,0 +1,642 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+
+/*
+ * Stream stack benchmark, the C++ counterpart of c/bench/codec-bench.c.
+ *
+ *   stream-bench [-b 4096,64k] [-n rounds] [-s synthetic-size] [-o out.json] [file ...]
+ *
+ * Each stack (buffered, lz4 independent/fast/linked compressed, zstd) writes
+ * the corpus over an in-memory stream with block-sized calls and reads it
+ * back. Results are printed as JSON with the same fields as codec-bench:
+ * ratio, MB/s and the p50/p99 latency of a single write/read call.
+ */
+
+#include <sys/stat.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "CompressedWriter.h"
+#include "CompressedReader.h"
+#include "BufferedWriter.h"
+#include "BufferedReader.h"
+#include "ZstdCompressed.h"
+
+#define BENCH_MAX_BLOCKS        16
+#define BENCH_MAX_CORPUS        32
+#define BENCH_SYNTHETIC_SIZE    (4 << 20)
+#define BENCH_ROUNDS            3
+
+/* ============================================================================
+ *  Timing and latency histogram
+ */
+#define HIST_BUCKETS            (8 + (61 * 8))
+
+struct bench_hist {
+    uint64_t count;
+    uint64_t buckets[HIST_BUCKETS];
+};
+
+static uint64_t __time_nanos (void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return(((uint64_t)ts.tv_sec * 1000000000ull) + ts.tv_nsec);
+}
+
+/* Log-linear buckets: 8 sub-buckets per power of two (12.5% precision) */
+static unsigned int __hist_bucket (uint64_t value) {
+    unsigned int shift;
+
+    if (value < 8)
+        return(value);
+
+    shift = (63 - __builtin_clzll(value)) - 3;
+    return((shift << 3) + (value >> shift));
+}
+
+static uint64_t __hist_bucket_max (unsigned int index) {
+    unsigned int shift;
+
+    if (index < 8)
+        return(index);
+
+    shift = (index >> 3) - 1;
+    return((((uint64_t)(8 + (index & 7)) + 1) << shift) - 1);
+}
+
+static void __hist_add (struct bench_hist *hist, uint64_t nanos) {
+    hist->buckets[__hist_bucket(nanos)]++;
+    hist->count++;
+}
+
+static double __hist_percentile_us (const struct bench_hist *hist,
+                                    double percentile)
+{
+    uint64_t threshold;
+    uint64_t total;
+    unsigned int i;
+
+    threshold = (uint64_t)(hist->count * percentile);
+    if (threshold == 0)
+        threshold = 1;
+
+    total = 0;
+    for (i = 0; i < HIST_BUCKETS; ++i) {
+        total += hist->buckets[i];
+        if (total >= threshold)
+            return(__hist_bucket_max(i) / 1000.0);
+    }
+
+    return(0.0);
+}
+
+/* ============================================================================
+ *  Results
+ */
+struct bench_result {
+    const char *corpus;
+    const char *kind;
+    const char *name;
+    unsigned int block_size;
+    uint64_t bytes;
+    uint64_t encoded_bytes;
+    uint64_t encode_nanos;          /* Best round */
+    uint64_t decode_nanos;          /* Best round */
+    struct bench_hist encode;
+    struct bench_hist decode;
+    bool ok;
+};
+
+static void __result_reset (struct bench_result *result,
+                            const char *corpus,
+                            const char *kind,
+                            const char *name,
+                            unsigned int block_size,
+                            uint64_t bytes)
+{
+    memset(result, 0, sizeof(struct bench_result));
+    result->corpus = corpus;
+    result->kind = kind;
+    result->name = name;
+    result->block_size = block_size;
+    result->bytes = bytes;
+    result->encode_nanos = UINT64_MAX;
+    result->decode_nanos = UINT64_MAX;
+    result->ok = true;
+}
+
+static double __mbs (uint64_t bytes, uint64_t nanos) {
+    if (nanos == 0 || nanos == UINT64_MAX)
+        return(0.0);
+    return((bytes / (1024.0 * 1024.0)) / (nanos / 1000000000.0));
+}
+
+static void __result_dump (FILE *out,
+                           const struct bench_result *result,
+                           bool first)
+{
+    double ratio;
+
+    ratio = result->encoded_bytes ?
+                ((double)result->bytes / result->encoded_bytes) : 0.0;
+
+    fprintf(out, "%s    {\"corpus\": \"%s\", \"kind\": \"%s\", \"name\": \"%s\", "
+                 "\"block_size\": %u,\n",
+            first ? "" : ",\n",
+            result->corpus, result->kind, result->name, result->block_size);
+    fprintf(out, "     \"bytes\": %llu, \"encoded_bytes\": %llu, \"ratio\": %.4f, "
+                 "\"ok\": %s,\n",
+            (unsigned long long)result->bytes,
+            (unsigned long long)result->encoded_bytes,
+            ratio, result->ok ? "true" : "false");
+    fprintf(out, "     \"encode_mbs\": %.2f, \"encode_p50_us\": %.2f, "
+                 "\"encode_p99_us\": %.2f,\n",
+            __mbs(result->bytes, result->encode_nanos),
+            __hist_percentile_us(&(result->encode), 0.50),
+            __hist_percentile_us(&(result->encode), 0.99));
+    fprintf(out, "     \"decode_mbs\": %.2f, \"decode_p50_us\": %.2f, "
+                 "\"decode_p99_us\": %.2f}",
+            __mbs(result->bytes, result->decode_nanos),
+            __hist_percentile_us(&(result->decode), 0.50),
+            __hist_percentile_us(&(result->decode), 0.99));
+}
+
+/* ============================================================================
+ *  Corpus
+ */
+struct bench_corpus {
+    char name[64];
+    uint8_t *data;
+    unsigned int size;
+};
+
+static uint64_t __rand_state = 0x9e3779b97f4a7c15ull;
+
+static uint32_t __rand (void) {
+    __rand_state ^= __rand_state << 13;
+    __rand_state ^= __rand_state >> 7;
+    __rand_state ^= __rand_state << 17;
+    return((uint32_t)(__rand_state >> 16));
+}
+
+/* Log lines, repetitive text with a few changing fields */
+static void __corpus_text (uint8_t *data, unsigned int size) {
+    static const char *levels[] = { "INFO", "DEBUG", "WARN", "ERROR" };
+    static const char *words[] = {
+        "request", "completed", "block", "flush", "reader", "writer",
+        "compaction", "segment", "checkpoint", "retry", "timeout", "client",
+    };
+    unsigned int used = 0;
+    char line[256];
+    int n;
+
+    while (used < size) {
+        n = snprintf(line, sizeof(line),
+                     "2012-%02u-%02u %02u:%02u:%02u.%03u %-5s [worker-%u] %s %s id=%08x took=%ums\n",
+                     1 + __rand() % 12, 1 + __rand() % 28, __rand() % 24,
+                     __rand() % 60, __rand() % 60, __rand() % 1000,
+                     levels[__rand() & 3], __rand() % 16,
+                     words[__rand() % 12], words[__rand() % 12],
+                     __rand(), __rand() % 5000);
+        if ((unsigned int)n > (size - used))
+            n = size - used;
+        memcpy(data + used, line, n);
+        used += n;
+    }
+}
+
+/* Fixed size binary records, small integers and a few constant fields */
+static void __corpus_records (uint8_t *data, unsigned int size) {
+    uint32_t key = 0;
+    unsigned int i;
+
+    for (i = 0; (i + 32) <= size; i += 32) {
+        uint32_t value = __rand();
+        key += 1 + (value & 7);
+        memcpy(data + i, &key, 4);
+        memset(data + i + 4, 0, 12);
+        data[i + 4] = value >> 24;
+        data[i + 5] = (value >> 16) & 3;
+        memcpy(data + i + 16, "user:0000000000\n", 16);
+        data[i + 21 + (value & 7)] = '0' + ((value >> 8) % 10);
+    }
+    memset(data + i, 0, size - i);
+}
+
+static void __corpus_random (uint8_t *data, unsigned int size) {
+    unsigned int i;
+    for (i = 0; i < size; ++i)
+        data[i] = __rand() & 0xff;
+}
+
+static int __corpus_synthetic (struct bench_corpus *corpus,
+                               const char *name,
+                               unsigned int size,
+                               void (*generate) (uint8_t *, unsigned int))
+{
+    if ((corpus->data = (uint8_t *)malloc(size)) == NULL)
+        return(-1);
+
+    snprintf(corpus->name, sizeof(corpus->name), "%s", name);
+    corpus->size = size;
+    generate(corpus->data, size);
+    return(0);
+}
+
+static int __corpus_load (struct bench_corpus *corpus, const char *path) {
+    const char *name;
+    struct stat st;
+    FILE *fp;
+
+    if (stat(path, &st) < 0 || st.st_size <= 0 || st.st_size > (1 << 30))
+        return(-1);
+
+    if ((fp = fopen(path, "rb")) == NULL)
+        return(-1);
+
+    corpus->size = st.st_size;
+    if ((corpus->data = (uint8_t *)malloc(corpus->size)) == NULL) {
+        fclose(fp);
+        return(-1);
+    }
+
+    if (fread(corpus->data, 1, corpus->size, fp) != corpus->size) {
+        free(corpus->data);
+        fclose(fp);
+        return(-1);
+    }
+
+    name = strrchr(path, '/');
+    snprintf(corpus->name, sizeof(corpus->name), "%s", name ? name + 1 : path);
+    fclose(fp);
+    return(0);
+}
+
+/* ============================================================================
+ *  Memory stream
+ */
+class MemoryStream : public Writable, public Readable {
+    public:
+        MemoryStream() {
+            _data = NULL;
+            _capacity = 0;
+            _size = 0;
+            _offset = 0;
+        }
+
+        ~MemoryStream() {
+            free(_data);
+        }
+
+        void reset (void) {
+            _size = 0;
+            _offset = 0;
+        }
+
+        void rewind (void) {
+            _offset = 0;
+        }
+
+        unsigned int size (void) const {
+            return(_size);
+        }
+
+        int write (const void *buf, unsigned int size) {
+            if ((_size + size) > _capacity) {
+                unsigned int capacity = _capacity ? _capacity : 4096;
+                uint8_t *data;
+
+                while (capacity < (_size + size))
+                    capacity <<= 1;
+
+                if ((data = (uint8_t *)realloc(_data, capacity)) == NULL)
+                    return(-1);
+
+                _data = data;
+                _capacity = capacity;
+            }
+
+            memcpy(_data + _size, buf, size);
+            _size += size;
+            return(size);
+        }
+
+        int flush (void) {
+            return(0);
+        }
+
+        int read (void *buf, unsigned int size) {
+            if (size > (_size - _offset))
+                size = _size - _offset;
+
+            memcpy(buf, _data + _offset, size);
+            _offset += size;
+            return(size);
+        }
+
+    private:
+        uint8_t *    _data;
+        unsigned int _capacity;
+        unsigned int _size;
+        unsigned int _offset;
+};
+
+/* ============================================================================
+ *  Stacks, add new writer/reader pairs to __bench_stacks
+ */
+struct bench_stack {
+    const char *kind;
+    const char *name;
+    Writable *(*writer) (Writable *writable, unsigned int block_size);
+    Readable *(*reader) (Readable *readable, unsigned int block_size);
+};
+
+static Writable *__buffered_writer (Writable *writable, unsigned int block_size) {
+    return(new BufferedWriter(writable, block_size));
+}
+
+static Readable *__buffered_reader (Readable *readable, unsigned int block_size) {
+    return(new BufferedReader(readable, block_size));
+}
+
+static Writable *__lz4_writer (Writable *writable, unsigned int block_size) {
+    return(new Lz4Writer(writable, block_size));
+}
+
+static Writable *__lz4_fast_writer (Writable *writable, unsigned int block_size) {
+    return(new Lz4Writer(writable, block_size, NULL, 8));
+}
+
+static Writable *__lz4_linked_writer (Writable *writable, unsigned int block_size) {
+    return(new Lz4Writer(writable, block_size, NULL, 1, 64));
+}
+
+static Readable *__lz4_reader (Readable *readable, unsigned int block_size) {
+    return(new Lz4Reader(readable));
+}
+
+#ifdef HAVE_ZSTD
+static Writable *__zstd1_writer (Writable *writable, unsigned int block_size) {
+    return(new ZstdWriter(writable, block_size, NULL, 1));
+}
+
+static Writable *__zstd3_writer (Writable *writable, unsigned int block_size) {
+    return(new ZstdWriter(writable, block_size, NULL, 3));
+}
+
+static Readable *__zstd_reader (Readable *readable, unsigned int block_size) {
+    return(new ZstdReader(readable));
+}
+#endif /* HAVE_ZSTD */
+
+static const struct bench_stack __bench_stacks[] = {
+    { "stream",     "buffered",   __buffered_writer,   __buffered_reader },
+    { "compressed", "lz4",        __lz4_writer,        __lz4_reader },
+    { "compressed", "lz4-fast8",  __lz4_fast_writer,   __lz4_reader },
+    { "compressed", "lz4-linked", __lz4_linked_writer, __lz4_reader },
+#ifdef HAVE_ZSTD
+    { "compressed", "zstd-1",     __zstd1_writer,      __zstd_reader },
+    { "compressed", "zstd-3",     __zstd3_writer,      __zstd_reader },
+#endif /* HAVE_ZSTD */
+};
+
+#define BENCH_NSTACKS   (sizeof(__bench_stacks) / sizeof(__bench_stacks[0]))
+
+/* ============================================================================
+ *  Stream bench, one block-sized write/read call at the time
+ */
+static int __bench_stream (struct bench_result *result,
+                           const struct bench_stack *stack,
+                           MemoryStream *memory,
+                           const struct bench_corpus *corpus,
+                           unsigned int block_size,
+                           unsigned int rounds)
+{
+    uint64_t start, t, elapsed;
+    unsigned int offset, r;
+    Writable *writer;
+    Readable *reader;
+    uint8_t *decoded;
+    int n;
+
+    if ((decoded = (uint8_t *)malloc(corpus->size + block_size)) == NULL)
+        return(-1);
+
+    for (r = 0; r < rounds; ++r) {
+        memory->reset();
+        writer = stack->writer(memory, block_size);
+
+        elapsed = 0;
+        for (offset = 0; offset < corpus->size; offset += block_size) {
+            unsigned int size = corpus->size - offset;
+
+            if (size > block_size)
+                size = block_size;
+
+            start = __time_nanos();
+            n = writer->write(corpus->data + offset, size);
+            t = __time_nanos() - start;
+
+            __hist_add(&(result->encode), t);
+            elapsed += t;
+            if (n != (int)size)
+                result->ok = false;
+        }
+
+        start = __time_nanos();
+        if (writer->flush() < 0)
+            result->ok = false;
+        elapsed += __time_nanos() - start;
+        delete writer;
+
+        if (elapsed < result->encode_nanos)
+            result->encode_nanos = elapsed;
+        result->encoded_bytes = memory->size();
+    }
+
+    for (r = 0; r < rounds && result->ok; ++r) {
+        memory->rewind();
+        reader = stack->reader(memory, block_size);
+
+        elapsed = 0;
+        offset = 0;
+        do {
+            start = __time_nanos();
+            n = reader->read(decoded + offset, block_size);
+            t = __time_nanos() - start;
+
+            elapsed += t;
+            if (n > 0) {
+                __hist_add(&(result->decode), t);
+                offset += n;
+            }
+        } while (n > 0 && offset < corpus->size);
+        delete reader;
+
+        if (n < 0 || offset != corpus->size)
+            result->ok = false;
+        if (elapsed < result->decode_nanos)
+            result->decode_nanos = elapsed;
+    }
+
+    if (result->ok && memcmp(decoded, corpus->data, corpus->size))
+        result->ok = false;
+
+    free(decoded);
+    return(0);
+}
+
+/* ============================================================================
+ *  Main
+ */
+static unsigned int __parse_size (const char *str, char **end) {
+    unsigned long value;
+
+    value = strtoul(str, end, 10);
+    switch (**end) {
+        case 'k': case 'K': value <<= 10; (*end)++; break;
+        case 'm': case 'M': value <<= 20; (*end)++; break;
+    }
+    return((unsigned int)value);
+}
+
+static unsigned int __parse_blocks (unsigned int *blocks, const char *str) {
+    unsigned int count = 0;
+    char *end;
+
+    while (*str != '\0' && count < BENCH_MAX_BLOCKS) {
+        unsigned int size = __parse_size(str, &end);
+        if (end == str)
+            break;
+        if (size > 0)
+            blocks[count++] = size;
+        str = (*end == ',') ? end + 1 : end;
+    }
+    return(count);
+}
+
+static void __usage (const char *prog) {
+    fprintf(stderr, "usage: %s [-b block-sizes] [-n rounds] [-s synthetic-size] "
+                    "[-o output.json] [file ...]\n", prog);
+}
+
+int main (int argc, char **argv) {
+    struct bench_corpus corpus[BENCH_MAX_CORPUS];
+    unsigned int blocks[BENCH_MAX_BLOCKS];
+    unsigned int nblocks, ncorpus, rounds, synthetic;
+    struct bench_result result;
+    const char *output = NULL;
+    MemoryStream memory;
+    unsigned int c, b, k;
+    char *end;
+    FILE *out;
+    bool first;
+    int opt;
+
+    nblocks = 0;
+    rounds = BENCH_ROUNDS;
+    synthetic = BENCH_SYNTHETIC_SIZE;
+    while ((opt = getopt(argc, argv, "b:n:s:o:h")) != -1) {
+        switch (opt) {
+            case 'b':
+                nblocks = __parse_blocks(blocks, optarg);
+                break;
+            case 'n':
+                rounds = strtoul(optarg, NULL, 10);
+                break;
+            case 's':
+                synthetic = __parse_size(optarg, &end);
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            default:
+                __usage(argv[0]);
+                return(1);
+        }
+    }
+
+    if (nblocks == 0) {
+        blocks[0] = 4 << 10;
+        blocks[1] = 64 << 10;
+        nblocks = 2;
+    }
+
+    if (rounds == 0)
+        rounds = 1;
+
+    ncorpus = 0;
+    if (optind < argc) {
+        for (; optind < argc && ncorpus < BENCH_MAX_CORPUS; ++optind) {
+            if (__corpus_load(&(corpus[ncorpus]), argv[optind])) {
+                fprintf(stderr, "stream-bench: unable to load %s\n", argv[optind]);
+                continue;
+            }
+            ncorpus++;
+        }
+    } else if (synthetic > 0) {
+        if (!__corpus_synthetic(&(corpus[ncorpus]), "text", synthetic, __corpus_text))
+            ncorpus++;
+        if (!__corpus_synthetic(&(corpus[ncorpus]), "records", synthetic, __corpus_records))
+            ncorpus++;
+        if (!__corpus_synthetic(&(corpus[ncorpus]), "random", synthetic, __corpus_random))
+            ncorpus++;
+    }
+
+    if (ncorpus == 0) {
+        fprintf(stderr, "stream-bench: no corpus to run\n");
+        return(1);
+    }
+
+    if (output == NULL) {
+        out = stdout;
+    } else if ((out = fopen(output, "w")) == NULL) {
+        perror(output);
+        return(1);
+    }
+
+    fprintf(out, "{\"bench\": \"stream-bench\", \"rounds\": %u, \"results\": [\n", rounds);
+    first = true;
+    for (c = 0; c < ncorpus; ++c) {
+        for (b = 0; b < nblocks; ++b) {
+            for (k = 0; k < BENCH_NSTACKS; ++k) {
+                const struct bench_stack *stack = &(__bench_stacks[k]);
+
+                __result_reset(&result, corpus[c].name, stack->kind, stack->name,
+                               blocks[b], corpus[c].size);
+                if (!__bench_stream(&result, stack, &memory, &(corpus[c]), blocks[b], rounds)) {
+                    __result_dump(out, &result, first);
+                    first = false;
+                }
+            }
+        }
+    }
+    fprintf(out, "\n]}\n");
+
+    if (out != stdout) {
+        fclose(out);
+        printf("stream-bench: results written to %s\n", output);
+    }
+
+    for (c = 0; c < ncorpus; ++c)
+        free(corpus[c].data);
+    return(0);
+}
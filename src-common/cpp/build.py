@@ -22,6 +22,7 @@ from threading import Thread
 
 import shutil
 import string
+import pipes
 import time
 import sys
 import os
@@ -200,9 +201,9 @@ class Build(object):
         else:
             _removeDirectory(self._dir_obj)
 
-    def runTool(self, tool, verbose=True):
+    def runTool(self, tool, verbose=True, args=None):
         ldLibraryPathUpdate([self._dir_lib])
-        exit_code, output = execCommand(tool)
+        exit_code, output = execCommand('%s %s' % (tool, args) if args else tool)
 
         tool_output = []
         if verbose:
@@ -540,6 +541,19 @@ class BuildLibrary(Build):
                         shutil.copyfile(src_path, dst_path)
                         msg_write(' [CP]', dst_path)
 
+def _benchArgs(options, tool):
+    args = []
+    if options.bench_blocks:
+        args.append('-b %s' % options.bench_blocks)
+    if options.bench_json:
+        if not os.path.exists(options.bench_json):
+            os.makedirs(options.bench_json)
+        json_path = os.path.join(options.bench_json, '%s.json' % os.path.basename(tool))
+        args.append('-o %s' % pipes.quote(json_path))
+    if options.bench_corpus:
+        args.extend([pipes.quote(path) for path in options.bench_corpus.split(',') if path])
+    return ' '.join(args)
+
 def _parseCmdline():
     try:
         from argparse import ArgumentParser
@@ -565,6 +579,16 @@ def _parseCmdline():
                         help="Show traceback infomation if something fails")
     parser.add_argument('--no-output', dest='no_output', action='store_true', default=False,
                         help='Do not print messages')
+    parser.add_argument('--zstd', dest='zstd', action='store_true', default=False,
+                        help='Build the zstd codecs (requires libzstd)')
+    parser.add_argument('--bench', dest='bench', action='store_true', default=False,
+                        help='Build and run the benchmarks')
+    parser.add_argument('--bench-corpus', dest='bench_corpus', action='store', default=None,
+                        help='Comma separated list of files used as benchmark corpus')
+    parser.add_argument('--bench-blocks', dest='bench_blocks', action='store', default=None,
+                        help='Comma separated list of benchmark block sizes (e.g. 4k,64k)')
+    parser.add_argument('--bench-json', dest='bench_json', action='store', default=None,
+                        help='Directory where the benchmarks write the JSON results')
 
     return parser.parse_args()
 
@@ -579,6 +603,10 @@ if __name__ == '__main__':
     DEFAULT_DEFINES = ['-D__USE_FILE_OFFSET64']
     DEFAULT_LDLIBS = []
 
+    if options.zstd:
+        DEFAULT_DEFINES.append('-DHAVE_ZSTD')
+        DEFAULT_LDLIBS.append('-lzstd')
+
     # Default Build Options
     default_opts = BuildOptions()
     default_opts.addDefines(DEFAULT_DEFINES)
@@ -610,18 +638,44 @@ if __name__ == '__main__':
     _inclib = lambda name: '-I%s/%s/include' % (Build.DEFAULT_BUILD_DIR, name)
 
     with bench('[T] Build Time'):
+        # C io library (../c): the codec ids are shared with the C codecs,
+        # crc32c and hash are wrapped by Crc32c.h and Hash.h, and the
+        # C streams are used through CStream.h by the demos
+        build_opts = default_lib_opts.clone()
+        build_opts.setCompiler(os.getenv('CC', 'gcc'))
+        build_opts.addIncludePaths(['-I../c/io', '-I../c/data'])
+        build_opts.addLdLibs(['-lpthread'])
+        build = BuildLibrary('common-c', '0.1.0', ['../c/io', '../c/data'], options=build_opts)
+        build.build()
+
         build_opts = default_lib_opts.clone()
         build_opts.addCFlags(['-Werror'])
-        build_opts.addIncludePaths(['-I./io', '-I./data', '-I./tools'])
+        build_opts.addIncludePaths(['-I./io', '-I./io/codec/lz4', '-I./data', '-I./tools', '-I../c/io', '-I../c/data'])
+        build_opts.addLdLibs([_ldlib('common-c')])
         build = BuildLibrary('common', '0.1.0', ['io', 'data', 'tools'], options=build_opts)
         build.build()
 
+        # Demos and benchmarks are linked against the shared libcommon
+        ldLibraryPathUpdate([os.path.join(Build.DEFAULT_BUILD_DIR, 'common', 'libs'),
+                             os.path.join(Build.DEFAULT_BUILD_DIR, 'common-c', 'libs')])
+
         build_opts = default_opts.clone()
-        build_opts.addLdLibs([_ldlib('common')])
-        build_opts.addIncludePaths([_inclib('common')])
-        build_opts.addIncludePaths(['-I./io', '-I./data', '-I./tools'])
+        build_opts.addLdLibs([_ldlib('common'), _ldlib('common-c')])
+        build_opts.addIncludePaths([_inclib('common'), _inclib('common-c')])
+        build_opts.addIncludePaths(['-I./io', '-I./io/codec/lz4', '-I./data', '-I./tools', '-I../c/io', '-I../c/data'])
 
         build = BuildMiniTools('common-demo', ['demo'], options=build_opts)
         tools = build.build()
         build.runTools('Demo', tools, verbose=options.verbose)
 
+        if options.bench:
+            build = BuildMiniTools('common-bench', ['bench'], options=build_opts)
+            tools = build.build()
+
+            # Run one at a time, benchmarks should not compete for the cpus
+            msg_write('Run Tools:', 'Bench')
+            msg_write('-' * 60)
+            for tool in sorted(tools):
+                build.runTool(tool, verbose=True, args=_benchArgs(options, tool))
+            msg_write()
+
@@ -0,0 +1,265 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "Allocator.h"
+
+#define __ALIGN_UP(x, align)        (((x) + ((align) - 1)) & ~((size_t)(align) - 1))
+#define ARENA_ALIGN                 16
+
+/* ============================================================================
+ *  Allocator
+ */
+Allocator *Allocator::heap (void) {
+    /* Never destroyed, static pools/arenas may still use it at exit */
+    static Allocator *allocator = new HeapAllocator();
+    return(allocator);
+}
+
+void *Allocator::reallocate (void *ptr, size_t old_size, size_t new_size) {
+    void *nptr;
+
+    if ((nptr = allocate(new_size)) == NULL)
+        return(NULL);
+
+    if (ptr != NULL) {
+        memcpy(nptr, ptr, (old_size < new_size) ? old_size : new_size);
+        deallocate(ptr, old_size);
+    }
+
+    return(nptr);
+}
+
+/* ============================================================================
+ *  Heap Allocator
+ */
+void *HeapAllocator::allocate (size_t size) {
+    return(malloc(size));
+}
+
+void *HeapAllocator::reallocate (void *ptr, size_t old_size, size_t new_size) {
+    return(realloc(ptr, new_size));
+}
+
+void HeapAllocator::deallocate (void *ptr, size_t size) {
+    free(ptr);
+}
+
+/* ============================================================================
+ *  Arena Allocator
+ */
+ArenaAllocator::ArenaAllocator(size_t chunk_size, Allocator *parent) {
+    _parent = (parent != NULL) ? parent : Allocator::heap();
+    _head = NULL;
+    _last = NULL;
+    _chunk_size = chunk_size;
+    _used = 0;
+    _reserved = 0;
+}
+
+ArenaAllocator::~ArenaAllocator() {
+    releaseChunks(_head);
+}
+
+void *ArenaAllocator::allocate (size_t size) {
+    Chunk *chunk = _head;
+    uint8_t *ptr;
+
+    size = __ALIGN_UP(size, ARENA_ALIGN);
+    if (chunk == NULL || (chunk->size - chunk->used) < size) {
+        if ((chunk = addChunk(size)) == NULL)
+            return(NULL);
+    }
+
+    ptr = ((uint8_t *)chunk) + chunk->used;
+    chunk->used += size;
+    _used += size;
+    _last = ptr;
+    return(ptr);
+}
+
+void *ArenaAllocator::reallocate (void *ptr, size_t old_size, size_t new_size) {
+    Chunk *chunk = _head;
+
+    /* The last allocation can be extended (or shrunk) in place */
+    if (ptr != NULL && ptr == _last) {
+        size_t offset = (uint8_t *)ptr - (uint8_t *)chunk;
+        size_t osize = __ALIGN_UP(old_size, ARENA_ALIGN);
+        size_t nsize = __ALIGN_UP(new_size, ARENA_ALIGN);
+
+        if ((offset + nsize) <= chunk->size) {
+            chunk->used = offset + nsize;
+            _used = _used - osize + nsize;
+            return(ptr);
+        }
+    }
+
+    return(Allocator::reallocate(ptr, old_size, new_size));
+}
+
+void ArenaAllocator::deallocate (void *ptr, size_t size) {
+    /* Only the last allocation can be given back, the rest waits reset() */
+    if (ptr != NULL && ptr == _last) {
+        size = __ALIGN_UP(size, ARENA_ALIGN);
+        _head->used -= size;
+        _used -= size;
+        _last = NULL;
+    }
+}
+
+void ArenaAllocator::reset (void) {
+    Chunk *chunk;
+
+    if ((chunk = _head) == NULL)
+        return;
+
+    /* Keep the oldest chunk (the tail), it's the default sized one */
+    while (chunk->next != NULL) {
+        Chunk *next = chunk->next;
+        _reserved -= chunk->size;
+        _parent->deallocate(chunk, chunk->size);
+        chunk = next;
+    }
+
+    chunk->used = __ALIGN_UP(sizeof(Chunk), ARENA_ALIGN);
+    _head = chunk;
+    _last = NULL;
+    _used = 0;
+}
+
+ArenaAllocator::Chunk *ArenaAllocator::addChunk (size_t size) {
+    size_t header = __ALIGN_UP(sizeof(Chunk), ARENA_ALIGN);
+    Chunk *chunk;
+
+    size += header;
+    if (size < _chunk_size)
+        size = _chunk_size;
+
+    if ((chunk = (Chunk *)_parent->allocate(size)) == NULL)
+        return(NULL);
+
+    chunk->next = _head;
+    chunk->size = size;
+    chunk->used = header;
+    _reserved += size;
+    _head = chunk;
+    return(chunk);
+}
+
+void ArenaAllocator::releaseChunks (Chunk *chunk) {
+    while (chunk != NULL) {
+        Chunk *next = chunk->next;
+        _parent->deallocate(chunk, chunk->size);
+        chunk = next;
+    }
+}
+
+/* ============================================================================
+ *  Buffer Pool
+ */
+BufferPool::BufferPool(unsigned int max_cached, Allocator *parent) {
+    _parent = (parent != NULL) ? parent : Allocator::heap();
+    _max_cached = max_cached;
+    _hits = 0;
+    _misses = 0;
+    memset(_free, 0, sizeof(_free));
+    memset(_cached, 0, sizeof(_cached));
+}
+
+BufferPool::~BufferPool() {
+    trim();
+}
+
+void *BufferPool::allocate (size_t size) {
+    FreeBlock *block;
+    int sclass;
+
+    if ((sclass = sizeClass(size)) < 0)
+        return(_parent->allocate(size));
+
+    if ((block = _free[sclass]) != NULL) {
+        _free[sclass] = block->next;
+        _cached[sclass]--;
+        _hits++;
+        return(block);
+    }
+
+    _misses++;
+    return(_parent->allocate(1 << (sclass + BUFFER_POOL_MIN_SHIFT)));
+}
+
+void *BufferPool::reallocate (void *ptr, size_t old_size, size_t new_size) {
+    int sclass = sizeClass(old_size);
+
+    /* Same class, the buffer is already large enough */
+    if (ptr != NULL && sclass >= 0 && sclass == sizeClass(new_size))
+        return(ptr);
+
+    /* Both outside the pool, let the parent do the job (e.g. realloc) */
+    if (sclass < 0 && sizeClass(new_size) < 0)
+        return(_parent->reallocate(ptr, old_size, new_size));
+
+    return(Allocator::reallocate(ptr, old_size, new_size));
+}
+
+void BufferPool::deallocate (void *ptr, size_t size) {
+    FreeBlock *block;
+    int sclass;
+
+    if (ptr == NULL)
+        return;
+
+    if ((sclass = sizeClass(size)) < 0) {
+        _parent->deallocate(ptr, size);
+    } else if (_cached[sclass] >= _max_cached) {
+        _parent->deallocate(ptr, 1 << (sclass + BUFFER_POOL_MIN_SHIFT));
+    } else {
+        block = (FreeBlock *)ptr;
+        block->next = _free[sclass];
+        _free[sclass] = block;
+        _cached[sclass]++;
+    }
+}
+
+void BufferPool::trim (void) {
+    int i;
+
+    for (i = 0; i < BUFFER_POOL_CLASSES; ++i) {
+        FreeBlock *block = _free[i];
+        while (block != NULL) {
+            FreeBlock *next = block->next;
+            _parent->deallocate(block, 1 << (i + BUFFER_POOL_MIN_SHIFT));
+            block = next;
+        }
+        _free[i] = NULL;
+        _cached[i] = 0;
+    }
+}
+
+int BufferPool::sizeClass (size_t size) {
+    int shift;
+
+    if (size <= (1 << BUFFER_POOL_MIN_SHIFT))
+        return(0);
+
+    shift = (8 * sizeof(unsigned long long)) - __builtin_clzll(size - 1);
+    if (shift > BUFFER_POOL_MAX_SHIFT)
+        return(-1);
+
+    return(shift - BUFFER_POOL_MIN_SHIFT);
+}
@@ -0,0 +1,129 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef _ALLOCATOR_H_
+#define _ALLOCATOR_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Memory source for Buffer and the stream buffers.
+ * deallocate() and reallocate() are sized: the caller passes back the
+ * size requested at allocation time.
+ */
+class Allocator {
+    public:
+        virtual ~Allocator() {}
+
+        virtual void *allocate   (size_t size) = 0;
+        virtual void *reallocate (void *ptr, size_t old_size, size_t new_size);
+        virtual void  deallocate (void *ptr, size_t size) = 0;
+
+        /* Process-wide malloc/free allocator, used when none is specified */
+        static Allocator *heap (void);
+};
+
+class HeapAllocator : public Allocator {
+    public:
+        void *allocate   (size_t size);
+        void *reallocate (void *ptr, size_t old_size, size_t new_size);
+        void  deallocate (void *ptr, size_t size);
+};
+
+/*
+ * Bump allocator: memory is carved out of large chunks and given back
+ * all at once by reset() or by the destructor. deallocate() and
+ * reallocate() only reclaim/extend the most recent allocation.
+ * Not thread-safe, use one arena per request/thread.
+ */
+class ArenaAllocator : public Allocator {
+    public:
+        ArenaAllocator(size_t chunk_size=(64 << 10), Allocator *parent=NULL);
+        ~ArenaAllocator();
+
+        void *allocate   (size_t size);
+        void *reallocate (void *ptr, size_t old_size, size_t new_size);
+        void  deallocate (void *ptr, size_t size);
+
+        /* Release everything, keeps the first chunk for the next round */
+        void reset (void);
+
+        size_t used (void) const { return(_used); }
+        size_t reserved (void) const { return(_reserved); }
+
+    private:
+        struct Chunk {
+            struct Chunk *next;
+            size_t size;
+            size_t used;
+        };
+
+        Chunk *addChunk (size_t size);
+        void releaseChunks (Chunk *chunk);
+
+    private:
+        Allocator *_parent;
+        Chunk *    _head;
+        uint8_t *  _last;
+        size_t     _chunk_size;
+        size_t     _used;
+        size_t     _reserved;
+};
+
+/*
+ * Size-class pool of recycled I/O buffers. Requests are rounded up to
+ * the next power of two between BUFFER_POOL_MIN_CLASS and
+ * BUFFER_POOL_MAX_CLASS; freed buffers are kept (up to 'max_cached' per
+ * class) and handed out again. Larger requests go to the parent.
+ * Not thread-safe, use one pool per thread.
+ */
+#define BUFFER_POOL_MIN_SHIFT       6       /* 64 bytes */
+#define BUFFER_POOL_MAX_SHIFT       22      /* 4M */
+#define BUFFER_POOL_CLASSES         (BUFFER_POOL_MAX_SHIFT - BUFFER_POOL_MIN_SHIFT + 1)
+
+class BufferPool : public Allocator {
+    public:
+        BufferPool(unsigned int max_cached=16, Allocator *parent=NULL);
+        ~BufferPool();
+
+        void *allocate   (size_t size);
+        void *reallocate (void *ptr, size_t old_size, size_t new_size);
+        void  deallocate (void *ptr, size_t size);
+
+        /* Give all the cached buffers back to the parent */
+        void trim (void);
+
+        uint64_t hits (void) const { return(_hits); }
+        uint64_t misses (void) const { return(_misses); }
+
+    private:
+        struct FreeBlock {
+            struct FreeBlock *next;
+        };
+
+        static int sizeClass (size_t size);
+
+    private:
+        Allocator *  _parent;
+        FreeBlock *  _free[BUFFER_POOL_CLASSES];
+        unsigned int _cached[BUFFER_POOL_CLASSES];
+        unsigned int _max_cached;
+        uint64_t     _hits;
+        uint64_t     _misses;
+};
+
+#endif /* !_ALLOCATOR_H_ */
@@ -19,18 +19,94 @@
 
 #include "Buffer.h"
 
-Buffer::Buffer(size_t n) {
-    _blob = NULL;
-    _block = n;
+static const BufferLinearGrow __bufferLinearGrow;
+static const BufferGeometricGrow __bufferGeometricGrow;
+
+const BufferGrowPolicy *BufferGrowPolicy::linear (void) {
+    return(&__bufferLinearGrow);
+}
+
+const BufferGrowPolicy *BufferGrowPolicy::geometric (void) {
+    return(&__bufferGeometricGrow);
+}
+
+static inline bool __bufferAliases (const uint8_t *buf,
+                                    size_t size,
+                                    const void *blob)
+{
+    return((const uint8_t *)blob >= buf && (const uint8_t *)blob < (buf + size));
+}
+
+Buffer::Buffer(size_t n, const BufferGrowPolicy *policy, Allocator *allocator) {
+    _policy = (policy != NULL) ? policy : BufferGrowPolicy::geometric();
+    _allocator = (allocator != NULL) ? allocator : Allocator::heap();
+    _blob = _inline;
+    _block = BUFFER_INLINE_SIZE;
     _size = 0;
+
+    /* On failure the buffer stays inline, and grows on demand */
+    if (n > _block)
+        bufferResize(n);
+}
+
+Buffer::Buffer(const Buffer& other) {
+    _policy = other._policy;
+    _allocator = other._allocator;
+    _blob = _inline;
+    _block = BUFFER_INLINE_SIZE;
+    _size = 0;
+
+    set(other._blob, other._size);
 }
 
 Buffer::~Buffer() {
-    if (_blob != NULL) {
-        free(_blob);
-        _blob = NULL;
-        _size = 0;
+    bufferRelease();
+}
+
+Buffer& Buffer::operator= (const Buffer& other) {
+    if (this != &other)
+        set(other._blob, other._size);
+    return(*this);
+}
+
+#if __cplusplus >= 201103L
+Buffer::Buffer(Buffer&& other) {
+    _policy = other._policy;
+    _allocator = other._allocator;
+    _blob = _inline;
+    _block = BUFFER_INLINE_SIZE;
+    _size = 0;
+
+    steal(other);
+}
+
+Buffer& Buffer::operator= (Buffer&& other) {
+    if (this != &other) {
+        bufferRelease();
+        steal(other);
     }
+    return(*this);
+}
+#endif
+
+void Buffer::swap (Buffer& other) {
+    const BufferGrowPolicy *policy;
+    Buffer tmp;
+
+    if (this == &other)
+        return;
+
+    tmp.steal(*this);
+    steal(other);
+    other.steal(tmp);
+
+    policy = _policy;
+    _policy = other._policy;
+    other._policy = policy;
+}
+
+void Buffer::setGrowPolicy (const BufferGrowPolicy *policy) {
+    _policy = (policy != NULL) ? policy : BufferGrowPolicy::geometric();
 }
 
 void Buffer::clear (void) {
@@ -38,21 +114,27 @@ void Buffer::clear (void) {
 }
 
 int Buffer::squeeze (void) {
-    if (_size > 0) {
-        uint8_t *blob;
+    return(bufferResize(_size));
+}
 
-        if ((blob = (uint8_t *) realloc(_blob, _size)) == NULL)
-            return(-1);
+uint8_t *Buffer::release (size_t *capacity) {
+    uint8_t *blob;
 
-        _block = _size;
-        _blob = blob;
+    if (_blob == _inline) {
+        size_t size = (_size > 0) ? _size : 1;
+        if ((blob = (uint8_t *) _allocator->allocate(size)) == NULL)
+            return(NULL);
+        memcpy(blob, _inline, _size);
+        *capacity = size;
     } else {
-        free(_blob);
-        _blob = NULL;
-        _block = 0;
+        blob = _blob;
+        *capacity = _block;
     }
 
-    return(0);
+    _blob = _inline;
+    _block = BUFFER_INLINE_SIZE;
+    _size = 0;
+    return(blob);
 }
 
 int Buffer::reserve (size_t n) {
@@ -86,9 +168,15 @@ int Buffer::set (const void *blob, size_t size) {
 int Buffer::append  (const void *blob, size_t size) {
     size_t n;
 
-    if ((n = _size + size) >= _block) {
-        if (bufferGrow(n))
+    if ((n = _size + size) > _block) {
+        if (__bufferAliases(_blob, _block, blob)) {
+            size_t offset = (const uint8_t *)blob - _blob;
+            if (bufferGrow(n))
+                return(-1);
+            blob = _blob + offset;
+        } else if (bufferGrow(n)) {
             return(-1);
+        }
     }
 
     memcpy(_blob + _size, blob, size);
@@ -97,71 +185,47 @@ int Buffer::append  (const void *blob, size_t size) {
 }
 
 int Buffer::prepend (const void *blob, size_t size) {
-    size_t n;
-
-    if ((n = (_size + size)) > _block) {
-        if (bufferGrow(n))
-            return(-1);
-    }
-
-    if ((uint8_t *)blob >= _blob && (uint8_t *)blob < (_blob + _block)) {
-        uint8_t *dblob;
-
-        if ((dblob = (uint8_t *) malloc(size)) == NULL)
-            return(-1);
-
-        memcpy(dblob, _blob, size);
-        memmove(_blob + size, _blob, _size);
-        memcpy(_blob, dblob, size);
-
-        free(dblob);
-    } else {
-        memmove(_blob + size, _blob, _size);
-        memcpy(_blob, blob, size);
-    }
-
-    _size += size;
-
-    return(0);
+    return(insert(0, blob, size));
 }
 
 int Buffer::insert (size_t index, const void *blob, size_t n) {
+    uint8_t *dblob = NULL;
     unsigned char *p;
     size_t size;
 
+    /* Copy out self-references, the grow and the move below clobber them */
+    if (__bufferAliases(_blob, _block, blob)) {
+        if ((dblob = (uint8_t *) _allocator->allocate(n)) == NULL)
+            return(-1);
+
+        memcpy(dblob, blob, n);
+        blob = dblob;
+    }
+
     size = _size + n;
     if (index > _size)
         size += (index - _size);
 
     if (size > _block) {
-        if (bufferGrow(size))
+        if (bufferGrow(size)) {
+            if (dblob != NULL)
+                _allocator->deallocate(dblob, n);
             return(-1);
+        }
     }
 
     p = (_blob + index);
     if (index > _size) {
         memset(_blob + _size, 0, index - _size);
-        memcpy(p, blob, n);
-    } else if ((uint8_t *)blob >= _blob &&
-               (uint8_t *)blob < (_blob + _block))
-    {
-        uint8_t *dblob;
-
-        if ((dblob = (uint8_t *) malloc(n)) == NULL)
-            return(-1);
-
-        memcpy(dblob, _blob, n);
-        memmove(p + n, p, _size - index);
-        memcpy(p, dblob, n);
-
-        free(dblob);
     } else {
         memmove(p + n, p, _size - index);
-        memcpy(p, blob, n);
     }
+    memcpy(p, blob, n);
 
     _size = size;
 
+    if (dblob != NULL)
+        _allocator->deallocate(dblob, n);
     return(0);
 }
 
@@ -211,15 +275,61 @@ bool Buffer::equals (const void *blob, size_t n) const {
 }
 
 int Buffer::bufferGrow (size_t n) {
+    return(bufferResize(_policy->grow(_block, n)));
+}
+
+int Buffer::bufferResize (size_t n) {
     uint8_t *blob;
-    size_t size;
 
-    size = (n + 0x1ff) & (-512);
-    if ((blob = (uint8_t *) realloc(_blob, size)) == NULL)
+    if (n < _size)
+        n = _size;
+
+    if (n <= BUFFER_INLINE_SIZE) {
+        if (_blob != _inline) {
+            memcpy(_inline, _blob, _size);
+            _allocator->deallocate(_blob, _block);
+            _blob = _inline;
+            _block = BUFFER_INLINE_SIZE;
+        }
+        return(0);
+    }
+
+    if (_blob == _inline) {
+        if ((blob = (uint8_t *) _allocator->allocate(n)) == NULL)
+            return(-1);
+        memcpy(blob, _inline, _size);
+    } else if ((blob = (uint8_t *) _allocator->reallocate(_blob, _block, n)) == NULL) {
         return(-1);
+    }
 
-    _block = size;
+    _block = n;
     _blob = blob;
     return(0);
 }
 
+void Buffer::bufferRelease (void) {
+    if (_blob != _inline)
+        _allocator->deallocate(_blob, _block);
+
+    _blob = _inline;
+    _block = BUFFER_INLINE_SIZE;
+    _size = 0;
+}
+
+/* Takes data and allocator of 'other', which is left empty */
+void Buffer::steal (Buffer& other) {
+    _allocator = other._allocator;
+    if (other._blob == other._inline) {
+        memcpy(_inline, other._inline, other._size);
+        _blob = _inline;
+        _block = BUFFER_INLINE_SIZE;
+    } else {
+        _blob = other._blob;
+        _block = other._block;
+    }
+    _size = other._size;
+
+    other._blob = other._inline;
+    other._block = BUFFER_INLINE_SIZE;
+    other._size = 0;
+}
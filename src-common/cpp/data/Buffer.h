@@ -17,19 +17,87 @@
 #ifndef _BUFFER_H_
 #define _BUFFER_H_
 
+#include <stddef.h>
+
+#include "Allocator.h"
 #include "Seekable.h"
 #include "Readable.h"
 #include "Writable.h"
 
+/* Bytes stored inside the Buffer object, before touching the heap */
+#define BUFFER_INLINE_SIZE          64
+
+class BufferGrowPolicy {
+    public:
+        virtual ~BufferGrowPolicy() {}
+
+        /* Returns the new capacity able to hold at least 'required' bytes */
+        virtual size_t grow (size_t capacity, size_t required) const = 0;
+
+        static const BufferGrowPolicy *linear (void);
+        static const BufferGrowPolicy *geometric (void);
+};
+
+/* Round up to the next 'step' bytes (step must be a power of two) */
+class BufferLinearGrow : public BufferGrowPolicy {
+    public:
+        BufferLinearGrow(size_t step=512) : _step(step) {}
+
+        size_t grow (size_t capacity, size_t required) const {
+            return((required + (_step - 1)) & ~(_step - 1));
+        }
+
+    private:
+        size_t _step;
+};
+
+/* Grow by num/den of the current capacity, amortized O(1) append */
+class BufferGeometricGrow : public BufferGrowPolicy {
+    public:
+        BufferGeometricGrow(unsigned int num=2, unsigned int den=1)
+            : _num(num), _den(den) {}
+
+        size_t grow (size_t capacity, size_t required) const {
+            size_t size = (capacity / _den) * _num;
+            if (size < required)
+                size = required;
+            return((size + 0xf) & ~((size_t)0xf));
+        }
+
+    private:
+        unsigned int _num;
+        unsigned int _den;
+};
+
 class Buffer {
     public:
-        Buffer(size_t n=0);
+        Buffer(size_t n=0,
+               const BufferGrowPolicy *policy=NULL,
+               Allocator *allocator=NULL);
+
+        /* Copy construction shares the allocator of 'other', moves/swap carry it */
+        Buffer(const Buffer& other);
         ~Buffer();
 
+        Buffer& operator= (const Buffer& other);
+
+#if __cplusplus >= 201103L
+        Buffer(Buffer&& other);
+        Buffer& operator= (Buffer&& other);
+#endif
+
+        void swap (Buffer& other);
+
         void clear   (void);
 
         int squeeze  (void);
         int reserve  (size_t n);
+
+        /*
+         * Hands the storage over to the caller, to be given back with
+         * allocator()->deallocate(blob, capacity). The buffer is left empty.
+         */
+        uint8_t *release (size_t *capacity);
         int truncate (size_t n);
 
         int set      (const void *blob, size_t n);
@@ -40,7 +108,17 @@ class Buffer {
         int remove   (size_t index, size_t size);
 
         bool isEmpty (void) const { return(_size == 0); }
+        bool isInline (void) const { return(_blob == _inline); }
         size_t size  (void) const { return(_size); }
+        size_t capacity (void) const { return(_block); }
+
+        const uint8_t *data (void) const { return(_blob); }
+        uint8_t *data (void) { return(_blob); }
+
+        const BufferGrowPolicy *growPolicy (void) const { return(_policy); }
+        void setGrowPolicy (const BufferGrowPolicy *policy);
+
+        Allocator *allocator (void) const { return(_allocator); }
 
         int compare (const Buffer& other) const {
             return(compare(other._blob, other._size));
@@ -68,11 +146,19 @@ class Buffer {
 
     protected:
         int bufferGrow (size_t n);
+        int bufferResize (size_t n);
+
+    private:
+        void bufferRelease (void);
+        void steal (Buffer& other);
 
     private:
+        const BufferGrowPolicy *_policy;
+        Allocator *_allocator;
         uint8_t *_blob;
         size_t   _block;
         size_t   _size;
+        uint8_t  _inline[BUFFER_INLINE_SIZE];
 };
 
 inline bool operator==(const Buffer& x, const Buffer& y) {
@@ -14,11 +14,33 @@
  *   limitations under the License.
  */
 
+#include <string.h>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#elif defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
 #include "ByteSlice.h"
 #include "Writable.h"
 
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    #define __load_be64(x)          (x)
+#else
+    #define __load_be64(x)          __builtin_bswap64(x)
+#endif
+
+/* ============================================================================
+ *  Byte Slice
+ */
 int ByteSlice::write (Writable *writable) const {
+    struct iovec iov[BYTE_SLICE_MAX_SEGMENTS];
     size_t len = length();
+    size_t count;
+
+    if ((count = segments(iov, BYTE_SLICE_MAX_SEGMENTS)) > 0)
+        return((writable->writev(iov, count) == (int)len) ? 0 : -1);
 
     size_t index = 0;
     for (; len >= 8; len -= 8) {
@@ -39,29 +61,49 @@ int ByteSlice::write (Writable *writable) const {
     return(0);
 }
 
+size_t ByteSlice::segments (struct iovec *iov, size_t count) const {
+    const uint8_t *blob;
+
+    if (count == 0 || (blob = data()) == NULL)
+        return(0);
+
+    iov[0].iov_base = (void *)blob;
+    iov[0].iov_len = length();
+    return(1);
+}
+
 int ByteSlice::compare (const ByteSlice *other) const {
+    const uint8_t *a = data();
+    const uint8_t *b = other->data();
     size_t a_len = length();
     size_t b_len = other->length();
     size_t min_len = (a_len < b_len) ? a_len : b_len;
     size_t index = 0;
     int cmp;
 
-    for (; min_len >= 8; min_len -= 8) {
-        uint64_t u1 = other->fetch64(index);
-        uint64_t u2 = fetch64(index);
-
-        if (u1 != u2) {
-            const char *m1 = (const char *)&u1;
-            const char *m2 = (const char *)&u2;
-            if (m1[0] != m2[0]) return(m1[0] - m2[0]);
-            if (m1[1] != m2[1]) return(m1[1] - m2[1]);
-            if (m1[2] != m2[2]) return(m1[2] - m2[2]);
-            if (m1[3] != m2[3]) return(m1[3] - m2[3]);
-            if (m1[4] != m2[4]) return(m1[4] - m2[4]);
-            if (m1[5] != m2[5]) return(m1[5] - m2[5]);
-            if (m1[6] != m2[6]) return(m1[6] - m2[6]);
-            if (m1[7] != m2[7]) return(m1[7] - m2[7]);
+    if (a != NULL && b != NULL)
+        return(byteSliceCompare(a, a_len, b, b_len));
+
+    /* Multi-part slices (prefix + data...) */
+    if (a == NULL || b == NULL) {
+        struct iovec av[BYTE_SLICE_MAX_SEGMENTS];
+        struct iovec bv[BYTE_SLICE_MAX_SEGMENTS];
+        size_t na, nb;
+
+        if ((na = segments(av, BYTE_SLICE_MAX_SEGMENTS)) > 0 &&
+            (nb = other->segments(bv, BYTE_SLICE_MAX_SEGMENTS)) > 0)
+        {
+            return(byteSliceCompareSegments(av, na, bv, nb, 0));
         }
+    }
+
+    /* Words compared as big-endian numbers give the lexicographic order */
+    for (; min_len >= 8; min_len -= 8) {
+        uint64_t u1 = __load_be64(fetch64(index));
+        uint64_t u2 = __load_be64(other->fetch64(index));
+
+        if (u1 != u2)
+            return((u1 < u2) ? -1 : 1);
 
         index++;
     }
@@ -77,3 +119,148 @@ int ByteSlice::compare (const ByteSlice *other) const {
     return((a_len < b_len) ? -1 : (a_len > b_len) ? 1 : 0);
 }
 
+int ByteSlice::compareFrom (const ByteSlice *other, size_t shared) const {
+    struct iovec av[BYTE_SLICE_MAX_SEGMENTS];
+    struct iovec bv[BYTE_SLICE_MAX_SEGMENTS];
+    size_t a_len = length();
+    size_t b_len = other->length();
+    size_t na, nb;
+    int cmp;
+
+    if ((na = segments(av, BYTE_SLICE_MAX_SEGMENTS)) > 0 &&
+        (nb = other->segments(bv, BYTE_SLICE_MAX_SEGMENTS)) > 0)
+    {
+        return(byteSliceCompareSegments(av, na, bv, nb, shared));
+    }
+
+    for (; shared < a_len && shared < b_len; ++shared) {
+        if ((cmp = fetch8(shared) - other->fetch8(shared)) != 0)
+            return(cmp);
+    }
+
+    return((a_len < b_len) ? -1 : (a_len > b_len) ? 1 : 0);
+}
+
+bool ByteSlice::equal (const ByteSlice *other) const {
+    const uint8_t *a, *b;
+
+    if (length() != other->length())
+        return(false);
+
+    if (length() == 0)
+        return(true);
+
+    if ((a = data()) != NULL && (b = other->data()) != NULL)
+        return(!memcmp(a, b, length()));
+
+    return(!compare(other));
+}
+
+/* ============================================================================
+ *  Contiguous memory compare
+ */
+size_t byteSliceMismatch (const uint8_t *a, const uint8_t *b, size_t n) {
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    for (; (i + 32) <= n; i += 32) {
+        __m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));
+        uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb));
+        if (mask != 0xffffffff)
+            return(i + __builtin_ctz(~mask));
+    }
+#endif
+
+#if defined(__SSE2__)
+    for (; (i + 16) <= n; i += 16) {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+        uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(va, vb));
+        if (mask != 0xffff)
+            return(i + __builtin_ctz(~mask));
+    }
+#endif
+
+    for (; (i + 8) <= n; i += 8) {
+        uint64_t wa, wb;
+
+        memcpy(&wa, a + i, 8);
+        memcpy(&wb, b + i, 8);
+        if (wa != wb)
+            return(i + (__builtin_clzll(__load_be64(wa) ^ __load_be64(wb)) >> 3));
+    }
+
+    for (; i < n; ++i) {
+        if (a[i] != b[i])
+            return(i);
+    }
+
+    return(n);
+}
+
+int byteSliceCompare (const uint8_t *a, size_t alength,
+                      const uint8_t *b, size_t blength)
+{
+    size_t min_len = (alength < blength) ? alength : blength;
+    size_t index;
+
+    if ((index = byteSliceMismatch(a, b, min_len)) < min_len)
+        return(a[index] - b[index]);
+
+    return((alength < blength) ? -1 : (alength > blength) ? 1 : 0);
+}
+
+bool byteSliceEqual (const uint8_t *a, size_t alength,
+                     const uint8_t *b, size_t blength)
+{
+    return(alength == blength && byteSliceMismatch(a, b, alength) == alength);
+}
+
+int byteSliceCompareSegments (const struct iovec *a, size_t acount,
+                              const struct iovec *b, size_t bcount,
+                              size_t shared)
+{
+    const uint8_t *pa = NULL, *pb = NULL;
+    size_t la = 0, lb = 0;
+    size_t n, index;
+
+    /* Skip the bytes known to be equal */
+    for (n = shared; acount > 0 && n >= a->iov_len; --acount, ++a)
+        n -= a->iov_len;
+    if (acount > 0) {
+        pa = (const uint8_t *)a->iov_base + n;
+        la = a->iov_len - n;
+    }
+
+    for (n = shared; bcount > 0 && n >= b->iov_len; --bcount, ++b)
+        n -= b->iov_len;
+    if (bcount > 0) {
+        pb = (const uint8_t *)b->iov_base + n;
+        lb = b->iov_len - n;
+    }
+
+    while (acount > 0 && bcount > 0) {
+        n = (la < lb) ? la : lb;
+        if ((index = byteSliceMismatch(pa, pb, n)) < n)
+            return(pa[index] - pb[index]);
+
+        pa += n; la -= n;
+        pb += n; lb -= n;
+
+        /* Next segment, empty ones are skipped */
+        while (la == 0 && --acount > 0) {
+            ++a;
+            pa = (const uint8_t *)a->iov_base;
+            la = a->iov_len;
+        }
+
+        while (lb == 0 && --bcount > 0) {
+            ++b;
+            pb = (const uint8_t *)b->iov_base;
+            lb = b->iov_len;
+        }
+    }
+
+    return((acount == bcount) ? 0 : (acount > 0) ? 1 : -1);
+}
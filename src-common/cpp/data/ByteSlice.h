@@ -17,15 +17,28 @@
 #ifndef _BYTE_SLICE_H_
 #define _BYTE_SLICE_H_
 
+#include <sys/uio.h>
 #include <stdint.h>
 #include <stddef.h>
 
+/* Max segments looked at by the segmented compare/write fast paths */
+#define BYTE_SLICE_MAX_SEGMENTS     16
+
 class Writable;
 
 class ByteSlice {
     public:
         virtual size_t length (void) const = 0;
 
+        /* Contiguous slices return their memory, enables the fast paths */
+        virtual const uint8_t *data (void) const { return(NULL); }
+
+        /*
+         * Fill 'iov' with the contiguous pieces of the slice and return
+         * their number, 0 if the slice has no memory or more than 'count'.
+         */
+        virtual size_t segments (struct iovec *iov, size_t count) const;
+
         virtual int write (Writable *writable) const;
 
         virtual uint8_t  fetch8  (size_t index) const = 0;
@@ -34,14 +47,59 @@ class ByteSlice {
         virtual uint64_t fetch64 (size_t index) const;
 
         virtual int compare (const ByteSlice *other) const;
+        virtual bool equal  (const ByteSlice *other) const;
 
         uint8_t operator[] (size_t index) const { return(fetch8(index)); }
 
         bool isEmpty (void) const { return(!length()); };
 
         int  compare (const ByteSlice& other) const { return(compare(&other)); }
-        bool equal   (const ByteSlice& other) const { return(!compare(other)); }
-        bool equal   (const ByteSlice *other) const { return(!compare(other)); }
+        bool equal   (const ByteSlice& other) const { return(equal(&other)); }
+
+        /* Compare knowing that the first 'shared' bytes are equal */
+        int compareFrom (const ByteSlice *other, size_t shared) const;
+};
+
+/*
+ * Lexicographic compare of two memory blocks (unsigned bytes, the
+ * shorter is smaller on a common prefix). Only the sign is meaningful.
+ */
+int byteSliceCompare (const uint8_t *a, size_t alength,
+                      const uint8_t *b, size_t blength);
+
+bool byteSliceEqual (const uint8_t *a, size_t alength,
+                     const uint8_t *b, size_t blength);
+
+/* Index of the first different byte, 'n' if equal */
+size_t byteSliceMismatch (const uint8_t *a, const uint8_t *b, size_t n);
+
+/* Same as byteSliceCompare() on segmented data, skipping 'shared' bytes */
+int byteSliceCompareSegments (const struct iovec *a, size_t acount,
+                              const struct iovec *b, size_t bcount,
+                              size_t shared);
+
+/*
+ * Non-virtual compare for contiguous slice types (BlobSlice,
+ * SharedSlice...): the qualified calls are resolved at compile time,
+ * so hot sorted-key loops do not go through the vtable.
+ */
+template <class TSliceA, class TSliceB>
+inline int sliceCompare (const TSliceA& a, const TSliceB& b) {
+    return(byteSliceCompare(a.TSliceA::data(), a.TSliceA::length(),
+                            b.TSliceB::data(), b.TSliceB::length()));
+}
+
+template <class TSliceA, class TSliceB>
+inline bool sliceEqual (const TSliceA& a, const TSliceB& b) {
+    return(byteSliceEqual(a.TSliceA::data(), a.TSliceA::length(),
+                          b.TSliceB::data(), b.TSliceB::length()));
+}
+
+template <class TSlice>
+struct SliceLess {
+    bool operator() (const TSlice& a, const TSlice& b) const {
+        return(sliceCompare(a, b) < 0);
+    }
 };
 
 inline bool operator==(const ByteSlice& a, const ByteSlice& b) {
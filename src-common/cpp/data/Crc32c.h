@@ -0,0 +1,26 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef _CRC32C_H_
+#define _CRC32C_H_
+
+/*
+ * CRC-32C (Castagnoli): crc32c(crc, data, length) is the C library one,
+ * chain calls passing the previous result as 'crc'.
+ */
+#include "crc32c.h"
+
+#endif /* !_CRC32C_H_ */
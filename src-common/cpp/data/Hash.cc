@@ -0,0 +1,56 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "Hash.h"
+
+#define HASH_READ_SIZE              4096
+
+/* ============================================================================
+ *  Streaming
+ */
+void Hasher::update (const ByteSlice& slice) {
+    struct iovec iov[BYTE_SLICE_MAX_SEGMENTS];
+    uint8_t buffer[256];
+    size_t i, n, count;
+    size_t length;
+
+    if ((count = slice.segments(iov, BYTE_SLICE_MAX_SEGMENTS)) > 0) {
+        for (i = 0; i < count; ++i)
+            update(iov[i].iov_base, iov[i].iov_len);
+        return;
+    }
+
+    length = slice.length();
+    for (i = 0; i < length; i += n) {
+        n = ((length - i) < sizeof(buffer)) ? (length - i) : sizeof(buffer);
+        for (size_t k = 0; k < n; ++k)
+            buffer[k] = slice.fetch8(i + k);
+        update(buffer, n);
+    }
+}
+
+int64_t Hasher::update (Readable *readable) {
+    uint8_t buffer[HASH_READ_SIZE];
+    int64_t total = 0;
+    int rd;
+
+    while ((rd = readable->read(buffer, sizeof(buffer))) > 0) {
+        update(buffer, rd);
+        total += rd;
+    }
+
+    return((rd < 0) ? -1 : total);
+}
@@ -0,0 +1,96 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef _HASH_H_
+#define _HASH_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "ByteSlice.h"
+#include "Readable.h"
+#include "Buffer.h"
+#include "hash.h"
+
+/*
+ * 64/128-bit non-cryptographic hash (wyhash-style 64x64->128 multiply
+ * mixing, 48-byte stripes). The output depends only on the bytes and
+ * the seed: it is the same on every platform and is kept stable, so it
+ * can be persisted. The implementation is the C library one (hash.h),
+ * these are the C++ overloads and the streaming Hasher around it.
+ */
+typedef hash128_t Hash128;
+
+/* Same function as the C hash64(), with the default seed */
+uint64_t hash64  (const void *data, size_t length, uint64_t seed=HASH_DEFAULT_SEED);
+
+inline Hash128 hash128 (const void *data, size_t length, uint64_t seed=HASH_DEFAULT_SEED) {
+    Hash128 hash;
+    hash128(&hash, data, length, seed);
+    return(hash);
+}
+
+inline uint64_t hash64 (const ByteSlice& slice, uint64_t seed=HASH_DEFAULT_SEED);
+
+/* hashes[i] = hash64(keys[i], lengths[i]), interleaved for short keys */
+inline void hash64Many (const void * const *keys,
+                        const size_t *lengths,
+                        size_t count,
+                        uint64_t *hashes,
+                        uint64_t seed=HASH_DEFAULT_SEED)
+{
+    hash64_many(keys, lengths, count, hashes, seed);
+}
+
+/* Streaming hash, same result as the one-shot functions on the concatenation */
+class Hasher {
+    public:
+        Hasher(uint64_t seed=HASH_DEFAULT_SEED) { hash_init(&_state, seed); }
+
+        void reset (uint64_t seed=HASH_DEFAULT_SEED) { hash_init(&_state, seed); }
+
+        void update (const void *data, size_t length) { hash_update(&_state, data, length); }
+        void update (const ByteSlice& slice);
+        void update (const Buffer& buffer) { update(buffer.data(), buffer.size()); }
+
+        /* Consume the readable until EOF, returns the bytes read or -1 */
+        int64_t update (Readable *readable);
+
+        uint64_t length (void) const { return(_state.length); }
+
+        uint64_t digest64  (void) const { return(hash_digest64(&_state)); }
+        Hash128  digest128 (void) const {
+            Hash128 hash;
+            hash_digest128(&_state, &hash);
+            return(hash);
+        }
+
+    private:
+        hash_state_t _state;
+};
+
+inline uint64_t hash64 (const ByteSlice& slice, uint64_t seed) {
+    const uint8_t *data;
+
+    if ((data = slice.data()) != NULL)
+        return(hash64(data, slice.length(), seed));
+
+    Hasher hasher(seed);
+    hasher.update(slice);
+    return(hasher.digest64());
+}
+
+#endif /* !_HASH_H_ */
@@ -0,0 +1,86 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "MultiSlice.h"
+
+int MultiSlice::add (const void *blob, size_t length) {
+    if (_count == MULTI_SLICE_MAX_PARTS)
+        return(-1);
+
+    _parts[_count].iov_base = (void *)blob;
+    _parts[_count].iov_len = length;
+    _length += length;
+    _count++;
+    return(0);
+}
+
+int MultiSlice::add (const ByteSlice *slice) {
+    struct iovec iov[MULTI_SLICE_MAX_PARTS];
+    size_t i, count;
+
+    count = slice->segments(iov, MULTI_SLICE_MAX_PARTS - _count);
+    if (count == 0 && slice->length() > 0)
+        return(-1);
+
+    for (i = 0; i < count; ++i)
+        add(iov[i].iov_base, iov[i].iov_len);
+
+    return(0);
+}
+
+size_t MultiSlice::segments (struct iovec *iov, size_t count) const {
+    size_t i;
+
+    if (_count > count)
+        return(0);
+
+    for (i = 0; i < _count; ++i)
+        iov[i] = _parts[i];
+
+    return(_count);
+}
+
+uint8_t MultiSlice::fetch8 (size_t index) const {
+    const struct iovec *part = _parts;
+
+    while (index >= part->iov_len) {
+        index -= part->iov_len;
+        part++;
+    }
+
+    return(((const uint8_t *)part->iov_base)[index]);
+}
+
+int MultiSlice::compare (const ByteSlice *other) const {
+    struct iovec iov[BYTE_SLICE_MAX_SEGMENTS];
+    size_t i, count, shared;
+
+    if ((count = other->segments(iov, BYTE_SLICE_MAX_SEGMENTS)) == 0)
+        return(ByteSlice::compare(other));
+
+    /* Leading parts that are the same memory are equal, skip them */
+    shared = 0;
+    for (i = 0; i < count && i < _count; ++i) {
+        if (iov[i].iov_base != _parts[i].iov_base ||
+            iov[i].iov_len != _parts[i].iov_len)
+        {
+            break;
+        }
+        shared += _parts[i].iov_len;
+    }
+
+    return(byteSliceCompareSegments(_parts, _count, iov, count, shared));
+}
@@ -0,0 +1,80 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef _MULTI_SLICE_H_
+#define _MULTI_SLICE_H_
+
+#include "ByteSlice.h"
+
+#define MULTI_SLICE_MAX_PARTS       8
+
+/*
+ * Concatenation of up to MULTI_SLICE_MAX_PARTS memory blocks, seen as
+ * a single slice without copying them. Compare and write work on the
+ * parts directly (segmented compare, vectored write).
+ */
+class MultiSlice : public ByteSlice {
+    public:
+        MultiSlice() {
+            _count = 0;
+            _length = 0;
+        }
+
+        MultiSlice(const void *a, size_t alength,
+                   const void *b, size_t blength)
+        {
+            _count = 0;
+            _length = 0;
+            add(a, alength);
+            add(b, blength);
+        }
+
+        /* Appends a part, returns -1 if there are already too many */
+        int add (const void *blob, size_t length);
+        int add (const ByteSlice *slice);
+
+        void clear (void) {
+            _count = 0;
+            _length = 0;
+        }
+
+        size_t parts (void) const { return(_count); }
+        const uint8_t *part (size_t index) const {
+            return((const uint8_t *)_parts[index].iov_base);
+        }
+        size_t partLength (size_t index) const {
+            return(_parts[index].iov_len);
+        }
+
+        size_t length (void) const { return(_length); }
+        const uint8_t *data (void) const {
+            return((_count == 1) ? part(0) : NULL);
+        }
+
+        size_t segments (struct iovec *iov, size_t count) const;
+
+        uint8_t fetch8 (size_t index) const;
+
+        using ByteSlice::compare;
+        int compare (const ByteSlice *other) const;
+
+    protected:
+        struct iovec _parts[MULTI_SLICE_MAX_PARTS];
+        size_t       _count;
+        size_t       _length;
+};
+
+#endif /* !_MULTI_SLICE_H_ */
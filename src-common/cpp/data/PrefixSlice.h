@@ -0,0 +1,79 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef _PREFIX_SLICE_H_
+#define _PREFIX_SLICE_H_
+
+#include "MultiSlice.h"
+
+/*
+ * Prefix + data pair (e.g. a prefix-compressed key: the prefix shared
+ * with the previous key and the stored suffix), never concatenated.
+ */
+class PrefixSlice : public MultiSlice {
+    public:
+        PrefixSlice() {
+            set(NULL, 0, NULL, 0);
+        }
+
+        PrefixSlice(const void *prefix, size_t prefix_length,
+                    const void *data, size_t data_length)
+        {
+            set(prefix, prefix_length, data, data_length);
+        }
+
+        void set (const void *prefix, size_t prefix_length,
+                  const void *data, size_t data_length)
+        {
+            /* Always two parts, even if empty */
+            _parts[0].iov_base = (void *)prefix;
+            _parts[0].iov_len = prefix_length;
+            _parts[1].iov_base = (void *)data;
+            _parts[1].iov_len = data_length;
+            _length = prefix_length + data_length;
+            _count = 2;
+        }
+
+        const uint8_t *data (void) const {
+            if (partLength(0) == 0)
+                return(part(1));
+            return((partLength(1) == 0) ? part(0) : NULL);
+        }
+
+        const uint8_t *prefix (void) const { return(part(0)); }
+        size_t prefixLength (void) const { return(partLength(0)); }
+
+        const uint8_t *suffix (void) const { return(part(1)); }
+        size_t suffixLength (void) const { return(partLength(1)); }
+};
+
+/*
+ * Compare two prefix-compressed keys. Keys of the same block point at
+ * the same prefix memory: their first min(prefix lengths) bytes are
+ * equal by construction and are not looked at.
+ */
+inline int prefixSliceCompare (const PrefixSlice& a, const PrefixSlice& b) {
+    size_t shared = 0;
+
+    if (a.prefix() == b.prefix()) {
+        shared = (a.prefixLength() < b.prefixLength()) ?
+                    a.prefixLength() : b.prefixLength();
+    }
+
+    return(a.compareFrom(&b, shared));
+}
+
+#endif /* !_PREFIX_SLICE_H_ */
@@ -0,0 +1,459 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "RopeBuffer.h"
+
+#define ROPE_WRITEV_BATCH           64
+
+RopeBuffer::RopeBuffer(size_t chunk_size, Allocator *allocator) {
+    _allocator = (allocator != NULL) ? allocator : Allocator::heap();
+    _head = NULL;
+    _tail = NULL;
+    _chunk_size = chunk_size;
+    _nchunks = 0;
+    _size = 0;
+}
+
+RopeBuffer::~RopeBuffer() {
+    clear();
+}
+
+void RopeBuffer::clear (void) {
+    Chunk *chunk = _head;
+
+    while (chunk != NULL) {
+        Chunk *next = chunk->next;
+        chunkFree(chunk);
+        chunk = next;
+    }
+
+    _head = NULL;
+    _tail = NULL;
+    _nchunks = 0;
+    _size = 0;
+}
+
+int RopeBuffer::append (const void *blob, size_t n) {
+    if (n == 0)
+        return(0);
+    return(fillAfter(_tail, (const uint8_t *)blob, n));
+}
+
+int RopeBuffer::prepend (const void *blob, size_t n) {
+    const uint8_t *pblob = (const uint8_t *)blob;
+    size_t room;
+    Chunk *chunk;
+
+    if (n == 0)
+        return(0);
+
+    /* Free space in front of the head chunk is filled backward */
+    room = (_head != NULL) ? _head->offset : 0;
+    if (n > room) {
+        size_t need = n - room;
+        size_t capacity = (need > _chunk_size) ? need : _chunk_size;
+
+        if ((chunk = chunkAlloc(capacity)) == NULL)
+            return(-1);
+
+        chunk->offset = capacity - need;
+        chunk->length = need;
+        memcpy(chunkData(chunk) + chunk->offset, pblob, need);
+        pblob += need;
+
+        if (room > 0) {
+            memcpy(chunkData(_head), pblob, room);
+            _head->offset = 0;
+            _head->length += room;
+        }
+
+        chunkLink(NULL, chunk);
+    } else {
+        _head->offset -= n;
+        _head->length += n;
+        memcpy(chunkData(_head) + _head->offset, pblob, n);
+    }
+
+    _size += n;
+    return(0);
+}
+
+int RopeBuffer::insert (size_t index, const void *blob, size_t n) {
+    size_t offset, head, capacity;
+    Chunk *chunk, *nchunk;
+
+    if (index > _size) {
+        static const uint8_t zeros[256] = {0};
+        size_t pad = index - _size;
+
+        while (pad > 0) {
+            size_t len = (pad < sizeof(zeros)) ? pad : sizeof(zeros);
+            if (append(zeros, len))
+                return(-1);
+            pad -= len;
+        }
+    }
+
+    if (index == _size)
+        return(append(blob, n));
+
+    if (index == 0)
+        return(prepend(blob, n));
+
+    if (n == 0)
+        return(0);
+
+    /* Chunk holding the byte just before the insert position */
+    chunk = chunkLocate(index - 1, &offset);
+    head = offset + 1;
+    if (head == chunk->length)
+        return(fillAfter(chunk, (const uint8_t *)blob, n));
+
+    /*
+     * Insert in the middle of a chunk: the head of the chunk and the new
+     * data go in a new chunk linked before it. Only fresh memory is
+     * written, so 'blob' may point inside this rope.
+     */
+    capacity = head + n;
+    if (capacity < _chunk_size)
+        capacity = _chunk_size;
+
+    if ((nchunk = chunkAlloc(capacity)) == NULL)
+        return(-1);
+
+    memcpy(chunkData(nchunk), chunkData(chunk) + chunk->offset, head);
+    memcpy(chunkData(nchunk) + head, blob, n);
+    nchunk->length = head + n;
+
+    chunk->offset += head;
+    chunk->length -= head;
+    chunkLink(chunk->prev, nchunk);
+
+    _size += n;
+    return(0);
+}
+
+int RopeBuffer::replace (size_t index, size_t size, const void *blob, size_t n) {
+    size_t offset;
+    Chunk *chunk;
+
+    if (index >= _size)
+        return(insert(index, blob, n));
+
+    if ((index + size) > _size)
+        size = _size - index;
+
+    /* Same size, within a single chunk: overwrite in place */
+    if (size == n && n > 0) {
+        chunk = chunkLocate(index, &offset);
+        if ((offset + n) <= chunk->length) {
+            memmove(chunkData(chunk) + chunk->offset + offset, blob, n);
+            return(0);
+        }
+    }
+
+    /* Insert first, the remove could clobber 'blob' if it is ours */
+    if (insert(index + size, blob, n))
+        return(-3);
+
+    if (size > 0)
+        remove(index, size);
+
+    return(0);
+}
+
+int RopeBuffer::remove (size_t index, size_t size) {
+    size_t offset;
+    Chunk *chunk;
+
+    if (index >= _size || size == 0)
+        return(-1);
+
+    if ((index + size) > _size)
+        size = _size - index;
+
+    chunk = chunkLocate(index, &offset);
+    _size -= size;
+
+    while (size > 0) {
+        Chunk *next = chunk->next;
+        size_t avail = chunk->length - offset;
+        size_t len = (size < avail) ? size : avail;
+
+        if (len == chunk->length) {
+            chunkUnlink(chunk);
+            chunkFree(chunk);
+        } else if (offset == 0) {
+            chunk->offset += len;
+            chunk->length -= len;
+        } else if ((offset + len) == chunk->length) {
+            chunk->length -= len;
+        } else {
+            /* Hole in the middle, bounded by the chunk size */
+            uint8_t *p = chunkData(chunk) + chunk->offset + offset;
+            memmove(p, p + len, chunk->length - offset - len);
+            chunk->length -= len;
+        }
+
+        size -= len;
+        offset = 0;
+        chunk = next;
+    }
+
+    return(0);
+}
+
+int RopeBuffer::truncate (size_t n) {
+    if (n >= _size)
+        return(-1);
+
+    return(remove(n, _size - n));
+}
+
+int RopeBuffer::append (RopeBuffer *other) {
+    Chunk *chunk;
+
+    if (other == this || other->_head == NULL)
+        return(0);
+
+    /* Chunks can only change owner if they come from the same allocator */
+    if (other->_allocator != _allocator) {
+        for (chunk = other->_head; chunk != NULL; chunk = chunk->next) {
+            if (append(chunkData(chunk) + chunk->offset, chunk->length))
+                return(-1);
+        }
+        other->clear();
+        return(0);
+    }
+
+    other->_head->prev = _tail;
+    if (_tail != NULL)
+        _tail->next = other->_head;
+    else
+        _head = other->_head;
+    _tail = other->_tail;
+
+    _nchunks += other->_nchunks;
+    _size += other->_size;
+
+    other->_head = NULL;
+    other->_tail = NULL;
+    other->_nchunks = 0;
+    other->_size = 0;
+    return(0);
+}
+
+uint8_t RopeBuffer::at (size_t index) const {
+    size_t offset;
+    Chunk *chunk;
+
+    chunk = chunkLocate(index, &offset);
+    return(chunkData(chunk)[chunk->offset + offset]);
+}
+
+size_t RopeBuffer::copy (size_t index, void *buffer, size_t n) const {
+    uint8_t *pbuf = (uint8_t *)buffer;
+    size_t offset, copied = 0;
+    Chunk *chunk;
+
+    if (index >= _size)
+        return(0);
+
+    chunk = chunkLocate(index, &offset);
+    while (chunk != NULL && n > 0) {
+        size_t avail = chunk->length - offset;
+        size_t len = (n < avail) ? n : avail;
+
+        memcpy(pbuf, chunkData(chunk) + chunk->offset + offset, len);
+        pbuf += len;
+        copied += len;
+        n -= len;
+
+        offset = 0;
+        chunk = chunk->next;
+    }
+
+    return(copied);
+}
+
+int RopeBuffer::gather (struct iovec *iov, int count) const {
+    Chunk *chunk;
+    int n = 0;
+
+    for (chunk = _head; chunk != NULL && n < count; chunk = chunk->next) {
+        iov[n].iov_base = chunkData(chunk) + chunk->offset;
+        iov[n].iov_len = chunk->length;
+        n++;
+    }
+
+    return(n);
+}
+
+int RopeBuffer::writeTo (Writable *writable) const {
+    struct iovec iov[ROPE_WRITEV_BATCH];
+    size_t batch_size;
+    Chunk *chunk;
+    int count, wr;
+    int n = 0;
+
+    chunk = _head;
+    while (chunk != NULL) {
+        count = 0;
+        batch_size = 0;
+        while (chunk != NULL && count < ROPE_WRITEV_BATCH) {
+            iov[count].iov_base = chunkData(chunk) + chunk->offset;
+            iov[count].iov_len = chunk->length;
+            batch_size += chunk->length;
+            chunk = chunk->next;
+            count++;
+        }
+
+        wr = writable->writev(iov, count);
+        if (wr > 0)
+            n += wr;
+
+        if (wr != (int)batch_size)
+            return((n > 0) ? n : -1);
+    }
+
+    return(n);
+}
+
+int RopeBuffer::read (void *buffer, unsigned int size) {
+    size_t rd;
+
+    if ((rd = copy(0, buffer, size)) > 0)
+        remove(0, rd);
+
+    return(rd);
+}
+
+int RopeBuffer::write (const void *buffer, unsigned int size) {
+    if (append(buffer, size))
+        return(-1);
+    return(size);
+}
+
+/* ============================================================================
+ *  Chunks
+ */
+RopeBuffer::Chunk *RopeBuffer::chunkAlloc (size_t capacity) {
+    Chunk *chunk;
+
+    if ((chunk = (Chunk *)_allocator->allocate(sizeof(Chunk) + capacity)) == NULL)
+        return(NULL);
+
+    chunk->next = NULL;
+    chunk->prev = NULL;
+    chunk->capacity = capacity;
+    chunk->offset = 0;
+    chunk->length = 0;
+    return(chunk);
+}
+
+void RopeBuffer::chunkFree (Chunk *chunk) {
+    _allocator->deallocate(chunk, sizeof(Chunk) + chunk->capacity);
+}
+
+/* Link 'chunk' after 'prev', at the head if 'prev' is NULL */
+void RopeBuffer::chunkLink (Chunk *prev, Chunk *chunk) {
+    chunk->prev = prev;
+    if (prev != NULL) {
+        chunk->next = prev->next;
+        prev->next = chunk;
+    } else {
+        chunk->next = _head;
+        _head = chunk;
+    }
+
+    if (chunk->next != NULL)
+        chunk->next->prev = chunk;
+    else
+        _tail = chunk;
+
+    _nchunks++;
+}
+
+void RopeBuffer::chunkUnlink (Chunk *chunk) {
+    if (chunk->prev != NULL)
+        chunk->prev->next = chunk->next;
+    else
+        _head = chunk->next;
+
+    if (chunk->next != NULL)
+        chunk->next->prev = chunk->prev;
+    else
+        _tail = chunk->prev;
+
+    _nchunks--;
+}
+
+/* Chunk holding byte 'index' (< size), walking from the closest end */
+RopeBuffer::Chunk *RopeBuffer::chunkLocate (size_t index, size_t *offset) const {
+    Chunk *chunk;
+    size_t start;
+
+    if (index < (_size >> 1)) {
+        start = 0;
+        for (chunk = _head; (start + chunk->length) <= index; chunk = chunk->next)
+            start += chunk->length;
+    } else {
+        start = _size;
+        for (chunk = _tail; (start - chunk->length) > index; chunk = chunk->prev)
+            start -= chunk->length;
+        start -= chunk->length;
+    }
+
+    *offset = index - start;
+    return(chunk);
+}
+
+/* Copy 'blob' after 'prev' (at the head if NULL), using its free space first */
+int RopeBuffer::fillAfter (Chunk *prev, const uint8_t *blob, size_t n) {
+    Chunk *chunk = NULL;
+    size_t room = 0;
+
+    if (prev != NULL)
+        room = prev->capacity - prev->offset - prev->length;
+
+    /* Allocate before touching anything, so a failure leaves us intact */
+    if (n > room) {
+        size_t need = n - room;
+        if ((chunk = chunkAlloc((need > _chunk_size) ? need : _chunk_size)) == NULL)
+            return(-1);
+    }
+
+    if (room > 0) {
+        size_t len = (n < room) ? n : room;
+        memcpy(chunkData(prev) + prev->offset + prev->length, blob, len);
+        prev->length += len;
+        _size += len;
+        blob += len;
+        n -= len;
+    }
+
+    if (chunk != NULL) {
+        memcpy(chunkData(chunk), blob, n);
+        chunk->length = n;
+        chunkLink(prev, chunk);
+        _size += n;
+    }
+
+    return(0);
+}
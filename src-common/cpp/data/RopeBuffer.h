@@ -0,0 +1,104 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef _ROPE_BUFFER_H_
+#define _ROPE_BUFFER_H_
+
+#include <sys/uio.h>
+#include <stddef.h>
+
+#include "Allocator.h"
+#include "Readable.h"
+#include "Writable.h"
+
+/*
+ * Chunked buffer: data lives in a list of chunks, so append/prepend
+ * never move the existing content, and insert/remove/replace only
+ * touch (split or trim) the chunk at the edit position.
+ * Reading consumes from the front, writing appends.
+ */
+class RopeBuffer : public Readable, public Writable {
+    public:
+        RopeBuffer(size_t chunk_size=4096, Allocator *allocator=NULL);
+        ~RopeBuffer();
+
+        void clear   (void);
+
+        int append   (const void *blob, size_t n);
+        int prepend  (const void *blob, size_t n);
+        int insert   (size_t index, const void *blob, size_t n);
+        int replace  (size_t index, size_t size, const void *blob, size_t n);
+        int remove   (size_t index, size_t size);
+        int truncate (size_t n);
+
+        /* Moves the chunks of 'other' at the end, 'other' is left empty */
+        int append   (RopeBuffer *other);
+
+        bool isEmpty (void) const { return(_size == 0); }
+        size_t size  (void) const { return(_size); }
+        size_t chunks (void) const { return(_nchunks); }
+
+        uint8_t at (size_t index) const;
+        size_t copy (size_t index, void *buffer, size_t n) const;
+
+        /* Fill up to 'count' iovecs from the chunks, returns the used ones */
+        int gather (struct iovec *iov, int count) const;
+
+        /* Vectored write of the whole content, returns the bytes written */
+        int writeTo (Writable *writable) const;
+
+        // Readable
+        int read (void *buffer, unsigned int size);
+
+        // Writable
+        int write (const void *buffer, unsigned int size);
+        int flush (void) { return(0); }
+
+    private:
+        RopeBuffer(const RopeBuffer& other);
+        RopeBuffer& operator= (const RopeBuffer& other);
+
+    private:
+        struct Chunk {
+            struct Chunk *next;
+            struct Chunk *prev;
+            size_t capacity;
+            size_t offset;
+            size_t length;
+        };
+
+        static uint8_t *chunkData (const Chunk *chunk) {
+            return((uint8_t *)(chunk + 1));
+        }
+
+        Chunk *chunkAlloc (size_t capacity);
+        void chunkFree (Chunk *chunk);
+        void chunkLink (Chunk *prev, Chunk *chunk);
+        void chunkUnlink (Chunk *chunk);
+        Chunk *chunkLocate (size_t index, size_t *offset) const;
+
+        int fillAfter (Chunk *prev, const uint8_t *blob, size_t n);
+
+    private:
+        Allocator *_allocator;
+        Chunk *    _head;
+        Chunk *    _tail;
+        size_t     _chunk_size;
+        size_t     _nchunks;
+        size_t     _size;
+};
+
+#endif /* !_ROPE_BUFFER_H_ */
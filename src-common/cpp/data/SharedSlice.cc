@@ -0,0 +1,364 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <sys/uio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "SharedSlice.h"
+#include "Writable.h"
+
+#define SLICE_LIST_WRITEV_BATCH     64
+
+/* ============================================================================
+ *  Shared Buffer
+ */
+SharedBuffer *SharedBuffer::create (const void *blob,
+                                    size_t size,
+                                    Allocator *allocator)
+{
+    SharedBuffer *buffer;
+
+    if (allocator == NULL)
+        allocator = Allocator::heap();
+
+    /* Header and data in a single allocation */
+    buffer = (SharedBuffer *)allocator->allocate(sizeof(SharedBuffer) + size);
+    if (buffer == NULL)
+        return(NULL);
+
+    buffer->_allocator = allocator;
+    buffer->_data = (uint8_t *)(buffer + 1);
+    buffer->_size = size;
+    buffer->_capacity = 0;
+    buffer->_refs = 1;
+    buffer->_shared = 0;
+    memcpy(buffer->_data, blob, size);
+    return(buffer);
+}
+
+SharedBuffer *SharedBuffer::adopt (uint8_t *blob,
+                                   size_t size,
+                                   size_t capacity,
+                                   Allocator *allocator)
+{
+    SharedBuffer *buffer;
+
+    if (allocator == NULL)
+        allocator = Allocator::heap();
+
+    buffer = (SharedBuffer *)allocator->allocate(sizeof(SharedBuffer));
+    if (buffer == NULL)
+        return(NULL);
+
+    buffer->_allocator = allocator;
+    buffer->_data = blob;
+    buffer->_size = size;
+    buffer->_capacity = capacity;
+    buffer->_refs = 1;
+    buffer->_shared = 0;
+    return(buffer);
+}
+
+void SharedBuffer::destroy (void) {
+    if (_capacity > 0) {
+        _allocator->deallocate(_data, _capacity);
+        _allocator->deallocate(this, sizeof(SharedBuffer));
+    } else {
+        _allocator->deallocate(this, sizeof(SharedBuffer) + _size);
+    }
+}
+
+/* ============================================================================
+ *  Shared Slice
+ */
+SharedSlice::SharedSlice(const void *blob, size_t length, Allocator *allocator) {
+    if ((_buffer = SharedBuffer::create(blob, length, allocator)) != NULL) {
+        _data = _buffer->data();
+        _length = length;
+    } else {
+        _data = NULL;
+        _length = 0;
+    }
+}
+
+SharedSlice::SharedSlice(SharedBuffer *buffer, size_t offset, size_t length) {
+    _buffer = buffer;
+    _data = buffer->data() + offset;
+    _length = length;
+    buffer->ref();
+}
+
+SharedSlice& SharedSlice::operator= (const SharedSlice& other) {
+    /* Ref first, 'other' may be a view on the storage we drop */
+    if (other._buffer != NULL)
+        other._buffer->ref();
+    if (_buffer != NULL)
+        _buffer->unref();
+
+    _buffer = other._buffer;
+    _data = other._data;
+    _length = other._length;
+    return(*this);
+}
+
+#if __cplusplus >= 201103L
+SharedSlice& SharedSlice::operator= (SharedSlice&& other) {
+    if (this != &other) {
+        if (_buffer != NULL)
+            _buffer->unref();
+
+        _buffer = other._buffer;
+        _data = other._data;
+        _length = other._length;
+        other._buffer = NULL;
+        other._data = NULL;
+        other._length = 0;
+    }
+    return(*this);
+}
+#endif
+
+SharedSlice SharedSlice::fromBuffer (Buffer *buffer) {
+    SharedSlice slice;
+    SharedBuffer *shared;
+    size_t capacity;
+    size_t size;
+    uint8_t *blob;
+
+    size = buffer->size();
+    if ((blob = buffer->release(&capacity)) == NULL)
+        return(slice);
+
+    shared = SharedBuffer::adopt(blob, size, capacity, buffer->allocator());
+    if (shared == NULL) {
+        buffer->allocator()->deallocate(blob, capacity);
+        return(slice);
+    }
+
+    /* The new slice takes its own reference, drop the creation one */
+    slice = SharedSlice(shared, 0, size);
+    shared->unref();
+    return(slice);
+}
+
+SharedSlice SharedSlice::slice (size_t offset, size_t length) const {
+    if (_buffer == NULL || offset >= _length)
+        return(SharedSlice());
+
+    if (length > (_length - offset))
+        length = _length - offset;
+
+    return(SharedSlice(_buffer, (_data - _buffer->data()) + offset, length));
+}
+
+void SharedSlice::split (size_t index, SharedSlice *head, SharedSlice *tail) const {
+    SharedSlice self(*this);
+
+    if (index > _length)
+        index = _length;
+
+    /* 'head' or 'tail' may be this slice */
+    *head = self.slice(0, index);
+    *tail = self.slice(index);
+}
+
+/* ============================================================================
+ *  Shared Slice List
+ */
+SharedSliceList::SharedSliceList() {
+    _slices = NULL;
+    _offsets = NULL;
+    _capacity = 0;
+    _count = 0;
+    _length = 0;
+}
+
+SharedSliceList::SharedSliceList(const SharedSliceList& other) {
+    _slices = NULL;
+    _offsets = NULL;
+    _capacity = 0;
+    _count = 0;
+    _length = 0;
+    append(other);
+}
+
+SharedSliceList::~SharedSliceList() {
+    delete[] _slices;
+    free(_offsets);
+}
+
+SharedSliceList& SharedSliceList::operator= (const SharedSliceList& other) {
+    if (this != &other) {
+        clear();
+        append(other);
+    }
+    return(*this);
+}
+
+void SharedSliceList::clear (void) {
+    size_t i;
+
+    for (i = 0; i < _count; ++i)
+        _slices[i] = SharedSlice();
+
+    _count = 0;
+    _length = 0;
+}
+
+int SharedSliceList::append (const SharedSlice& slice) {
+    if (slice.length() == 0)
+        return(0);
+
+    /* Contiguous with the last view, just extend it */
+    if (_count > 0) {
+        SharedSlice *last = &(_slices[_count - 1]);
+        if (last->buffer() == slice.buffer() &&
+            (last->data() + last->length()) == slice.data())
+        {
+            const uint8_t *base = last->buffer()->data();
+            *last = SharedSlice((SharedBuffer *)slice.buffer(),
+                                last->data() - base,
+                                last->length() + slice.length());
+            _length += slice.length();
+            return(0);
+        }
+    }
+
+    if (_count == _capacity) {
+        /* 'slice' may live in the array we are going to replace */
+        SharedSlice keep(slice);
+
+        if (reserve((_capacity > 0) ? (_capacity << 1) : 4))
+            return(-1);
+
+        _slices[_count] = keep;
+    } else {
+        _slices[_count] = slice;
+    }
+
+    _offsets[_count] = _length;
+    _length += _slices[_count].length();
+    _count++;
+    return(0);
+}
+
+int SharedSliceList::append (const SharedSliceList& other) {
+    size_t i;
+
+    /* Appending to itself may merge/move the views being read */
+    if (&other == this) {
+        SharedSliceList copy(other);
+        return(append(copy));
+    }
+
+    for (i = 0; i < other._count; ++i) {
+        if (append(other._slices[i]))
+            return(-1);
+    }
+    return(0);
+}
+
+uint8_t SharedSliceList::fetch8 (size_t index) const {
+    size_t lo = 0, hi = _count;
+
+    /* Last segment starting at or before index */
+    while ((hi - lo) > 1) {
+        size_t mid = (lo + hi) >> 1;
+        if (_offsets[mid] <= index)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    return(_slices[lo].fetch8(index - _offsets[lo]));
+}
+
+int SharedSliceList::write (Writable *writable) const {
+    struct iovec iov[SLICE_LIST_WRITEV_BATCH];
+    size_t i, batch_size;
+    int count;
+
+    i = 0;
+    while (i < _count) {
+        count = 0;
+        batch_size = 0;
+        while (i < _count && count < SLICE_LIST_WRITEV_BATCH) {
+            iov[count].iov_base = (void *)_slices[i].data();
+            iov[count].iov_len = _slices[i].length();
+            batch_size += _slices[i].length();
+            count++;
+            i++;
+        }
+
+        if (writable->writev(iov, count) != (int)batch_size)
+            return(-1);
+    }
+
+    return(0);
+}
+
+SharedSlice SharedSliceList::flatten (Allocator *allocator) const {
+    SharedBuffer *buffer;
+    SharedSlice slice;
+    uint8_t *p;
+    size_t i;
+
+    if (_count == 0)
+        return(slice);
+
+    if (_count == 1)
+        return(_slices[0]);
+
+    if (allocator == NULL)
+        allocator = Allocator::heap();
+
+    if ((p = (uint8_t *)allocator->allocate(_length)) == NULL)
+        return(slice);
+
+    if ((buffer = SharedBuffer::adopt(p, _length, _length, allocator)) == NULL) {
+        allocator->deallocate(p, _length);
+        return(slice);
+    }
+
+    for (i = 0; i < _count; ++i) {
+        memcpy(p, _slices[i].data(), _slices[i].length());
+        p += _slices[i].length();
+    }
+
+    slice = SharedSlice(buffer, 0, _length);
+    buffer->unref();
+    return(slice);
+}
+
+int SharedSliceList::reserve (size_t count) {
+    SharedSlice *slices;
+    size_t *offsets;
+    size_t i;
+
+    if ((offsets = (size_t *)realloc(_offsets, count * sizeof(size_t))) == NULL)
+        return(-1);
+    _offsets = offsets;
+
+    slices = new SharedSlice[count];
+    for (i = 0; i < _count; ++i)
+        slices[i] = _slices[i];
+
+    delete[] _slices;
+    _slices = slices;
+    _capacity = count;
+    return(0);
+}
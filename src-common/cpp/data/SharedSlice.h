@@ -0,0 +1,203 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef _SHARED_SLICE_H_
+#define _SHARED_SLICE_H_
+
+#include <string.h>
+
+#include "ByteSlice.h"
+#include "Allocator.h"
+#include "Buffer.h"
+
+/*
+ * Reference counted immutable storage, owned by the SharedSlice views.
+ * The counter is a plain integer until share() is called, after that
+ * every ref/unref is atomic. share() must be called by the owner thread
+ * before handing a view to other threads (SharedSlice::share()).
+ */
+class SharedBuffer {
+    public:
+        static SharedBuffer *create (const void *blob,
+                                     size_t size,
+                                     Allocator *allocator=NULL);
+
+        /* Takes ownership of 'blob' (allocated with 'allocator') */
+        static SharedBuffer *adopt (uint8_t *blob,
+                                    size_t size,
+                                    size_t capacity,
+                                    Allocator *allocator=NULL);
+
+        void ref (void) {
+            if (_shared)
+                __sync_add_and_fetch(&_refs, 1);
+            else
+                _refs++;
+        }
+
+        void unref (void) {
+            if (_shared ? (__sync_sub_and_fetch(&_refs, 1) == 0) : (--_refs == 0))
+                destroy();
+        }
+
+        void share (void) {
+            if (!_shared) {
+                _shared = 1;
+                __sync_synchronize();
+            }
+        }
+
+        bool isShared (void) const { return(_shared != 0); }
+        unsigned int refs (void) const { return(_refs); }
+
+        const uint8_t *data (void) const { return(_data); }
+        size_t size (void) const { return(_size); }
+
+    private:
+        void destroy (void);
+
+    private:
+        Allocator *  _allocator;
+        uint8_t *    _data;
+        size_t       _size;
+        size_t       _capacity;
+        unsigned int _refs;
+        unsigned int _shared;
+};
+
+/*
+ * Zero-copy view on a SharedBuffer, keeps the storage alive.
+ * Slicing and splitting return new views on the same storage.
+ */
+class SharedSlice : public ByteSlice {
+    public:
+        SharedSlice() {
+            _buffer = NULL;
+            _data = NULL;
+            _length = 0;
+        }
+
+        /* Copy 'blob' in a new shared storage */
+        SharedSlice(const void *blob, size_t length, Allocator *allocator=NULL);
+
+        /* New view on 'buffer', takes a reference */
+        SharedSlice(SharedBuffer *buffer, size_t offset, size_t length);
+
+        SharedSlice(const SharedSlice& other) {
+            if ((_buffer = other._buffer) != NULL)
+                _buffer->ref();
+            _data = other._data;
+            _length = other._length;
+        }
+
+        ~SharedSlice() {
+            if (_buffer != NULL)
+                _buffer->unref();
+        }
+
+        SharedSlice& operator= (const SharedSlice& other);
+
+#if __cplusplus >= 201103L
+        SharedSlice(SharedSlice&& other) {
+            _buffer = other._buffer;
+            _data = other._data;
+            _length = other._length;
+            other._buffer = NULL;
+            other._data = NULL;
+            other._length = 0;
+        }
+
+        SharedSlice& operator= (SharedSlice&& other);
+#endif
+
+        /* Takes over the storage of 'buffer' (no copy if on the heap) */
+        static SharedSlice fromBuffer (Buffer *buffer);
+
+        size_t length (void) const { return(_length); }
+        const uint8_t *data (void) const { return(_data); }
+        const SharedBuffer *buffer (void) const { return(_buffer); }
+
+        uint8_t fetch8 (size_t index) const { return(_data[index]); }
+        uint16_t fetch16 (size_t index) const {
+            uint16_t v; memcpy(&v, _data + (index << 1), 2); return(v);
+        }
+        uint32_t fetch32 (size_t index) const {
+            uint32_t v; memcpy(&v, _data + (index << 2), 4); return(v);
+        }
+        uint64_t fetch64 (size_t index) const {
+            uint64_t v; memcpy(&v, _data + (index << 3), 8); return(v);
+        }
+
+        SharedSlice slice (size_t offset, size_t length) const;
+        SharedSlice slice (size_t offset) const {
+            return(slice(offset, (offset < _length) ? (_length - offset) : 0));
+        }
+
+        void split (size_t index, SharedSlice *head, SharedSlice *tail) const;
+
+        /* Switch the storage to atomic refcounting, before crossing threads */
+        const SharedSlice& share (void) const {
+            if (_buffer != NULL)
+                _buffer->share();
+            return(*this);
+        }
+
+    private:
+        SharedBuffer *  _buffer;
+        const uint8_t * _data;
+        size_t          _length;
+};
+
+/*
+ * Zero-copy concatenation of SharedSlice views.
+ * Adjacent views of the same storage are merged back into one.
+ */
+class SharedSliceList : public ByteSlice {
+    public:
+        SharedSliceList();
+        SharedSliceList(const SharedSliceList& other);
+        ~SharedSliceList();
+
+        SharedSliceList& operator= (const SharedSliceList& other);
+
+        void clear (void);
+
+        int append (const SharedSlice& slice);
+        int append (const SharedSliceList& other);
+
+        size_t count (void) const { return(_count); }
+        const SharedSlice& at (size_t index) const { return(_slices[index]); }
+
+        size_t length (void) const { return(_length); }
+        uint8_t fetch8 (size_t index) const;
+
+        int write (Writable *writable) const;
+
+        /* Single contiguous view, copies only if there is more than one */
+        SharedSlice flatten (Allocator *allocator=NULL) const;
+
+    private:
+        int reserve (size_t count);
+
+    private:
+        SharedSlice * _slices;
+        size_t *      _offsets;
+        size_t        _capacity;
+        size_t        _count;
+        size_t        _length;
+};
+
+#endif /* !_SHARED_SLICE_H_ */
@@ -0,0 +1,65 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "Allocator.h"
+#include "Buffer.h"
+#include "BufferedWriter.h"
+
+void testArena (void) {
+    ArenaAllocator arena(4096);
+    int i, j;
+
+    for (i = 0; i < 3; ++i) {
+        Buffer key(0, NULL, &arena);
+        Buffer value(0, NULL, &arena);
+
+        for (j = 0; j < 32; ++j) {
+            key.append("key-", 4);
+            value.append("value-value-", 12);
+        }
+
+        printf("Arena round %d: key %zu value %zu used %zu reserved %zu\n",
+               i, key.size(), value.size(), arena.used(), arena.reserved());
+        arena.reset();
+    }
+}
+
+void testPool (void) {
+    BufferPool pool;
+    Buffer buf;
+    int i;
+
+    for (i = 0; i < 4; ++i) {
+        BufferWriter bwriter(&buf);
+        BufferedWriter writer(&bwriter, 8192, &pool);
+
+        writer.write("Hello Pool!", 11);
+        writer.flush();
+    }
+
+    printf("Pool: buffer %zu, hits %llu misses %llu\n", buf.size(),
+           (unsigned long long)pool.hits(),
+           (unsigned long long)pool.misses());
+}
+
+int main (int argc, char **argv) {
+    testArena();
+    testPool();
+    return(0);
+}
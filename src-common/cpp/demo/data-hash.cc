@@ -0,0 +1,65 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <stdio.h>
+
+#include "MultiSlice.h"
+#include "BlobSlice.h"
+#include "Buffer.h"
+#include "Hash.h"
+
+int main (int argc, char **argv) {
+    const void *keys[5] = { "a", "ab", "abc", "user:42", "hello world!" };
+    size_t lengths[5] = { 1, 2, 3, 7, 12 };
+    uint64_t hashes[5];
+    MultiSlice parts;
+    Hasher hasher;
+    Hash128 h128;
+    Buffer buf;
+    size_t i;
+
+    printf("1. hash64(hello world!) %016llx\n",
+           (unsigned long long)hash64("hello world!", 12));
+    printf("2. seed 1               %016llx\n",
+           (unsigned long long)hash64("hello world!", 12, 1));
+
+    h128 = hash128("hello world!", 12);
+    printf("3. hash128              %016llx%016llx\n",
+           (unsigned long long)h128.high, (unsigned long long)h128.low);
+
+    /* Streaming over pieces gives the same value */
+    hasher.update("hello", 5);
+    hasher.update(" ", 1);
+    hasher.update("world!", 6);
+    printf("4. Hasher               %016llx\n", (unsigned long long)hasher.digest64());
+
+    parts.add("hello ", 6);
+    parts.add("world!", 6);
+    printf("5. MultiSlice           %016llx\n", (unsigned long long)hash64(parts));
+
+    buf.append("hello world!", 12);
+    BufferReader reader(&buf);
+    hasher.reset();
+    printf("6. Readable %lld bytes   ", (long long)hasher.update(&reader));
+    printf("%016llx\n", (unsigned long long)hasher.digest64());
+
+    hash64Many(keys, lengths, 5, hashes);
+    printf("7. Many:");
+    for (i = 0; i < 5; ++i)
+        printf(" %d", hashes[i] == hash64(keys[i], lengths[i]));
+    printf("\n");
+    return(0);
+}
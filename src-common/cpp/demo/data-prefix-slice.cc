@@ -0,0 +1,48 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "PrefixSlice.h"
+#include "BlobSlice.h"
+#include "Buffer.h"
+
+int main (int argc, char **argv) {
+    /* Prefix-compressed block: every key shares a piece of "user:1000" */
+    const char *prefix = "user:1000";
+    PrefixSlice k1(prefix, 5, "0042", 4);
+    PrefixSlice k2(prefix, 8, "17", 2);
+    PrefixSlice k3(prefix, 9, "9", 1);
+    BlobSlice full("user:10017", 10);
+    MultiSlice parts;
+    Buffer buf;
+
+    printf("1. Compare %d\n", prefixSliceCompare(k1, k2));
+    printf("2. Compare %d\n", prefixSliceCompare(k3, k2));
+    printf("3. Equal %d\n", k2.equal(full));
+    printf("4. Compare %d\n", full.compare(k3));
+
+    parts.add("[", 1);
+    parts.add(&k2);
+    parts.add("]", 1);
+    printf("5. Parts %zu Length %zu\n", parts.parts(), parts.length());
+
+    BufferWriter writer(&buf);
+    parts.write(&writer);
+    printf("6. Written '%.*s'\n", (int)buf.size(), buf.data());
+    return(0);
+}
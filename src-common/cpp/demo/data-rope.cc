@@ -0,0 +1,80 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <unistd.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "RopeBuffer.h"
+#include "DiskWriter.h"
+#include "DiskReader.h"
+
+static void dump (const char *label, RopeBuffer *rope) {
+    char buffer[128];
+    size_t n;
+
+    n = rope->copy(0, buffer, sizeof(buffer) - 1);
+    buffer[n] = '\0';
+    printf("%s: '%s' (size %zu, chunks %zu)\n",
+           label, buffer, rope->size(), rope->chunks());
+}
+
+int main (int argc, char **argv) {
+    const char *filename = "data-rope.disk";
+    RopeBuffer message(16);
+    RopeBuffer body(16);
+    char buffer[128];
+    int n;
+
+    body.append("Hello World", 11);
+    body.append(", from a rope!", 14);
+    dump("Body", &body);
+
+    // Frame: header + body, no body copy
+    message.append("[", 1);
+    message.append(&body);
+    message.append("]", 1);
+    message.prepend("HDR ", 4);
+    message.insert(10, "<ins>", 5);
+    dump("Message", &message);
+
+    message.replace(0, 3, "hdr", 3);
+    message.remove(10, 5);
+    dump("Edited", &message);
+
+    // Vectored write of all the chunks
+    DiskWriter writer;
+    if (!writer.open(filename, true))
+        return(1);
+    printf("WriteTo %d\n", message.writeTo(&writer));
+    writer.close();
+
+    DiskReader reader;
+    if (!reader.open(filename))
+        return(1);
+    n = reader.readFully(buffer, sizeof(buffer) - 1);
+    buffer[n > 0 ? n : 0] = '\0';
+    printf("Disk: '%s'\n", buffer);
+    reader.close();
+    unlink(filename);
+
+    // Readable: consume from the front
+    n = message.read(buffer, 4);
+    buffer[n] = '\0';
+    printf("Read '%s'\n", buffer);
+    dump("Left", &message);
+    return(0);
+}
@@ -0,0 +1,57 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "SharedSlice.h"
+
+static void dump (const char *label, const ByteSlice& slice) {
+    size_t i;
+
+    printf("%s: '", label);
+    for (i = 0; i < slice.length(); ++i)
+        printf("%c", slice[i]);
+    printf("' (%zu)\n", slice.length());
+}
+
+int main (int argc, char **argv) {
+    SharedSlice head, tail;
+    SharedSliceList list;
+    Buffer buf;
+
+    buf.append("Hello World, this is a shared buffer!", 37);
+    SharedSlice value = SharedSlice::fromBuffer(&buf);
+    dump("Value", value);
+
+    value.split(11, &head, &tail);
+    dump("Head", head);
+    dump("Tail", tail);
+    printf("Refs %u\n", value.buffer()->refs());
+
+    list.append(tail.slice(2, 4));
+    list.append(SharedSlice(" ", 1));
+    list.append(head);
+    dump("List", list);
+    printf("List views %zu\n", list.count());
+
+    // Split and concat back, the views are merged
+    list.clear();
+    list.append(head);
+    list.append(tail);
+    printf("Rejoined views %zu, equal %d\n", list.count(), list.equal(value));
+    return(0);
+}
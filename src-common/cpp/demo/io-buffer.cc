@@ -15,7 +15,11 @@
  */
 
 #include <stdint.h>
+#include <string.h>
 #include <stdio.h>
+
+#include <utility>
+
 #include "Buffer.h"
 
 void test0 (void) {
@@ -109,9 +113,111 @@ void test1 (void) {
     printf("vu64 %-12lu\n", u64);
 }
 
+static int check (const char *name, bool ok) {
+    printf("%-28s %s\n", name, ok ? "ok" : "FAILED");
+    return(ok ? 0 : 1);
+}
+
+static bool holds (const Buffer& buf, const char *data, size_t n) {
+    return(buf.size() == n && memcmp(buf.data(), data, n) == 0);
+}
+
+int test2 (void) {
+    char data[BUFFER_INLINE_SIZE * 4];
+    char expected[BUFFER_INLINE_SIZE * 4];
+    int failed = 0;
+    size_t i;
+
+    for (i = 0; i < sizeof(data); ++i)
+        data[i] = 'a' + (i % 26);
+
+    /* Inline storage up to BUFFER_INLINE_SIZE, then the heap, and back */
+    Buffer a;
+    a.append(data, BUFFER_INLINE_SIZE);
+    failed += check("inline at 64 bytes", a.isInline() && holds(a, data, BUFFER_INLINE_SIZE));
+    a.append(data + BUFFER_INLINE_SIZE, 1);
+    failed += check("heap at 65 bytes", !a.isInline() && holds(a, data, BUFFER_INLINE_SIZE + 1));
+    a.truncate(10);
+    a.squeeze();
+    failed += check("squeeze back inline", a.isInline() && holds(a, data, 10));
+
+    /* Copies are deep, from inline and from heap storage */
+    Buffer heap;
+    heap.set(data, 200);
+    Buffer heapCopy(heap);
+    heapCopy[0] = '#';
+    failed += check("copy ctor (heap)", holds(heap, data, 200) &&
+                                        heapCopy.size() == 200 && heapCopy[0] == '#' &&
+                                        memcmp(heapCopy.data() + 1, data + 1, 199) == 0);
+    Buffer inlineCopy(a);
+    failed += check("copy ctor (inline)", inlineCopy.isInline() && holds(inlineCopy, data, 10));
+
+#if __cplusplus >= 201103L
+    /* Moves take the heap storage, copy the inline one, leave the source empty */
+    const uint8_t *blob = heap.data();
+    Buffer moved(std::move(heap));
+    failed += check("move ctor (heap)", moved.data() == blob && holds(moved, data, 200) &&
+                                        heap.isEmpty() && heap.isInline());
+    Buffer movedInline(std::move(a));
+    failed += check("move ctor (inline)", movedInline.isInline() && holds(movedInline, data, 10) &&
+                                          a.isEmpty());
+
+    Buffer target;
+    target.set(data + 1, 100);
+    target = std::move(movedInline);
+    failed += check("move assign (inline)", target.isInline() && holds(target, data, 10) &&
+                                            movedInline.isEmpty());
+    target = std::move(moved);
+    failed += check("move assign (heap)", target.data() == blob && holds(target, data, 200) &&
+                                          moved.isEmpty() && moved.isInline());
+#else
+    Buffer target(heap);
+#endif
+
+    /* Swap, heap with inline and back */
+    Buffer small;
+    small.set("small", 5);
+    target.swap(small);
+    failed += check("swap heap/inline", target.isInline() && holds(target, "small", 5) &&
+                                        !small.isInline() && holds(small, data, 200));
+    small.swap(target);
+    failed += check("swap inline/heap", small.isInline() && holds(small, "small", 5) &&
+                                        holds(target, data, 200));
+
+    /* Self-references, the source moves while the buffer grows */
+    Buffer self;
+    self.set(data, 60);
+    self.insert(3, self.data() + 1, 20);
+    memcpy(expected, data, 3);
+    memcpy(expected + 3, data + 1, 20);
+    memcpy(expected + 23, data + 3, 57);
+    failed += check("insert self, grows", !self.isInline() && holds(self, expected, 80));
+
+    self.set(data, 40);
+    self.prepend(self.data(), 40);
+    memcpy(expected, data, 40);
+    memcpy(expected + 40, data, 40);
+    failed += check("prepend self, grows", holds(self, expected, 80));
+
+    self.set(data, 30);
+    self.insert(10, self.data() + 20, 10);
+    memcpy(expected, data, 10);
+    memcpy(expected + 10, data + 20, 10);
+    memcpy(expected + 20, data + 10, 20);
+    failed += check("insert self, in place", holds(self, expected, 40));
+
+    self.set(data, 60);
+    self.append(self.data() + 5, 50);
+    memcpy(expected, data, 60);
+    memcpy(expected + 60, data + 5, 50);
+    failed += check("append self, grows", holds(self, expected, 110));
+
+    return(failed);
+}
+
 int main (int argc, char **argv) {
     test0();
     test1();
-    return(0);
+    return(test2());
 }
 
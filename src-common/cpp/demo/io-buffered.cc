@@ -69,10 +69,57 @@ static int testRead (const char *filename) {
     return(0);
 }
 
+static void printStats (const char *name,
+                        unsigned int buf_size,
+                        const BufferedStats& stats)
+{
+    printf("%s buffer %u requests %lu stream-ops %lu direct-ops %lu "
+           "stream-bytes %lu grows %lu shrinks %lu\n",
+           name, buf_size,
+           (unsigned long)stats.requests, (unsigned long)stats.streamOps,
+           (unsigned long)stats.directOps, (unsigned long)stats.streamBytes,
+           (unsigned long)stats.grows, (unsigned long)stats.shrinks);
+}
+
+static int testAdaptive (const char *filename) {
+    DiskWriter disk_writer;
+    DiskReader disk_reader;
+    uint32_t value;
+    uint32_t i;
+
+    if (!disk_writer.open(filename, true))
+        return(1);
+
+    // Sequential writes, the buffer grows up to max_size
+    BufferedWriter buffered_writer(&disk_writer, 0);
+    buffered_writer.setAdaptive(disk_writer.blockSize(), 256 << 10);
+    for (i = 0; i < (1 << 20); ++i)
+        buffered_writer.writeInt32(i);
+    buffered_writer.flush();
+    printStats("writer", buffered_writer.bufferSize(), buffered_writer.stats());
+    disk_writer.close();
+
+    if (!disk_reader.open(filename))
+        return(1);
+
+    BufferedReader buffered_reader(&disk_reader, 0);
+    buffered_reader.setAdaptive(disk_reader.blockSize());
+    for (i = 0; buffered_reader.readInt32((int32_t *)&value) > 0; ++i) {
+        if (value != i) {
+            printf("ADAPTIVE MISMATCH %u %u\n", value, i);
+            break;
+        }
+    }
+    printStats("reader", buffered_reader.bufferSize(), buffered_reader.stats());
+    disk_reader.close();
+    return(0);
+}
+
 int main (int argc, char **argv) {
     const char *filename = "io-buffered.disk";
     testWrite(filename);
     testRead(filename);
+    testAdaptive(filename);
     unlink(filename);
     return(0);
 }
@@ -16,8 +16,10 @@
 
 #include "CompressedWriter.h"
 #include "CompressedReader.h"
+#include "ZstdCompressed.h"
 #include "DiskWriter.h"
 #include "DiskReader.h"
+#include "Frame.h"
 
 #include <unistd.h>
 #include <stdio.h>
@@ -57,11 +59,175 @@ int testRead (const char *filename) {
     return(0);
 }
 
+int testAdaptive (const char *filename) {
+    DiskWriter disk_writer;
+    uint8_t block[4096];
+    uint32_t seed = 1;
+
+    if (!disk_writer.open(filename, true))
+        return(1);
+
+    // 8 text blocks, then 32 random blocks (skipped after a few tries)
+    Lz4Writer lz4_writer(&disk_writer, sizeof(block));
+    for (int i = 0; i < 40; ++i) {
+        for (unsigned int j = 0; j < sizeof(block); ++j) {
+            seed = seed * 1103515245 + 12345;
+            block[j] = (i < 8) ? "Hello World "[j % 12] : (seed >> 16);
+        }
+        lz4_writer.write(block, sizeof(block));
+    }
+    lz4_writer.flush();
+
+    printf("ADAPTIVE compressed %llu raw %llu skipped %llu\n",
+           (unsigned long long)lz4_writer.compressedBlocks(),
+           (unsigned long long)lz4_writer.rawBlocks(),
+           (unsigned long long)lz4_writer.skippedBlocks());
+
+    disk_writer.close();
+    return(0);
+}
+
+static uint64_t writeLog (const char *filename, unsigned int checkpoint) {
+    DiskWriter disk_writer;
+    char line[96];
+    uint64_t size;
+    int n;
+
+    if (!disk_writer.open(filename, true))
+        return(0);
+
+    // Small blocks, as a log flushed often would have
+    Lz4Writer lz4_writer(&disk_writer, 512, NULL, 1, checkpoint);
+    for (unsigned int i = 0; i < 4096; ++i) {
+        n = snprintf(line, sizeof(line), "12:%02u:%02u INFO request id=%u status=%u\n",
+                     (i / 60) % 60, i % 60, i * 7919, (i % 13) ? 200 : 404);
+        lz4_writer.write(line, n);
+    }
+    lz4_writer.flush();
+
+    size = disk_writer.length();
+    disk_writer.close();
+    return(size);
+}
+
+int testLinked (const char *filename) {
+    DiskReader disk_reader;
+    char buffer[4096];
+    uint64_t total;
+    int n;
+
+    printf("LINKED independent %llu linked %llu\n",
+           (unsigned long long)writeLog(filename, 0),
+           (unsigned long long)writeLog(filename, 64));
+
+    if (!disk_reader.open(filename))
+        return(1);
+
+    total = 0;
+    Lz4Reader lz4_reader(&disk_reader);
+    while ((n = lz4_reader.read(buffer, sizeof(buffer))) > 0)
+        total += n;
+    printf("LINKED READED %llu\n", (unsigned long long)total);
+
+    disk_reader.close();
+    return(0);
+}
+
+int testResync (const char *filename) {
+    DiskWriter disk_writer;
+    DiskReader disk_reader;
+    char buffer[34];
+    int n;
+
+    if (!disk_writer.open(filename, true))
+        return(1);
+
+    Lz4Writer lz4_writer(&disk_writer, 11);
+    lz4_writer.write("Hello World", 11);
+    lz4_writer.write("Damaged Blk", 11);
+    lz4_writer.write("Hello World", 11);
+    lz4_writer.flush();
+
+    // Flip a byte in the second block payload
+    disk_writer.seek(disk_writer.length() / 3 + FRAME_HEADER_SIZE + 2);
+    disk_writer.write("?", 1);
+    disk_writer.close();
+
+    if (!disk_reader.open(filename))
+        return(1);
+
+    Lz4Reader lz4_reader(&disk_reader);
+    lz4_reader.setVerify(true, true);
+    lz4_reader.setResync(true);
+    n = lz4_reader.read(buffer, 33);
+    buffer[(n > 0) ? n : 0] = 0;
+    printf("RESYNC READED %d '%s' damaged %llu skipped %llu\n", n, buffer,
+           (unsigned long long)lz4_reader.damagedBlocks(),
+           (unsigned long long)lz4_reader.skippedBytes());
+
+    disk_reader.close();
+    return(0);
+}
+
+#ifdef HAVE_ZSTD
+int testZstd (const char *filename) {
+    unsigned int sizes[256];
+    char samples[256 * 32];
+    char dict_data[1024];
+    ZstdDictionary dict;
+    char buffer[32];
+    unsigned int off;
+    int n;
+
+    // Train a dictionary on small records
+    off = 0;
+    for (unsigned int i = 0; i < 256; ++i) {
+        sizes[i] = snprintf(samples + off, 32, "{id: %u, key: 'k%03u'}", i, i * 7);
+        off += sizes[i];
+    }
+
+    if ((n = ZstdDictionary::train(dict_data, sizeof(dict_data), samples, sizes, 256)) < 0)
+        return(1);
+    dict.load(dict_data, n, 19);
+    printf("ZSTD DICT %d\n", n);
+
+    DiskWriter disk_writer;
+    if (!disk_writer.open(filename, true))
+        return(1);
+
+    ZstdWriter zstd_writer(&disk_writer, 32, NULL, 19, false, &dict);
+    zstd_writer.write("{id: 7, key: 'k049'}", 20);
+    zstd_writer.flush();
+    printf("ZSTD WRITTEN %llu\n", (unsigned long long)disk_writer.length());
+    disk_writer.close();
+
+    DiskReader disk_reader;
+    if (!disk_reader.open(filename))
+        return(1);
+
+    ZstdReader zstd_reader(&disk_reader, NULL, &dict);
+    while ((n = zstd_reader.read(buffer, 20)) > 0) {
+        buffer[n] = 0;
+        printf("ZSTD READED %d '%s'\n", n, buffer);
+    }
+
+    disk_reader.close();
+    return(0);
+}
+#endif /* HAVE_ZSTD */
+
 int main (int argc, char **argv) {
     const char *filename = "io-compressed.disk";
 
     testWrite(filename);
     testRead(filename);
+    testAdaptive(filename);
+    testResync(filename);
+    testLinked(filename);
+
+#ifdef HAVE_ZSTD
+    testZstd(filename);
+#endif
 
     unlink(filename);
     return(0);
@@ -0,0 +1,156 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <stdio.h>
+
+#include "CompressedWriter.h"
+#include "CompressedReader.h"
+#include "DiskWriter.h"
+#include "DiskReader.h"
+#include "CStream.h"
+
+#include "encoded.h"
+#include "codec.h"
+
+#define LOG_LINES       4096
+
+static int logLine (char *line, unsigned int size, unsigned int i) {
+    return(snprintf(line, size, "12:%02u:%02u INFO request id=%u status=%u\n",
+                    (i / 60) % 60, i % 60, i * 7919, (i % 13) ? 200 : 404));
+}
+
+// Compare the stream with the log lines, returns the bytes matched
+static uint64_t checkLog (Readable *readable) {
+    char buffer[96];
+    char line[96];
+    uint64_t total;
+    int n;
+
+    total = 0;
+    for (unsigned int i = 0; i < LOG_LINES; ++i) {
+        n = logLine(line, sizeof(line), i);
+        if (readable->readFully(buffer, n) != n || memcmp(buffer, line, n))
+            break;
+        total += n;
+    }
+
+    // Nothing should be left
+    if (readable->read(buffer, 1) > 0)
+        return(0);
+
+    return(total);
+}
+
+static uint64_t logSize (void) {
+    char line[96];
+    uint64_t size = 0;
+    for (unsigned int i = 0; i < LOG_LINES; ++i)
+        size += logLine(line, sizeof(line), i);
+    return(size);
+}
+
+// C++ Lz4Writer, read back by the C encoded_reader
+int testCppToC (const char *filename, unsigned int checkpoint) {
+    DiskWriter disk_writer;
+    DiskReader disk_reader;
+    encoded_reader_t reader;
+    lz4_codec_t lz4;
+    codec_t codec;
+    char line[96];
+    uint64_t total;
+
+    if (!disk_writer.open(filename, true))
+        return(1);
+
+    Lz4Writer lz4_writer(&disk_writer, 512, NULL, 1, checkpoint);
+    for (unsigned int i = 0; i < LOG_LINES; ++i)
+        lz4_writer.write(line, logLine(line, sizeof(line), i));
+    lz4_writer.flush();
+    disk_writer.close();
+
+    if (!disk_reader.open(filename))
+        return(1);
+
+    lz4_codec_open(&lz4, 1);
+    codec.vtable = &codec_lz4;
+    codec.data.ptr = &lz4;
+
+    // DiskReader -> C encoded_reader -> Readable
+    ReadableCStream disk_stream(&disk_reader);
+    encoded_reader_open(&reader, &codec, disk_stream.stream());
+    CStreamReader encoded_stream((stream_t *)&reader);
+    total = checkLog(&encoded_stream);
+
+    printf("CPP->C checkpoint %u READED %llu %s\n", checkpoint,
+           (unsigned long long)total, (total == logSize()) ? "OK" : "MISMATCH");
+
+    encoded_reader_close(&reader);
+    lz4_codec_close(&lz4);
+    disk_reader.close();
+    return(total != logSize());
+}
+
+// C encoded_writer, read back by the C++ Lz4Reader
+int testCToCpp (const char *filename) {
+    DiskWriter disk_writer;
+    DiskReader disk_reader;
+    encoded_writer_t writer;
+    lz4_codec_t lz4;
+    codec_t codec;
+    char line[96];
+    uint64_t total;
+
+    if (!disk_writer.open(filename, true))
+        return(1);
+
+    lz4_codec_open(&lz4, 1);
+    codec.vtable = &codec_lz4;
+    codec.data.ptr = &lz4;
+
+    // C encoded_writer -> DiskWriter
+    WritableCStream disk_stream(&disk_writer);
+    encoded_writer_open(&writer, &codec, disk_stream.stream(), 512);
+    for (unsigned int i = 0; i < LOG_LINES; ++i)
+        io_write((stream_t *)&writer, line, logLine(line, sizeof(line), i));
+    io_flush((stream_t *)&writer);
+    encoded_writer_close(&writer);
+    lz4_codec_close(&lz4);
+    disk_writer.close();
+
+    if (!disk_reader.open(filename))
+        return(1);
+
+    Lz4Reader lz4_reader(&disk_reader);
+    total = checkLog(&lz4_reader);
+
+    printf("C->CPP READED %llu %s\n",
+           (unsigned long long)total, (total == logSize()) ? "OK" : "MISMATCH");
+
+    disk_reader.close();
+    return(total != logSize());
+}
+
+int main (int argc, char **argv) {
+    const char *filename = "io-cstream.disk";
+    int res = 0;
+    res |= testCppToC(filename, 0);
+    res |= testCppToC(filename, 64);
+    res |= testCToCpp(filename);
+    unlink(filename);
+    return(res);
+}
@@ -0,0 +1,54 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <stdio.h>
+
+#include "BitArray.h"
+
+int main (int argc, char **argv) {
+    BitArray a(1000);
+    BitArray b(1000);
+    size_t i;
+
+    a.setRange(100, 300);
+    a.set(777);
+    b.setRange(200, 400);
+    printf("1. Count a=%zu b=%zu\n", a.count(), b.count());
+
+    printf("2. Set bits from 290:");
+    for (i = a.nextSetBit(290); i != BIT_ARRAY_NPOS; i = a.nextSetBit(i + 1))
+        printf(" %zu", i);
+    printf("\n");
+
+    printf("3. Rank(250)=%zu Select(150)=%zu Select(201)=%zu\n",
+           a.rank(250), a.select(150), a.select(201));
+
+    BitArray c(a);
+    c.andWith(b);
+    printf("4. AND count=%zu first=%zu\n", c.count(), c.nextSetBit(0));
+
+    c = a;
+    c.xorWith(b);
+    printf("5. XOR count=%zu\n", c.count());
+
+    a.andNotWith(b);
+    printf("6. ANDNOT count=%zu first-unset=%zu\n", a.count(), a.nextUnsetBit(100));
+
+    a.resize(2000);
+    a.setRange(1500, 5000);
+    printf("7. Resized count=%zu rank(end)=%zu\n", a.count(), a.rank(a.length()));
+    return(0);
+}
@@ -0,0 +1,64 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <stdio.h>
+
+#include "BloomFilter.h"
+#include "Buffer.h"
+
+int main (int argc, char **argv) {
+    const void *keys[4] = { "user:17", "user:42", "user:99", "group:1" };
+    size_t lengths[4] = { 7, 7, 7, 7 };
+    BloomFilter filter(10000, 0.01);
+    BloomFilter loaded;
+    char key[32];
+    bool found[4];
+    size_t i, fp;
+    Buffer buf;
+    int n;
+
+    for (i = 0; i < 10000; ++i) {
+        n = snprintf(key, sizeof(key), "user:%zu", i * 3);
+        filter.add(key, n);
+    }
+    printf("1. Blocks %zu, %zu bytes for %llu items\n",
+           filter.blocks(), filter.sizeInBytes(), (unsigned long long)filter.items());
+
+    filter.mayContainMany(keys, lengths, 4, found);
+    printf("2. Batch %d %d %d %d\n", found[0], found[1], found[2], found[3]);
+
+    fp = 0;
+    for (i = 0; i < 10000; ++i) {
+        n = snprintf(key, sizeof(key), "item:%zu", i);
+        fp += filter.mayContain(key, n);
+    }
+    printf("3. False positives %zu/10000\n", fp);
+
+    BufferWriter writer(&buf);
+    filter.write(&writer);
+    BufferReader reader(&buf);
+    printf("4. Serialized %zu bytes, read %d\n", buf.size(), loaded.read(&reader));
+    printf("5. Loaded user:42=%d user:43=%d\n",
+           loaded.mayContain("user:42", 7), loaded.mayContain("user:43", 7));
+
+    /* A truncated image leaves an empty filter, that answers "maybe" */
+    buf.truncate(buf.size() / 2);
+    BufferReader truncated(&buf);
+    n = loaded.read(&truncated);
+    printf("6. Truncated read %d, blocks %zu, item:1=%d\n",
+           n, loaded.blocks(), loaded.mayContain("item:1", 6));
+    return((n < 0 && loaded.mayContain("item:1", 6)) ? 0 : 1);
+}
@@ -0,0 +1,153 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "RoaringBitmap.h"
+#include "BitArray.h"
+#include "Buffer.h"
+
+/* Both read() and map() must reject the image */
+static int checkCorrupt (const char *name, const Buffer *buf) {
+    RoaringBitmap bitmap;
+    uint64_t *image;
+    int rd, mp;
+
+    BufferReader reader(buf);
+    rd = bitmap.read(&reader);
+
+    image = (uint64_t *)malloc(buf->size());
+    memcpy(image, buf->data(), buf->size());
+    mp = bitmap.map(image, buf->size());
+    bitmap.clear();
+    free(image);
+
+    printf("   %s: read %s, map %s\n", name,
+           (rd < 0) ? "rejected" : "ACCEPTED", (mp < 0) ? "rejected" : "ACCEPTED");
+    return((rd < 0 && mp < 0) ? 0 : 1);
+}
+
+/* Serialize 'bitmap', the payload of the first container is at 'payload' */
+static uint8_t *serialize (Buffer *buf, const RoaringBitmap& bitmap) {
+    const uint8_t *desc;
+    uint32_t offset;
+
+    BufferWriter writer(buf);
+    bitmap.write(&writer);
+
+    desc = buf->data() + 8;
+    offset = desc[12] | (desc[13] << 8) | (desc[14] << 16) | ((uint32_t)desc[15] << 24);
+    return(buf->data() + offset);
+}
+
+int main (int argc, char **argv) {
+    RoaringBitmap docs, tagged;
+    RoaringBitmap mapped;
+    BitArray dense(1 << 24);
+    RoaringIterator *iter;
+    uint64_t *image;
+    uint32_t value;
+    Buffer buf;
+    uint32_t i;
+
+    /* Sparse posting list: one doc every ~200 over 16M ids */
+    for (i = 0; i < (1 << 24); i += 197) {
+        docs.add(i);
+        dense.set(i);
+    }
+    tagged.addRange(1000000, 3000000);
+
+    printf("1. Docs %llu roaring %zu bytes, bitarray %zu bytes\n",
+           (unsigned long long)docs.cardinality(), docs.memoryUsage(),
+           dense.blockCount() * sizeof(uint64_t));
+
+    tagged.runOptimize();
+    printf("2. Tagged %llu roaring %zu bytes\n",
+           (unsigned long long)tagged.cardinality(), tagged.memoryUsage());
+
+    RoaringBitmap both(docs);
+    both.andWith(tagged);
+    printf("3. AND %llu values, first:", (unsigned long long)both.cardinality());
+    iter = new RoaringIterator(&both);
+    for (i = 0; i < 4 && iter->next(&value); ++i)
+        printf(" %u", value);
+    printf("\n");
+    delete iter;
+
+    RoaringBitmap any(docs);
+    any.orWith(tagged);
+    printf("4. OR %llu values\n", (unsigned long long)any.cardinality());
+
+    BufferWriter writer(&buf);
+    any.write(&writer);
+    printf("5. Serialized %zu bytes (%zu expected)\n", buf.size(), any.serializedSize());
+
+    /* Zero-copy: the image is used in place */
+    image = (uint64_t *)malloc(buf.size());
+    memcpy(image, buf.data(), buf.size());
+    mapped.map(image, buf.size());
+    printf("6. Mapped %llu values contains(1000001)=%d contains(197)=%d\n",
+           (unsigned long long)mapped.cardinality(),
+           mapped.contains(1000001), mapped.contains(197));
+    mapped.clear();
+    free(image);
+
+    /* Corrupt images, the payloads are validated not only the descriptors */
+    int corrupt = 0;
+    printf("7. Corrupt images\n");
+    {
+        RoaringBitmap bitmap;
+        Buffer buf;
+        uint8_t *payload;
+
+        /* Bitmap with all the 64K bits set, declared cardinality 5000 */
+        for (i = 0; i < 5000; ++i)
+            bitmap.add(i * 3);
+        payload = serialize(&buf, bitmap);
+        memset(payload, 0xff, ROARING_BITMAP_WORDS * sizeof(uint64_t));
+        corrupt |= checkCorrupt("bitmap popcount", &buf);
+    }
+    {
+        RoaringBitmap bitmap;
+        uint16_t *values;
+        Buffer buf;
+
+        /* Unsorted array */
+        for (i = 0; i < 100; ++i)
+            bitmap.add(i * 7);
+        values = (uint16_t *)serialize(&buf, bitmap);
+        values[10] = values[20];
+        corrupt |= checkCorrupt("unsorted array", &buf);
+    }
+    {
+        RoaringBitmap bitmap;
+        uint16_t *runs;
+        Buffer buf;
+
+        /* Runs past the chunk end, and overlapping runs */
+        bitmap.addRange(100, 200);
+        bitmap.addRange(1000, 2000);
+        bitmap.runOptimize();
+        runs = (uint16_t *)serialize(&buf, bitmap);
+        runs[2] = 0xff00;
+        corrupt |= checkCorrupt("run past 0xffff", &buf);
+        runs[2] = 150;
+        corrupt |= checkCorrupt("overlapping runs", &buf);
+    }
+    return(corrupt);
+}
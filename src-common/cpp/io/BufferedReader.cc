@@ -22,17 +22,23 @@
 /* ============================================================================
  *  Buffered Reader
  */
-BufferedReader::BufferedReader(Readable *readable, unsigned int buf_size) {
+BufferedReader::BufferedReader(Readable *readable,
+                               unsigned int buf_size,
+                               Allocator *allocator)
+    : _sizing(buf_size)
+{
+    _allocator = (allocator != NULL) ? allocator : Allocator::heap();
     _readable = readable;
     _buffer = NULL;
     _buf_required = buf_size;
     _buf_readed = 0;
     _buf_size = 0;
+    memset(&_stats, 0, sizeof(BufferedStats));
 }
 
 BufferedReader::~BufferedReader() {
     if (_buffer != NULL) {
-        delete[] _buffer;
+        _allocator->deallocate(_buffer, _buf_required);
         _buffer = NULL;
     }
 }
@@ -42,9 +48,13 @@ int BufferedReader::read (void *buffer, unsigned int size) {
     uint8_t *pbuf = (uint8_t *)buffer;
     int n, rd;
 
+    _stats.requests++;
+
     // Direct read if requested size is larger than buffer and no buf
-    if (!buf_avail && size >= _buf_required)
-        return(_readable->readFully(buffer, size));
+    if (!buf_avail && size >= _buf_required) {
+        _stats.directOps++;
+        return(readStream(buffer, size));
+    }
 
     if (size <= buf_avail) {
         memcpy(buffer, _buffer + _buf_readed, size);
@@ -52,32 +62,78 @@ int BufferedReader::read (void *buffer, unsigned int size) {
         return(size);
     }
 
-    if (_buffer == NULL)
-        _buffer = new uint8_t[_buf_required];
+    if (_buffer == NULL) {
+        if ((_buffer = (uint8_t *)_allocator->allocate(_buf_required)) == NULL)
+            return(-1);
+    }
 
     // Copy the old buffer to the end
     if ((n = buf_avail) > 0) {
         memcpy(pbuf, _buffer + _buf_readed, buf_avail);
+        _buf_readed = _buf_size;
         pbuf += buf_avail;
         size -= buf_avail;
     }
 
     // Direct read if requested size is larger than buffer
     if (size >= _buf_required) {
-        int rd = _readable->readFully(pbuf, size);
+        _stats.directOps++;
+        rd = readStream(pbuf, size);
         _buf_readed = 0;
         _buf_size = 0;
         return((rd > 0) ? (n + rd) : n);
     }
 
+    // The buffer is empty, the previous fill decides the next size
+    if (_buf_size > 0)
+        resizeBuffer();
+
     // Fill the buffer
-    if ((rd = _readable->readFully(_buffer, _buf_required)) <= 0)
+    if ((rd = readStream(_buffer, _buf_required)) <= 0)
         return(n);
 
-    // Copy to used
+    // Copy to used, the end of the stream may give back less than asked
+    if (size > (unsigned int)rd)
+        size = rd;
     memcpy(pbuf, _buffer, size);
     _buf_readed = size;
     _buf_size = rd;
     return(n + size);
 }
 
+bool BufferedReader::setAdaptive (unsigned int align, unsigned int max_size) {
+    if (_buffer != NULL)
+        return(false);
+
+    _buf_required = _sizing.setAdaptive(align, max_size);
+    return(true);
+}
+
+int BufferedReader::readStream (void *buffer, unsigned int size) {
+    int rd;
+
+    rd = _readable->readFully(buffer, size);
+    _stats.streamOps++;
+    if (rd > 0)
+        _stats.streamBytes += rd;
+    return(rd);
+}
+
+// The buffer is consumed, _buf_size is the amount of the last fill
+void BufferedReader::resizeBuffer (void) {
+    unsigned int size;
+    uint8_t *buffer;
+
+    size = _sizing.adapt(&_stats, _buf_required, _buf_size);
+    if (size == _buf_required)
+        return;
+
+    // Keep the old buffer on failure
+    if ((buffer = (uint8_t *)_allocator->allocate(size)) == NULL)
+        return;
+
+    _allocator->deallocate(_buffer, _buf_required);
+    _buffer = buffer;
+    _buf_required = size;
+}
+
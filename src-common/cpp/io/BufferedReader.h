@@ -17,23 +17,41 @@
 #ifndef _BUFFERED_READER_H_
 #define _BUFFERED_READER_H_
 
+#include "BufferedSizing.h"
+#include "Allocator.h"
 #include "Readable.h"
 
 class BufferedReader : public Readable {
     public:
-        BufferedReader(Readable *readable, unsigned int buf_size);
+        BufferedReader(Readable *readable,
+                       unsigned int buf_size,
+                       Allocator *allocator=NULL);
         virtual ~BufferedReader();
 
         int read (void *buffer, unsigned int size);
 
+        // Adaptive buffer size (see BufferedSizing), before the first read.
+        // align=0 is 4K, max_size=0 is 1M
+        bool setAdaptive (unsigned int align=0, unsigned int max_size=0);
+
+        unsigned int bufferSize (void) const { return(_buf_required); }
+        const BufferedStats& stats (void) const { return(_stats); }
+
     protected:
         Readable *_readable;
 
     private:
+        int readStream (void *buffer, unsigned int size);
+        void resizeBuffer (void);
+
+    private:
+        Allocator *  _allocator;
         uint8_t *    _buffer;
         unsigned int _buf_size;
         unsigned int _buf_readed;
-        unsigned int _buf_required;
+        unsigned int _buf_required;     // Buffer size
+        BufferedSizing _sizing;
+        BufferedStats _stats;
 };
 
 #endif /* !_BUFFERED_READER_H_ */
@@ -0,0 +1,100 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <time.h>
+
+#include "BufferedSizing.h"
+
+static uint64_t __now_msec (void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return(((uint64_t)ts.tv_sec * 1000) + (ts.tv_nsec / 1000000));
+}
+
+/* ============================================================================
+ *  Buffered Sizing
+ */
+BufferedSizing::BufferedSizing(unsigned int size) {
+    _min_size = size;
+    _max_size = size;
+    _streak = 0;
+    _last_io = 0;
+}
+
+unsigned int BufferedSizing::setAdaptive (unsigned int align,
+                                          unsigned int max_size)
+{
+    if (align == 0)
+        align = DEFAULT_ALIGN;
+
+    if (max_size == 0)
+        max_size = DEFAULT_MAX;
+
+    max_size -= max_size % align;
+    if (max_size < align)
+        max_size = align;
+
+    _min_size = align;
+    _max_size = max_size;
+    _streak = 0;
+    _last_io = 0;
+    return(align);
+}
+
+unsigned int BufferedSizing::adapt (BufferedStats *stats,
+                                    unsigned int size,
+                                    unsigned int used)
+{
+    uint64_t now;
+    bool idle;
+
+    if (!isAdaptive())
+        return(size);
+
+    now = __now_msec();
+    idle = _last_io > 0 && (now - _last_io) >= IDLE_MSEC;
+    _last_io = now;
+
+    // Sequential access, grow the buffer to do less calls on the stream
+    if (used >= size && !idle) {
+        if (++_streak < GROW_STREAK || size >= _max_size)
+            return(size);
+
+        _streak = 0;
+        stats->grows++;
+        return((size > (_max_size >> 1)) ? _max_size : (size << 1));
+    }
+
+    _streak = 0;
+    if (size <= _min_size)
+        return(size);
+
+    if (idle) {
+        stats->shrinks++;
+        return(_min_size);
+    }
+
+    // Sparse access, the buffer is too big
+    if (used < (size >> 2)) {
+        stats->shrinks++;
+        size >>= 1;
+        size -= size % _min_size;
+        return((size > _min_size) ? size : _min_size);
+    }
+
+    return(size);
+}
+
@@ -0,0 +1,64 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef _BUFFERED_SIZING_H_
+#define _BUFFERED_SIZING_H_
+
+#include <stdint.h>
+
+// Access-pattern counters of the BufferedReader/BufferedWriter
+struct BufferedStats {
+    uint64_t requests;          // read/write calls
+    uint64_t streamOps;         // reads/writes on the underlying stream
+    uint64_t directOps;         // of which bypassing the buffer
+    uint64_t streamBytes;       // bytes read/written on the stream
+    uint64_t grows;
+    uint64_t shrinks;
+};
+
+// Adaptive buffer size, same policy of the C buffered streams:
+// the buffer doubles (up to max) after GROW_STREAK full buffers in a row,
+// halves (down to min) when a fill/flush uses less than 1/4 of it, and is
+// back to min after IDLE_MSEC without fills/flushes.
+// Sizes are multiples of min, the 'align' (e.g. DiskReader::blockSize()).
+class BufferedSizing {
+    public:
+        static const unsigned int GROW_STREAK = 2;
+        static const unsigned int IDLE_MSEC = 1000;
+        static const unsigned int DEFAULT_ALIGN = 4 << 10;
+        static const unsigned int DEFAULT_MAX = 1 << 20;
+
+    public:
+        BufferedSizing(unsigned int size);
+
+        bool isAdaptive (void) const { return(_min_size != _max_size); }
+
+        // Returns the initial buffer size
+        unsigned int setAdaptive (unsigned int align, unsigned int max_size);
+
+        // Size of the next buffer, after a fill/flush of 'used' bytes of 'size'
+        unsigned int adapt (BufferedStats *stats,
+                            unsigned int size,
+                            unsigned int used);
+
+    private:
+        unsigned int _min_size;
+        unsigned int _max_size;
+        unsigned int _streak;
+        uint64_t     _last_io;
+};
+
+#endif /* !_BUFFERED_SIZING_H_ */
@@ -24,11 +24,17 @@
 /* ============================================================================
  *  Buffered Writer
  */
-BufferedWriter::BufferedWriter(Writable *writable, unsigned int buf_size) {
+BufferedWriter::BufferedWriter(Writable *writable,
+                               unsigned int buf_size,
+                               Allocator *allocator)
+    : _sizing(buf_size)
+{
+    _allocator = (allocator != NULL) ? allocator : Allocator::heap();
     _writable = writable;
     _buffer = NULL;
     _buf_size = buf_size;
     _buf_used = 0;
+    memset(&_stats, 0, sizeof(BufferedStats));
 }
 
 BufferedWriter::~BufferedWriter() {
@@ -36,7 +42,7 @@ BufferedWriter::~BufferedWriter() {
         fprintf(stderr, "WARNING: Data not flushed before destruction\n");
 
     if (_buffer != NULL)
-        delete[] _buffer;
+        _allocator->deallocate(_buffer, _buf_size);
 }
 
 int BufferedWriter::write (const void *buffer, unsigned int size) {
@@ -44,8 +50,12 @@ int BufferedWriter::write (const void *buffer, unsigned int size) {
     unsigned int buf_avail;
     unsigned int n;
 
-    if (_buffer == NULL)
-        _buffer = new uint8_t[_buf_size];
+    _stats.requests++;
+
+    if (_buffer == NULL) {
+        if ((_buffer = (uint8_t *)_allocator->allocate(_buf_size)) == NULL)
+            return(-1);
+    }
 
     buf_avail = _buf_size - _buf_used;
     if (size <= buf_avail) {
@@ -54,16 +64,22 @@ int BufferedWriter::write (const void *buffer, unsigned int size) {
         return(size);
     }
 
-    // Fill buffer and flush
+    // Fill buffer and flush, on error the buffer is left as it was
     memcpy(_buffer + _buf_used, pbuf, buf_avail);
+    if (writeBuffer(_buffer, _buf_size) < 0)
+        return(-1);
+
     pbuf += buf_avail;
     size -= buf_avail;
-    flushBuffer(_buffer, _buf_size);
+    _buf_used = 0;
+    resizeBuffer(_buf_size);
     n = buf_avail;
 
     // Flush directly if input is greater than buffer
     while (size >= _buf_size) {
-        flushBuffer(pbuf, _buf_size);
+        _stats.directOps++;
+        if (writeBuffer(pbuf, _buf_size) < 0)
+            return((n > 0) ? n : -1);
         pbuf += _buf_size;
         size -= _buf_size;
         n += _buf_size;
@@ -79,10 +95,44 @@ int BufferedWriter::write (const void *buffer, unsigned int size) {
 
 int BufferedWriter::flush (void) {
     if (_buf_used > 0) {
-        int r = flushBuffer(_buffer, _buf_used);
+        int r = writeBuffer(_buffer, _buf_used);
+        if (r < 0)
+            return(-1);
+        resizeBuffer(_buf_used);
         _buf_used = 0;
         return(r);
     }
     return(0);
 }
 
+bool BufferedWriter::setAdaptive (unsigned int align, unsigned int max_size) {
+    if (_buffer != NULL)
+        return(false);
+
+    _buf_size = _sizing.setAdaptive(align, max_size);
+    return(true);
+}
+
+int BufferedWriter::writeBuffer (const void *buffer, unsigned int size) {
+    _stats.streamOps++;
+    _stats.streamBytes += size;
+    return(flushBuffer(buffer, size));
+}
+
+// The buffer is flushed, 'used' is the amount of data that was in it
+void BufferedWriter::resizeBuffer (unsigned int used) {
+    unsigned int size;
+    uint8_t *buffer;
+
+    if ((size = _sizing.adapt(&_stats, _buf_size, used)) == _buf_size)
+        return;
+
+    // Keep the old buffer on failure
+    if ((buffer = (uint8_t *)_allocator->allocate(size)) == NULL)
+        return;
+
+    _allocator->deallocate(_buffer, _buf_size);
+    _buffer = buffer;
+    _buf_size = size;
+}
+
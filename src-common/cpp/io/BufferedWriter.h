@@ -17,28 +17,52 @@
 #ifndef _BUFFERED_WRITER_H_
 #define _BUFFERED_WRITER_H_
 
+#include "BufferedSizing.h"
+#include "Allocator.h"
 #include "Writable.h"
 
 class BufferedWriter : public Writable {
     public:
-        BufferedWriter(Writable *writable, unsigned int buf_size);
+        BufferedWriter(Writable *writable,
+                       unsigned int buf_size,
+                       Allocator *allocator=NULL);
         virtual ~BufferedWriter();
 
+        // Returns -1 if the buffer can't be flushed, or a short count if
+        // the error happens after a part of the input was written.
         int write (const void *buffer, unsigned int size);
+        // On error returns -1, the data stays in the buffer.
         virtual int flush (void);
 
+        // Adaptive buffer size (see BufferedSizing), before the first write.
+        // align=0 is 4K, max_size=0 is 1M
+        bool setAdaptive (unsigned int align=0, unsigned int max_size=0);
+
+        unsigned int bufferSize (void) const { return(_buf_size); }
+        const BufferedStats& stats (void) const { return(_stats); }
+
     protected:
+        // Returns the bytes written to the writable, -1 on error
         virtual int flushBuffer (const void *buffer, unsigned int size) {
-            return(_writable->writeFully(buffer, size));
+            if (_writable->writeFully(buffer, size) != (int)size)
+                return(-1);
+            return(size);
         }
 
     protected:
+        Allocator *_allocator;
         Writable *_writable;
 
+    private:
+        int writeBuffer (const void *buffer, unsigned int size);
+        void resizeBuffer (unsigned int used);
+
     private:
         uint8_t *    _buffer;
         unsigned int _buf_size;
         unsigned int _buf_used;
+        BufferedSizing _sizing;
+        BufferedStats _stats;
 };
 
 #endif /* !_BUFFERED_WRITER_H_ */
@@ -0,0 +1,136 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef _C_STREAM_H_
+#define _C_STREAM_H_
+
+// Adapters between the C streams (c/io/stream.h) and Readable/Writable,
+// e.g. a C encoded_reader_t read as a Readable, or a BufferedWriter used
+// as the stream_t of a C encoded_writer_t. Header only, each call is just
+// one indirect call on the other side. The frames of the encoded and the
+// compressed streams are the same, files are readable from both sides.
+//
+// Requires the C io headers in the include path (-I c/io).
+
+#include <stddef.h>
+
+#include "Readable.h"
+#include "Writable.h"
+#include "stream.h"
+
+// C stream_t as a Readable
+class CStreamReader : public Readable {
+    public:
+        CStreamReader(stream_t *stream) {
+            _stream = stream;
+        }
+
+        int read (void *buffer, unsigned int size) {
+            return(io_read(_stream, buffer, size));
+        }
+
+    private:
+        stream_t *_stream;
+};
+
+// C stream_t as a Writable
+class CStreamWriter : public Writable {
+    public:
+        CStreamWriter(stream_t *stream) {
+            _stream = stream;
+        }
+
+        int write (const void *buffer, unsigned int size) {
+            return(io_write(_stream, buffer, size));
+        }
+
+        int flush (void) {
+            if (!io_stream_has_method(_stream, flush))
+                return(0);
+            return(io_flush(_stream));
+        }
+
+    private:
+        stream_t *_stream;
+};
+
+// Readable as a C stream_t, pass stream() to the C functions
+class ReadableCStream {
+    public:
+        ReadableCStream(Readable *readable) {
+            _stream.vtable = vtable();
+            _readable = readable;
+        }
+
+        stream_t *stream (void) {
+            return(&_stream);
+        }
+
+    private:
+        static int __read (stream_t *stream, void *buf, unsigned int n) {
+            return(((ReadableCStream *)stream)->_readable->read(buf, n));
+        }
+
+        static stream_vtable_t *vtable (void) {
+            static stream_vtable_t __vtable = {
+                NULL, NULL, NULL, __read, NULL,     // write, flush, zread, read, seek
+                NULL, NULL, NULL, NULL,             // can_write/zread/read/seek
+                NULL, NULL,                         // position, length
+            };
+            return(&__vtable);
+        }
+
+    private:
+        stream_t _stream;           // First member, the stream_t is the object
+        Readable *_readable;
+};
+
+// Writable as a C stream_t, pass stream() to the C functions
+class WritableCStream {
+    public:
+        WritableCStream(Writable *writable) {
+            _stream.vtable = vtable();
+            _writable = writable;
+        }
+
+        stream_t *stream (void) {
+            return(&_stream);
+        }
+
+    private:
+        static int __write (stream_t *stream, const void *buf, unsigned int n) {
+            return(((WritableCStream *)stream)->_writable->write(buf, n));
+        }
+
+        static int __flush (stream_t *stream) {
+            return(((WritableCStream *)stream)->_writable->flush());
+        }
+
+        static stream_vtable_t *vtable (void) {
+            static stream_vtable_t __vtable = {
+                __write, __flush, NULL, NULL, NULL, // write, flush, zread, read, seek
+                NULL, NULL, NULL, NULL,             // can_write/zread/read/seek
+                NULL, NULL,                         // position, length
+            };
+            return(&__vtable);
+        }
+
+    private:
+        stream_t _stream;           // First member, the stream_t is the object
+        Writable *_writable;
+};
+
+#endif /* !_C_STREAM_H_ */
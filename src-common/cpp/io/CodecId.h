@@ -0,0 +1,27 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+
+#ifndef _CODEC_ID_H_
+#define _CODEC_ID_H_
+
+// Codec ids, recorded in each compressed block header.
+// The list is shared with the C codecs (c/io/codec_id.h).
+#include "codec_id.h"
+
+typedef enum codec_id CodecId;
+
+#endif /* !_CODEC_ID_H_ */
@@ -17,11 +17,13 @@
 #include <string.h>
 
 #include "CompressedReader.h"
+#include "Crc32c.h"
+#include "Frame.h"
 
 int CompressedReader::read (void *buffer, unsigned int size) {
     unsigned int buf_avail = _buf_size - _buf_readed;
     uint8_t *pbuf = (uint8_t *)buffer;
-    int n;
+    int n, rd;
 
     if (size <= buf_avail) {
         memcpy(buffer, _buffer + _buf_readed, size);
@@ -32,18 +34,27 @@ int CompressedReader::read (void *buffer, unsigned int size) {
     // Copy the old buffer to the end.
     if ((n = buf_avail) > 0) {
         memcpy(pbuf, _buffer + _buf_readed, buf_avail);
+        _buf_readed += buf_avail;
         pbuf += buf_avail;
         size -= buf_avail;
     }
 
     do {
-        // Read new Buffer
-        if (readBuffer() < 0)
-            return(-1);
+        // Read new Buffer, straight to the user buffer if the block fits
+        if ((rd = readBuffer(pbuf, size)) < 0)
+            return((n > 0) ? n : -1);
+
+        if (rd > 0) {
+            pbuf += rd;
+            size -= rd;
+            n += rd;
+            continue;
+        }
 
         // Copy to user
         buf_avail = (size > _buf_size) ? _buf_size : size;
         memcpy(pbuf, _buffer, buf_avail);
+        _buf_readed = buf_avail;
         pbuf += buf_avail;
         size -= buf_avail;
         n += buf_avail;
@@ -52,31 +63,199 @@ int CompressedReader::read (void *buffer, unsigned int size) {
     return(n);
 }
 
-int CompressedReader::readBuffer (void) {
-    uint64_t size, csize;
+int CompressedReader::readBuffer (uint8_t *dst, unsigned int dst_size) {
+    FrameHeader frame;
+    uint64_t skipped;
+    uint8_t *pbuf;
+    uint8_t *stored;
+    int rd;
+
+    _buf_size = 0;
+    _buf_readed = 0;
+    while (true) {
+        // Read Header, end of stream or unrecoverable damage
+        skipped = _skipped_bytes;
+        if ((rd = frame.read(_readable, _resync, &_skipped_bytes)) <= 0)
+            return((rd == 0) ? -1 : -2);
+
+        // Resynced, the blocks in between are lost
+        if (skipped != _skipped_bytes)
+            _hist_size = 0;
+
+        // Block written by a different codec (or stored uncompressed)
+        if (frame.codec != codecId() && frame.codec != CODEC_ID_PLAIN)
+            return(-6);
+
+        if (frame.codec == CODEC_ID_PLAIN && frame.csize != frame.size)
+            return(-2);
+
+        // Not part of a linked chain, drop the history
+        if (!(frame.flags & FRAME_FLAG_HISTORY))
+            _hist_size = 0;
+
+        // The whole block fits in the user buffer, no copy
+        pbuf = dst;
+        if (frame.size > dst_size) {
+            if (!reserve(&_buffer, &_buf_capacity, frame.size))
+                return(-4);
+            pbuf = _buffer;
+        }
+
+        // Raw block, read straight into the destination
+        stored = pbuf;
+        if (frame.codec != CODEC_ID_PLAIN) {
+            if (!reserve(&_cbuffer, &_cbuf_capacity, frame.csize))
+                return(-4);
+            stored = _cbuffer;
+        }
+
+        if ((rd = _readable->readFully(stored, frame.csize)) != (int)frame.csize) {
+            if (_resync) {
+                _damaged_blocks++;
+                _skipped_bytes += FRAME_HEADER_SIZE + ((rd > 0) ? rd : 0);
+            }
+            return(-3);
+        }
+
+        // Raw blocks have a single crc, stored and data are the same bytes
+        if ((_verify_stored || (_verify_data && stored == pbuf)) &&
+            crc32c(0, stored, frame.csize) != frame.storedCrc)
+        {
+            goto _damaged;
+        }
+
+        if (frame.codec != CODEC_ID_PLAIN) {
+            // Uncompress, the block must fill exactly the declared size
+            if (frame.flags & FRAME_FLAG_HISTORY)
+                rd = decodeHistory(&frame, pbuf);
+            else
+                rd = decompress(_cbuffer, frame.csize, pbuf, frame.size);
+
+            if (rd != (int)frame.size) {
+                if (!_resync)
+                    return(-5);
+                goto _damaged;
+            }
+
+            if (_verify_data && (frame.flags & FRAME_FLAG_DATA_CRC) &&
+                crc32c(0, pbuf, frame.size) != frame.dataCrc)
+            {
+                goto _damaged;
+            }
+        } else if (frame.flags & FRAME_FLAG_HISTORY) {
+            // Raw block of a linked chain, the next ones may reference it
+            if (decodeHistory(&frame, pbuf) != (int)frame.size) {
+                if (!_resync)
+                    return(-5);
+                goto _damaged;
+            }
+        }
+
+        if (pbuf != _buffer)
+            return(frame.size);
+
+        _buf_size = frame.size;
+        return(0);
+
+_damaged:
+        if (!_resync)
+            return(-7);
+
+        // The header is sane, skip just this block
+        // (and the linked ones up to the next independent block)
+        _hist_size = 0;
+        _damaged_blocks++;
+        _skipped_bytes += FRAME_HEADER_SIZE + frame.csize;
+    }
+
+    return(-1);
+}
 
-    // Read Header
-    if (_readable->readVUInt(&size) <= 0)
+// Linked blocks are decoded right after the previous ones, in the history
+// window, then copied out (raw blocks are just copied in from 'dst').
+// Only the last FRAME_HISTORY_SIZE bytes are kept.
+int CompressedReader::decodeHistory (const FrameHeader *frame, uint8_t *dst) {
+    unsigned int prefix;
+    uint8_t *pbuf;
+    int n;
+
+    // A linked block without history: the chain was broken by a damaged
+    // block, or the reader did not start at an independent block.
+    if ((frame->flags & FRAME_FLAG_LINKED) && _hist_size == 0)
         return(-1);
 
-    if (_readable->readVUInt(&csize) <= 0)
-        return(-2);
-
-    // Read Compressed Data
-    uint8_t cbuffer[csize];
-    if (_readable->readFully(cbuffer, csize) != (int)csize)
-        return(-3);
-
-    // Prepare new buffer for data
-    if (size != _buf_size) {
-        if (_buffer != NULL)
-            delete[] _buffer;
-        _buffer = new uint8_t[size];
-        _buf_size = size;
-        _buf_readed = 0;
+    if (!(frame->flags & FRAME_FLAG_LINKED))
+        _hist_size = 0;
+
+    prefix = (_hist_size < FRAME_HISTORY_SIZE) ? _hist_size : FRAME_HISTORY_SIZE;
+    if ((uint64_t)_hist_size + frame->size > _hist_capacity) {
+        if ((uint64_t)prefix + frame->size > _hist_capacity) {
+            // Grow, with room for two windows the memmove is amortized
+            uint64_t capacity = (2 * FRAME_HISTORY_SIZE) + (uint64_t)frame->size;
+            if (capacity > 0xffffffffU)
+                return(-1);
+
+            if ((pbuf = (uint8_t *)_allocator->allocate(capacity)) == NULL)
+                return(-1);
+
+            if (prefix > 0)
+                memcpy(pbuf, _history + _hist_size - prefix, prefix);
+            if (_history != NULL)
+                _allocator->deallocate(_history, _hist_capacity);
+
+            _history = pbuf;
+            _hist_capacity = capacity;
+        } else {
+            memmove(_history, _history + _hist_size - prefix, prefix);
+        }
+        _hist_size = prefix;
+    }
+
+    pbuf = _history + _hist_size;
+    if (frame->codec == CODEC_ID_PLAIN) {
+        memcpy(pbuf, dst, frame->size);
+        _hist_size += frame->size;
+        return(frame->size);
+    }
+
+    if (frame->flags & FRAME_FLAG_LINKED)
+        n = decompressLinked(_cbuffer, frame->csize, pbuf, frame->size, prefix);
+    else
+        n = decompress(_cbuffer, frame->csize, pbuf, frame->size);
+
+    if (n != (int)frame->size) {
+        _hist_size = 0;
+        return(-1);
     }
 
-    // Uncompress
-    return(decompress(cbuffer, csize, _buffer, _buf_size));
+    memcpy(dst, pbuf, frame->size);
+    _hist_size += frame->size;
+    return(n);
 }
 
+// Scratch buffers only grow, blocks have usually the same size
+bool CompressedReader::reserve (uint8_t **buffer,
+                                unsigned int *capacity,
+                                uint64_t size)
+{
+    uint8_t *pbuf;
+
+    if (size <= *capacity)
+        return(true);
+
+    if (size > 0xffffffffU)
+        return(false);
+
+    if (*buffer != NULL)
+        _allocator->deallocate(*buffer, *capacity);
+
+    if ((pbuf = (uint8_t *)_allocator->allocate(size)) == NULL) {
+        *buffer = NULL;
+        *capacity = 0;
+        return(false);
+    }
+
+    *buffer = pbuf;
+    *capacity = size;
+    return(true);
+}
@@ -20,52 +20,139 @@
 #include <stdint.h>
 #include <stddef.h>
 
+#include "Allocator.h"
 #include "Readable.h"
+#include "CodecId.h"
+#include "lz4l.h"
 
+struct FrameHeader;
+
+// Blocks are read as checksummed frames (see Frame.h). By default the stored
+// data crc is verified, checking the decoded data costs a second crc pass.
+// With resync enabled damaged blocks are skipped instead of failing the read.
+// Linked blocks are decoded in a history window that keeps the previous 64KB,
+// after a damaged block the reader waits for the next independent one.
 class CompressedReader : public Readable {
     public:
-        CompressedReader(Readable *readable) {
+        CompressedReader(Readable *readable, Allocator *allocator=NULL) {
+            _allocator = (allocator != NULL) ? allocator : Allocator::heap();
             _readable = readable;
+            _buf_capacity = 0;
             _buf_readed = 0;
             _buf_size = 0;
             _buffer = NULL;
+            _cbuf_capacity = 0;
+            _cbuffer = NULL;
+            _hist_capacity = 0;
+            _hist_size = 0;
+            _history = NULL;
+            _verify_stored = true;
+            _verify_data = false;
+            _resync = false;
+            _damaged_blocks = 0;
+            _skipped_bytes = 0;
+        }
+
+        virtual ~CompressedReader() {
+            if (_buffer != NULL)
+                _allocator->deallocate(_buffer, _buf_capacity);
+            if (_cbuffer != NULL)
+                _allocator->deallocate(_cbuffer, _cbuf_capacity);
+            if (_history != NULL)
+                _allocator->deallocate(_history, _hist_capacity);
         }
 
         int read (void *buffer, unsigned int size);
 
+        void setVerify (bool stored, bool data) {
+            _verify_stored = stored;
+            _verify_data = data;
+        }
+
+        void setResync (bool resync) {
+            _resync = resync;
+        }
+
+        uint64_t damagedBlocks (void) const { return(_damaged_blocks); }
+        uint64_t skippedBytes  (void) const { return(_skipped_bytes); }
+
     protected:
-        virtual unsigned int decompress (const void *src,
-                                         unsigned int isize,
-                                         void *dst,
-                                         unsigned int osize) = 0;
+        virtual uint8_t codecId (void) const = 0;
+
+        // Returns the number of bytes written to dst, or -1 on corruption
+        virtual int decompress (const void *src,
+                                unsigned int isize,
+                                void *dst,
+                                unsigned int osize) = 0;
+
+        // Like decompress(), 'dst' is preceded by 'prefix_size' bytes of
+        // history that matches may reference. Only for linked codecs.
+        virtual int decompressLinked (const void *src,
+                                      unsigned int isize,
+                                      void *dst,
+                                      unsigned int osize,
+                                      unsigned int prefix_size)
+        {
+            return(-1);
+        }
 
     private:
-        int readBuffer (void);
+        int readBuffer (uint8_t *dst, unsigned int dst_size);
+        int decodeHistory (const FrameHeader *frame, uint8_t *dst);
+        bool reserve (uint8_t **buffer, unsigned int *capacity, uint64_t size);
 
     protected:
         Readable *_readable;
 
     private:
+        Allocator *  _allocator;
         uint8_t *    _buffer;
+        unsigned int _buf_capacity;
         unsigned int _buf_size;
         unsigned int _buf_readed;
+        uint8_t *    _cbuffer;          // Compressed block, reused across blocks
+        unsigned int _cbuf_capacity;
+        uint8_t *    _history;          // Decoded linked blocks
+        unsigned int _hist_capacity;
+        unsigned int _hist_size;
+        bool _verify_stored;
+        bool _verify_data;
+        bool _resync;
+        uint64_t _damaged_blocks;
+        uint64_t _skipped_bytes;
 };
 
-int LZ4_uncompress (char* source, char* dest, int osize);
 class Lz4Reader : public CompressedReader {
     public:
-        Lz4Reader(Readable *readable)
-            : CompressedReader(readable)
+        Lz4Reader(Readable *readable, Allocator *allocator=NULL)
+            : CompressedReader(readable, allocator)
         {
         }
 
     protected:
-        unsigned int decompress (const void *src,
-                                 unsigned int isize,
-                                 void *dst,
-                                 unsigned int osize)
+        uint8_t codecId (void) const {
+            return(CODEC_ID_LZ4);
+        }
+
+        int decompress (const void *src,
+                        unsigned int isize,
+                        void *dst,
+                        unsigned int osize)
+        {
+            int n = LZ4L_decompress_safe((const char *)src, (char *)dst,
+                                        isize, osize);
+            return((n < 0) ? -1 : n);
+        }
+
+        int decompressLinked (const void *src,
+                              unsigned int isize,
+                              void *dst,
+                              unsigned int osize,
+                              unsigned int prefix_size)
         {
-            return(LZ4_uncompress((char *)src, (char *)dst, osize));
+            int n = LZ4L_decompress_safe_usingPrefix((const char *)src, (char *)dst,
+                                                    isize, osize, prefix_size);
+            return((n < 0) ? -1 : n);
         }
 };
 
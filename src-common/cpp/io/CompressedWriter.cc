@@ -0,0 +1,292 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+
+#include <string.h>
+#include <math.h>
+
+#include "CompressedWriter.h"
+#include "Crc32c.h"
+#include "Frame.h"
+
+// Incompressible blocks in a row before sampling the data
+#define INCOMPRESSIBLE_PROBE_BLOCKS     4
+// Max number of blocks stored without trying the compressor
+#define INCOMPRESSIBLE_MAX_SKIP         64
+// Sampled entropy (bits per byte) above which the data is considered random
+#define RANDOM_ENTROPY_BITS             7.5
+#define ENTROPY_SAMPLE_MAX              4096
+#define ENTROPY_SAMPLE_RUN              64
+
+/* ============================================================================
+ *  Entropy sampling
+ */
+static double __sampleEntropy (const uint8_t *data, unsigned int size) {
+    unsigned int counts[256];
+    unsigned int stride, nsamples;
+    double entropy;
+
+    // Contiguous runs of bytes, a single byte stride aliases with
+    // periodic data (e.g. fixed size records)
+    stride = ENTROPY_SAMPLE_RUN;
+    if (size > ENTROPY_SAMPLE_MAX)
+        stride = (size / ENTROPY_SAMPLE_MAX) * ENTROPY_SAMPLE_RUN;
+
+    memset(counts, 0, sizeof(counts));
+    nsamples = 0;
+    for (unsigned int i = 0; i + ENTROPY_SAMPLE_RUN <= size; i += stride) {
+        for (unsigned int j = 0; j < ENTROPY_SAMPLE_RUN; ++j)
+            counts[data[i + j]]++;
+        nsamples += ENTROPY_SAMPLE_RUN;
+    }
+
+    // Small samples underestimate the entropy, don't skip on those
+    if (nsamples < 1024)
+        return(0.0);
+
+    entropy = 0.0;
+    for (unsigned int i = 0; i < 256; ++i) {
+        if (counts[i] > 0) {
+            double p = (double)counts[i] / nsamples;
+            entropy -= p * log2(p);
+        }
+    }
+    return(entropy);
+}
+
+/* ============================================================================
+ *  Compressed Writer
+ */
+CompressedWriter::CompressedWriter(Writable *writable,
+                                   unsigned int buf_size,
+                                   Allocator *allocator,
+                                   unsigned int min_saving)
+    : BufferedWriter(writable, buf_size, allocator)
+{
+    _cbuffer = NULL;
+    _cbuf_capacity = 0;
+    _compressed_blocks = 0;
+    _raw_blocks = 0;
+    _skipped_blocks = 0;
+    _incompressible = 0;
+    _skip_blocks = 0;
+    _skip_backoff = 1;
+    setMinSaving(min_saving);
+}
+
+CompressedWriter::~CompressedWriter() {
+    if (_cbuffer != NULL)
+        _allocator->deallocate(_cbuffer, _cbuf_capacity);
+}
+
+int CompressedWriter::flushBuffer (const void *buffer, unsigned int size) {
+    const uint8_t *data = (const uint8_t *)buffer;
+    unsigned int limit;
+    uint8_t flags;
+    int csize;
+
+    flags = prepareBlock(buffer, size);
+
+    // Skipping the compressor, unless the data does not look random anymore
+    if (_skip_blocks > 0) {
+        if (__sampleEntropy(data, size) >= RANDOM_ENTROPY_BITS) {
+            _skip_blocks--;
+            _skipped_blocks++;
+            _raw_blocks++;
+            return(writeBlock(CODEC_ID_PLAIN, flags, buffer, size, buffer, size));
+        }
+        _skip_blocks = 0;
+        _skip_backoff = 1;
+    }
+
+    // The output must save at least _min_saving percent, the compressor
+    // gives up as soon as it does not fit.
+    limit = size - (unsigned int)(((uint64_t)size * _min_saving) / 100);
+    if (limit > maxLengthForInput(size))
+        limit = maxLengthForInput(size);
+
+    // Scratch buffer only grows, blocks have usually the same size
+    if (limit > _cbuf_capacity) {
+        if (_cbuffer != NULL)
+            _allocator->deallocate(_cbuffer, _cbuf_capacity);
+
+        if ((_cbuffer = (uint8_t *)_allocator->allocate(limit)) == NULL) {
+            _cbuf_capacity = 0;
+            return(-1);
+        }
+        _cbuf_capacity = limit;
+    }
+
+    if ((csize = compress(buffer, size, _cbuffer, limit)) > 0 && (unsigned int)csize < size) {
+        _incompressible = 0;
+        _skip_backoff = 1;
+        _compressed_blocks++;
+        return(writeBlock(codecId(), flags, buffer, size, _cbuffer, csize));
+    }
+
+    // Incompressible, check if it is worth to skip the next blocks.
+    // Right after a skip period one failed probe is enough to skip again.
+    if (++_incompressible >= INCOMPRESSIBLE_PROBE_BLOCKS || _skip_backoff > 1) {
+        if (__sampleEntropy(data, size) >= RANDOM_ENTROPY_BITS) {
+            _skip_blocks = _skip_backoff;
+            if (_skip_backoff < INCOMPRESSIBLE_MAX_SKIP)
+                _skip_backoff <<= 1;
+        }
+        _incompressible = 0;
+    }
+
+    _raw_blocks++;
+    return(writeBlock(CODEC_ID_PLAIN, flags, buffer, size, buffer, size));
+}
+
+int CompressedWriter::writeBlock (uint8_t codec_id,
+                                  uint8_t flags,
+                                  const void *buffer,
+                                  unsigned int size,
+                                  const void *data,
+                                  unsigned int data_size)
+{
+    uint8_t header[FRAME_HEADER_SIZE];
+    FrameHeader frame;
+
+    frame.codec = codec_id;
+    frame.flags = FRAME_FLAG_DATA_CRC | flags;
+    frame.size = size;
+    frame.csize = data_size;
+    frame.dataCrc = crc32c(0, buffer, size);
+    frame.storedCrc = (data == buffer) ? frame.dataCrc : crc32c(0, data, data_size);
+    frame.encode(header);
+
+    if (_writable->writeFully(header, FRAME_HEADER_SIZE) != FRAME_HEADER_SIZE)
+        return(-1);
+
+    if (_writable->writeFully(data, data_size) != (int)data_size)
+        return(-1);
+
+    return(FRAME_HEADER_SIZE + data_size);
+}
+
+/* ============================================================================
+ *  LZ4 Writer
+ */
+// The state has not seen any block of the window
+#define LZ4_STATE_NONE                  0xffffffffU
+
+Lz4Writer::Lz4Writer(Writable *writable,
+                     unsigned int buf_size,
+                     Allocator *allocator,
+                     int acceleration,
+                     unsigned int checkpoint)
+    : CompressedWriter(writable, buf_size, allocator)
+{
+    _acceleration = (acceleration > 0) ? acceleration : 1;
+    _state = _allocator->allocate(LZ4L_sizeofState());
+    if (_state != NULL)
+        LZ4L_resetState(_state);
+
+    // Room for two windows of history, the memmove is amortized
+    _window = NULL;
+    _win_capacity = 0;
+    _win_size = 0;
+    _checkpoint = checkpoint;
+    _linked = 0;
+    _block = NULL;
+    _prefix = 0;
+    _state_end = LZ4_STATE_NONE;
+    if (_checkpoint > 1) {
+        _win_capacity = (2 * FRAME_HISTORY_SIZE) + buf_size;
+        if ((_window = (uint8_t *)_allocator->allocate(_win_capacity)) == NULL)
+            _win_capacity = 0;
+    }
+}
+
+Lz4Writer::~Lz4Writer() {
+    if (_state != NULL)
+        _allocator->deallocate(_state, LZ4L_sizeofState());
+    if (_window != NULL)
+        _allocator->deallocate(_window, _win_capacity);
+}
+
+// Linked blocks are copied in the window, right after the previous ones.
+// Raw blocks are part of the history too, the reader keeps them as well.
+uint8_t Lz4Writer::prepareBlock (const void *src, unsigned int size) {
+    _block = NULL;
+    _prefix = 0;
+
+    // Independent block
+    if (_window == NULL || size > (_win_capacity - FRAME_HISTORY_SIZE)) {
+        _state_end = LZ4_STATE_NONE;
+        _linked = 0;
+        return(0);
+    }
+
+    // Checkpoint, the history restarts from this block
+    if (_linked == 0) {
+        _state_end = LZ4_STATE_NONE;
+        _win_size = 0;
+    }
+
+    // Keep only the last 64KB in front of the new block
+    _prefix = (_win_size < FRAME_HISTORY_SIZE) ? _win_size : FRAME_HISTORY_SIZE;
+    if ((_win_size + size) > _win_capacity) {
+        memmove(_window, _window + _win_size - _prefix, _prefix);
+        if (_state_end != LZ4_STATE_NONE && _state_end >= (_win_size - _prefix))
+            _state_end -= (_win_size - _prefix);
+        else
+            _state_end = LZ4_STATE_NONE;
+        _win_size = _prefix;
+    }
+
+    _block = _window + _win_size;
+    memcpy(_block, src, size);
+    _win_size += size;
+
+    if (++_linked >= _checkpoint)
+        _linked = 0;
+
+    return(FRAME_FLAG_HISTORY | ((_prefix > 0) ? FRAME_FLAG_LINKED : 0));
+}
+
+int Lz4Writer::compress (const void *src,
+                         unsigned int isize,
+                         void *dst,
+                         unsigned int osize)
+{
+    unsigned int prefix;
+
+    if (_state == NULL)
+        return(-1);
+
+    if (_block != NULL) {
+        // The state must have seen the block right before this one
+        // (not the case after a raw block that skipped the compressor)
+        prefix = (_state_end == (unsigned int)(_block - _window)) ? _prefix : 0;
+        _state_end = (_block - _window) + isize;
+
+        if (prefix > 0) {
+            return(LZ4L_compress_fast_continue(_state,
+                                              (const char *)_block, (char *)dst,
+                                              isize, osize, _acceleration, prefix));
+        }
+
+        // Checkpoint, compressed from the window
+        src = _block;
+    }
+
+    return(LZ4L_compress_fast_extState(_state,
+                                      (const char *)src, (char *)dst,
+                                      isize, osize, _acceleration));
+}
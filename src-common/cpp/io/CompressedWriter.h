@@ -21,47 +21,111 @@
 #include <stddef.h>
 
 #include "BufferedWriter.h"
+#include "CodecId.h"
+#include "lz4l.h"
 
+// Blocks are stored uncompressed (CODEC_ID_PLAIN) when compression does not
+// save at least 'min_saving' percent. After a few incompressible blocks in a
+// row the compressor is skipped for a while, as long as a sample of the data
+// still looks random (already compressed media, encrypted data...).
+// Each block is written as a checksummed frame (see Frame.h).
 class CompressedWriter : public BufferedWriter {
     public:
-        CompressedWriter(Writable *writable, unsigned int buf_size)
-            : BufferedWriter(writable, buf_size)
-        {
+        CompressedWriter(Writable *writable,
+                         unsigned int buf_size,
+                         Allocator *allocator=NULL,
+                         unsigned int min_saving=3);
+        virtual ~CompressedWriter();
+
+        void setMinSaving (unsigned int percent) {
+            _min_saving = (percent < 100) ? percent : 99;
         }
 
+        uint64_t compressedBlocks (void) const { return(_compressed_blocks); }
+        uint64_t rawBlocks        (void) const { return(_raw_blocks); }
+        uint64_t skippedBlocks    (void) const { return(_skipped_blocks); }
+
     protected:
-        virtual int flushBuffer (const void *buffer, unsigned int size) {
-            uint8_t cbuffer[maxLengthForInput(size)];
-            unsigned int csize = compress(buffer, cbuffer, size);
-            // TODO: Check Returns
-            int n;
-            n  = _writable->writeVUInt(size);       // Uncompressed Size
-            n += _writable->writeVUInt(csize);      // Compressed Size
-            n += _writable->writeFully(cbuffer, csize);
-            return(n);
-        }
+        virtual int flushBuffer (const void *buffer, unsigned int size);
 
+        virtual uint8_t codecId (void) const = 0;
         virtual unsigned int maxLengthForInput (unsigned int size) const = 0;
-        virtual unsigned int compress (const void *src, void *dst, unsigned int size) = 0;
+        virtual int compress (const void *src,
+                              unsigned int isize,
+                              void *dst,
+                              unsigned int osize) = 0;
+
+        // Called for each block before compress() (that may be skipped),
+        // returns the frame flags (FRAME_FLAG_HISTORY...) of the block.
+        virtual uint8_t prepareBlock (const void *src, unsigned int size) {
+            return(0);
+        }
+
+    private:
+        // The block size (and the linked window) is the buf_size
+        using BufferedWriter::setAdaptive;
+
+        int writeBlock (uint8_t codec_id,
+                        uint8_t flags,
+                        const void *buffer,
+                        unsigned int size,
+                        const void *data,
+                        unsigned int data_size);
+
+    private:
+        uint8_t *    _cbuffer;          // Compress scratch, reused across blocks
+        unsigned int _cbuf_capacity;
+        uint64_t _compressed_blocks;
+        uint64_t _raw_blocks;
+        uint64_t _skipped_blocks;
+        unsigned int _min_saving;
+        unsigned int _incompressible;
+        unsigned int _skip_blocks;
+        unsigned int _skip_backoff;
 };
 
-int LZ4_compress (char* source, char* dest, int isize);
 class Lz4Writer : public CompressedWriter {
     public:
-        Lz4Writer(Writable *writable, unsigned int buf_size)
-            : CompressedWriter(writable, buf_size)
-        {
-        }
+        // acceleration: 1 is the default, higher values are faster
+        // but compress less (each step skips more input on a miss).
+        // checkpoint: 0 compresses each block on its own, otherwise blocks
+        // are linked (the previous 64KB are the dictionary of the next one)
+        // and every 'checkpoint' blocks one is independent, a reader can
+        // start from there. Small blocks get close to large block ratios.
+        Lz4Writer(Writable *writable,
+                  unsigned int buf_size,
+                  Allocator *allocator=NULL,
+                  int acceleration=1,
+                  unsigned int checkpoint=0);
+        ~Lz4Writer();
 
     protected:
-        unsigned int compress (const void *src, void *dst, unsigned int size) {
-            return(LZ4_compress((char *)src, (char *)dst, size));
+        uint8_t codecId (void) const {
+            return(CODEC_ID_LZ4);
         }
 
+        int compress (const void *src,
+                      unsigned int isize,
+                      void *dst,
+                      unsigned int osize);
+
+        uint8_t prepareBlock (const void *src, unsigned int size);
+
         unsigned int maxLengthForInput (unsigned int size) const {
-            unsigned int extra = (size * 0.4f);
-            return(size + ((extra > 8) ? extra : 8));
+            return(LZ4L_compressBound(size));
         }
+
+    private:
+        void *_state;
+        int _acceleration;
+        uint8_t *    _window;           // Previous 64KB + current block
+        unsigned int _win_capacity;
+        unsigned int _win_size;
+        unsigned int _checkpoint;
+        unsigned int _linked;           // Blocks since the last independent one
+        uint8_t *    _block;            // Prepared block, in the window
+        unsigned int _prefix;
+        unsigned int _state_end;        // Window offset after the last compress
 };
 
 #endif /* !_COMPRESSED_WRITER_H_ */
@@ -83,3 +83,12 @@ uint64_t DiskReader::length (void) {
     return(length);
 }
 
+unsigned int DiskReader::blockSize (void) {
+    struct stat buf;
+
+    if (fstat(_fd, &buf) < 0 || buf.st_blksize <= 0)
+        return(4096);
+
+    return(buf.st_blksize);
+}
+
@@ -36,6 +36,9 @@ class DiskReader : public Readable, public Seekable {
         uint64_t tell   (void);
         uint64_t length (void);
 
+        // Preferred I/O size (st_blksize), 4K if unknown
+        unsigned int blockSize (void);
+
     private:
         uint64_t _offset;
         int _fd;
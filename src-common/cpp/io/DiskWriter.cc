@@ -16,7 +16,10 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
+#include <limits.h>
+#include <string.h>
 #include <fcntl.h>
 
 #include "DiskWriter.h"
@@ -64,6 +67,44 @@ int DiskWriter::write (const void *buf, unsigned int size) {
     return(wr);
 }
 
+int DiskWriter::writev (const struct iovec *iov, int iovcnt) {
+    struct iovec vec[IOV_MAX];
+    struct iovec *pvec;
+    ssize_t wr;
+    int count;
+    int n = 0;
+
+    while (iovcnt > 0) {
+        count = (iovcnt > IOV_MAX) ? IOV_MAX : iovcnt;
+        memcpy(vec, iov, count * sizeof(struct iovec));
+        iov += count;
+        iovcnt -= count;
+
+        /* pwritev() may stop short, resume from the partial vector */
+        pvec = vec;
+        while (count > 0) {
+            if ((wr = pwritev(_fd, pvec, count, _offset)) <= 0)
+                return((n > 0) ? n : -1);
+
+            _offset += wr;
+            n += wr;
+
+            while (count > 0 && (size_t)wr >= pvec->iov_len) {
+                wr -= pvec->iov_len;
+                pvec++;
+                count--;
+            }
+
+            if (count > 0) {
+                pvec->iov_base = (uint8_t *)pvec->iov_base + wr;
+                pvec->iov_len -= wr;
+            }
+        }
+    }
+
+    return(n);
+}
+
 int DiskWriter::flush (void) {
     return(fsync(_fd));
 }
@@ -93,3 +134,12 @@ uint64_t DiskWriter::length (void) {
     return(length);
 }
 
+unsigned int DiskWriter::blockSize (void) {
+    struct stat buf;
+
+    if (fstat(_fd, &buf) < 0 || buf.st_blksize <= 0)
+        return(4096);
+
+    return(buf.st_blksize);
+}
+
@@ -30,6 +30,7 @@ class DiskWriter : public Writable, public Seekable {
         void close (void);
 
         int write (const void *buf, unsigned int size);
+        int writev (const struct iovec *iov, int iovcnt);
         int flush (void);
 
         int      seek   (uint64_t offset);
@@ -37,6 +38,9 @@ class DiskWriter : public Writable, public Seekable {
         uint64_t tell   (void);
         uint64_t length (void);
 
+        // Preferred I/O size (st_blksize), 4K if unknown
+        unsigned int blockSize (void);
+
     private:
         uint64_t _offset;
         int _fd;
@@ -0,0 +1,114 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+
+#include <string.h>
+
+#include "Crc32c.h"
+#include "Frame.h"
+
+static void __writeU32BE (uint8_t *buf, uint32_t value) {
+    buf[0] = (value >> 24) & 0xff;
+    buf[1] = (value >> 16) & 0xff;
+    buf[2] = (value >> 8) & 0xff;
+    buf[3] = value & 0xff;
+}
+
+static uint32_t __readU32BE (const uint8_t *buf) {
+    return(((uint32_t)buf[0] << 24) | ((uint32_t)buf[1] << 16) |
+           ((uint32_t)buf[2] << 8) | buf[3]);
+}
+
+// Offset of the next (possibly partial) magic after buffer[0]
+static unsigned int __scanMagic (const uint8_t *buffer, unsigned int size) {
+    for (unsigned int i = 1; i < size; ++i) {
+        unsigned int n = (size - i) < 4 ? (size - i) : 4;
+        if (!memcmp(buffer + i, FRAME_MAGIC, n))
+            return(i);
+    }
+    return(size);
+}
+
+void FrameHeader::encode (uint8_t *buffer) const {
+    memcpy(buffer, FRAME_MAGIC, 4);
+    buffer[4] = FRAME_VERSION;
+    buffer[5] = codec;
+    buffer[6] = flags;
+    buffer[7] = 0;
+    __writeU32BE(buffer + 8, size);
+    __writeU32BE(buffer + 12, csize);
+    __writeU32BE(buffer + 16, storedCrc);
+    __writeU32BE(buffer + 20, dataCrc);
+    __writeU32BE(buffer + 24, crc32c(0, buffer, 24));
+}
+
+int FrameHeader::decode (const uint8_t *buffer) {
+    if (memcmp(buffer, FRAME_MAGIC, 4))
+        return(-1);
+
+    if (__readU32BE(buffer + 24) != crc32c(0, buffer, 24))
+        return(-2);
+
+    if (buffer[4] != FRAME_VERSION)
+        return(-3);
+
+    codec = buffer[5];
+    flags = buffer[6];
+    size = __readU32BE(buffer + 8);
+    csize = __readU32BE(buffer + 12);
+    storedCrc = __readU32BE(buffer + 16);
+    dataCrc = __readU32BE(buffer + 20);
+    return(0);
+}
+
+int FrameHeader::read (Readable *readable, bool resync, uint64_t *skipped) {
+    uint8_t buffer[FRAME_HEADER_SIZE];
+    unsigned int avail = 0;
+    unsigned int offset;
+    int err, rd;
+
+    while (true) {
+        rd = readable->readFully(buffer + avail, FRAME_HEADER_SIZE - avail);
+        if (rd < 0)
+            rd = 0;
+
+        if ((avail += rd) < FRAME_HEADER_SIZE) {
+            // Truncated tail, nothing else to read
+            if (avail == 0)
+                return(0);
+
+            if (!resync)
+                return(-4);
+
+            *skipped += avail;
+            return(0);
+        }
+
+        if ((err = decode(buffer)) == 0)
+            return(1);
+
+        if (!resync)
+            return(err);
+
+        // Slide to the next candidate magic
+        offset = __scanMagic(buffer, FRAME_HEADER_SIZE);
+        memmove(buffer, buffer + offset, FRAME_HEADER_SIZE - offset);
+        avail = FRAME_HEADER_SIZE - offset;
+        *skipped += offset;
+    }
+
+    return(-1);
+}
@@ -0,0 +1,65 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+
+#ifndef _FRAME_H_
+#define _FRAME_H_
+
+#include <stdint.h>
+
+#include "Readable.h"
+
+// Block frame, same layout as the C encoded streams (c/io/frame.h).
+//
+//  0  magic "CBLK"         8  size  (u32 BE)   20 data crc   (u32 BE)
+//  4  version              12 csize (u32 BE)   24 header crc (u32 BE)
+//  5  codec id             16 stored crc (u32 BE)
+//  6  flags, 7 reserved
+//
+// The header crc covers bytes 0-23, a reader that lost the sync can scan
+// for the magic and trust only headers that check out.
+#define FRAME_MAGIC                 "CBLK"
+#define FRAME_VERSION               1
+#define FRAME_HEADER_SIZE           28
+
+#define FRAME_FLAG_DATA_CRC         (1 << 0)
+// The decoded block is history for the next linked block (up to 64KB)
+#define FRAME_FLAG_HISTORY          (1 << 1)
+// Continues the history of the previous blocks (otherwise it restarts),
+// compressed blocks may reference it
+#define FRAME_FLAG_LINKED           (1 << 2)
+
+// History a linked block can reference
+#define FRAME_HISTORY_SIZE          (64 << 10)
+
+struct FrameHeader {
+    uint8_t  codec;
+    uint8_t  flags;
+    uint32_t size;
+    uint32_t csize;
+    uint32_t storedCrc;     // crc32c of the csize bytes after the header
+    uint32_t dataCrc;       // crc32c of the decoded block
+
+    void encode (uint8_t *buffer) const;
+    int  decode (const uint8_t *buffer);
+
+    // Returns 1 on success, 0 at the end of the stream and a negative
+    // value on a damaged header. With 'resync' damaged bytes are skipped
+    // (and added to 'skipped') until a valid header is found.
+    int read (Readable *readable, bool resync, uint64_t *skipped);
+};
+
+#endif /* !_FRAME_H_ */
@@ -91,7 +91,7 @@ int Readable::readVUInt (uint64_t *value) {
     uint64_t result = 0;
     unsigned int shift;
     uint8_t buffer;
-    int rd;
+    int rd = 0;
 
     for (shift = 0; shift < 64; shift += 7) {
         if (read(&buffer, 1) != 1)
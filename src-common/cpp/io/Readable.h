@@ -21,6 +21,8 @@
 
 class Readable {
     public:
+        virtual ~Readable() {}
+
         virtual int read (void *buf, unsigned int size) = 0;
 
         int readFully  (void *buffer, unsigned int size);
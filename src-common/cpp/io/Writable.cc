@@ -39,6 +39,24 @@ int Writable::writeFully (const void *buffer, unsigned int size) {
     return(n);
 }
 
+int Writable::writev (const struct iovec *iov, int iovcnt) {
+    int n = 0;
+    int wr;
+
+    while (iovcnt-- > 0) {
+        wr = writeFully(iov->iov_base, iov->iov_len);
+        if (wr > 0)
+            n += wr;
+
+        if (wr != (int)iov->iov_len)
+            return((n > 0) ? n : -1);
+
+        iov++;
+    }
+
+    return(n);
+}
+
 int Writable::writeUInt8 (uint8_t value) {
     return(writeFully(&value, 1));
 }
@@ -17,13 +17,19 @@
 #ifndef _WRITEABLE_H_
 #define _WRITEABLE_H_
 
+#include <sys/uio.h>
 #include <stdint.h>
 
 class Writable {
     public:
+        virtual ~Writable() {}
+
         virtual int write (const void *buf, unsigned int size) = 0;
         virtual int flush (void) = 0;
 
+        /* Gather write, returns the bytes written (short only on error) */
+        virtual int writev (const struct iovec *iov, int iovcnt);
+
         int writeFully   (const void *buffer, unsigned int size);
 
         int writeInt8   (int8_t value);
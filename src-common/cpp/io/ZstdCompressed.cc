@@ -0,0 +1,170 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+
+#ifdef HAVE_ZSTD
+
+#include <stdlib.h>
+
+#include <zstd.h>
+#include <zdict.h>
+
+#include "ZstdCompressed.h"
+
+#define ZSTD_LONG_WINDOW_LOG        27
+
+/* ============================================================================
+ *  Zstd Dictionary
+ */
+ZstdDictionary::ZstdDictionary() {
+    _cdict = NULL;
+    _ddict = NULL;
+}
+
+ZstdDictionary::~ZstdDictionary() {
+    ZSTD_freeCDict((ZSTD_CDict *)_cdict);
+    ZSTD_freeDDict((ZSTD_DDict *)_ddict);
+}
+
+bool ZstdDictionary::load (const void *dict, unsigned int size, int level) {
+    ZSTD_CDict *cdict;
+    ZSTD_DDict *ddict;
+
+    level = (level < 1) ? 1 : ((level > 19) ? 19 : level);
+    if ((cdict = ZSTD_createCDict(dict, size, level)) == NULL)
+        return(false);
+
+    if ((ddict = ZSTD_createDDict(dict, size)) == NULL) {
+        ZSTD_freeCDict(cdict);
+        return(false);
+    }
+
+    ZSTD_freeCDict((ZSTD_CDict *)_cdict);
+    ZSTD_freeDDict((ZSTD_DDict *)_ddict);
+    _cdict = cdict;
+    _ddict = ddict;
+    return(true);
+}
+
+int ZstdDictionary::train (void *dict,
+                           unsigned int capacity,
+                           const void *samples,
+                           const unsigned int *sizes,
+                           unsigned int nsamples)
+{
+    size_t *ssizes;
+    size_t size;
+
+    if ((ssizes = (size_t *) malloc(nsamples * sizeof(size_t))) == NULL)
+        return(-1);
+
+    for (unsigned int i = 0; i < nsamples; ++i)
+        ssizes[i] = sizes[i];
+
+    size = ZDICT_trainFromBuffer(dict, capacity, samples, ssizes, nsamples);
+    free(ssizes);
+
+    return(ZDICT_isError(size) ? -1 : (int)size);
+}
+
+/* ============================================================================
+ *  Zstd Writer
+ */
+ZstdWriter::ZstdWriter(Writable *writable,
+                       unsigned int buf_size,
+                       Allocator *allocator,
+                       int level,
+                       bool long_distance,
+                       const ZstdDictionary *dict)
+    : CompressedWriter(writable, buf_size, allocator)
+{
+    ZSTD_CCtx *cctx;
+
+    if ((_cctx = cctx = ZSTD_createCCtx()) == NULL)
+        return;
+
+    level = (level < 1) ? 1 : ((level > 19) ? 19 : level);
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level);
+    if (long_distance) {
+        ZSTD_CCtx_setParameter(cctx, ZSTD_c_enableLongDistanceMatching, 1);
+        ZSTD_CCtx_setParameter(cctx, ZSTD_c_windowLog, ZSTD_LONG_WINDOW_LOG);
+    }
+
+    if (dict != NULL && dict->cdict() != NULL)
+        ZSTD_CCtx_refCDict(cctx, (const ZSTD_CDict *)dict->cdict());
+}
+
+ZstdWriter::~ZstdWriter() {
+    ZSTD_freeCCtx((ZSTD_CCtx *)_cctx);
+}
+
+int ZstdWriter::compress (const void *src,
+                          unsigned int isize,
+                          void *dst,
+                          unsigned int osize)
+{
+    size_t size;
+
+    if (_cctx == NULL)
+        return(-1);
+
+    size = ZSTD_compress2((ZSTD_CCtx *)_cctx, dst, osize, src, isize);
+    return(ZSTD_isError(size) ? -1 : (int)size);
+}
+
+unsigned int ZstdWriter::maxLengthForInput (unsigned int size) const {
+    return(ZSTD_compressBound(size));
+}
+
+/* ============================================================================
+ *  Zstd Reader
+ */
+ZstdReader::ZstdReader(Readable *readable,
+                       Allocator *allocator,
+                       const ZstdDictionary *dict)
+    : CompressedReader(readable, allocator)
+{
+    ZSTD_DCtx *dctx;
+
+    if ((_dctx = dctx = ZSTD_createDCtx()) == NULL)
+        return;
+
+    // Accept long distance blocks, whatever the writer settings were
+    ZSTD_DCtx_setParameter(dctx, ZSTD_d_windowLogMax, ZSTD_LONG_WINDOW_LOG);
+
+    if (dict != NULL && dict->ddict() != NULL)
+        ZSTD_DCtx_refDDict(dctx, (const ZSTD_DDict *)dict->ddict());
+}
+
+ZstdReader::~ZstdReader() {
+    ZSTD_freeDCtx((ZSTD_DCtx *)_dctx);
+}
+
+int ZstdReader::decompress (const void *src,
+                            unsigned int isize,
+                            void *dst,
+                            unsigned int osize)
+{
+    size_t size;
+
+    if (_dctx == NULL)
+        return(-1);
+
+    size = ZSTD_decompressDCtx((ZSTD_DCtx *)_dctx, dst, osize, src, isize);
+    return(ZSTD_isError(size) ? -1 : (int)size);
+}
+
+#endif /* HAVE_ZSTD */
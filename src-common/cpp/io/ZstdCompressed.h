@@ -0,0 +1,109 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+
+#ifndef _ZSTD_COMPRESSED_H_
+#define _ZSTD_COMPRESSED_H_
+
+#ifdef HAVE_ZSTD
+
+#include "CompressedWriter.h"
+#include "CompressedReader.h"
+
+// Shared zstd dictionary, used to compress small blocks (records) that
+// have too little content on their own. The same dictionary must be given
+// to the writer and to the reader, and must outlive both.
+class ZstdDictionary {
+    public:
+        ZstdDictionary();
+        ~ZstdDictionary();
+
+        // Load a dictionary (trained or raw content). The level is the one
+        // used by the writers that reference this dictionary.
+        bool load (const void *dict, unsigned int size, int level=3);
+
+        // Train a dictionary from 'nsamples' concatenated samples.
+        // Returns the dictionary size, or -1 on failure.
+        static int train (void *dict,
+                          unsigned int capacity,
+                          const void *samples,
+                          const unsigned int *sizes,
+                          unsigned int nsamples);
+
+        const void *cdict (void) const { return(_cdict); }
+        const void *ddict (void) const { return(_ddict); }
+
+    private:
+        ZstdDictionary(const ZstdDictionary& other);
+        ZstdDictionary& operator= (const ZstdDictionary& other);
+
+    private:
+        void *_cdict;
+        void *_ddict;
+};
+
+class ZstdWriter : public CompressedWriter {
+    public:
+        // level: 1-19, long_distance enables the long distance matcher
+        // (128M window) useful for big blocks of archived data.
+        ZstdWriter(Writable *writable,
+                   unsigned int buf_size,
+                   Allocator *allocator=NULL,
+                   int level=3,
+                   bool long_distance=false,
+                   const ZstdDictionary *dict=NULL);
+        ~ZstdWriter();
+
+    protected:
+        uint8_t codecId (void) const {
+            return(CODEC_ID_ZSTD);
+        }
+
+        int compress (const void *src,
+                      unsigned int isize,
+                      void *dst,
+                      unsigned int osize);
+
+        unsigned int maxLengthForInput (unsigned int size) const;
+
+    private:
+        void *_cctx;
+};
+
+class ZstdReader : public CompressedReader {
+    public:
+        ZstdReader(Readable *readable,
+                   Allocator *allocator=NULL,
+                   const ZstdDictionary *dict=NULL);
+        ~ZstdReader();
+
+    protected:
+        uint8_t codecId (void) const {
+            return(CODEC_ID_ZSTD);
+        }
+
+        int decompress (const void *src,
+                        unsigned int isize,
+                        void *dst,
+                        unsigned int osize);
+
+    private:
+        void *_dctx;
+};
+
+#endif /* HAVE_ZSTD */
+
+#endif /* !_ZSTD_COMPRESSED_H_ */
@@ -728,3 +728,379 @@ _output_error:
 	return (int) (-(((char*)ip)-source));
 }
 
+
+
+
+//****************************
+// Bounded compression
+//****************************
+
+// The state keeps a table of positions (U32, relative to 'currentOffset')
+// instead of pointers, so it can be reused across calls without clearing:
+// an independent call starts MAX_DISTANCE past the previous input, the old
+// entries are then too far to be accepted as matches. A linked call starts
+// right after the previous input, its entries become the dictionary.
+#define LZ4_STATE_HASHLOG		(HASH_LOG+1)
+#define LZ4_STATE_HASHSIZE		(1 << LZ4_STATE_HASHLOG)
+#define LZ4_STATE_GAP			(1U << MAXD_LOG)
+#define LZ4_STATE_MAXOFFSET		(1U << 30)
+#define LZ4_STATE_HASH(p)		((A32(p) * 2654435761U) >> ((MINMATCH*8)-LZ4_STATE_HASHLOG))
+
+struct LZ4_state
+{
+	U32 hashTable[LZ4_STATE_HASHSIZE];
+	U32 currentOffset;		// End of the previous input
+};
+
+static inline int LZ4_countMatch(const BYTE* ip, const BYTE* ref, const BYTE* const limit)
+{
+	const BYTE* const start = ip;
+
+#if defined(__GNUC__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+	while (ip + 8 <= limit)
+	{
+		unsigned long long a, b;
+		memcpy(&a, ip, 8);
+		memcpy(&b, ref, 8);
+		if (a != b) return (int)(ip - start) + (__builtin_ctzll(a ^ b) >> 3);
+		ip += 8; ref += 8;
+	}
+#endif
+	while ((ip < limit) && (*ip == *ref)) { ip++; ref++; }
+	return (int)(ip - start);
+}
+
+int LZ4L_compressBound(int isize)
+{
+	return isize + (isize / 255) + 16;
+}
+
+int LZ4L_sizeofState(void)
+{
+	return sizeof(struct LZ4_state);
+}
+
+void LZ4L_resetState(void* state)
+{
+	struct LZ4_state* ctx = (struct LZ4_state*) state;
+	memset(ctx->hashTable, 0, sizeof(ctx->hashTable));
+	ctx->currentOffset = 0;
+}
+
+// prefixSize: bytes right before 'source' that are the previous input of a
+// linked call (0 for an independent block). Matches never go below them.
+static int LZ4_compress_state_generic(struct LZ4_state* const ctx,
+				 const char* source,
+				 char* dest,
+				 int isize,
+				 int maxOutputSize,
+				 int acceleration,
+				 int prefixSize)
+{
+	U32* const HashTable = ctx->hashTable;
+
+	const BYTE* ip = (const BYTE*) source;
+	const BYTE* anchor = ip;
+	const BYTE* const lowLimit = ip - prefixSize;
+	const BYTE* base;
+	const BYTE* const iend = ip + isize;
+	const BYTE* const mflimit = iend - MFLIMIT;
+	const BYTE* const mlimit = iend - LASTLITERALS;
+	const BYTE* ref;
+
+	BYTE* op = (BYTE*) dest;
+	BYTE* const oend = op + maxOutputSize;
+	BYTE* token;
+
+	U32 offset, cur, refPos, h;
+	int len, length;
+
+	if ((isize < 0) || ((U32)isize > LZ4_STATE_MAXOFFSET) || (maxOutputSize < 0)) return 0;
+	if ((prefixSize < 0) || (prefixSize > MAX_DISTANCE + 1)) return 0;
+	if (acceleration < 1) acceleration = 1;
+
+	// Init, the table is cleared only when the offsets would wrap
+	// (a linked call loses its dictionary, the output is still valid)
+	if (ctx->currentOffset > LZ4_STATE_MAXOFFSET)
+		LZ4L_resetState(ctx);
+	offset = ctx->currentOffset;
+	if ((prefixSize == 0) || (offset == 0)) offset += LZ4_STATE_GAP;
+	ctx->currentOffset = offset + isize;
+
+	// Positions are U32 offsets from 'base', entries of a linked call
+	// may point up to MAX_DISTANCE before 'source'
+	base = ip - offset;
+
+	if (isize < MINLENGTH) goto _last_literals;
+
+	// First Byte
+	HashTable[LZ4_STATE_HASH(ip)] = offset;
+	ip++;
+
+	// Main Loop
+	for ( ; ; )
+	{
+		U32 searchMatchNb = ((U32)acceleration << SKIPSTRENGTH);
+		const BYTE* forwardIp = ip;
+		U32 forwardH = LZ4_STATE_HASH(ip);
+
+		// Find a match, the step grows with the misses (and the acceleration)
+		do {
+			U32 step = searchMatchNb++ >> SKIPSTRENGTH;
+			h = forwardH;
+			ip = forwardIp;
+			forwardIp = ip + step;
+
+			if (forwardIp > mflimit) { goto _last_literals; }
+
+			forwardH = LZ4_STATE_HASH(forwardIp);
+			cur = (U32)(ip - base);
+			refPos = HashTable[h];
+			HashTable[h] = cur;
+		} while (((cur - refPos) > MAX_DISTANCE) || (A32(base + refPos) != A32(ip)));
+		ref = base + refPos;
+
+		// Catch up
+		while ((ip>anchor) && (ref>lowLimit) && (ip[-1]==ref[-1])) { ip--; ref--; }
+
+		// Encode Literal length
+		length = (int)(ip - anchor);
+		token = op++;
+		if (op + length + (2 + 1 + LASTLITERALS) + (length / 255) > oend) return 0;
+		if (length>=(int)RUN_MASK) { *token=(RUN_MASK<<ML_BITS); len = length-RUN_MASK; for(; len > 254 ; len-=255) *op++ = 255; *op++ = (BYTE)len; }
+		else *token = (BYTE)(length<<ML_BITS);
+
+		// Copy Literals
+		memcpy(op, anchor, length);
+		op += length;
+
+_next_match:
+		// Encode Offset
+		{
+			U32 delta = (U32)(ip - ref);
+			*op++ = (BYTE)delta;
+			*op++ = (BYTE)(delta >> 8);
+		}
+
+		// Count and Encode MatchLength
+		len = LZ4_countMatch(ip + MINMATCH, ref + MINMATCH, mlimit);
+		ip += MINMATCH + len;
+		if (op + (1 + LASTLITERALS) + (len >> 8) > oend) return 0;
+		if (len>=(int)ML_MASK) { *token+=ML_MASK; len-=ML_MASK; for(; len > 509 ; len-=510) { *op++ = 255; *op++ = 255; } if (len > 254) { len-=255; *op++ = 255; } *op++ = (BYTE)len; }
+		else *token += (BYTE)len;
+
+		// Test end of chunk
+		anchor = ip;
+		if (ip > mflimit) break;
+
+		// Fill table
+		HashTable[LZ4_STATE_HASH(ip-2)] = (U32)(ip - 2 - base);
+
+		// Test next position
+		h = LZ4_STATE_HASH(ip);
+		cur = (U32)(ip - base);
+		refPos = HashTable[h];
+		HashTable[h] = cur;
+		if (((cur - refPos) <= MAX_DISTANCE) && (A32(base + refPos) == A32(ip)))
+		{
+			ref = base + refPos;
+			token = op++; *token=0;
+			goto _next_match;
+		}
+
+		// Prepare next loop
+		ip++;
+	}
+
+_last_literals:
+	// Encode Last Literals
+	{
+		int lastRun = (int)(iend - anchor);
+		if (op + lastRun + 1 + ((lastRun + 255 - RUN_MASK) / 255) > oend) return 0;
+		if (lastRun>=(int)RUN_MASK) { *op++=(RUN_MASK<<ML_BITS); lastRun-=RUN_MASK; for(; lastRun > 254 ; lastRun-=255) *op++ = 255; *op++ = (BYTE) lastRun; }
+		else *op++ = (BYTE)(lastRun<<ML_BITS);
+		memcpy(op, anchor, iend - anchor);
+		op += iend-anchor;
+	}
+
+	// End
+	return (int) (((char*)op)-dest);
+}
+
+int LZ4L_compress_fast_extState(void* state,
+				 const char* source,
+				 char* dest,
+				 int isize,
+				 int maxOutputSize,
+				 int acceleration)
+{
+	return LZ4_compress_state_generic((struct LZ4_state*) state, source, dest,
+				 isize, maxOutputSize, acceleration, 0);
+}
+
+// Note : LZ4L_compress_fast_continue() uses the 'prefixSize' bytes right before
+//		'source' (up to 64KB) as dictionary. They must be the input of the
+//		previous calls on the same state, since the last independent call.
+//		Decode with LZ4L_decompress_safe_usingPrefix() and the same prefix.
+int LZ4L_compress_fast_continue(void* state,
+				 const char* source,
+				 char* dest,
+				 int isize,
+				 int maxOutputSize,
+				 int acceleration,
+				 int prefixSize)
+{
+	return LZ4_compress_state_generic((struct LZ4_state*) state, source, dest,
+				 isize, maxOutputSize, acceleration, prefixSize);
+}
+
+int LZ4L_compress_fast(const char* source,
+				 char* dest,
+				 int isize,
+				 int maxOutputSize,
+				 int acceleration)
+{
+	struct LZ4_state* state;
+	int result;
+
+	if ((state = (struct LZ4_state*) malloc(sizeof(struct LZ4_state))) == NULL) return 0;
+	LZ4L_resetState(state);
+	result = LZ4L_compress_fast_extState(state, source, dest, isize, maxOutputSize, acceleration);
+	free(state);
+	return result;
+}
+
+
+
+//****************************
+// Safe decompression
+//****************************
+
+// Note : LZ4L_decompress_safe() checks every read against the input size and
+//		every write against maxOutputSize, and never references data before
+//		'dest'. A corrupted input returns a negative value; a valid one
+//		returns the number of bytes written in 'dest'.
+//		LZ4L_decompress_safe_usingPrefix() also accepts references to the
+//		'prefixSize' bytes right before 'dest' (the previous linked blocks).
+
+static int LZ4_decompress_safe_generic(const char* source,
+				 char* dest,
+				 int isize,
+				 int maxOutputSize,
+				 int prefixSize)
+{
+	const BYTE* ip = (const BYTE*) source;
+	const BYTE* const iend = ip + isize;
+	const BYTE* ref;
+
+	BYTE* op = (BYTE*) dest;
+	BYTE* const oend = op + maxOutputSize;
+	BYTE* const lowPrefix = op - prefixSize;
+
+	size_t length, offset;
+	unsigned int s;
+	BYTE token;
+
+	if ((isize <= 0) || (maxOutputSize < 0) || (prefixSize < 0)) return -1;
+
+	// Main Loop
+	while (1)
+	{
+		// get runlength
+		if (ip >= iend) goto _output_error;
+		token = *ip++;
+		if ((length=(token>>ML_BITS)) == RUN_MASK)
+		{
+			do {
+				if (ip >= iend) goto _output_error;
+				s = *ip++;
+				length += s;
+			} while (s == 255);
+			if (length > (size_t)maxOutputSize) goto _output_error;
+		}
+
+		// copy literals
+		if ((length > (size_t)(iend - ip)) || (length > (size_t)(oend - op))) goto _output_error;
+		if ((length <= (size_t)(iend - ip) - COPYLENGTH) && (length <= (size_t)(oend - op) - COPYLENGTH) &&
+			((size_t)(iend - ip) >= COPYLENGTH) && ((size_t)(oend - op) >= COPYLENGTH))
+		{
+			BYTE* const cpy = op + length;
+			while (op < cpy) { memcpy(op, ip, 8); op += 8; ip += 8; }
+			ip -= (op - cpy); op = cpy;
+		}
+		else
+		{
+			memcpy(op, ip, length);
+			op += length; ip += length;
+		}
+
+		// The last sequence has no match
+		if (ip == iend) break;
+
+		// get offset
+		if ((iend - ip) < 2) goto _output_error;
+		offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+		ip += 2;
+		if ((offset == 0) || (offset > (size_t)(op - lowPrefix))) goto _output_error;
+		ref = op - offset;
+
+		// get matchlength
+		if ((length=(token&ML_MASK)) == ML_MASK)
+		{
+			do {
+				if (ip >= iend) goto _output_error;
+				s = *ip++;
+				length += s;
+			} while (s == 255);
+		}
+		length += MINMATCH;
+		if (length > (size_t)(oend - op)) goto _output_error;
+
+		// copy repeated sequence
+		if (offset < 8)
+		{
+			// Short period: copy the first bytes one by one, then move ref
+			// back by a multiple of the period, at least 8 bytes behind op
+			size_t period = offset * ((8 + offset - 1) / offset);
+			size_t n = (length < period) ? length : period;
+			length -= n;
+			while (n-- > 0) *op++ = *ref++;
+			ref = op - period;
+		}
+
+		if ((size_t)(oend - op) >= length + COPYLENGTH)
+		{
+			BYTE* const cpy = op + length;
+			while (op < cpy) { memcpy(op, ref, 8); op += 8; ref += 8; }
+			op = cpy;
+		}
+		else
+		{
+			while (length-- > 0) *op++ = *ref++;
+		}
+	}
+
+	// end of decoding
+	return (int) (((char*)op)-dest);
+
+	// input or output overflow detected
+_output_error:
+	return (int) (-(((char*)ip)-source)) - 1;
+}
+
+int LZ4L_decompress_safe(const char* source,
+				 char* dest,
+				 int isize,
+				 int maxOutputSize)
+{
+	return LZ4_decompress_safe_generic(source, dest, isize, maxOutputSize, 0);
+}
+
+int LZ4L_decompress_safe_usingPrefix(const char* source,
+				 char* dest,
+				 int isize,
+				 int maxOutputSize,
+				 int prefixSize)
+{
+	return LZ4_decompress_safe_generic(source, dest, isize, maxOutputSize, prefixSize);
+}
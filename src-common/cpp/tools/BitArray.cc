@@ -0,0 +1,400 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+
+#if defined(__BMI2__)
+    #include <immintrin.h>
+#elif defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
+#include "BitArray.h"
+
+#define __WORDS(nbits)              (((nbits) + 63) >> 6)
+#define __SUPER_WORDS               8       /* 512 bits per rank superblock */
+#define __SUPER_SHIFT               9
+#define __SELECT_SHIFT              9       /* a select sample every 512 set bits */
+
+static inline unsigned int __popcount64 (uint64_t x) {
+    return(__builtin_popcountll(x));
+}
+
+/* Position of the n-th set bit of 'word' (n < popcount(word)) */
+static inline unsigned int __select64 (uint64_t word, unsigned int n) {
+#if defined(__BMI2__)
+    return(__builtin_ctzll(_pdep_u64(1ull << n, word)));
+#else
+    while (n-- > 0)
+        word &= word - 1;
+    return(__builtin_ctzll(word));
+#endif
+}
+
+BitArray::BitArray(size_t length) {
+    _ranks = NULL;
+    _samples = NULL;
+    _nsamples = 0;
+    _dirty = true;
+
+    _length = length;
+    if ((_blocks = (uint64_t *)calloc(__WORDS(length) + 1, sizeof(uint64_t))) == NULL)
+        _length = 0;
+}
+
+BitArray::BitArray(const BitArray& other) {
+    _ranks = NULL;
+    _samples = NULL;
+    _nsamples = 0;
+    _dirty = true;
+
+    _length = other._length;
+    if ((_blocks = (uint64_t *)malloc((__WORDS(_length) + 1) * sizeof(uint64_t))) == NULL)
+        _length = 0;
+    else
+        memcpy(_blocks, other._blocks, (__WORDS(_length) + 1) * sizeof(uint64_t));
+}
+
+BitArray::~BitArray() {
+    free(_blocks);
+    free(_ranks);
+    free(_samples);
+}
+
+BitArray& BitArray::operator= (const BitArray& other) {
+    if (this != &other && resize(other._length) == 0) {
+        memcpy(_blocks, other._blocks, __WORDS(_length) * sizeof(uint64_t));
+        _dirty = true;
+    }
+    return(*this);
+}
+
+int BitArray::resize (size_t length) {
+    size_t owords = __WORDS(_length);
+    size_t nwords = __WORDS(length);
+    uint64_t *blocks;
+
+    /* One spare word, keeps the word loops free of bound checks */
+    if (nwords != owords) {
+        blocks = (uint64_t *)realloc(_blocks, (nwords + 1) * sizeof(uint64_t));
+        if (blocks == NULL)
+            return(-1);
+
+        _blocks = blocks;
+        if (nwords > owords)
+            memset(_blocks + owords, 0, (nwords - owords + 1) * sizeof(uint64_t));
+        else
+            _blocks[nwords] = 0;
+    }
+
+    _length = length;
+    maskTail();
+    _dirty = true;
+    return(0);
+}
+
+void BitArray::setRange (size_t start, size_t end) {
+    size_t ws, we;
+    uint64_t first, last;
+
+    if (end > _length)
+        end = _length;
+    if (start >= end)
+        return;
+
+    ws = start >> 6;
+    we = (end - 1) >> 6;
+    first = ~0ull << (start & 63);
+    last = ~0ull >> (63 - ((end - 1) & 63));
+
+    if (ws == we) {
+        _blocks[ws] |= (first & last);
+    } else {
+        _blocks[ws] |= first;
+        memset(_blocks + ws + 1, 0xff, (we - ws - 1) * sizeof(uint64_t));
+        _blocks[we] |= last;
+    }
+
+    _dirty = true;
+}
+
+void BitArray::unsetRange (size_t start, size_t end) {
+    size_t ws, we;
+    uint64_t first, last;
+
+    if (end > _length)
+        end = _length;
+    if (start >= end)
+        return;
+
+    ws = start >> 6;
+    we = (end - 1) >> 6;
+    first = ~0ull << (start & 63);
+    last = ~0ull >> (63 - ((end - 1) & 63));
+
+    if (ws == we) {
+        _blocks[ws] &= ~(first & last);
+    } else {
+        _blocks[ws] &= ~first;
+        memset(_blocks + ws + 1, 0, (we - ws - 1) * sizeof(uint64_t));
+        _blocks[we] &= ~last;
+    }
+
+    _dirty = true;
+}
+
+size_t BitArray::count (void) const {
+    size_t i, nwords = __WORDS(_length);
+    size_t c0 = 0, c1 = 0;
+
+    /* Two accumulators, the popcnt latency is the bottleneck */
+    for (i = 0; (i + 2) <= nwords; i += 2) {
+        c0 += __popcount64(_blocks[i]);
+        c1 += __popcount64(_blocks[i + 1]);
+    }
+
+    if (i < nwords)
+        c0 += __popcount64(_blocks[i]);
+
+    return(c0 + c1);
+}
+
+size_t BitArray::nextSetBit (size_t index) const {
+    size_t w, nwords = __WORDS(_length);
+    uint64_t word;
+
+    if (index >= _length)
+        return(BIT_ARRAY_NPOS);
+
+    w = index >> 6;
+    word = _blocks[w] & (~0ull << (index & 63));
+    while (word == 0) {
+        if (++w == nwords)
+            return(BIT_ARRAY_NPOS);
+        word = _blocks[w];
+    }
+
+    return((w << 6) + __builtin_ctzll(word));
+}
+
+size_t BitArray::nextUnsetBit (size_t index) const {
+    size_t w, nwords = __WORDS(_length);
+    uint64_t word;
+
+    if (index >= _length)
+        return(BIT_ARRAY_NPOS);
+
+    w = index >> 6;
+    word = ~_blocks[w] & (~0ull << (index & 63));
+    while (word == 0) {
+        if (++w == nwords)
+            return(BIT_ARRAY_NPOS);
+        word = ~_blocks[w];
+    }
+
+    index = (w << 6) + __builtin_ctzll(word);
+    return((index < _length) ? index : BIT_ARRAY_NPOS);
+}
+
+/* ============================================================================
+ *  Bitwise operations
+ */
+#if defined(__SSE2__)
+    #define __BIT_ARRAY_SSE2_LOOP(dst, src, n, i, sse_op)                       \
+        for (; ((i) + 2) <= (n); (i) += 2) {                                    \
+            __m128i a = _mm_loadu_si128((const __m128i *)((dst) + (i)));        \
+            __m128i b = _mm_loadu_si128((const __m128i *)((src) + (i)));        \
+            _mm_storeu_si128((__m128i *)((dst) + (i)), sse_op);                 \
+        }
+#else
+    #define __BIT_ARRAY_SSE2_LOOP(dst, src, n, i, sse_op)
+#endif
+
+#define __BIT_ARRAY_OP(dst, src, n, sse_op, op)                                 \
+    do {                                                                        \
+        size_t i = 0;                                                           \
+        __BIT_ARRAY_SSE2_LOOP(dst, src, n, i, sse_op)                           \
+        for (; i < (n); ++i)                                                    \
+            (dst)[i] = op;                                                      \
+    } while (0)
+
+void BitArray::andWith (const BitArray& other) {
+    size_t nwords = __WORDS(_length);
+    size_t owords = __WORDS(other._length);
+    size_t n = (nwords < owords) ? nwords : owords;
+
+    __BIT_ARRAY_OP(_blocks, other._blocks, n,
+                   _mm_and_si128(a, b), _blocks[i] & other._blocks[i]);
+
+    if (n < nwords)
+        memset(_blocks + n, 0, (nwords - n) * sizeof(uint64_t));
+
+    _dirty = true;
+}
+
+void BitArray::orWith (const BitArray& other) {
+    size_t nwords = __WORDS(_length);
+    size_t owords = __WORDS(other._length);
+    size_t n = (nwords < owords) ? nwords : owords;
+
+    __BIT_ARRAY_OP(_blocks, other._blocks, n,
+                   _mm_or_si128(a, b), _blocks[i] | other._blocks[i]);
+
+    maskTail();
+    _dirty = true;
+}
+
+void BitArray::xorWith (const BitArray& other) {
+    size_t nwords = __WORDS(_length);
+    size_t owords = __WORDS(other._length);
+    size_t n = (nwords < owords) ? nwords : owords;
+
+    __BIT_ARRAY_OP(_blocks, other._blocks, n,
+                   _mm_xor_si128(a, b), _blocks[i] ^ other._blocks[i]);
+
+    maskTail();
+    _dirty = true;
+}
+
+void BitArray::andNotWith (const BitArray& other) {
+    size_t nwords = __WORDS(_length);
+    size_t owords = __WORDS(other._length);
+    size_t n = (nwords < owords) ? nwords : owords;
+
+    __BIT_ARRAY_OP(_blocks, other._blocks, n,
+                   _mm_andnot_si128(b, a), _blocks[i] & ~other._blocks[i]);
+
+    _dirty = true;
+}
+
+/* ============================================================================
+ *  Rank/Select
+ */
+size_t BitArray::rank (size_t index) const {
+    size_t i, w, sb, rank;
+
+    if (index > _length)
+        index = _length;
+
+    w = index >> 6;
+    if (_dirty && buildIndex() < 0) {
+        /* No memory for the index, count from the start */
+        i = 0;
+        rank = 0;
+    } else {
+        sb = index >> __SUPER_SHIFT;
+        i = sb * __SUPER_WORDS;
+        rank = _ranks[sb];
+    }
+
+    /* At most 7 full words with the index, plus the partial one */
+    for (; i < w; ++i)
+        rank += __popcount64(_blocks[i]);
+
+    if (index & 63)
+        rank += __popcount64(_blocks[w] & ((1ull << (index & 63)) - 1));
+
+    return(rank);
+}
+
+size_t BitArray::select (size_t n) const {
+    size_t nwords = __WORDS(_length);
+    size_t nsuper = (nwords + __SUPER_WORDS - 1) / __SUPER_WORDS;
+    size_t k, sb, hi, mid, w;
+    unsigned int c;
+
+    if (_dirty && buildIndex() < 0) {
+        /* No memory for the index, scan from the start */
+        for (w = 0; w < nwords; ++w) {
+            if (n < (c = __popcount64(_blocks[w])))
+                return((w << 6) + __select64(_blocks[w], n));
+            n -= c;
+        }
+        return(BIT_ARRAY_NPOS);
+    }
+
+    if (n >= _ranks[nsuper])
+        return(BIT_ARRAY_NPOS);
+
+    /* The target is between this sample and the next one: binary search
+     * the superblocks in between, the empty ones of a sparse bitmap included.
+     */
+    k = n >> __SELECT_SHIFT;
+    sb = _samples[k];
+    hi = (k + 1 < _nsamples) ? _samples[k + 1] : (nsuper - 1);
+    while (sb < hi) {
+        mid = sb + ((hi - sb) >> 1);
+        if (_ranks[mid + 1] <= n)
+            sb = mid + 1;
+        else
+            hi = mid;
+    }
+
+    n -= _ranks[sb];
+    for (w = sb * __SUPER_WORDS; ; ++w) {
+        if (n < (c = __popcount64(_blocks[w])))
+            return((w << 6) + __select64(_blocks[w], n));
+        n -= c;
+    }
+}
+
+int BitArray::buildIndex (void) const {
+    size_t nwords = __WORDS(_length);
+    size_t nsuper = (nwords + __SUPER_WORDS - 1) / __SUPER_WORDS;
+    size_t sb, w, rank, next_sample;
+    uint64_t *ranks;
+    uint32_t *samples;
+    size_t nsamples;
+
+    if ((ranks = (uint64_t *)realloc(_ranks, (nsuper + 1) * sizeof(uint64_t))) == NULL)
+        return(-1);
+    _ranks = ranks;
+
+    rank = 0;
+    for (sb = 0; sb < nsuper; ++sb) {
+        _ranks[sb] = rank;
+        for (w = sb * __SUPER_WORDS; w < nwords && w < (sb + 1) * __SUPER_WORDS; ++w)
+            rank += __popcount64(_blocks[w]);
+    }
+    _ranks[nsuper] = rank;
+
+    nsamples = (rank >> __SELECT_SHIFT) + 1;
+    if ((samples = (uint32_t *)realloc(_samples, nsamples * sizeof(uint32_t))) == NULL)
+        return(-1);
+    _samples = samples;
+    _nsamples = nsamples;
+
+    /* Superblock holding each (k << __SELECT_SHIFT)-th set bit */
+    next_sample = 0;
+    for (sb = 0; sb < nsuper && next_sample < nsamples; ++sb) {
+        while (next_sample < nsamples &&
+               (next_sample << __SELECT_SHIFT) < _ranks[sb + 1])
+        {
+            _samples[next_sample++] = sb;
+        }
+    }
+    while (next_sample < nsamples)
+        _samples[next_sample++] = (nsuper > 0) ? (nsuper - 1) : 0;
+
+    _dirty = false;
+    return(0);
+}
+
+void BitArray::maskTail (void) {
+    if (_length & 63)
+        _blocks[_length >> 6] &= (1ull << (_length & 63)) - 1;
+}
@@ -18,17 +18,30 @@
 #define _BIT_ARRAY_H_
 
 #include <stdint.h>
+#include <stddef.h>
 
+#define BIT_ARRAY_NPOS          ((size_t)-1)
+
+/*
+ * Fixed length bitmap. Bits past length() are always zero.
+ * rank()/select() use an auxiliary index (~3% of the bitmap) that is
+ * rebuilt on the first query after a modification; queries on a
+ * modified bitmap are not thread-safe, call buildIndex() first.
+ * rank() is O(1); select() is O(log gap), gap being the superblocks
+ * between two samples. Without memory for the index both scan the bitmap.
+ */
 class BitArray {
     public:
-        BitArray(size_t length) {
-            _blocks = new uint64_t[(length + 63) >> 6];
-            _length = length;
-        }
+        BitArray(size_t length=0);
+        BitArray(const BitArray& other);
+        ~BitArray();
 
-        size_t length (void) const {
-            return(_length);
-        }
+        BitArray& operator= (const BitArray& other);
+
+        /* New bits are zero */
+        int resize (size_t length);
+
+        size_t length (void) const { return(_length); }
 
         void set (size_t index, bool value) {
             if (value)
@@ -38,20 +51,70 @@ class BitArray {
         }
 
         void set (size_t index) {
-            _blocks[index >> 6] |= (1 << (index & 63));
+            _blocks[index >> 6] |= (1ull << (index & 63));
+            _dirty = true;
         }
 
         void unset (size_t index) {
-            _blocks[index >> 6] &= ~(1 << (index & 63));
+            _blocks[index >> 6] &= ~(1ull << (index & 63));
+            _dirty = true;
+        }
+
+        void flip (size_t index) {
+            _blocks[index >> 6] ^= (1ull << (index & 63));
+            _dirty = true;
         }
 
-        bool operator[] (size_t index) const {
-            return(_blocks[index >> 6] & (1 << (index & 63)));
+        bool test (size_t index) const {
+            return((_blocks[index >> 6] >> (index & 63)) & 1);
         }
 
+        bool operator[] (size_t index) const { return(test(index)); }
+
+        /* Bulk operations on [start, end) */
+        void setRange   (size_t start, size_t end);
+        void unsetRange (size_t start, size_t end);
+        void setAll     (void) { setRange(0, _length); }
+        void clear      (void) { unsetRange(0, _length); }
+
+        /* Number of set bits */
+        size_t count (void) const;
+
+        /* First set/unset bit at or after 'index', BIT_ARRAY_NPOS if none */
+        size_t nextSetBit   (size_t index) const;
+        size_t nextUnsetBit (size_t index) const;
+
+        /* In place, the bits past other.length() count as zero */
+        void andWith    (const BitArray& other);
+        void orWith     (const BitArray& other);
+        void xorWith    (const BitArray& other);
+        void andNotWith (const BitArray& other);
+
+        /* Set bits in [0, index) */
+        size_t rank (size_t index) const;
+
+        /* Position of the n-th (0 based) set bit, BIT_ARRAY_NPOS if none */
+        size_t select (size_t n) const;
+
+        /* -1 if the index can't be allocated */
+        int buildIndex (void) const;
+
+        const uint64_t *blocks (void) const { return(_blocks); }
+        uint64_t *blocks (void) { _dirty = true; return(_blocks); }
+        size_t blockCount (void) const { return((_length + 63) >> 6); }
+
+    private:
+        void maskTail (void);
+
     private:
         uint64_t *_blocks;
         size_t    _length;
+
+        /* rank/select index */
+        mutable uint64_t *_ranks;       /* set bits before each 512-bit superblock */
+        mutable uint32_t *_samples;     /* superblock of every 512th set bit */
+        mutable size_t    _nsamples;
+        mutable bool      _dirty;
 };
 
 #endif /* !_BIT_ARRAY_H_ */
@@ -0,0 +1,271 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <string.h>
+#include <math.h>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#endif
+
+#include "BloomFilter.h"
+
+#define BLOOM_MAGIC                 0x424c4d31      /* "BLM1" */
+#define BLOOM_MAX_BLOCKS            (1u << 26)      /* 4G of filter */
+#define BLOOM_IO_WORDS              (1u << 17)      /* 1M per read/write */
+
+/* Odd multipliers, one per block word (same as the Parquet split-block filter) */
+static const uint32_t __bloom_salt[BLOOM_BLOCK_WORDS] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U,
+};
+
+#if defined(__AVX2__)
+/* One bit per 64-bit word: bit = (key * salt[i]) >> 26 */
+static inline void __bloom_mask (uint32_t key, __m256i *lo, __m256i *hi) {
+    __m256i salt = _mm256_loadu_si256((const __m256i *)__bloom_salt);
+    __m256i bits = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_set1_epi32(key), salt), 26);
+    __m256i one = _mm256_set1_epi64x(1);
+
+    *lo = _mm256_sllv_epi64(one, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(bits)));
+    *hi = _mm256_sllv_epi64(one, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(bits, 1)));
+}
+#else
+static inline uint64_t __bloom_bit (uint32_t key, unsigned int i) {
+    return(1ull << ((key * __bloom_salt[i]) >> 26));
+}
+#endif
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+static void __bloom_swap_words (uint64_t *words, size_t count) {
+    while (count-- > 0) {
+        *words = __builtin_bswap64(*words);
+        words++;
+    }
+}
+#endif
+
+/* ============================================================================
+ *  Bloom Filter
+ */
+BloomFilter::BloomFilter(size_t expected_items, double fpp) {
+    double bits;
+
+    _base = NULL;
+    _nblocks = 0;
+    _items = 0;
+
+    if (fpp <= 0.0 || fpp >= 1.0)
+        fpp = 0.01;
+
+    /* Classic sizing, -n ln(p) / ln(2)^2, plus 20% for the blocking */
+    bits = 1.2 * expected_items * -log(fpp) / (M_LN2 * M_LN2);
+    bits = ceil(bits / (BLOOM_BLOCK_WORDS * 64));
+    if (bits < 1)
+        bits = 1;
+    if (bits > BLOOM_MAX_BLOCKS)
+        bits = BLOOM_MAX_BLOCKS;
+
+    allocate((uint32_t)bits);
+}
+
+int BloomFilter::allocate (uint32_t nblocks) {
+    uint64_t *blocks;
+
+    /* 7 spare words to align the first block to the cache line */
+    if (_bits.resize(((size_t)nblocks * BLOOM_BLOCK_WORDS + 7) * 64) < 0) {
+        _base = NULL;
+        _nblocks = 0;
+        return(-1);
+    }
+
+    _bits.clear();
+    blocks = _bits.blocks();
+    _base = blocks + (((64 - ((uintptr_t)blocks & 63)) & 63) >> 3);
+    _nblocks = nblocks;
+    _items = 0;
+    return(0);
+}
+
+void BloomFilter::clear (void) {
+    _bits.clear();
+    _items = 0;
+}
+
+void BloomFilter::addHash (uint64_t hash) {
+    uint64_t *block;
+
+    if (_nblocks == 0)
+        return;
+
+    block = (uint64_t *)blockFor(hash);
+#if defined(__AVX2__)
+    __m256i lo, hi;
+    __bloom_mask((uint32_t)hash, &lo, &hi);
+    _mm256_store_si256((__m256i *)block,
+                       _mm256_or_si256(_mm256_load_si256((const __m256i *)block), lo));
+    _mm256_store_si256((__m256i *)(block + 4),
+                       _mm256_or_si256(_mm256_load_si256((const __m256i *)(block + 4)), hi));
+#else
+    for (unsigned int i = 0; i < BLOOM_BLOCK_WORDS; ++i)
+        block[i] |= __bloom_bit((uint32_t)hash, i);
+#endif
+
+    _items++;
+}
+
+bool BloomFilter::mayContainHash (uint64_t hash) const {
+    const uint64_t *block;
+
+    if (_nblocks == 0)
+        return(true);
+
+    block = blockFor(hash);
+#if defined(__AVX2__)
+    __m256i lo, hi;
+    __bloom_mask((uint32_t)hash, &lo, &hi);
+    return(_mm256_testc_si256(_mm256_load_si256((const __m256i *)block), lo) &&
+           _mm256_testc_si256(_mm256_load_si256((const __m256i *)(block + 4)), hi));
+#else
+    uint64_t miss = 0;
+    for (unsigned int i = 0; i < BLOOM_BLOCK_WORDS; ++i) {
+        uint64_t bit = __bloom_bit((uint32_t)hash, i);
+        miss |= (block[i] & bit) ^ bit;
+    }
+    return(miss == 0);
+#endif
+}
+
+void BloomFilter::mayContainHashes (const uint64_t *hashes,
+                                    size_t count,
+                                    bool *results) const
+{
+    size_t i, j, n;
+
+    if (_nblocks == 0) {
+        memset(results, 1, count * sizeof(bool));
+        return;
+    }
+
+    for (i = 0; i < count; i += n) {
+        n = ((count - i) < BLOOM_BATCH) ? (count - i) : BLOOM_BATCH;
+
+        /* Issue all the loads first, the probes overlap the misses */
+        for (j = 0; j < n; ++j)
+            __builtin_prefetch(blockFor(hashes[i + j]));
+
+        for (j = 0; j < n; ++j)
+            results[i + j] = mayContainHash(hashes[i + j]);
+    }
+}
+
+void BloomFilter::mayContainMany (const void * const *keys,
+                                  const size_t *lengths,
+                                  size_t count,
+                                  bool *results) const
+{
+    uint64_t hashes[BLOOM_BATCH];
+    size_t i, n;
+
+    for (i = 0; i < count; i += n) {
+        n = ((count - i) < BLOOM_BATCH) ? (count - i) : BLOOM_BATCH;
+        hash64Many(keys + i, lengths + i, n, hashes);
+        mayContainHashes(hashes, n, results + i);
+    }
+}
+
+int BloomFilter::merge (const BloomFilter& other) {
+    size_t i, nwords;
+
+    if (other._nblocks != _nblocks)
+        return(-1);
+
+    nwords = (size_t)_nblocks * BLOOM_BLOCK_WORDS;
+    for (i = 0; i < nwords; ++i)
+        _base[i] |= other._base[i];
+
+    _items += other._items;
+    return(0);
+}
+
+int BloomFilter::write (Writable *writable) const {
+    size_t i, n, nwords;
+
+    if (writable->writeUInt32(BLOOM_MAGIC) != 4 ||
+        writable->writeUInt32(_nblocks) != 4 ||
+        writable->writeUInt64(_items) != 8)
+    {
+        return(-1);
+    }
+
+    nwords = (size_t)_nblocks * BLOOM_BLOCK_WORDS;
+    for (i = 0; i < nwords; i += n) {
+        n = ((nwords - i) < BLOOM_IO_WORDS) ? (nwords - i) : BLOOM_IO_WORDS;
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+        uint64_t words[BLOOM_BLOCK_WORDS];
+        size_t k;
+
+        for (k = 0; k < n; k += BLOOM_BLOCK_WORDS) {
+            memcpy(words, _base + i + k, sizeof(words));
+            __bloom_swap_words(words, BLOOM_BLOCK_WORDS);
+            if (writable->writeFully(words, sizeof(words)) != (int)sizeof(words))
+                return(-1);
+        }
+#else
+        if (writable->writeFully(_base + i, n * 8) != (int)(n * 8))
+            return(-1);
+#endif
+    }
+
+    return(0);
+}
+
+int BloomFilter::read (Readable *readable) {
+    uint32_t magic, nblocks;
+    size_t i, n, nwords;
+    uint64_t items;
+
+    if (readable->readUInt32(&magic) != 4 || magic != BLOOM_MAGIC)
+        return(-1);
+
+    if (readable->readUInt32(&nblocks) != 4 || readable->readUInt64(&items) != 8)
+        return(-1);
+
+    if (nblocks == 0 || nblocks > BLOOM_MAX_BLOCKS)
+        return(-1);
+
+    if (allocate(nblocks) < 0)
+        return(-1);
+
+    nwords = (size_t)nblocks * BLOOM_BLOCK_WORDS;
+    for (i = 0; i < nwords; i += n) {
+        n = ((nwords - i) < BLOOM_IO_WORDS) ? (nwords - i) : BLOOM_IO_WORDS;
+        if (readable->readFully(_base + i, n * 8) != (int)(n * 8)) {
+            /* No blocks, mayContain() answers true for every key */
+            _base = NULL;
+            _nblocks = 0;
+            _items = 0;
+            return(-1);
+        }
+    }
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    __bloom_swap_words(_base, nwords);
+#endif
+
+    _items = items;
+    return(0);
+}
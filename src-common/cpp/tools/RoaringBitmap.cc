@@ -0,0 +1,1333 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "RoaringBitmap.h"
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__)
+    #error "RoaringBitmap: the serialized image is little-endian only"
+#endif
+
+#define ROARING_MAGIC               0x314d4252      /* "RBM1" */
+#define ROARING_HEADER_SIZE         8
+#define ROARING_DESCRIPTOR_SIZE     16
+#define ROARING_WRITEV_BATCH        64
+#define ROARING_CHUNK_BITS          65536
+
+#define __ALIGN8(x)                 (((x) + 7) & ~((size_t)7))
+
+enum {
+    ROARING_ARRAY  = 0,
+    ROARING_BITMAP = 1,
+    ROARING_RUN    = 2,
+};
+
+struct RoaringContainer {
+    uint16_t key;
+    uint8_t  type;
+    uint8_t  mapped;        /* data points into a map()ed image */
+    uint32_t cardinality;
+    uint32_t size;          /* array values, bitmap words or runs */
+    uint32_t capacity;      /* allocated bytes, 0 when mapped */
+    void *   data;          /* runs are (start, length - 1) pairs */
+};
+
+#define __values(c)                 ((uint16_t *)(c)->data)
+#define __words(c)                  ((uint64_t *)(c)->data)
+#define __runs(c)                   ((uint16_t *)(c)->data)
+
+/* ============================================================================
+ *  Bitmap words helpers
+ */
+static void __words_set_range (uint64_t *words, uint32_t start, uint32_t last) {
+    uint32_t ws = start >> 6;
+    uint32_t we = last >> 6;
+    uint64_t first_mask = ~0ull << (start & 63);
+    uint64_t last_mask = ~0ull >> (63 - (last & 63));
+
+    if (ws == we) {
+        words[ws] |= (first_mask & last_mask);
+    } else {
+        words[ws] |= first_mask;
+        memset(words + ws + 1, 0xff, (we - ws - 1) * sizeof(uint64_t));
+        words[we] |= last_mask;
+    }
+}
+
+static void __words_clear_range (uint64_t *words, uint32_t start, uint32_t last) {
+    uint32_t ws = start >> 6;
+    uint32_t we = last >> 6;
+    uint64_t first_mask = ~0ull << (start & 63);
+    uint64_t last_mask = ~0ull >> (63 - (last & 63));
+
+    if (ws == we) {
+        words[ws] &= ~(first_mask & last_mask);
+    } else {
+        words[ws] &= ~first_mask;
+        memset(words + ws + 1, 0, (we - ws - 1) * sizeof(uint64_t));
+        words[we] &= ~last_mask;
+    }
+}
+
+static uint32_t __words_count (const uint64_t *words) {
+    uint32_t c0 = 0, c1 = 0;
+    uint32_t i;
+
+    for (i = 0; i < ROARING_BITMAP_WORDS; i += 2) {
+        c0 += __builtin_popcountll(words[i]);
+        c1 += __builtin_popcountll(words[i + 1]);
+    }
+
+    return(c0 + c1);
+}
+
+/* First bit >= pos set in (words ^ flip), ROARING_CHUNK_BITS if none */
+static uint32_t __words_next (const uint64_t *words, uint32_t pos, uint64_t flip) {
+    uint32_t w = pos >> 6;
+    uint64_t word;
+
+    if (w >= ROARING_BITMAP_WORDS)
+        return(ROARING_CHUNK_BITS);
+
+    word = (words[w] ^ flip) & (~0ull << (pos & 63));
+    while (word == 0) {
+        if (++w == ROARING_BITMAP_WORDS)
+            return(ROARING_CHUNK_BITS);
+        word = words[w] ^ flip;
+    }
+
+    return((w << 6) + __builtin_ctzll(word));
+}
+
+static uint32_t __words_count_runs (const uint64_t *words) {
+    uint64_t prev = 0;
+    uint32_t runs = 0;
+    uint32_t i;
+
+    /* A run starts at every set bit whose predecessor is clear */
+    for (i = 0; i < ROARING_BITMAP_WORDS; ++i) {
+        runs += __builtin_popcountll(words[i] & ~((words[i] << 1) | (prev >> 63)));
+        prev = words[i];
+    }
+
+    return(runs);
+}
+
+/* ============================================================================
+ *  Container helpers
+ */
+static uint32_t __array_lower_bound (const uint16_t *values, uint32_t size, uint16_t v) {
+    uint32_t lo = 0, hi = size, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) >> 1;
+        if (values[mid] < v)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return(lo);
+}
+
+/* Index of the last run starting at or before 'v', -1 if none */
+static int32_t __run_find (const uint16_t *runs, uint32_t size, uint16_t v) {
+    uint32_t lo = 0, hi = size, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) >> 1;
+        if (runs[mid << 1] <= v)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return((int32_t)lo - 1);
+}
+
+static size_t __container_bytes (const RoaringContainer *c) {
+    switch (c->type) {
+        case ROARING_ARRAY:  return(c->size * sizeof(uint16_t));
+        case ROARING_BITMAP: return(ROARING_BITMAP_WORDS * sizeof(uint64_t));
+        default:             return(c->size * 2 * sizeof(uint16_t));
+    }
+}
+
+static void __container_release (RoaringContainer *c) {
+    if (!c->mapped)
+        free(c->data);
+}
+
+static void __container_replace (RoaringContainer *c,
+                                 uint8_t type,
+                                 void *data,
+                                 uint32_t capacity,
+                                 uint32_t size,
+                                 uint32_t cardinality)
+{
+    __container_release(c);
+    c->type = type;
+    c->mapped = 0;
+    c->data = data;
+    c->capacity = capacity;
+    c->size = size;
+    c->cardinality = cardinality;
+}
+
+/* Make room for 'bytes' of payload, copying a mapped payload out */
+static int __container_reserve (RoaringContainer *c, size_t bytes) {
+    size_t capacity;
+    void *data;
+
+    if (!c->mapped && c->capacity >= bytes)
+        return(0);
+
+    capacity = c->mapped ? bytes : (c->capacity << 1);
+    if (capacity < bytes)
+        capacity = bytes;
+    if (capacity < 16)
+        capacity = 16;
+
+    if (c->mapped) {
+        if ((data = malloc(capacity)) == NULL)
+            return(-1);
+        memcpy(data, c->data, __container_bytes(c));
+        c->mapped = 0;
+    } else if ((data = realloc(c->data, capacity)) == NULL) {
+        return(-1);
+    }
+
+    c->data = data;
+    c->capacity = capacity;
+    return(0);
+}
+
+static int __container_copy (RoaringContainer *dst, const RoaringContainer *src) {
+    size_t bytes = __container_bytes(src);
+
+    *dst = *src;
+    dst->mapped = 0;
+    dst->capacity = (bytes < 16) ? 16 : bytes;
+    if ((dst->data = malloc(dst->capacity)) == NULL)
+        return(-1);
+
+    memcpy(dst->data, src->data, bytes);
+    return(0);
+}
+
+static bool __container_contains (const RoaringContainer *c, uint16_t v) {
+    const uint16_t *runs;
+    uint32_t i;
+    int32_t r;
+
+    switch (c->type) {
+        case ROARING_ARRAY:
+            i = __array_lower_bound(__values(c), c->size, v);
+            return(i < c->size && __values(c)[i] == v);
+        case ROARING_BITMAP:
+            return((__words(c)[v >> 6] >> (v & 63)) & 1);
+        default:
+            runs = __runs(c);
+            r = __run_find(runs, c->size, v);
+            return(r >= 0 && (uint32_t)(v - runs[r << 1]) <= runs[(r << 1) + 1]);
+    }
+}
+
+static void __words_or (uint64_t *words, const RoaringContainer *c) {
+    const uint16_t *p;
+    uint32_t i;
+
+    switch (c->type) {
+        case ROARING_ARRAY:
+            p = __values(c);
+            for (i = 0; i < c->size; ++i)
+                words[p[i] >> 6] |= (1ull << (p[i] & 63));
+            break;
+        case ROARING_BITMAP:
+            for (i = 0; i < ROARING_BITMAP_WORDS; ++i)
+                words[i] |= __words(c)[i];
+            break;
+        default:
+            p = __runs(c);
+            for (i = 0; i < c->size; ++i)
+                __words_set_range(words, p[i << 1], p[i << 1] + p[(i << 1) + 1]);
+            break;
+    }
+}
+
+static void __words_andnot (uint64_t *words, const RoaringContainer *c) {
+    const uint16_t *p;
+    uint32_t i;
+
+    switch (c->type) {
+        case ROARING_ARRAY:
+            p = __values(c);
+            for (i = 0; i < c->size; ++i)
+                words[p[i] >> 6] &= ~(1ull << (p[i] & 63));
+            break;
+        case ROARING_BITMAP:
+            for (i = 0; i < ROARING_BITMAP_WORDS; ++i)
+                words[i] &= ~__words(c)[i];
+            break;
+        default:
+            p = __runs(c);
+            for (i = 0; i < c->size; ++i)
+                __words_clear_range(words, p[i << 1], p[i << 1] + p[(i << 1) + 1]);
+            break;
+    }
+}
+
+/* Words to work on: the container own bitmap or a copy in 'scratch' */
+static uint64_t *__container_words (RoaringContainer *c, uint64_t *scratch) {
+    if (c->type == ROARING_BITMAP && !c->mapped)
+        return(__words(c));
+
+    memset(scratch, 0, ROARING_BITMAP_WORDS * sizeof(uint64_t));
+    __words_or(scratch, c);
+    return(scratch);
+}
+
+/* Replace the content with 'words', as an array or as a bitmap */
+static int __container_set_words (RoaringContainer *c,
+                                  const uint64_t *words,
+                                  uint32_t cardinality)
+{
+    uint16_t *values;
+    uint64_t word;
+    uint32_t capacity;
+    uint32_t i, n;
+    void *data;
+
+    if (cardinality <= ROARING_ARRAY_MAX) {
+        capacity = ((cardinality < 8) ? 8 : cardinality) * sizeof(uint16_t);
+        if ((values = (uint16_t *)malloc(capacity)) == NULL)
+            return(-1);
+
+        n = 0;
+        for (i = 0; i < ROARING_BITMAP_WORDS; ++i) {
+            for (word = words[i]; word != 0; word &= word - 1)
+                values[n++] = (i << 6) + __builtin_ctzll(word);
+        }
+
+        __container_replace(c, ROARING_ARRAY, values, capacity, n, n);
+        return(0);
+    }
+
+    if (c->type == ROARING_BITMAP && !c->mapped) {
+        if (c->data != words)
+            memcpy(c->data, words, ROARING_BITMAP_WORDS * sizeof(uint64_t));
+        c->cardinality = cardinality;
+        return(0);
+    }
+
+    if ((data = malloc(ROARING_BITMAP_WORDS * sizeof(uint64_t))) == NULL)
+        return(-1);
+
+    memcpy(data, words, ROARING_BITMAP_WORDS * sizeof(uint64_t));
+    __container_replace(c, ROARING_BITMAP, data,
+                        ROARING_BITMAP_WORDS * sizeof(uint64_t),
+                        ROARING_BITMAP_WORDS, cardinality);
+    return(0);
+}
+
+static uint32_t __container_count_runs (const RoaringContainer *c) {
+    const uint16_t *values;
+    uint32_t i, runs;
+
+    switch (c->type) {
+        case ROARING_ARRAY:
+            values = __values(c);
+            runs = (c->size > 0);
+            for (i = 1; i < c->size; ++i)
+                runs += (values[i] != values[i - 1] + 1);
+            return(runs);
+        case ROARING_BITMAP:
+            return(__words_count_runs(__words(c)));
+        default:
+            return(c->size);
+    }
+}
+
+/* ============================================================================
+ *  Container set operations
+ */
+static int __container_or (RoaringContainer *c, const RoaringContainer *oc) {
+    uint64_t scratch[ROARING_BITMAP_WORDS];
+    const uint16_t *a, *b;
+    uint32_t i, j, n, capacity;
+    uint16_t *values;
+    uint64_t *words;
+
+    if (c->type == ROARING_ARRAY && oc->type == ROARING_ARRAY &&
+        (c->cardinality + oc->cardinality) <= ROARING_ARRAY_MAX)
+    {
+        capacity = c->size + oc->size;
+        capacity = ((capacity < 8) ? 8 : capacity) * sizeof(uint16_t);
+        if ((values = (uint16_t *)malloc(capacity)) == NULL)
+            return(-1);
+
+        a = __values(c);
+        b = __values(oc);
+        i = j = n = 0;
+        while (i < c->size && j < oc->size) {
+            if (a[i] < b[j]) {
+                values[n++] = a[i++];
+            } else if (a[i] > b[j]) {
+                values[n++] = b[j++];
+            } else {
+                values[n++] = a[i++];
+                j++;
+            }
+        }
+        while (i < c->size) values[n++] = a[i++];
+        while (j < oc->size) values[n++] = b[j++];
+
+        __container_replace(c, ROARING_ARRAY, values, capacity, n, n);
+        return(0);
+    }
+
+    words = __container_words(c, scratch);
+    __words_or(words, oc);
+    return(__container_set_words(c, words, __words_count(words)));
+}
+
+static int __container_and (RoaringContainer *c, const RoaringContainer *oc) {
+    uint64_t scratch[ROARING_BITMAP_WORDS];
+    uint64_t other[ROARING_BITMAP_WORDS];
+    const uint16_t *a, *b;
+    uint32_t i, j, n, capacity;
+    uint16_t *values;
+    uint64_t *words;
+
+    if (c->type == ROARING_ARRAY) {
+        if (c->mapped && __container_reserve(c, __container_bytes(c)) < 0)
+            return(-1);
+
+        values = __values(c);
+        n = 0;
+        if (oc->type == ROARING_ARRAY) {
+            /* Merge, the output never overtakes the input */
+            b = __values(oc);
+            i = j = 0;
+            while (i < c->size && j < oc->size) {
+                if (values[i] < b[j]) {
+                    i++;
+                } else if (values[i] > b[j]) {
+                    j++;
+                } else {
+                    values[n++] = values[i++];
+                    j++;
+                }
+            }
+        } else {
+            for (i = 0; i < c->size; ++i) {
+                if (__container_contains(oc, values[i]))
+                    values[n++] = values[i];
+            }
+        }
+
+        c->size = c->cardinality = n;
+        return(0);
+    }
+
+    if (oc->type == ROARING_ARRAY) {
+        capacity = ((oc->size < 8) ? 8 : oc->size) * sizeof(uint16_t);
+        if ((values = (uint16_t *)malloc(capacity)) == NULL)
+            return(-1);
+
+        a = __values(oc);
+        for (i = n = 0; i < oc->size; ++i) {
+            if (__container_contains(c, a[i]))
+                values[n++] = a[i];
+        }
+
+        __container_replace(c, ROARING_ARRAY, values, capacity, n, n);
+        return(0);
+    }
+
+    words = __container_words(c, scratch);
+    if (oc->type == ROARING_BITMAP) {
+        for (i = 0; i < ROARING_BITMAP_WORDS; ++i)
+            words[i] &= __words(oc)[i];
+    } else {
+        memset(other, 0, sizeof(other));
+        __words_or(other, oc);
+        for (i = 0; i < ROARING_BITMAP_WORDS; ++i)
+            words[i] &= other[i];
+    }
+
+    return(__container_set_words(c, words, __words_count(words)));
+}
+
+static int __container_andnot (RoaringContainer *c, const RoaringContainer *oc) {
+    uint64_t scratch[ROARING_BITMAP_WORDS];
+    uint16_t *values;
+    uint64_t *words;
+    uint32_t i, n;
+
+    if (c->type == ROARING_ARRAY) {
+        if (c->mapped && __container_reserve(c, __container_bytes(c)) < 0)
+            return(-1);
+
+        values = __values(c);
+        for (i = n = 0; i < c->size; ++i) {
+            if (!__container_contains(oc, values[i]))
+                values[n++] = values[i];
+        }
+
+        c->size = c->cardinality = n;
+        return(0);
+    }
+
+    words = __container_words(c, scratch);
+    __words_andnot(words, oc);
+    return(__container_set_words(c, words, __words_count(words)));
+}
+
+static int __container_to_runs (RoaringContainer *c, uint32_t nruns) {
+    uint64_t scratch[ROARING_BITMAP_WORDS];
+    uint32_t start, end, pos, n;
+    uint16_t *runs;
+    uint64_t *words;
+    size_t capacity;
+
+    capacity = ((nruns < 4) ? 4 : nruns) * 2 * sizeof(uint16_t);
+    if ((runs = (uint16_t *)malloc(capacity)) == NULL)
+        return(-1);
+
+    words = __container_words(c, scratch);
+    pos = n = 0;
+    while ((start = __words_next(words, pos, 0)) < ROARING_CHUNK_BITS) {
+        end = __words_next(words, start, ~0ull);
+        runs[(n << 1) + 0] = start;
+        runs[(n << 1) + 1] = end - 1 - start;
+        pos = end;
+        n++;
+    }
+
+    __container_replace(c, ROARING_RUN, runs, capacity, n, c->cardinality);
+    return(0);
+}
+
+/* ============================================================================
+ *  Roaring Bitmap
+ */
+RoaringBitmap::RoaringBitmap() {
+    _containers = NULL;
+    _count = 0;
+    _capacity = 0;
+}
+
+RoaringBitmap::RoaringBitmap(const RoaringBitmap& other) {
+    _containers = NULL;
+    _count = 0;
+    _capacity = 0;
+    *this = other;
+}
+
+RoaringBitmap::~RoaringBitmap() {
+    clear();
+    free(_containers);
+}
+
+RoaringBitmap& RoaringBitmap::operator= (const RoaringBitmap& other) {
+    RoaringContainer *containers;
+    uint32_t i;
+
+    if (this == &other)
+        return(*this);
+
+    clear();
+    if (_capacity < other._count) {
+        containers = (RoaringContainer *)realloc(_containers,
+                                other._count * sizeof(RoaringContainer));
+        if (containers == NULL)
+            return(*this);
+
+        _containers = containers;
+        _capacity = other._count;
+    }
+
+    for (i = 0; i < other._count; ++i) {
+        if (__container_copy(&(_containers[i]), &(other._containers[i])) < 0)
+            break;
+        _count++;
+    }
+
+    return(*this);
+}
+
+#if __cplusplus >= 201103L
+RoaringBitmap::RoaringBitmap(RoaringBitmap&& other) {
+    _containers = NULL;
+    _count = 0;
+    _capacity = 0;
+    swap(other);
+}
+
+RoaringBitmap& RoaringBitmap::operator= (RoaringBitmap&& other) {
+    if (this != &other) {
+        clear();
+        swap(other);
+    }
+    return(*this);
+}
+#endif
+
+void RoaringBitmap::swap (RoaringBitmap& other) {
+    RoaringContainer *containers = _containers;
+    uint32_t count = _count;
+    uint32_t capacity = _capacity;
+
+    _containers = other._containers;
+    _count = other._count;
+    _capacity = other._capacity;
+
+    other._containers = containers;
+    other._count = count;
+    other._capacity = capacity;
+}
+
+void RoaringBitmap::clear (void) {
+    uint32_t i;
+
+    for (i = 0; i < _count; ++i)
+        __container_release(&(_containers[i]));
+    _count = 0;
+}
+
+static bool __lookup (const RoaringContainer *containers,
+                      uint32_t count,
+                      uint16_t key,
+                      uint32_t *index)
+{
+    uint32_t lo = 0, hi = count, mid;
+
+    /* Values are mostly added in order, try the tail first */
+    if (count > 0 && containers[count - 1].key <= key) {
+        *index = count - (containers[count - 1].key == key);
+        return(containers[count - 1].key == key);
+    }
+
+    while (lo < hi) {
+        mid = (lo + hi) >> 1;
+        if (containers[mid].key < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    *index = lo;
+    return(lo < count && containers[lo].key == key);
+}
+
+RoaringContainer *RoaringBitmap::fetchContainer (uint16_t key) {
+    RoaringContainer *containers;
+    RoaringContainer *c;
+    uint32_t capacity;
+    uint32_t index;
+
+    if (__lookup(_containers, _count, key, &index))
+        return(&(_containers[index]));
+
+    if (_count == _capacity) {
+        capacity = (_capacity < 4) ? 4 : (_capacity << 1);
+        containers = (RoaringContainer *)realloc(_containers,
+                                capacity * sizeof(RoaringContainer));
+        if (containers == NULL)
+            return(NULL);
+
+        _containers = containers;
+        _capacity = capacity;
+    }
+
+    memmove(_containers + index + 1, _containers + index,
+            (_count - index) * sizeof(RoaringContainer));
+    _count++;
+
+    c = &(_containers[index]);
+    memset(c, 0, sizeof(RoaringContainer));
+    c->key = key;
+    c->type = ROARING_ARRAY;
+    return(c);
+}
+
+void RoaringBitmap::eraseContainer (uint32_t index) {
+    __container_release(&(_containers[index]));
+    memmove(_containers + index, _containers + index + 1,
+            (_count - index - 1) * sizeof(RoaringContainer));
+    _count--;
+}
+
+int RoaringBitmap::add (uint32_t value) {
+    uint64_t scratch[ROARING_BITMAP_WORDS];
+    uint16_t low = value & 0xffff;
+    RoaringContainer *c;
+    uint16_t *values;
+    uint64_t *words;
+    uint32_t i;
+    int err;
+
+    if ((c = fetchContainer(value >> 16)) == NULL)
+        return(-1);
+
+    if (c->type == ROARING_ARRAY && c->size < ROARING_ARRAY_MAX) {
+        i = __array_lower_bound(__values(c), c->size, low);
+        if (i < c->size && __values(c)[i] == low)
+            return(0);
+
+        if ((err = __container_reserve(c, (c->size + 1) * sizeof(uint16_t))) < 0) {
+            if (c->cardinality == 0)
+                eraseContainer(c - _containers);
+            return(err);
+        }
+
+        values = __values(c);
+        memmove(values + i + 1, values + i, (c->size - i) * sizeof(uint16_t));
+        values[i] = low;
+        c->size++;
+        c->cardinality++;
+        return(0);
+    }
+
+    if (__container_contains(c, low))
+        return(0);
+
+    words = __container_words(c, scratch);
+    words[low >> 6] |= (1ull << (low & 63));
+    return(__container_set_words(c, words, c->cardinality + 1));
+}
+
+int RoaringBitmap::addRange (uint64_t start, uint64_t end) {
+    uint64_t scratch[ROARING_BITMAP_WORDS];
+    RoaringContainer *c;
+    uint64_t *words;
+    uint16_t *runs;
+    uint32_t lo, hi;
+    uint16_t key;
+
+    if (end > (1ull << 32))
+        end = (1ull << 32);
+
+    while (start < end) {
+        key = start >> 16;
+        lo = start & 0xffff;
+        hi = ((end - 1) >> 16 == key) ? ((end - 1) & 0xffff) : 0xffff;
+
+        if ((c = fetchContainer(key)) == NULL)
+            return(-1);
+
+        if (lo == 0 && hi == 0xffff) {
+            /* Full chunk, a single run */
+            if ((runs = (uint16_t *)malloc(16)) == NULL)
+                goto _failed;
+            runs[0] = 0;
+            runs[1] = 0xffff;
+            __container_replace(c, ROARING_RUN, runs, 16, 1, ROARING_CHUNK_BITS);
+        } else {
+            words = __container_words(c, scratch);
+            __words_set_range(words, lo, hi);
+            if (__container_set_words(c, words, __words_count(words)) < 0)
+                goto _failed;
+        }
+
+        start = ((uint64_t)key << 16) + hi + 1;
+    }
+
+    return(0);
+
+_failed:
+    if (c->cardinality == 0)
+        eraseContainer(c - _containers);
+    return(-1);
+}
+
+int RoaringBitmap::remove (uint32_t value) {
+    uint64_t scratch[ROARING_BITMAP_WORDS];
+    uint16_t low = value & 0xffff;
+    RoaringContainer *c;
+    uint16_t *values;
+    uint64_t *words;
+    uint32_t index, i;
+
+    if (!__lookup(_containers, _count, value >> 16, &index))
+        return(0);
+
+    c = &(_containers[index]);
+    if (!__container_contains(c, low))
+        return(0);
+
+    if (c->cardinality == 1) {
+        eraseContainer(index);
+        return(0);
+    }
+
+    if (c->type == ROARING_ARRAY) {
+        if (c->mapped && __container_reserve(c, __container_bytes(c)) < 0)
+            return(-1);
+
+        values = __values(c);
+        i = __array_lower_bound(values, c->size, low);
+        memmove(values + i, values + i + 1, (c->size - i - 1) * sizeof(uint16_t));
+        c->size--;
+        c->cardinality--;
+        return(0);
+    }
+
+    words = __container_words(c, scratch);
+    words[low >> 6] &= ~(1ull << (low & 63));
+    return(__container_set_words(c, words, c->cardinality - 1));
+}
+
+bool RoaringBitmap::contains (uint32_t value) const {
+    uint32_t index;
+
+    if (!__lookup(_containers, _count, value >> 16, &index))
+        return(false);
+
+    return(__container_contains(&(_containers[index]), value & 0xffff));
+}
+
+uint64_t RoaringBitmap::cardinality (void) const {
+    uint64_t total = 0;
+    uint32_t i;
+
+    for (i = 0; i < _count; ++i)
+        total += _containers[i].cardinality;
+
+    return(total);
+}
+
+int RoaringBitmap::orWith (const RoaringBitmap& other) {
+    const RoaringContainer *oc;
+    RoaringContainer *c;
+    uint32_t i, j;
+
+    if (this == &other)
+        return(0);
+
+    i = j = 0;
+    while (j < other._count) {
+        oc = &(other._containers[j]);
+        if (i < _count && _containers[i].key < oc->key) {
+            i++;
+            continue;
+        }
+
+        if (i < _count && _containers[i].key == oc->key) {
+            if (__container_or(&(_containers[i]), oc) < 0)
+                return(-1);
+        } else {
+            if ((c = fetchContainer(oc->key)) == NULL)
+                return(-1);
+            if (__container_copy(c, oc) < 0) {
+                c->data = NULL;
+                eraseContainer(i);
+                return(-1);
+            }
+        }
+
+        i++;
+        j++;
+    }
+
+    return(0);
+}
+
+int RoaringBitmap::andWith (const RoaringBitmap& other) {
+    RoaringContainer *c;
+    uint32_t i, j, k;
+
+    if (this == &other)
+        return(0);
+
+    for (i = j = k = 0; i < _count; ++i) {
+        c = &(_containers[i]);
+        while (j < other._count && other._containers[j].key < c->key)
+            j++;
+
+        if (j < other._count && other._containers[j].key == c->key) {
+            if (__container_and(c, &(other._containers[j])) < 0) {
+                memmove(_containers + k, c, (_count - i) * sizeof(RoaringContainer));
+                _count = k + (_count - i);
+                return(-1);
+            }
+
+            if (c->cardinality > 0) {
+                _containers[k++] = *c;
+                continue;
+            }
+        }
+
+        __container_release(c);
+    }
+
+    _count = k;
+    return(0);
+}
+
+int RoaringBitmap::andNotWith (const RoaringBitmap& other) {
+    RoaringContainer *c;
+    uint32_t i, j, k;
+
+    if (this == &other) {
+        clear();
+        return(0);
+    }
+
+    for (i = j = k = 0; i < _count; ++i) {
+        c = &(_containers[i]);
+        while (j < other._count && other._containers[j].key < c->key)
+            j++;
+
+        if (j < other._count && other._containers[j].key == c->key) {
+            if (__container_andnot(c, &(other._containers[j])) < 0) {
+                memmove(_containers + k, c, (_count - i) * sizeof(RoaringContainer));
+                _count = k + (_count - i);
+                return(-1);
+            }
+
+            if (c->cardinality == 0) {
+                __container_release(c);
+                continue;
+            }
+        }
+
+        _containers[k++] = *c;
+    }
+
+    _count = k;
+    return(0);
+}
+
+int RoaringBitmap::runOptimize (void) {
+    uint64_t scratch[ROARING_BITMAP_WORDS];
+    size_t run_bytes, bytes;
+    RoaringContainer *c;
+    uint64_t *words;
+    uint32_t nruns;
+    uint32_t i;
+
+    for (i = 0; i < _count; ++i) {
+        c = &(_containers[i]);
+        nruns = __container_count_runs(c);
+        run_bytes = nruns * 2 * sizeof(uint16_t);
+
+        if (c->type == ROARING_RUN) {
+            bytes = (c->cardinality <= ROARING_ARRAY_MAX) ?
+                        c->cardinality * sizeof(uint16_t) :
+                        ROARING_BITMAP_WORDS * sizeof(uint64_t);
+            if (bytes < run_bytes) {
+                words = __container_words(c, scratch);
+                if (__container_set_words(c, words, c->cardinality) < 0)
+                    return(-1);
+            }
+        } else if (run_bytes < __container_bytes(c)) {
+            if (__container_to_runs(c, nruns) < 0)
+                return(-1);
+        }
+    }
+
+    return(0);
+}
+
+size_t RoaringBitmap::toArray (uint32_t *values) const {
+    RoaringIterator iter(this);
+    uint64_t total = cardinality();
+    size_t n = 0;
+
+    while (n < total && iter.next(&(values[n])))
+        n++;
+
+    return(n);
+}
+
+size_t RoaringBitmap::memoryUsage (void) const {
+    size_t total;
+    uint32_t i;
+
+    total = _capacity * sizeof(RoaringContainer);
+    for (i = 0; i < _count; ++i)
+        total += _containers[i].capacity;
+
+    return(total);
+}
+
+/* ============================================================================
+ *  Serialization
+ */
+static void __put_le16 (uint8_t *buf, uint16_t v) {
+    buf[0] = v & 0xff;
+    buf[1] = (v >> 8) & 0xff;
+}
+
+static void __put_le32 (uint8_t *buf, uint32_t v) {
+    buf[0] = v & 0xff;
+    buf[1] = (v >> 8) & 0xff;
+    buf[2] = (v >> 16) & 0xff;
+    buf[3] = (v >> 24) & 0xff;
+}
+
+static uint16_t __get_le16 (const uint8_t *buf) {
+    return(buf[0] | ((uint16_t)buf[1] << 8));
+}
+
+static uint32_t __get_le32 (const uint8_t *buf) {
+    return(buf[0] | ((uint32_t)buf[1] << 8) |
+           ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24));
+}
+
+/* Decode and validate a descriptor, returns the payload offset */
+static int __descriptor_decode (RoaringContainer *c, const uint8_t *buf) {
+    memset(c, 0, sizeof(RoaringContainer));
+    c->key = __get_le16(buf);
+    c->type = buf[2];
+    c->cardinality = __get_le32(buf + 4);
+    c->size = __get_le32(buf + 8);
+
+    switch (c->type) {
+        case ROARING_ARRAY:
+            if (c->size == 0 || c->size > ROARING_ARRAY_MAX || c->size != c->cardinality)
+                return(-1);
+            break;
+        case ROARING_BITMAP:
+            if (c->size != ROARING_BITMAP_WORDS ||
+                c->cardinality <= ROARING_ARRAY_MAX ||
+                c->cardinality > ROARING_CHUNK_BITS)
+            {
+                return(-1);
+            }
+            break;
+        case ROARING_RUN:
+            if (c->size == 0 || c->size > (ROARING_CHUNK_BITS / 2) ||
+                c->cardinality == 0 || c->cardinality > ROARING_CHUNK_BITS)
+            {
+                return(-1);
+            }
+            break;
+        default:
+            return(-1);
+    }
+
+    return(0);
+}
+
+/* Validate a payload against its descriptor, the containers rely on
+ * sorted values and on the cardinality (e.g. toArray() buffers).
+ */
+static int __container_validate (const RoaringContainer *c) {
+    const uint16_t *values;
+    uint32_t next, sum;
+    uint32_t i;
+
+    switch (c->type) {
+        case ROARING_ARRAY:
+            values = __values(c);
+            for (i = 1; i < c->size; ++i) {
+                if (values[i] <= values[i - 1])
+                    return(-1);
+            }
+            break;
+        case ROARING_BITMAP:
+            if (__words_count(__words(c)) != c->cardinality)
+                return(-1);
+            break;
+        default:
+            /* Sorted runs, not overlapping and inside the chunk */
+            values = __runs(c);
+            next = 0;
+            sum = 0;
+            for (i = 0; i < c->size; ++i, values += 2) {
+                if (values[0] < next || ((uint32_t)values[0] + values[1]) > 0xffff)
+                    return(-1);
+                next = (uint32_t)values[0] + values[1] + 1;
+                sum += values[1] + 1;
+            }
+            if (sum != c->cardinality)
+                return(-1);
+            break;
+    }
+
+    return(0);
+}
+
+size_t RoaringBitmap::serializedSize (void) const {
+    size_t size;
+    uint32_t i;
+
+    size = ROARING_HEADER_SIZE + _count * ROARING_DESCRIPTOR_SIZE;
+    for (i = 0; i < _count; ++i)
+        size += __ALIGN8(__container_bytes(&(_containers[i])));
+
+    return(size);
+}
+
+int RoaringBitmap::write (Writable *writable) const {
+    static const uint8_t zeros[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+    struct iovec iov[ROARING_WRITEV_BATCH];
+    size_t header_size, batch_size, bytes;
+    const RoaringContainer *c;
+    uint8_t *header, *p;
+    uint32_t offset;
+    uint32_t i;
+    int count;
+
+    header_size = ROARING_HEADER_SIZE + _count * ROARING_DESCRIPTOR_SIZE;
+    if ((header = (uint8_t *)malloc(header_size)) == NULL)
+        return(-1);
+
+    __put_le32(header, ROARING_MAGIC);
+    __put_le32(header + 4, _count);
+
+    offset = header_size;
+    p = header + ROARING_HEADER_SIZE;
+    for (i = 0; i < _count; ++i) {
+        c = &(_containers[i]);
+        __put_le16(p, c->key);
+        p[2] = c->type;
+        p[3] = 0;
+        __put_le32(p + 4, c->cardinality);
+        __put_le32(p + 8, c->size);
+        __put_le32(p + 12, offset);
+        offset += __ALIGN8(__container_bytes(c));
+        p += ROARING_DESCRIPTOR_SIZE;
+    }
+
+    if (writable->writeFully(header, header_size) != (int)header_size) {
+        free(header);
+        return(-1);
+    }
+    free(header);
+
+    /* Payloads and their padding, in writev batches */
+    i = 0;
+    while (i < _count) {
+        count = 0;
+        batch_size = 0;
+        while (i < _count && count < (ROARING_WRITEV_BATCH - 1)) {
+            c = &(_containers[i++]);
+            bytes = __container_bytes(c);
+            iov[count].iov_base = c->data;
+            iov[count].iov_len = bytes;
+            batch_size += bytes;
+            count++;
+
+            if (bytes & 7) {
+                iov[count].iov_base = (void *)zeros;
+                iov[count].iov_len = 8 - (bytes & 7);
+                batch_size += 8 - (bytes & 7);
+                count++;
+            }
+        }
+
+        if (writable->writev(iov, count) != (int)batch_size)
+            return(-1);
+    }
+
+    return(0);
+}
+
+int RoaringBitmap::read (Readable *readable) {
+    uint8_t header[ROARING_HEADER_SIZE];
+    RoaringContainer *containers;
+    uint8_t *descriptors;
+    uint8_t padding[8];
+    size_t offset, bytes, size;
+    RoaringContainer *c;
+    uint32_t count;
+    uint32_t i;
+
+    clear();
+
+    if (readable->readFully(header, ROARING_HEADER_SIZE) != ROARING_HEADER_SIZE)
+        return(-1);
+
+    if (__get_le32(header) != ROARING_MAGIC || (count = __get_le32(header + 4)) > 65536)
+        return(-1);
+
+    size = count * ROARING_DESCRIPTOR_SIZE;
+    if ((descriptors = (uint8_t *)malloc(size + 1)) == NULL)
+        return(-1);
+
+    if (readable->readFully(descriptors, size) != (int)size)
+        goto _failed;
+
+    if (_capacity < count) {
+        containers = (RoaringContainer *)realloc(_containers,
+                                count * sizeof(RoaringContainer));
+        if (containers == NULL)
+            goto _failed;
+
+        _containers = containers;
+        _capacity = count;
+    }
+
+    offset = ROARING_HEADER_SIZE + size;
+    for (i = 0; i < count; ++i) {
+        c = &(_containers[i]);
+        if (__descriptor_decode(c, descriptors + i * ROARING_DESCRIPTOR_SIZE) < 0)
+            goto _failed;
+        if (__get_le32(descriptors + i * ROARING_DESCRIPTOR_SIZE + 12) != offset)
+            goto _failed;
+        if (i > 0 && c->key <= _containers[i - 1].key)
+            goto _failed;
+
+        bytes = __container_bytes(c);
+        c->capacity = (bytes < 16) ? 16 : bytes;
+        if ((c->data = malloc(c->capacity)) == NULL)
+            goto _failed;
+        _count++;
+
+        if (readable->readFully(c->data, bytes) != (int)bytes)
+            goto _failed;
+
+        if (__container_validate(c) < 0)
+            goto _failed;
+
+        if ((bytes & 7) && readable->readFully(padding, 8 - (bytes & 7)) != (int)(8 - (bytes & 7)))
+            goto _failed;
+
+        offset += __ALIGN8(bytes);
+    }
+
+    free(descriptors);
+    return(0);
+
+_failed:
+    free(descriptors);
+    clear();
+    return(-1);
+}
+
+int RoaringBitmap::map (const void *image, size_t size, bool verify) {
+    const uint8_t *pimage = (const uint8_t *)image;
+    RoaringContainer *containers;
+    const uint8_t *desc;
+    RoaringContainer *c;
+    uint32_t offset;
+    uint32_t count;
+    uint32_t i;
+
+    clear();
+
+    if (((uintptr_t)image & 7) != 0 || size < ROARING_HEADER_SIZE)
+        return(-1);
+
+    if (__get_le32(pimage) != ROARING_MAGIC || (count = __get_le32(pimage + 4)) > 65536)
+        return(-1);
+
+    if ((size - ROARING_HEADER_SIZE) / ROARING_DESCRIPTOR_SIZE < count)
+        return(-1);
+
+    if (_capacity < count) {
+        containers = (RoaringContainer *)realloc(_containers,
+                                count * sizeof(RoaringContainer));
+        if (containers == NULL)
+            return(-1);
+
+        _containers = containers;
+        _capacity = count;
+    }
+
+    desc = pimage + ROARING_HEADER_SIZE;
+    for (i = 0; i < count; ++i, desc += ROARING_DESCRIPTOR_SIZE) {
+        c = &(_containers[i]);
+        if (__descriptor_decode(c, desc) < 0)
+            goto _failed;
+
+        offset = __get_le32(desc + 12);
+        if ((offset & 7) != 0 || offset > size || __container_bytes(c) > (size - offset))
+            goto _failed;
+        if (i > 0 && c->key <= _containers[i - 1].key)
+            goto _failed;
+
+        c->mapped = 1;
+        c->data = (void *)(pimage + offset);
+        _count++;
+
+        if (verify && __container_validate(c) < 0)
+            goto _failed;
+    }
+
+    return(0);
+
+_failed:
+    clear();
+    return(-1);
+}
+
+/* ============================================================================
+ *  Roaring Iterator
+ */
+RoaringIterator::RoaringIterator(const RoaringBitmap *bitmap) {
+    _bitmap = bitmap;
+    _container = 0;
+    _pos = 0;
+    _offset = 0;
+    _index = 0;
+}
+
+bool RoaringIterator::next (uint32_t *value) {
+    const RoaringContainer *c;
+    const uint16_t *runs;
+    uint32_t base;
+
+    while (_container < _bitmap->_count) {
+        c = &(_bitmap->_containers[_container]);
+        base = (uint32_t)c->key << 16;
+
+        /* Never more than the declared cardinality (unverified images) */
+        if (_index < c->cardinality) {
+            switch (c->type) {
+                case ROARING_ARRAY:
+                    if (_pos < c->size) {
+                        *value = base | __values(c)[_pos++];
+                        _index++;
+                        return(true);
+                    }
+                    break;
+                case ROARING_BITMAP:
+                    if ((_pos = __words_next(__words(c), _pos, 0)) < ROARING_CHUNK_BITS) {
+                        *value = base | _pos++;
+                        _index++;
+                        return(true);
+                    }
+                    break;
+                default:
+                    if (_pos < c->size) {
+                        runs = __runs(c) + (_pos << 1);
+                        *value = base | ((runs[0] + _offset) & 0xffff);
+                        if (_offset++ == runs[1]) {
+                            _pos++;
+                            _offset = 0;
+                        }
+                        _index++;
+                        return(true);
+                    }
+                    break;
+            }
+        }
+
+        _container++;
+        _pos = 0;
+        _offset = 0;
+        _index = 0;
+    }
+
+    return(false);
+}
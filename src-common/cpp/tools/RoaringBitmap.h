@@ -0,0 +1,119 @@
+/*
+ *   Copyright 2012 Matteo Bertozzi
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef _ROARING_BITMAP_H_
+#define _ROARING_BITMAP_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "Readable.h"
+#include "Writable.h"
+
+#define ROARING_ARRAY_MAX           4096    /* above this a chunk is a bitmap */
+#define ROARING_BITMAP_WORDS        1024    /* 64K bits */
+
+struct RoaringContainer;
+class RoaringIterator;
+
+/*
+ * Compressed set of uint32 values. The values are split in 64K chunks
+ * by their high 16 bits, each chunk is a sorted uint16 array (sparse),
+ * a 64K bitmap (dense) or a list of runs (see runOptimize()).
+ *
+ * Serialized image (little-endian, all the payloads 8-byte aligned):
+ *   magic u32 | count u32 | count * {key u16, type u8, pad u8,
+ *   cardinality u32, size u32, offset u32} | payloads
+ * map() uses the image in place, containers are copied on first write.
+ * read() and map() validate the payloads: sorted values, runs inside the
+ * chunk, and the declared cardinality.
+ */
+class RoaringBitmap {
+    public:
+        RoaringBitmap();
+        RoaringBitmap(const RoaringBitmap& other);
+        ~RoaringBitmap();
+
+        RoaringBitmap& operator= (const RoaringBitmap& other);
+
+#if __cplusplus >= 201103L
+        RoaringBitmap(RoaringBitmap&& other);
+        RoaringBitmap& operator= (RoaringBitmap&& other);
+#endif
+
+        void swap (RoaringBitmap& other);
+        void clear (void);
+
+        int add      (uint32_t value);
+        int addRange (uint64_t start, uint64_t end);     /* [start, end) */
+        int remove   (uint32_t value);
+        bool contains (uint32_t value) const;
+
+        bool isEmpty (void) const { return(_count == 0); }
+        uint64_t cardinality (void) const;
+
+        /* In-place set operations */
+        int orWith     (const RoaringBitmap& other);
+        int andWith    (const RoaringBitmap& other);
+        int andNotWith (const RoaringBitmap& other);
+
+        /* Turn the chunks into runs where smaller (and back) */
+        int runOptimize (void);
+
+        /* Fill 'values' (at most cardinality() entries) in ascending order */
+        size_t toArray (uint32_t *values) const;
+
+        /* Heap used by the containers (mapped payloads excluded) */
+        size_t memoryUsage (void) const;
+        size_t containers (void) const { return(_count); }
+
+        size_t serializedSize (void) const;
+        int write (Writable *writable) const;
+        int read  (Readable *readable);
+
+        /* 'image' must be 8-byte aligned and outlive the bitmap.
+         * The payloads are validated as in read(), verify=false skips
+         * the pass for trusted images only (e.g. written by this process).
+         */
+        int map (const void *image, size_t size, bool verify=true);
+
+    private:
+        RoaringContainer *fetchContainer (uint16_t key);
+        void eraseContainer (uint32_t index);
+
+    private:
+        friend class RoaringIterator;
+
+        RoaringContainer *_containers;
+        uint32_t _count;
+        uint32_t _capacity;
+};
+
+class RoaringIterator {
+    public:
+        RoaringIterator(const RoaringBitmap *bitmap);
+
+        bool next (uint32_t *value);
+
+    private:
+        const RoaringBitmap *_bitmap;
+        uint32_t _container;
+        uint32_t _pos;          /* array index, bit or run index */
+        uint32_t _offset;       /* position inside the current run */
+        uint32_t _index;        /* values returned from the container */
+};
+
+#endif /* !_ROARING_BITMAP_H_ */